@@ -149,6 +149,18 @@ void JImGui::newFrame() {
     }
 
 
+    //occlusion, packed with roughness and metallic
+    ImGui::Separator();
+    ImGui::Text("Occlusion");
+    const char* OcclusionButton = uiSettings.inputOcclusionPath ? "No Occlusion##occlusion" : "Input Path##occlusion";
+    if(ImGui::Button(OcclusionButton)){
+        uiSettings.inputOcclusionPath = !uiSettings.inputOcclusionPath;    }
+
+    if(uiSettings.inputOcclusionPath){
+        ImGui::InputText("File Path##occlusion", uiSettings.occlusionTexPath, sizeof(uiSettings.occlusionTexPath));
+    }
+
+
     //roughness
     ImGui::Separator();
     ImGui::Text("Roughness");
@@ -189,6 +201,18 @@ void JImGui::newFrame() {
     }else{
         // ImGui::SliderFloat("Float", &uiSettings.roughness, 0.f, 1.0f);
     }
+
+
+    //environment, old sky stays until the new one is baked
+    ImGui::Separator();
+    ImGui::Text("Environment");
+    const char* EnvMapButton = uiSettings.inputEnvMapPath ? "Keep Current##envmap" : "Input Path##envmap";
+    if(ImGui::Button(EnvMapButton)){
+        uiSettings.inputEnvMapPath = !uiSettings.inputEnvMapPath;    }
+
+    if(uiSettings.inputEnvMapPath){
+        ImGui::InputText("HDR Path##envmap", uiSettings.envMapPath, sizeof(uiSettings.envMapPath));
+    }
     ImGui::End();
 
     
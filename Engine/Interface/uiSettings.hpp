@@ -17,6 +17,9 @@ struct UISettings{
     bool inputAlbedoPath = false;
     char albedoTexPath[256];
 
+    bool inputOcclusionPath = false;
+    char occlusionTexPath[256];
+
     bool inputRoughnessPath = false;
     char roughnessTexPath[256];
 
@@ -26,6 +29,10 @@ struct UISettings{
     bool inputNormalPath = false;
     char normalTexPath[256];
 
+    //equirect hdr, baked in the background and swapped in when ready
+    bool inputEnvMapPath = false;
+    char envMapPath[256];
+
 };
 
 
@@ -3,6 +3,7 @@
 
 #include "./Renderers/RenderingSystem.hpp"
 #include "./VulkanCore/structs/uniforms.hpp"
+#include <algorithm>
 
 
 #include "./Interface/keyboardController.hpp"
@@ -41,6 +42,8 @@ void JRenderApp::run(){
 
 
 
+    uint64_t frameIndex = 0;
+
     while (!glfwWindowShouldClose(window_app.getGLFWwindow())) {
         glfwPollEvents(); // 遍历所有的callback
         
@@ -55,8 +58,12 @@ void JRenderApp::run(){
         // Start ImGui frame
         interactiveSystem_->getImguiApp().newFrame();
         
+        // texture streaming at frame boundary, before recording
+        renderingSystem_->updateStreaming(perspMatrix, viewMatrix, ++frameIndex);
+        renderingSystem_->updatePrecompute(interactiveSystem_->getUISettings(), frameIndex);
+
         // Apply any material/texture updates before recording begins
-        renderingSystem_->updateMaterial(interactiveSystem_->getUISettings());
+        renderingSystem_->updateMaterial(interactiveSystem_->getUISettings(), frameIndex);
 
         //if command buffer has something/working.. otherwise if it is return nullptr, will go else branch
         if(VkCommandBuffer commandBuffer = renderer_app.beginFrame()){
@@ -70,6 +77,7 @@ void JRenderApp::run(){
             ubo.projection[1][1] *= -1;
             ubo.invView = glm::inverse(viewMatrix);
             ubo.camPos = glm::vec3(ubo.invView[3]);
+            std::copy(renderingSystem_->getIrradianceSH().begin(), renderingSystem_->getIrradianceSH().end(), ubo.irradianceSH);
             
             // Debug camera position
             // static int frameCount = 0;
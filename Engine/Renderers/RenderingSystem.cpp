@@ -2,33 +2,46 @@
 #include "../VulkanCore/pipeline.hpp"
 #include "../VulkanCore/descriptor/descriptor.hpp"
 #include "../VulkanCore/descriptor/descriptorAllocator.hpp"
+#include "../VulkanCore/descriptor/bindlessTable.hpp"
+#include "../VulkanCore/descriptor/frameDescriptorArena.hpp"
+#include "../VulkanCore/descriptor/descriptorSetCache.hpp"
 #include "../VulkanCore/buffer.hpp"
 #include "../VulkanCore/material/load_texture.hpp"
+#include "../VulkanCore/material/imageDecode.hpp"
 #include "../VulkanCore/material/PBRmaterial.hpp"
+#include "../VulkanCore/material/streamingTexture.hpp"
 #include "../VulkanCore/load_model.hpp"
 #include "../VulkanCore/structs/uniforms.hpp"
 #include "../VulkanCore/structs/pushConstants.hpp"
 #include "../VulkanCore/shaderModule.hpp"
 #include "../VulkanCore/commandBuffer.hpp"
 #include "precomputeSystem.hpp"
+#include "brdfLut.hpp"
 #include "../Interface/uiSettings.hpp"
 
 #include "ktx.h"
+#include <cstdlib>
+#include <cstring>
 
 
 RenderingSystem::RenderingSystem(JDevice& device, const JSwapchain& swapchain):
     device_app(device), swapchain_app(swapchain)
 {
     samplerManager_app = std::make_unique<SamplerManager>(device_app);
+    textureStreamer_app = std::make_unique<TextureStreamer>(device_app);
     createDescriptorResources();
     createPipelineResources();
-    createBRDFLUT();  //need to be moved to precomputeSystem
+    createBRDFLUT();
     loadAssets();
+    precompSystem_app = std::make_unique<PrecomputeSystem>(device_app);
+    bakeSliceMs_ = bakeSliceMsFromEnv();
     loadEnvMaps();
-    // Use the skybox cubemap as the base environment map for precomputation
+    // Use the skybox cubemap as the base environment map for precomputation.
+    // prefilter bakes on the compute queue, first frame does not wait for it (see updatePrecompute)
     auto* skyboxCubemap = static_cast<JCubemap*>(cubemaps_["skybox"].get());
-    precompSystem_app = std::make_unique<PrecomputeSystem>(device_app, *skyboxCubemap);
-    loadPrecomputedResources();
+    const bool prefilterBaking = precompSystem_app->beginPrefilterBake(*skyboxCubemap, bakeSliceMs_);
+    irradianceSH_ = precompSystem_app->projectIrradianceSH(*skyboxCubemap);
+    loadPrecomputedResources(!prefilterBaking);
     bindGlobalStatic();
 
 }
@@ -41,143 +54,61 @@ RenderingSystem::~RenderingSystem(){
 
 
 
-void RenderingSystem::loadPrecomputedResources(){
+//raw ktx2 goes straight from the mmapped file into staging, zstd levels are inflated in parallel on the way.
+//basis / zlib one is transcoded by libktx first
+static std::unique_ptr<JTextureBase> loadKtx2Texture(JDevice& device, const std::string& path){
+    MappedFile file(path);
+    TexUtils::Ktx2Header header;
+    if(TexUtils::parseKtx2Header(file, header) &&
+       TexUtils::isKtx2Readable(header) && header.vkFormat != VK_FORMAT_UNDEFINED){
+        TextureConfig config = TexUtils::Ktx2TextureConfig(header);
+        auto texture = std::make_unique<JTextureBase>(device, config);
+        TexUtils::UploadKtx2ToTexture(device, file, header, *texture);
+        return texture;
+    }
 
-    /* load in BRDF LUT */
-    ktxTexture2* ktxTex_brdf = nullptr;
-    if(ktxTexture2_CreateFromNamedFile("../data/BRDF_LUT.ktx", 
-            KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTex_brdf) != KTX_SUCCESS){
-        throw std::runtime_error("Failed to load BRDF lUT ktx file");      }
-    TextureConfig brdf_config = {
-        .format = static_cast<VkFormat>(ktxTex_brdf->vkFormat),
-        .channels = ktxTexture2_GetNumComponents(ktxTex_brdf),
+    ktxTexture2* ktxTex = nullptr;
+    if(ktxTexture2_CreateFromNamedFile(path.c_str(), 
+            KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTex) != KTX_SUCCESS){
+        throw std::runtime_error("ktx file load failed: " + path);      }
+    const bool isCube = (ktxTex->numFaces == 6);
+    TextureConfig config = {
+        .format = static_cast<VkFormat>(ktxTex->vkFormat),
+        .channels = ktxTexture2_GetNumComponents(ktxTex),
         .imageType = VK_IMAGE_TYPE_2D,
         .usageFlags = VK_IMAGE_USAGE_SAMPLED_BIT|VK_IMAGE_USAGE_TRANSFER_SRC_BIT|VK_IMAGE_USAGE_TRANSFER_DST_BIT,
-        .extent = {ktxTex_brdf->baseWidth, ktxTex_brdf->baseHeight, 1},
-        .mipLevels = ktxTex_brdf->numLevels,
+        .createFlags = isCube ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0u,
+        .extent = {ktxTex->baseWidth, ktxTex->baseHeight, 1},
+        .mipLevels = ktxTex->numLevels,
         .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        .viewType = VK_IMAGE_VIEW_TYPE_2D,
-        .arrayLayers = 1,
+        .viewType = isCube ? VK_IMAGE_VIEW_TYPE_CUBE : VK_IMAGE_VIEW_TYPE_2D,
+        .arrayLayers = isCube ? 6u : 1u,
     };
-    brdf_lut = std::make_unique<JTextureBase>(device_app, brdf_config);
-    TexUtils::UploadKtxToTexture(device_app, ktxTex_brdf, *brdf_lut, /*isCube*/false);
-    ktxTexture2_Destroy(ktxTex_brdf);
-
+    auto texture = std::make_unique<JTextureBase>(device, config);
+    TexUtils::UploadKtxToTexture(device, ktxTex, *texture, isCube);
+    ktxTexture2_Destroy(ktxTex);
+    return texture;
+}
 
 
-    /* load in irradiance */
-    ktxTexture2* ktxTex_irrad = nullptr;
-    if(ktxTexture2_CreateFromNamedFile("../data/irradianceMap.ktx", 
-            KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTex_irrad) != KTX_SUCCESS){
-        throw std::runtime_error("ktx file load failed");      }
-    const bool irradIsCube = (ktxTex_irrad->numFaces == 6);
-    TextureConfig irrad_config = {
-        .format = static_cast<VkFormat>(ktxTex_irrad->vkFormat),
-        .channels = ktxTexture2_GetNumComponents(ktxTex_irrad),
-        .imageType = VK_IMAGE_TYPE_2D,
-        .usageFlags = VK_IMAGE_USAGE_SAMPLED_BIT|VK_IMAGE_USAGE_TRANSFER_SRC_BIT|VK_IMAGE_USAGE_TRANSFER_DST_BIT,
-        .createFlags = irradIsCube ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0u,
-        .extent = {ktxTex_irrad->baseWidth, ktxTex_irrad->baseHeight, 1},
-        .mipLevels = ktxTex_irrad->numLevels,
-        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        .viewType = irradIsCube ? VK_IMAGE_VIEW_TYPE_CUBE : VK_IMAGE_VIEW_TYPE_2D,
-        .arrayLayers = irradIsCube ? 6u : 1u,
-    };
-    irradianceMap = std::make_unique<JTextureBase>(device_app, irrad_config);
-    TexUtils::UploadKtxToTexture(device_app, ktxTex_irrad, *irradianceMap, true);
-    ktxTexture2_Destroy(ktxTex_irrad);
-    
-         
-    /* load in prefilter */
-    ktxTexture2* ktxTex_prefilter = nullptr;
-    if(ktxTexture2_CreateFromNamedFile("../data/prefilterEnvMap.ktx", 
-            KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTex_prefilter) != KTX_SUCCESS){
-        throw std::runtime_error("ktx file load failed");      }
-    const bool prefilterIsCube = (ktxTex_prefilter->numFaces == 6);
-    TextureConfig prefilter_config = {
-        .format = static_cast<VkFormat>(ktxTex_prefilter->vkFormat),
-        .channels = ktxTexture2_GetNumComponents(ktxTex_prefilter),
-        .imageType = VK_IMAGE_TYPE_2D,
-        .usageFlags = VK_IMAGE_USAGE_SAMPLED_BIT|VK_IMAGE_USAGE_TRANSFER_SRC_BIT|VK_IMAGE_USAGE_TRANSFER_DST_BIT,
-        .createFlags = prefilterIsCube ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0u,
-        .extent = {ktxTex_prefilter->baseWidth, ktxTex_prefilter->baseHeight, 1},
-        .mipLevels = ktxTex_prefilter->numLevels,
-        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        .viewType = prefilterIsCube ? VK_IMAGE_VIEW_TYPE_CUBE : VK_IMAGE_VIEW_TYPE_2D,
-        .arrayLayers = prefilterIsCube ? 6u : 1u,
-    };
-    prefilterEnvmap = std::make_unique<JTextureBase>(device_app, prefilter_config);
-    TexUtils::UploadKtxToTexture(device_app, ktxTex_prefilter, *prefilterEnvmap, true);
-    ktxTexture2_Destroy(ktxTex_prefilter);
+void RenderingSystem::loadPrecomputedResources(bool loadPrefilter){
+    if(loadPrefilter){
+        setPrefilterEnvmap(loadKtx2Texture(device_app, kPrefilterEnvMapPath));}
 
+    TexUtils::logLoadStats("precomputed maps loaded");
 }
 
 
 void RenderingSystem::createBRDFLUT(){
-
-
-    storageBuffer_ = std::make_unique<JBuffer>(device_app, bufferSize, 
-                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT|VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT|VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT      );
-
-   //BRDF LUT -----------------------------------------------------------------------------
-   pushBRDFStruct brdfPushConstant{};
-   brdfPushConstant.BRDF_H = brdf_h;
-   brdfPushConstant.BRDF_W = brdf_w;
-   brdfPushConstant.bufferAddr = storageBuffer_->getBufferAddress();
-
-   JCommandBuffer commandBuffer(device_app, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
-   commandBuffer.beginSingleTimeCommands();
-   
-   vkCmdBindPipeline(commandBuffer.getCommandBuffer(), VK_PIPELINE_BIND_POINT_COMPUTE, brdfComputePipeline_app->getComputePipeline());
-   vkCmdPushConstants(commandBuffer.getCommandBuffer(), brdfPipelineLayout_app->getPipelineLayout(), 
-                       VK_SHADER_STAGE_COMPUTE_BIT, 0, 
-                       sizeof(brdfPushConstant), &brdfPushConstant);
-   vkCmdDispatch(commandBuffer.getCommandBuffer(), (brdf_w / 16), (brdf_h / 16), 1);
-   //用graphicqueue来计算compute的东西
-   commandBuffer.endSingleTimeCommands(device_app.graphicsQueue());
-
-
-   //write to ktx file
-   
-   ktxTextureCreateInfo ktxCreateInfo{};
-   ktxCreateInfo.vkFormat         = VK_FORMAT_R16G16B16A16_SFLOAT;
-   ktxCreateInfo.baseWidth        = brdf_w;
-   ktxCreateInfo.baseHeight       = brdf_h;
-   ktxCreateInfo.baseDepth        = 1;
-   ktxCreateInfo.numDimensions    = 2;
-   ktxCreateInfo.numLayers        = 1;
-   ktxCreateInfo.numLevels        = 1;
-   ktxCreateInfo.numFaces         = 1;
-   ktxCreateInfo.generateMipmaps  = KTX_FALSE;
-   ktxCreateInfo.isArray          = KTX_FALSE;
-   
-   ktxTexture2* lutTexture = nullptr;
-   if (ktxTexture2_Create(&ktxCreateInfo, KTX_TEXTURE_CREATE_ALLOC_STORAGE, &lutTexture) != KTX_SUCCESS){
-       throw std::runtime_error("BRDF LUT ktx file create failed!");   };
-       
-    
-    JBuffer stagingBuffer(device_app, storageBuffer_->getSize(),   // in gpu but cpu can access
-                VK_BUFFER_USAGE_TRANSFER_DST_BIT, 
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT|VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-    util::copyBuffer(storageBuffer_->buffer() , stagingBuffer.buffer(),  storageBuffer_->getSize(), 
-            device_app.device(), device_app.getCommandPool(), device_app.graphicsQueue()); 
-
-    stagingBuffer.map();    
-
-    const ktx_size_t imageSize = static_cast<ktx_size_t>(brdf_w) * brdf_h * 4 * sizeof(uint16_t);
-    if(ktxTexture_SetImageFromMemory(ktxTexture(lutTexture), /*level*/0, /*layer*/0, /*faceSlice*/0,
-                            reinterpret_cast<const ktx_uint8_t*>(stagingBuffer.getBufferMapped()), imageSize )
-              != KTX_SUCCESS)
-    {
-        throw std::runtime_error("BRDF LUT ktx texture set image from memory failed!") ;
-    };
-
-    ktxTexture2_WriteToNamedFile(lutTexture, "../data/BRDF_LUT.ktx");
-    ktxTexture2_Destroy(lutTexture);
-
-    stagingBuffer.unmap();
+    //compiled in (brdfLut.hpp), straight into staging
+    TextureConfig config;
+    config.format       = kBrdfLutFormat;
+    config.channels     = 2;
+    config.usageFlags   = VK_IMAGE_USAGE_SAMPLED_BIT|VK_IMAGE_USAGE_TRANSFER_SRC_BIT|VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    config.extent       = {kBrdfLutSize, kBrdfLutSize, 1};
+    config.mipLevels    = 1;
+    config.writeData    = [](void* dst){ std::memcpy(dst, kBrdfLutData, kBrdfLutBytes); };
+    brdf_lut = std::make_unique<JTextureBase>(device_app, config);
 }
 
 
@@ -185,16 +116,8 @@ void RenderingSystem::createBRDFLUT(){
  
 void RenderingSystem::createDescriptorResources(){
 
-    //create poolsize
-    // Reserve enough descriptors for UBOs and image samplers (materials + IBL)
-    std::vector<VkDescriptorPoolSize> poolSizes = 
-    {
-        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,             8},
-        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,     32},
-    };
-
-    // create descriptor allocator (create descriptor pool)
-    descriptorAllocator_obj = std::make_shared<JDescriptorAllocator>(device_app, poolSizes, 10);
+    // create descriptor allocator. pools per set layout, sized from its bindings and doubled when one fills
+    descriptorAllocator_obj = std::make_shared<JDescriptorAllocator>(device_app, 10);
 
 
     //create descriptor set layout
@@ -213,27 +136,33 @@ void RenderingSystem::createDescriptorResources(){
         .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1) 
         //brdf lut
         .addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1) 
-        //irradiance map
+        //prefiltered envmap  (irradiance is sh9 in the global ubo)
         .addBinding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1) 
-        //prefiltered envmap
-        .addBinding(3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1) 
         .build();
 
     /*  PBR material
-        0: albedo , 1: roughness, 2: metallic, 3: normal */
+        0: albedo , 1: occlusion/roughness/metallic packed, 2: normal */
     descriptorSetLayout_asset = JDescriptorSetLayout::Builder{device_app}
         .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
         .addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
         .addBinding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
-        .addBinding(3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
         .build();
 
+    /*  bindless (replace the per material set when supported)
+        0: all textures, 1: material buffer */
+    if(device_app.bindlessSupported()){
+        bindlessTable_app = std::make_unique<JBindlessTable>(device_app);}
+    //per material sets otherwise, deduplicated unless JRENDERER_DESCRIPTOR_CACHE=0
+    else if(const char* cache = std::getenv("JRENDERER_DESCRIPTOR_CACHE"); !(cache && std::string(cache) == "0")){
+        descriptorSetCache_ = std::make_unique<JDescriptorSetCache>(device_app, *descriptorAllocator_obj);}
+
     
 
-    descriptorSets_glob.reserve(Global::MAX_FRAMES_IN_FLIGHT);
-    //assign ubo descriptor set
+    //sets that live for one frame (the ubo set, anything a pass builds per frame)
+    frameDescriptors_ = std::make_unique<JFrameDescriptorArena>(device_app);
+
+    //ubo per frame in flight, its set is built every frame in render()
     uniformBuffer_objs.reserve(Global::MAX_FRAMES_IN_FLIGHT);
-    JDescriptorWriter writer_glob{*descriptorSetLayout_glob, descriptorAllocator_obj->getDescriptorPool() };  
     for(size_t i =0; i< Global::MAX_FRAMES_IN_FLIGHT; ++i)
     {
         //create uniform buffer
@@ -244,40 +173,12 @@ void RenderingSystem::createDescriptorResources(){
             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
         buffer->map();
         uniformBuffer_objs.emplace_back( std::move(buffer) );
-
-        auto& ubo = *uniformBuffer_objs.back();
-        auto bufferInfo = ubo.descriptorInfo();
-        VkDescriptorSet desSet;
-        if( !writer_glob
-                    .writeBuffer(0, &bufferInfo)
-                    .build(desSet)){ throw std::runtime_error("failed to allocate descriptor set!");    }  
-
-        descriptorSets_glob.push_back(desSet);
     }    
 }
 
 
 
 void RenderingSystem::createPipelineResources(){
-    //compute pipeline -- for BRDF LUT
-    auto code = util::readFile("../shaders/BRDF_LUT.comp.spv");
-    brdfComputeShader = std::make_unique<JShaderModule>(device_app.device(), code);
-
-    VkPushConstantRange brdf_pushConstantRange{};
-    brdf_pushConstantRange.stageFlags    = VK_SHADER_STAGE_COMPUTE_BIT;
-    brdf_pushConstantRange.offset        = 0;
-    brdf_pushConstantRange.size          = sizeof(uint32_t) * 2 + sizeof(uint64_t); //BRDF_W + BRDF_H + buffer address
-
-    brdfPipelineLayout_app = JPipelineLayout::Builder{device_app}
-                            .setPushConstRanges(1, &brdf_pushConstantRange)
-                            .build();
-
-    brdfComputePipeline_app = std::make_unique<JComputePipeline>(
-                                device_app, *brdfComputeShader,
-                                brdfPipelineLayout_app->getPipelineLayout());    
-
-
-
     //create shader stage
     shaderStages_main = std::make_unique<JShaderStages>(
         JShaderStages::Builder(device_app)
@@ -318,6 +219,30 @@ void RenderingSystem::createPipelineResources(){
     pipeline_app = std::make_unique<JPipeline>(device_app, swapchain_app,
                     pipelinelayout_app->getPipelineLayout(), pipelineConfig);
 
+    //bindless pipeline, same vertex shader, fragment compiled with -DBINDLESS
+    if(bindlessTable_app){
+        shaderStages_bindless = std::make_unique<JShaderStages>(
+            JShaderStages::Builder(device_app)
+                            .setVert("../shaders/shader.vert.spv")
+                            .setFrag( "../shaders/shader_bindless.frag.spv")
+                            .build());
+        auto& stages_bindless = shaderStages_bindless->getStageInfos();
+        pipelineConfig.pStages = stages_bindless.data();
+        pipelineConfig.stageCount = static_cast<uint32_t>(stages_bindless.size());
+
+        //set 0 and 1 are the same, so the global sets stay valid when switching layout
+        VkDescriptorSetLayout setLayouts_bindless[] = {
+                    descriptorSetLayout_glob->descriptorSetLayout(), 
+                    descriptorSetLayout_glob_static->descriptorSetLayout(),
+                    bindlessTable_app->getDescriptorSetLayout().descriptorSetLayout()};
+        pipelinelayout_bindless_app = JPipelineLayout::Builder{device_app}
+                            .setDescriptorSetLayout(3, setLayouts_bindless)
+                            .setPushConstRanges(1, &pushConstanRange)
+                            .build();  
+        pipeline_bindless_app = std::make_unique<JPipeline>(device_app, swapchain_app,
+                        pipelinelayout_bindless_app->getPipelineLayout(), pipelineConfig);
+    }
+
 
     //skybox pipeline
     shaderStages_skybox = std::make_unique<JShaderStages>(
@@ -345,12 +270,23 @@ void RenderingSystem::createPipelineResources(){
 void RenderingSystem::render(VkCommandBuffer commandBuffer, 
                                 uint32_t currentFrame, const UI::UISettings& uiSettings ){
 
+    //the frame's fence has signaled (Renderer::beginFrame), what this slot allocated last time is free again
+    frameDescriptors_->beginFrame(currentFrame);
+    if(descriptorSetCache_){ descriptorSetCache_->beginFrame(); }
+    if(bindlessTable_app){ bindlessTable_app->beginFrame(currentFrame); }
+    for(auto& [name, material] : materials_){ material->beginFrame(); }
+    auto uboInfo = uniformBuffer_objs[currentFrame]->descriptorInfo();
+    VkDescriptorSet globSet;
+    JDescriptorWriter(*descriptorSetLayout_glob, frameDescriptors_->allocator())
+                    .writeBuffer(0, &uboInfo)
+                    .build(globSet);
+
     /* --------------------------------
      ------------ skybox ------------
     ----------------------------------*/
     vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_skybox_app->getGraphicPipeline());
     VkDescriptorSet glob_bind_forSkybox[1] = {
-        descriptorSets_glob[currentFrame]
+        globSet
     };
 
     vkCmdBindDescriptorSets(commandBuffer, 
@@ -366,7 +302,7 @@ void RenderingSystem::render(VkCommandBuffer commandBuffer,
     // Bind static descriptors (cubemap)
     if (!descriptorSets_glob_static.empty()) {
         VkDescriptorSet glob_static_bind[1] = {
-            descriptorSets_glob_static[0]
+            descriptorSets_glob_static[staticSet_]
         };
 
         vkCmdBindDescriptorSets(commandBuffer, 
@@ -392,31 +328,35 @@ void RenderingSystem::render(VkCommandBuffer commandBuffer,
     /* --------------------------------
      --- Now render regular objects ---
     ----------------------------------*/
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_app->getGraphicPipeline());
+    const bool bindless = (pipeline_bindless_app != nullptr);
+    VkPipelineLayout assetLayout = bindless ? pipelinelayout_bindless_app->getPipelineLayout()
+                                            : pipelinelayout_app->getPipelineLayout();
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, 
+                bindless ? pipeline_bindless_app->getGraphicPipeline() : pipeline_app->getGraphicPipeline());
 
     // Bind global dynamic descriptors (camera UBO)
     VkDescriptorSet glob_bind_forAssets[1] = {
-        descriptorSets_glob[currentFrame]
+        globSet
     };
 
     vkCmdBindDescriptorSets(commandBuffer, 
                 VK_PIPELINE_BIND_POINT_GRAPHICS, 
-                pipelinelayout_app->getPipelineLayout(),
+                assetLayout,
                 0,/* firstSet */
                 1, /* descriptorSetCount */
                 glob_bind_forAssets, /* *pDescriptorSets */
                 0, 
                 nullptr );
 
-    // Bind global static descriptors (IBL textures: BRDF, irradiance, prefilter)
+    // Bind global static descriptors (IBL textures: BRDF, prefilter)
     if (!descriptorSets_glob_static.empty()) {
         VkDescriptorSet glob_static_bind_assets[1] = {
-            descriptorSets_glob_static[0]
+            descriptorSets_glob_static[staticSet_]
         };
 
         vkCmdBindDescriptorSets(commandBuffer, 
                     VK_PIPELINE_BIND_POINT_GRAPHICS, 
-                    pipelinelayout_app->getPipelineLayout(),
+                    assetLayout,
                     1,/* firstSet */
                     1, /* descriptorSetCount */
                     glob_static_bind_assets, /* *pDescriptorSets */
@@ -424,6 +364,11 @@ void RenderingSystem::render(VkCommandBuffer commandBuffer,
                     nullptr );
     }
 
+    // Bindless: all material textures in one set, bound once for every draw
+    if (bindless) {
+        bindlessTable_app->bind(commandBuffer, assetLayout, 2);
+    }
+
     // loop all collected assets, and all bind, also aplied push constant
     for (auto& asset : sceneAssets )
     {   
@@ -441,13 +386,16 @@ void RenderingSystem::render(VkCommandBuffer commandBuffer,
         transformPushData.inputAlbedoPath = uiSettings.inputAlbedoPath ? 1 : 0;
         transformPushData.inputRoughnessPath = uiSettings.inputRoughnessPath ? 1 : 0;
         transformPushData.inputMetallicPath = uiSettings.inputMetallicPath ? 1 : 0;
+        transformPushData.inputOcclusionPath = uiSettings.inputOcclusionPath ? 1 : 0;
         transformPushData.inputNormalPath = uiSettings.inputNormalPath ? 1 : 0;
+        //record in this frame's slice of the material buffer
+        transformPushData.materialIndex = bindless ? static_cast<int>(bindlessTable_app->materialRecord(obj.material->getMaterialIndex())) : 0;
 
-        vkCmdPushConstants(commandBuffer, pipelinelayout_app->getPipelineLayout(), 
+        vkCmdPushConstants(commandBuffer, assetLayout, 
             VK_SHADER_STAGE_VERTEX_BIT|VK_SHADER_STAGE_FRAGMENT_BIT, 0, 
             sizeof(pushTransformation), &transformPushData );
 
-        obj.material->bind(commandBuffer, pipelinelayout_app->getPipelineLayout());
+        obj.material->bind(commandBuffer, assetLayout); //no-op in bindless mode
         obj.model->bind(commandBuffer); //bind vertex buffer and index buffer
         obj.model->draw(commandBuffer); 
     }
@@ -464,10 +412,8 @@ void RenderingSystem::loadAssets(){
 
     // std::shared_ptr<JTexture2D> fruit_albedo = std::make_shared<JTexture2D>(device_app, "../assets/Cerberus/Cerberus_A.tga", VK_FORMAT_R8G8B8A8_SRGB);
     // textures_["pomoFruit_Albedo"] = fruit_albedo;
-    // std::shared_ptr<JTexture2D> fruit_rough = std::make_shared<JTexture2D>(device_app, "../assets/Cerberus/Cerberus_R.tga", VK_FORMAT_R8G8B8A8_UNORM);  //has to be 4 channels
-    // textures_["pomoFruit_Roughness"] = fruit_rough;
-    // std::shared_ptr<JTexture2D> fruit_metallic = std::make_shared<JTexture2D>(device_app, "../assets/Cerberus/Cerberus_M.tga", VK_FORMAT_R8G8B8A8_UNORM);
-    // textures_["pomoFruit_Metallic"] = fruit_metallic;
+    // std::shared_ptr<JORMTexture> fruit_orm = std::make_shared<JORMTexture>(device_app, "", "../assets/Cerberus/Cerberus_R.tga", "../assets/Cerberus/Cerberus_M.tga");
+    // textures_["pomoFruit_ORM"] = fruit_orm;
     // std::shared_ptr<JTexture2D> fruit_normal = std::make_shared<JTexture2D>(device_app, "../assets/Cerberus/Cerberus_N.tga", VK_FORMAT_R8G8B8A8_UNORM);
     // textures_["pomoFruit_Normal"] = fruit_normal;
 
@@ -475,12 +421,13 @@ void RenderingSystem::loadAssets(){
     //allocate descriptor automatically in material class
     std::shared_ptr<JPBRMaterial> pbrMat = std::make_shared<JPBRMaterial>(device_app, 
                                                                         descriptorAllocator_obj, 
-                                                                        descriptorSetLayout_asset->descriptorSetLayout(),
-                                                                        *samplerManager_app);
+                                                                        *descriptorSetLayout_asset,
+                                                                        *samplerManager_app,
+                                                                        bindlessTable_app.get(),
+                                                                        descriptorSetCache_.get());
     // pbrMat->setAlbedoTexture(*fruit_albedo);
-    // pbrMat->setRoughnessTexture(*fruit_rough);
+    // pbrMat->setORMTexture(*fruit_orm);
     // pbrMat->setNormalTexture(*fruit_normal);
-    // pbrMat->setMetallicTexture(*fruit_metallic);
     materials_["pomoFruit_mat"] = pbrMat;
     
     auto pomoFruit = Scene::JAsset::createAsset();
@@ -495,7 +442,11 @@ void RenderingSystem::loadAssets(){
 
 
 void RenderingSystem::loadEnvMaps(){
-    std::shared_ptr<JCubemap> skybox_texture = std::make_shared<JCubemap>("../assets/rustig_koppie_1k.hdr", device_app);
+    const std::string skyboxPath = "../assets/rustig_koppie_1k.hdr";
+    //JRENDERER_CUBEMAP_CONVERSION=gpu: resample with compute, otherwise on the cpu
+    std::shared_ptr<JCubemap> skybox_texture = (cubemapConversionFromEnv() == CubemapConversion::GPU)
+        ? precompSystem_app->createCubemapFromEquirect(skyboxPath, *samplerManager_app)
+        : std::make_shared<JCubemap>(skyboxPath, device_app, *samplerManager_app);
     // std::shared_ptr<JCubemap> skybox_texture = std::make_shared<JCubemap>("../assets/park_music_stage_2k.hdr", device_app);
     cubemaps_["skybox"] = skybox_texture;
 
@@ -515,40 +466,95 @@ void RenderingSystem::loadEnvMaps(){
 
 
 void RenderingSystem::bindGlobalStatic(){
+    //specific samplers from the cache
+    auto BrdfSamplerInfo = SamplerCreateInfoBuilder()
+                    .addressMode(VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE)
+                    .maxLod(0)
+                    .getInfo();
+    brdf_lut->createCustomSampler(*samplerManager_app, BrdfSamplerInfo);
+
+    //both written now, a swap only rewrites the one no frame binds
+    for(int i = 0; i < 2; ++i){
+        VkDescriptorSet desSet = descriptorAllocator_obj->allocateDescriptorSet(*descriptorSetLayout_glob_static);
+        writeGlobalStatic(desSet);
+        descriptorSets_glob_static.push_back(desSet);
+    }
+}
+
+
+void RenderingSystem::writeGlobalStatic(VkDescriptorSet set){
     /*  0 : skybox
         1 : brdf lut
-        2 : irradiance map
-        3 : prefilter envmap  */
+        2 : prefilter envmap  */
+    auto CubemapInfo = cubemaps_["skybox"]->getDescriptorImageInfo();
+    auto BrdfInfo = brdf_lut->getDesImageInfo();
+    //bake still running: the skybox cube stands in, its mip chain is a rough (box filtered) blur of the sky
+    auto prefilterInfo = prefilterEnvmap ? prefilterEnvmap->getDesImageInfo() : CubemapInfo;
 
-    JDescriptorWriter writer_glob_static(*descriptorSetLayout_glob_static, descriptorAllocator_obj->getDescriptorPool());
+    if(!JDescriptorWriter(*descriptorSetLayout_glob_static, *descriptorAllocator_obj)
+                    .writeImage(0, &CubemapInfo)
+                    .writeImage(1, &BrdfInfo)
+                    .writeImage(2, &prefilterInfo)
+                    .overwrite(set)){ throw std::runtime_error("failed to write descriptor set for cubemap!");}
+}
 
-    auto CubemapInfo = cubemaps_["skybox"]->getDescriptorImageInfo();
 
-    //create specific sampler, might merge into sampler manager later
-    auto BrdfSamplerInfo = SamplerCreateInfoBuilder()
-                    .addressMode(VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE)
-                    .maxLod(0)
-                    .getInfo();
-    brdf_lut->createCustomSampler(BrdfSamplerInfo);
-    irradianceMap->createCustomSampler(BrdfSamplerInfo);
-    
+void RenderingSystem::setPrefilterEnvmap(std::unique_ptr<JTextureBase> map){
     auto PrefilterSamplerInfo = SamplerCreateInfoBuilder()
                     .addressMode(VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE)
                     .getInfo();
-    prefilterEnvmap->createCustomSampler(PrefilterSamplerInfo);
+    map->createCustomSampler(*samplerManager_app, PrefilterSamplerInfo);
+    prefilterEnvmap = std::move(map);
+}
 
-    auto BrdfInfo = brdf_lut->getDesImageInfo();
-    auto irradianceInfo =  irradianceMap->getDesImageInfo();    
-    auto prefilterInfo =  prefilterEnvmap->getDesImageInfo();
-    
-    VkDescriptorSet desSet;
-    if(!writer_glob_static
-                    .writeImage(0, &CubemapInfo)
-                    .writeImage(1, &BrdfInfo)
-                    .writeImage(2, &irradianceInfo)
-                    .writeImage(3, &prefilterInfo)
-                    .build(desSet)){ throw std::runtime_error("failed to allocate descriptor set for cubemap!");}
-    descriptorSets_glob_static.push_back(desSet);
+
+void RenderingSystem::requestEnvironment(const std::string& path){
+    precompSystem_app->requestEnvironment(path, *samplerManager_app, bakeSliceMs_);
+}
+
+
+void RenderingSystem::updatePrecompute(const UI::UISettings& uiSettings, uint64_t frameIndex){
+    //same as the material paths: a new, existing file starts it, once
+    if(uiSettings.inputEnvMapPath && lastEnvMapPath != std::string(uiSettings.envMapPath) && strlen(uiSettings.envMapPath) > 0 &&
+       std::filesystem::is_regular_file(uiSettings.envMapPath)){
+        lastEnvMapPath = std::string(uiSettings.envMapPath);
+        requestEnvironment(lastEnvMapPath);
+    }
+
+    //a newer result replaces one still waiting, that one was never bound
+    if(auto maps = precompSystem_app->pollPrefilterBake()){
+        pendingSwap_ = std::move(maps);}
+    if(pendingSwap_ && frameIndex >= lastSwapFrame_ + Global::MAX_FRAMES_IN_FLIGHT){
+        swapEnvironment(std::move(*pendingSwap_), frameIndex);
+        pendingSwap_.reset();
+    }
+
+    //called before this frame's fence wait: frame - MAX_FRAMES_IN_FLIGHT - 1 and older are done
+    std::erase_if(retiredEnvironments_, [&](const RetiredEnvironment& retired){
+        return frameIndex >= retired.frame + Global::MAX_FRAMES_IN_FLIGHT;});
+}
+
+
+void RenderingSystem::swapEnvironment(EnvironmentMaps maps, uint64_t frameIndex){
+    RetiredEnvironment retired{frameIndex, nullptr, std::move(prefilterEnvmap)};
+    if(maps.cubemap){
+        retired.cubemap = cubemaps_["skybox"];
+        cubemaps_["skybox"] = maps.cubemap;
+        for(auto& envMap : sceneEnvMap){
+            envMap.second.texture = maps.cubemap;}
+        //goes into this frame's ubo, same frame as the set flip
+        irradianceSH_ = maps.irradianceSH;
+    }
+    setPrefilterEnvmap(std::move(maps.prefiltered));
+
+    //no wait: the other set is not bound by any frame in flight (see updatePrecompute)
+    const uint32_t next = 1 - staticSet_;
+    writeGlobalStatic(descriptorSets_glob_static[next]);
+    staticSet_ = next;
+    lastSwapFrame_ = frameIndex;
+    retiredEnvironments_.push_back(std::move(retired));
+    if(TexUtils::loadStatsEnabled()){
+        std::cout << "DEBUG: " << (maps.path.empty() ? "prefiltered envmap" : maps.path) << " swapped in" << std::endl;}
 }
 
 
@@ -556,11 +562,67 @@ void RenderingSystem::bindGlobalStatic(){
 
 
 
-void RenderingSystem::updateMaterial(const UI::UISettings& uiSettings){
+void RenderingSystem::updateStreaming(const glm::mat4& projection, const glm::mat4& view, uint64_t frameIndex){
+    //frustum planes from view-projection (Gribb/Hartmann), vulkan depth 0..1
+    const glm::mat4 viewProj = projection * view;
+    auto row = [&](int i){ return glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]); };
+    const glm::vec4 planes[6] = {
+        row(3) + row(0), row(3) - row(0),
+        row(3) + row(1), row(3) - row(1),
+        row(2),          row(3) - row(2) };
 
-    vkDeviceWaitIdle(device_app.device());
+    const float screenHeight = static_cast<float>(swapchain_app.getSwapChainExtent().height);
+
+    for(auto& asset : sceneAssets){
+        auto& obj = asset.second;
+        if(obj.model == nullptr || obj.material == nullptr){ continue; }
+
+        //bounding sphere in world space
+        const glm::mat4 model = obj.transform.mat4();
+        const glm::vec3 center = glm::vec3(model * glm::vec4(obj.model->getBoundsCenter(), 1.f));
+        const float maxScale = std::max({std::abs(obj.transform.scale.x), std::abs(obj.transform.scale.y), std::abs(obj.transform.scale.z)});
+        const float radius = obj.model->getBoundsRadius() * maxScale;
+
+        bool visible = true;
+        for(const auto& plane : planes){
+            const float len = glm::length(glm::vec3(plane));
+            if((glm::dot(glm::vec3(plane), center) + plane.w) / len < -radius){
+                visible = false; break; }
+        }
+        if(!visible){ continue; } //not requested -> evicted to tail after a while
+
+        //projected diameter in pixels
+        const float distance = glm::length(glm::vec3(view * glm::vec4(center, 1.f)));
+        const float screenPixels = distance > radius
+                                    ? (radius / distance) * projection[1][1] * screenHeight
+                                    : screenHeight;
+
+        for(auto& texture : obj.material->getStreamingTextures()){
+            if(!texture){ continue; }
+            const uint32_t mip = TextureStreamer::mipForScreenSize(texture->getFullWidth(), texture->getFullHeight(), screenPixels);
+            texture->request(mip, screenPixels, frameIndex);
+        }
+    }
+
+    textureStreamer_app->update(frameIndex);
+}
+
+
+
+void RenderingSystem::replaceTexture(const std::string& name, std::shared_ptr<JTextureBase> texture, uint64_t frameIndex){
+    auto& current = textures_[name];
+    if(current){
+        retiredTextures_.push_back({frameIndex, std::move(current)});}
+    current = std::move(texture);
+}
+
+
+void RenderingSystem::updateMaterial(const UI::UISettings& uiSettings, uint64_t frameIndex){
+
+    //no wait: the material writes another set / slot for the new texture, the one recorded frames use stays as is
+    std::erase_if(retiredTextures_, [&](const RetiredTexture& retired){
+        return frameIndex >= retired.frame + Global::MAX_FRAMES_IN_FLIGHT;});
     auto& pbrMat = materials_["pomoFruit_mat"];
-    bool needsUpdate = false;
 
     //need to use function to not do this repeat thing
 
@@ -573,10 +635,10 @@ void RenderingSystem::updateMaterial(const UI::UISettings& uiSettings){
             return;
         }
         try{
-            vkDeviceWaitIdle(device_app.device());
-            std::shared_ptr<JTexture2D> fruit_albedo = std::make_shared<JTexture2D>(device_app, uiSettings.albedoTexPath, VK_FORMAT_R8G8B8A8_SRGB);
-            textures_["pomoFruit_Albedo"] = fruit_albedo;  //must for render
-            pbrMat->setAlbedoTexture(*fruit_albedo);
+            auto fruit_albedo = std::make_shared<JStreamingTexture2D>(device_app, uiSettings.albedoTexPath, VK_FORMAT_R8G8B8A8_SRGB);
+            textureStreamer_app->add(fruit_albedo);
+            replaceTexture("pomoFruit_Albedo", fruit_albedo, frameIndex);  //must for render
+            pbrMat->setStreamingTexture(JPBRMaterial::Slot::Albedo, fruit_albedo);
             lastAlbedoPath = std::string(uiSettings.albedoTexPath);
         }catch(const std::exception& error){
             std::cout << "warning: Failed to load Albedo Texture: " <<uiSettings.albedoTexPath<<std::endl;
@@ -584,39 +646,31 @@ void RenderingSystem::updateMaterial(const UI::UISettings& uiSettings){
     }
 
     
-    if(uiSettings.inputRoughnessPath && lastRoughnessPath != std::string(uiSettings.roughnessTexPath) && strlen(uiSettings.roughnessTexPath) >0){
-    //check if file exist
-        if(!std::filesystem::exists(uiSettings.roughnessTexPath)){
-            // std::cout << "warning: Roughness texture path not found!: " << uiSettings.albedoTexPath << std::endl;
-            return;
-        }
+    //occlusion / roughness / metallic are packed into one texture, rebuild when any source changed.
+    //a toggled off channel keep its last loaded map, the push flag (inputOcclusionPath / Roughness / Metallic)
+    //makes the shader ignore it
+    auto pickPath = [](bool enabled, const char* path, const std::string& last){
+        if(enabled && strlen(path) > 0 && std::filesystem::exists(path)){
+            return std::string(path);   }
+        return last;
+    };
+    const std::string occlusionPath = pickPath(uiSettings.inputOcclusionPath, uiSettings.occlusionTexPath, lastOcclusionPath);
+    const std::string roughnessPath = pickPath(uiSettings.inputRoughnessPath, uiSettings.roughnessTexPath, lastRoughnessPath);
+    const std::string metallicPath  = pickPath(uiSettings.inputMetallicPath,  uiSettings.metallicTexPath,  lastMetallicPath);
+
+    if(occlusionPath != lastOcclusionPath || roughnessPath != lastRoughnessPath || metallicPath != lastMetallicPath){
         try{
-            vkDeviceWaitIdle(device_app.device());
-            std::shared_ptr<JTexture2D> fruit_roughness = std::make_shared<JTexture2D>(device_app, uiSettings.roughnessTexPath, VK_FORMAT_R8G8B8A8_UNORM);
-            pbrMat->setRoughnessTexture(*fruit_roughness);
-            textures_["pomoFruit_Roughness"] = fruit_roughness;  //must for render
-            lastRoughnessPath = std::string(uiSettings.roughnessTexPath);
+            auto fruit_ORM = std::make_shared<JORMTexture>(device_app, occlusionPath, roughnessPath, metallicPath);
+            pbrMat->setORMTexture(*fruit_ORM);
+            replaceTexture("pomoFruit_ORM", fruit_ORM, frameIndex);  //must for render
         }catch(const std::exception& error){
-            std::cout << "warning: Failed to load Roughness Texture: " <<uiSettings.roughnessTexPath<<std::endl;
+            std::cout << "warning: Failed to pack ORM Texture: " << error.what() <<std::endl;
         }
+        //dont retry the same paths every frame if failed
+        lastOcclusionPath = occlusionPath;
+        lastRoughnessPath = roughnessPath;
+        lastMetallicPath  = metallicPath;
     }
-    
-    if(uiSettings.inputMetallicPath && lastMetallicPath != std::string(uiSettings.metallicTexPath) && strlen(uiSettings.metallicTexPath) >0){
-        //check if file exist
-        if(!std::filesystem::exists(uiSettings.metallicTexPath)){
-            // std::cout << "warning: Metallic texture path not found!: " << uiSettings.albedoTexPath << std::endl;
-            return;
-        }
-        try{
-            vkDeviceWaitIdle(device_app.device());
-            std::shared_ptr<JTexture2D> fruit_Metallic = std::make_shared<JTexture2D>(device_app, uiSettings.metallicTexPath, VK_FORMAT_R8G8B8A8_UNORM);
-            pbrMat->setMetallicTexture(*fruit_Metallic);
-            textures_["pomoFruit_Metallic"] = fruit_Metallic;  //must for render
-            lastMetallicPath = std::string(uiSettings.metallicTexPath);
-        }catch(const std::exception& error){
-            std::cout << "warning: Failed to load Metallic Texture: " <<uiSettings.metallicTexPath<<std::endl;
-            }
-        }
 
         
 
@@ -627,10 +681,10 @@ void RenderingSystem::updateMaterial(const UI::UISettings& uiSettings){
             return;
         }
         try{
-            vkDeviceWaitIdle(device_app.device());
-            std::shared_ptr<JTexture2D> fruit_Normal = std::make_shared<JTexture2D>(device_app, uiSettings.normalTexPath, VK_FORMAT_R8G8B8A8_UNORM);
-            pbrMat->setNormalTexture(*fruit_Normal);
-            textures_["pomoFruit_Normal"] = fruit_Normal;  //must for render
+            auto fruit_Normal = std::make_shared<JStreamingTexture2D>(device_app, uiSettings.normalTexPath, VK_FORMAT_R8G8B8A8_UNORM);
+            textureStreamer_app->add(fruit_Normal);
+            pbrMat->setStreamingTexture(JPBRMaterial::Slot::Normal, fruit_Normal);
+            replaceTexture("pomoFruit_Normal", fruit_Normal, frameIndex);  //must for render
             lastNormalPath = std::string(uiSettings.normalTexPath);
         }catch(const std::exception& error){
             std::cout << "warning: Failed to load Normal Texture: " <<uiSettings.normalTexPath<<std::endl;
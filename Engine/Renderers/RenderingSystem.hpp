@@ -1,10 +1,15 @@
 #pragma once
 #include <vulkan/vulkan.hpp>
 #include <memory>
+#include <array>
 #include <filesystem>
+#include <optional>
+#include <glm/glm.hpp>
 #include "../VulkanCore/global.hpp"
 #include "../Scene/info.hpp"
 #include "../Scene/asset.hpp"
+#include "precomputeCommon.hpp"
+#include "precomputeSystem.hpp"
 
 
 class JPipeline;
@@ -19,6 +24,8 @@ class JSwapchain;
 class JBuffer;
 struct SceneInfo;
 class JDescriptorAllocator;
+class JDescriptorSetCache;
+class JFrameDescriptorArena;
 class JShaderStages;
 class JShaderModule;
 class JComputePipeline;
@@ -27,6 +34,9 @@ class SamplerManager;
 class JCubemap;
 class JTexture2D;
 class JTextureBase;
+class JStreamingTexture2D;
+class TextureStreamer;
+class JBindlessTable;
 
 namespace UI{
     class UISettings;
@@ -49,8 +59,21 @@ public:
 
     //getter
     std::vector<std::unique_ptr<JBuffer>>& getUniformBufferObjs() {return uniformBuffer_objs;}
-
-    void updateMaterial(const UI::UISettings& uiSettings);
+    //goes into GlobalUbo::irradianceSH every frame
+    const std::array<glm::vec4, 9>& getIrradianceSH() const {return irradianceSH_;}
+
+    //new texture from the ui path: recorded frames keep their set / slot, the replaced texture is kept until
+    //they are done (no queue wait)
+    void updateMaterial(const UI::UISettings& uiSettings, uint64_t frameIndex);
+
+    //frame boundary: request mips from screen size of each asset, then stream in/out
+    void updateStreaming(const glm::mat4& projection, const glm::mat4& view, uint64_t frameIndex);
+    //frame boundary: next slice of the background bake, the finished maps go into the static set
+    //(startup prefilter, environment swaps). env path from the ui starts a swap
+    void updatePrecompute(const UI::UISettings& uiSettings, uint64_t frameIndex);
+    //another sky, no stall: converted + baked in the background (JRENDERER_IBL_SLICE_MS of gpu time a frame),
+    //the old sky stays bound until cube, prefiltered map and sh9 are all ready, then they flip in one frame
+    void requestEnvironment(const std::string& path);
 
 private:
     JDevice& device_app;
@@ -61,15 +84,15 @@ private:
     //pipeline
     std::unique_ptr<JPipeline> pipeline_app;
     std::unique_ptr<JPipeline> pipeline_skybox_app;
-    std::unique_ptr<JComputePipeline> brdfComputePipeline_app;
+    std::unique_ptr<JPipeline> pipeline_bindless_app;  //only when device support descriptor indexing
 
     std::unique_ptr<JPipelineLayout> pipelinelayout_app;
-    std::unique_ptr<JPipelineLayout> brdfPipelineLayout_app;
+    std::unique_ptr<JPipelineLayout> pipelinelayout_bindless_app;
     
     //shader stages - must be kept alive for pipeline lifetime
     std::unique_ptr<JShaderStages> shaderStages_main;
     std::unique_ptr<JShaderStages> shaderStages_skybox;
-    std::unique_ptr<JShaderModule> brdfComputeShader;
+    std::unique_ptr<JShaderStages> shaderStages_bindless;
 
 
     //descriptor
@@ -77,9 +100,14 @@ private:
     std::unique_ptr<JDescriptorSetLayout> descriptorSetLayout_glob;
     std::unique_ptr<JDescriptorSetLayout> descriptorSetLayout_glob_static;
     std::unique_ptr<JDescriptorSetLayout> descriptorSetLayout_asset;
+    //bindless: all material textures in one table, set 2 bound once per frame
+    std::unique_ptr<JBindlessTable> bindlessTable_app;
 
-    std::vector<VkDescriptorSet> descriptorSets_glob;
+    //per frame sets, reset when the frame slot comes around again. the ubo set is built from it every frame
+    std::unique_ptr<JFrameDescriptorArena> frameDescriptors_;
+    //two sets: frames bind [staticSet_], a swap writes the other one and flips the index
     std::vector<VkDescriptorSet> descriptorSets_glob_static;
+    uint32_t staticSet_{0};
 
     std::vector<std::unique_ptr<JBuffer>> uniformBuffer_objs;
 
@@ -87,30 +115,54 @@ private:
     void createPipelineResources();
     
     std::shared_ptr<JDescriptorAllocator> descriptorAllocator_obj;
+    //material sets by their textures, materials with the same textures share one. nullptr with bindless
+    //or JRENDERER_DESCRIPTOR_CACHE=0. before materials_: the last default textures go after the materials
+    std::unique_ptr<JDescriptorSetCache> descriptorSetCache_;
 
     std::unordered_map<std::string, std::shared_ptr<JModel>>        models_;
-    std::unordered_map<std::string, std::shared_ptr<JTexture2D>>    textures_;
+    std::unordered_map<std::string, std::shared_ptr<JTextureBase>>   textures_;
     std::unordered_map<std::string, std::shared_ptr<JCubemap>>      cubemaps_; //legacy issue, need to be changed in the future
     std::unordered_map<std::string, std::shared_ptr<JPBRMaterial>>  materials_;
 
 
     Scene::JAsset::Map sceneAssets;
     Scene::JEnvMap::Map sceneEnvMap;
-    //for brdf lut
-    std::unique_ptr<JBuffer> storageBuffer_;
-    const uint32_t brdf_w = 256, brdf_h = 256;
-    const uint32_t bufferSize = 4u * sizeof(uint16_t) * brdf_h * brdf_w;
 
 
     std::unique_ptr<JTextureBase> brdf_lut;
     std::unique_ptr<JTextureBase> prefilterEnvmap;
-    std::unique_ptr<JTextureBase> irradianceMap;
+    //diffuse irradiance of the skybox, see PrecomputeSystem::projectIrradianceSH
+    std::array<glm::vec4, 9> irradianceSH_{};
 
     void loadAssets();
     void loadEnvMaps();
+    //upload of the lut baked at build time (brdfLut.hpp)
     void createBRDFLUT();
-    void loadPrecomputedResources();
+    //loadPrefilter false: it is still baking, skybox cube is bound until updatePrecompute swaps it
+    void loadPrecomputedResources(bool loadPrefilter);
+    void setPrefilterEnvmap(std::unique_ptr<JTextureBase> map);
     void bindGlobalStatic();
+    //skybox, brdf lut, prefiltered map (or the skybox while it bakes) -> set
+    void writeGlobalStatic(VkDescriptorSet set);
+    void swapEnvironment(EnvironmentMaps maps, uint64_t frameIndex);
+
+    //gpu time a frame for background bakes, JRENDERER_IBL_SLICE_MS
+    float bakeSliceMs_{kDefaultBakeSliceMs};
+    //frames before lastSwapFrame_ may still be in flight with the other set, the next swap waits for them
+    uint64_t lastSwapFrame_{0};
+    std::optional<EnvironmentMaps> pendingSwap_;
+    //what a swap replaced, freed once the frames that could read it are done
+    struct RetiredEnvironment{
+        uint64_t frame;
+        std::shared_ptr<JCubemap> cubemap;
+        std::unique_ptr<JTextureBase> prefiltered;  };
+    std::vector<RetiredEnvironment> retiredEnvironments_;
+    //textures_ entries updateMaterial replaced, same rule
+    struct RetiredTexture{
+        uint64_t frame;
+        std::shared_ptr<JTextureBase> texture;  };
+    std::vector<RetiredTexture> retiredTextures_;
+    void replaceTexture(const std::string& name, std::shared_ptr<JTextureBase> texture, uint64_t frameIndex);
 
 
     // get the scene info, which including all assets
@@ -121,6 +173,7 @@ private:
 
 
     std::unique_ptr<PrecomputeSystem> precompSystem_app;
+    std::unique_ptr<TextureStreamer> textureStreamer_app;
 
 
 
@@ -131,8 +184,10 @@ private:
     bool lastNormalTexState = false;
 
     std::string lastAlbedoPath;
+    std::string lastOcclusionPath;
     std::string lastRoughnessPath;
     std::string lastMetallicPath;
     std::string lastNormalPath;
+    std::string lastEnvMapPath;
 };
 
@@ -0,0 +1,9 @@
+#include "brdfLut.hpp"
+
+
+//generated into the build dir, see CMakeLists.txt
+const uint16_t kBrdfLutData[] = {
+#include "brdfLut.inc"
+};
+
+static_assert(sizeof(kBrdfLutData) == kBrdfLutBytes, "brdfLut.inc is not kBrdfLutSize^2 rg16f, rebuild JIBLBaker");
@@ -0,0 +1,11 @@
+//split sum brdf lut, only math so it is baked once at build time (JIBLBaker --brdf-inc, see CMakeLists.txt)
+//and compiled in. no compute pipeline, no readback, no file at startup, just an upload
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "precomputeCommon.hpp"
+
+
+//kBrdfLutSize^2 of kBrdfLutFormat: x = NdotV, y = roughness, rg = scale / bias on F0 (halfs)
+extern const uint16_t kBrdfLutData[];
+inline constexpr size_t kBrdfLutBytes = size_t(kBrdfLutSize) * kBrdfLutSize * 2 * sizeof(uint16_t);
@@ -0,0 +1,248 @@
+#include "precomputeCommon.hpp"
+#include "../VulkanCore/material/imageDecode.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+
+//JRENDERER_IBL_MAX_ERROR=0.005 for cleaner (slower) bakes
+float maxSampleErrorFromEnv(){
+    const char* value = std::getenv("JRENDERER_IBL_MAX_ERROR");
+    if(value){
+        char* end = nullptr;
+        const float maxError = std::strtof(value, &end);
+        if(end != value && maxError > 0.0f) return maxError;
+    }
+    return kDefaultMaxSampleError;
+}
+
+
+std::vector<uint32_t> calibrationCandidates(uint32_t sampleCount){
+    std::vector<uint32_t> candidates;
+    for(uint32_t count = kMinSampleBudget; count < sampleCount; count *= 2){
+        candidates.push_back(count);}
+    candidates.push_back(sampleCount);
+    return candidates;
+}
+
+
+uint64_t calibrationKey(uint64_t sourceHash, uint32_t faceSize, uint32_t distribution, uint32_t sampleCount, float maxError){
+    if(sourceHash == 0) return 0;
+    const std::string id = "calibration face=" + std::to_string(faceSize) + ",distribution=" + std::to_string(distribution) +
+                           ",samples=" + std::to_string(sampleCount) + ",maxError=" + std::to_string(maxError) +
+                           ",reference=" + std::to_string(kReferenceSampleCount) + ",probe=" + std::to_string(kProbeSize);
+    return TexUtils::hashBytes(id.data(), id.size(), sourceHash);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////////
+//sample tables. V = N, so direction (in the frame of N), NdotL and lod of a sample are the same for
+//every texel of a mip. worked out once here instead of per texel per sample in the shader
+
+float levelRoughness(uint32_t distribution, uint32_t level, uint32_t mipLevels){
+    if(distribution == Distribution_Lambertian || mipLevels < 2) return 0.0f;
+    return static_cast<float>(level) / static_cast<float>(mipLevels - 1);
+}
+
+//hammersley2d y
+float radicalInverse(uint32_t bits){
+    bits = (bits << 16u) | (bits >> 16u);
+    bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+    bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+    bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+    bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+    return float(bits) * 2.3283064365386963e-10f;
+}
+
+//same math computePrefilIrrad.comp used to do per sample. envFaceSize: source cube, dstW/dstH: mip being written
+SampleRun appendSamples(std::vector<PrefilterSample>& table, uint32_t distribution, float roughness,
+            uint32_t sampleCount, uint32_t envFaceSize, uint32_t dstW, uint32_t dstH){
+    constexpr float pi = 3.14159265358979323846f;
+    SampleRun run{static_cast<uint32_t>(table.size()), 0};
+
+    const float alpha2 = roughness * roughness * roughness * roughness;
+    const float omegaP = 4.0f * pi / (6.0f * float(envFaceSize) * float(envFaceSize));    //solid angle of one source texel
+
+    for(uint32_t i = 0; i < sampleCount; ++i){
+        const float phi = 2.0f * pi * float(i) / float(sampleCount);
+        const float xi  = radicalInverse(i);
+
+        if(distribution == Distribution_Lambertian){
+            //cosine weighted hemisphere, lod from the pdf
+            const float cosTheta = std::sqrt(1.0f - xi);
+            const float sinTheta = std::sqrt(xi);
+            const float pdf = cosTheta / pi;
+            const float lod = 0.5f * std::log2(6.0f * float(dstW) * float(dstH) / (float(sampleCount) * pdf));
+            table.push_back({sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta, lod});
+            continue;
+        }
+
+        //ggx H, then L = 2 (V.H) H - V with V = N = +z
+        const float cosTheta = std::clamp(std::sqrt((1.0f - xi) / (1.0f + (alpha2 - 1.0f) * xi)), 0.0f, 1.0f);
+        const float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+        const float NdotL = 2.0f * cosTheta * cosTheta - 1.0f;
+        if(NdotL <= 0.0f) continue;     //contributes nothing but still counts for the pdf
+
+        //pdf = D * NdotH / (4 VdotH), NdotH == VdotH here
+        const float denom = cosTheta * cosTheta * (alpha2 - 1.0f) + 1.0f;
+        const float pdf = alpha2 / (pi * denom * denom) / 4.0f + 0.0001f;
+        const float omegaS = 1.0f / (float(sampleCount) * pdf);
+        //biased (+1.0) mip level for better result
+        const float lod = roughness == 0.0f ? 0.0f : std::max(0.5f * std::log2(omegaS / omegaP) + 1.0f, 0.0f);
+        table.push_back({2.0f * cosTheta * sinTheta * std::cos(phi), 2.0f * cosTheta * sinTheta * std::sin(phi), NdotL, lod});
+    }
+
+    run.count = static_cast<uint32_t>(table.size()) - run.offset;
+    return run;
+}
+
+
+
+PrecomputeCacheEntry prefilterCacheEntry(const std::string& output, uint64_t sourceHash, uint32_t faceSize,
+            uint32_t distribution, uint32_t sampleCount, uint64_t spirvHash, float maxError){
+    PrecomputeCacheEntry entry;
+    entry.output      = output;
+    entry.sourceHash  = sourceHash;
+    entry.sampleCount = sampleCount;
+    entry.spirvHash   = spirvHash;
+    entry.format      = kBakedMapFormat;
+    entry.params      = "face=" + std::to_string(faceSize) +
+                        ",distribution=" + std::to_string(distribution) +
+                        ",maxError=" + std::to_string(maxError) + kBakedFileParams;
+    return entry;
+}
+
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////////
+//precompute manifest
+//line:  <output> source=<hex> samples=<n> spirv=<hex> format=<n> params=<text> output=<hex>
+//       calibration:<key hex> budgets=<n>,<n>,...
+
+//first token of a budgets line, a path never starts with it
+static constexpr const char* kCalibrationPrefix = "calibration:";
+
+uint64_t hashFileContent(const std::string& path){
+    std::error_code ec;
+    if(!std::filesystem::exists(path, ec) || std::filesystem::file_size(path, ec) == 0) return 0;
+    MappedFile file(path);
+    return TexUtils::hashBytes(file.data(), file.size());
+}
+
+
+PrecomputeManifest::PrecomputeManifest(const std::string& path):
+    path_(path)
+{
+    std::ifstream in(path_);
+    std::string line;
+    while(std::getline(in, line)){
+        std::istringstream fields(line);
+        PrecomputeCacheEntry entry;
+        if(!(fields >> entry.output) || entry.output[0] == '#') continue;
+
+        std::string field;
+        if(entry.output.rfind(kCalibrationPrefix, 0) == 0){
+            try{
+                const uint64_t key = std::stoull(entry.output.substr(std::char_traits<char>::length(kCalibrationPrefix)), nullptr, 16);
+                std::vector<uint32_t> budgets;
+                if(fields >> field && field.rfind("budgets=", 0) == 0){
+                    std::istringstream list(field.substr(8));
+                    for(std::string budget; std::getline(list, budget, ',');){
+                        budgets.push_back(static_cast<uint32_t>(std::stoul(budget)));}
+                }
+                if(!budgets.empty()) budgets_[key] = std::move(budgets);
+            }
+            catch(const std::exception&){}  //broken line: calibrates again
+            continue;}
+
+        try{
+            while(fields >> field){
+                const size_t eq = field.find('=');
+                if(eq == std::string::npos) continue;
+                const std::string key = field.substr(0, eq);
+                const std::string value = field.substr(eq + 1);
+                if(key == "source")       entry.sourceHash  = std::stoull(value, nullptr, 16);
+                else if(key == "samples") entry.sampleCount = static_cast<uint32_t>(std::stoul(value));
+                else if(key == "spirv")   entry.spirvHash   = std::stoull(value, nullptr, 16);
+                else if(key == "format")  entry.format      = static_cast<VkFormat>(std::stoi(value));
+                else if(key == "params")  entry.params      = value;
+                else if(key == "output")  entry.outputHash  = std::stoull(value, nullptr, 16);
+            }
+        }
+        catch(const std::exception&){
+            continue;} //broken line: that output just bakes again
+        entries_[entry.output] = entry;
+    }
+}
+
+
+bool PrecomputeManifest::isValid(const PrecomputeCacheEntry& expected) const{
+    auto it = entries_.find(expected.output);
+    if(it == entries_.end()) return false;
+
+    const PrecomputeCacheEntry& recorded = it->second;
+    if(recorded.sourceHash != expected.sourceHash || recorded.sampleCount != expected.sampleCount ||
+       recorded.spirvHash != expected.spirvHash || recorded.format != expected.format ||
+       recorded.params != expected.params){
+        return false;}
+    return recorded.outputHash != 0 && hashFileContent(expected.output) == recorded.outputHash;
+}
+
+
+void PrecomputeManifest::record(PrecomputeCacheEntry entry){
+    entry.outputHash = hashFileContent(entry.output);
+    entries_[entry.output] = entry;
+    save();
+}
+
+
+std::vector<uint32_t> PrecomputeManifest::calibratedBudgets(uint64_t key, uint32_t levelCount) const{
+    auto it = budgets_.find(key);
+    if(key == 0 || it == budgets_.end() || it->second.size() != levelCount) return {};
+    return it->second;
+}
+
+
+void PrecomputeManifest::recordBudgets(uint64_t key, std::vector<uint32_t> budgets){
+    if(key == 0 || budgets.empty()) return;
+    budgets_[key] = std::move(budgets);
+    save();
+}
+
+
+void PrecomputeManifest::save() const{
+    std::ofstream out(path_, std::ios::trunc);
+    if(!out){
+        std::cout << "DEBUG: cant write precompute manifest " << path_ << ", maps will bake again next start" << std::endl;
+        return;}
+
+    out << "# baked maps and what they were made from, rewritten after every bake\n";
+    out << std::hex;
+    for(const auto& [output, e] : entries_){
+        out << output
+            << " source="  << e.sourceHash
+            << " samples=" << std::dec << e.sampleCount << std::hex
+            << " spirv="   << e.spirvHash
+            << " format="  << std::dec << int(e.format) << std::hex
+            << " params="  << e.params
+            << " output="  << e.outputHash << "\n";
+    }
+    for(const auto& [key, budgets] : budgets_){
+        out << kCalibrationPrefix << key << " budgets=" << std::dec;
+        for(size_t i = 0; i < budgets.size(); ++i){
+            out << (i ? "," : "") << budgets[i];}
+        out << std::hex << "\n";
+    }
+}
+
+
+
+
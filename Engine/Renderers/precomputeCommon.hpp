@@ -0,0 +1,116 @@
+//shared by PrecomputeSystem and the cpu baker (Tools/IBLBaker): sample tables, the precompute manifest.
+//no vulkan calls in here, only its types
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+//env cubes (converted / cached), prefiltered / irradiance maps. half float: hdr range is fine, half the size of rgba32f
+inline constexpr VkFormat kBakedMapFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+//how baked files are stored (zstd supercompressed, TexUtils::kKtx2ZstdLevel). part of the manifest params,
+//so files an older build wrote raw are baked (and shrunk) once more
+inline constexpr const char* kBakedFileParams = ",ktx2=zstd";
+
+//what the viewer bakes and loads, JIBLBaker writes the same by default
+inline constexpr const char* kPrefilterEnvMapPath   = "../data/prefilterEnvMap.ktx";
+inline constexpr uint32_t    kPrefilterSampleCount  = 2048;     //ceiling per mip, the calibrated budgets stay at or below
+//brdf lut: baked at build time (JIBLBaker --brdf-inc) and compiled in, see Renderers/brdfLut.hpp
+inline constexpr uint32_t    kBrdfLutSize           = 256;
+inline constexpr uint32_t    kBrdfSampleCount       = 1024;
+inline constexpr VkFormat    kBrdfLutFormat         = VK_FORMAT_R16G16_SFLOAT;  //scale / bias, nothing in b / a
+
+enum Distribution{
+    Distribution_Lambertian = 0,
+    Distribution_GGX        = 1,   };
+
+//one sample table entry, a vec4 in the shader
+struct PrefilterSample{
+    float x, y, z;                  //L in the tangent frame of N
+    float lod;                      };
+
+//where one mip's samples sit in the table
+struct SampleRun{
+    uint32_t offset;
+    uint32_t count;                 };
+
+//relative rms against the reference, how far the calibrated budgets may go from it
+inline constexpr float kDefaultMaxSampleError = 0.01f;
+//JRENDERER_IBL_MAX_ERROR=0.005 for cleaner (slower) bakes
+float maxSampleErrorFromEnv();
+
+//adaptive budgets: per mip, the first candidate whose kProbeSize probe is within maxError of kReferenceSampleCount
+//samples. the viewer probes on the gpu, JIBLBaker on the cpu, same candidates and same rule
+inline constexpr uint32_t kMinSampleBudget      = 16;
+inline constexpr uint32_t kReferenceSampleCount = 8192;
+inline constexpr uint32_t kProbeSize            = 16;       //probe texels per face edge, one work group
+//doubling from kMinSampleBudget, the bake's sample count last
+std::vector<uint32_t> calibrationCandidates(uint32_t sampleCount);
+//the budgets only depend on these, so they are kept in the manifest under this key and the probes run once per sky.
+//0 when sourceHash is 0 (cube of unknown origin): always calibrated
+uint64_t calibrationKey(uint64_t sourceHash, uint32_t faceSize, uint32_t distribution, uint32_t sampleCount, float maxError);
+
+
+//sample tables. V = N, so direction (in the frame of N), NdotL and lod of a sample are the same for
+//every texel of a mip. worked out once here instead of per texel per sample in the shader
+float levelRoughness(uint32_t distribution, uint32_t level, uint32_t mipLevels);
+//hammersley2d y
+float radicalInverse(uint32_t bits);
+//same math computePrefilIrrad.comp used to do per sample. envFaceSize: source cube, dstW/dstH: mip being written.
+//ggx samples with NdotL <= 0 are dropped, NdotL is in z
+SampleRun appendSamples(std::vector<PrefilterSample>& table, uint32_t distribution, float roughness,
+            uint32_t sampleCount, uint32_t envFaceSize, uint32_t dstW, uint32_t dstH);
+
+
+
+//what a baked file (prefiltered / irradiance map) was made from.
+//while all of it still matches, the bake is skipped and the file is just loaded
+struct PrecomputeCacheEntry{
+    std::string output;                         //path of the baked file
+    uint64_t    sourceHash{0};                  //input map (JCubemap::getContentHash), 0 when there is none
+    uint32_t    sampleCount{0};
+    uint64_t    spirvHash{0};                   //TexUtils::hashBytes of the .spv that bakes it
+    VkFormat    format{VK_FORMAT_UNDEFINED};
+    std::string params;                         //anything else that changes the result (size, mips ...), no spaces
+    uint64_t    outputHash{0};                  //content of the file when it was written, catches replaced / broken files
+};
+
+//the viewer and the cpu baker build their entries here, the same key for both: they bake with the same per mip
+//budgets, a file from either one is taken by the other. JIBLBaker --compare is the parity check between them
+PrecomputeCacheEntry prefilterCacheEntry(const std::string& output, uint64_t sourceHash, uint32_t faceSize,
+            uint32_t distribution, uint32_t sampleCount, uint64_t spirvHash, float maxError);
+
+//text file next to the baked maps, one line per output. delete it to force a rebake
+inline constexpr const char* kPrecomputeManifestPath = "../data/precompute.manifest";
+
+class PrecomputeManifest{
+public:
+    //missing or unreadable file = empty manifest, everything bakes
+    explicit PrecomputeManifest(const std::string& path);
+
+    //recorded inputs are the same as expected's (outputHash is not compared) and the file still hashes the same
+    bool isValid(const PrecomputeCacheEntry& expected) const;
+    //call after entry.output was written: hashes it, replaces its line and saves the manifest
+    void record(PrecomputeCacheEntry entry);
+
+    //per mip budgets a calibration found for key (calibrationKey), empty if there are none or not levelCount of them
+    std::vector<uint32_t> calibratedBudgets(uint64_t key, uint32_t levelCount) const;
+    //replaces key's line and saves the manifest
+    void recordBudgets(uint64_t key, std::vector<uint32_t> budgets);
+
+private:
+    std::string path_;
+    std::unordered_map<std::string, PrecomputeCacheEntry> entries_;
+    std::unordered_map<uint64_t, std::vector<uint32_t>> budgets_;
+
+    void save() const;
+};
+
+//0 if the file cant be read
+uint64_t hashFileContent(const std::string& path);
+
+
+
+
@@ -2,10 +2,13 @@
 #include "../VulkanCore/material/load_texture.hpp"
 #include "../VulkanCore/material/cubemapUtils.hpp"
 #include "../VulkanCore/material/bitmap.hpp"
+#include "../VulkanCore/material/imageDecode.hpp"
 #include "../VulkanCore/device.hpp"
 #include "../VulkanCore/shaderModule.hpp"
 #include "../VulkanCore/pipeline.hpp"
 #include "../VulkanCore/commandBuffer.hpp"
+#include "../VulkanCore/buffer.hpp"
+#include "../VulkanCore/sync.hpp"
 #include "../VulkanCore/descriptor/descriptor.hpp"
 #include "../VulkanCore/descriptor/descriptorAllocator.hpp"
 
@@ -13,293 +16,1107 @@
 #include "stb_image_write.h"
 #include <ktx.h>
 #include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <sstream>
 
-static inline VkDeviceSize Align(VkDeviceSize v, VkDeviceSize a) { return (v + a - 1) & ~(a - 1); }
 
+//face comes from gl_GlobalInvocationID.z, one dispatch covers all 6
 struct PerFrameData{
-    uint32_t face;
-    float roughness;
+    uint64_t sampleTable;           //buffer address of the PrefilterSample table
 
     uint32_t width;
     uint32_t height;
 
+    uint32_t sampleOffset;
     uint32_t sampleCount;
-    uint32_t distribution;         };  
+    uint32_t rowOffset;             };
 
-enum Distribution{
-    Distribution_Lambertian = 0,
-    Distribution_GGX        = 1,   };
+//time slicing: a bake dispatch covers this many rows of a mip (one work group high), the smallest piece a slice takes
+static constexpr uint32_t kBakeBandRows          = 16;
+//texel samples per ms until the first slice is measured, about a mid range desktop gpu
+static constexpr double   kInitialCostPerMs      = 2.0e7;
 
-PrecomputeSystem::PrecomputeSystem(JDevice& device, const JCubemap& cubemapBase):
-    device_app(device)
+//sh9 only keeps very low frequencies, projecting from a 64 face mip is plenty
+static constexpr uint32_t kIrradianceSHFaceSize  = 64;
+
+//equirectToCube.comp, fits in the PerFrameData push range
+struct EquirectPushData{
+    uint32_t width;
+    uint32_t height;
+    float    lod;       };
+
+
+CubemapConversion cubemapConversionFromEnv(){
+    const char* mode = std::getenv("JRENDERER_CUBEMAP_CONVERSION");
+    if(mode && std::string(mode) == "gpu") return CubemapConversion::GPU;
+    return CubemapConversion::CPU;
+}
+
+float bakeSliceMsFromEnv(){
+    const char* value = std::getenv("JRENDERER_IBL_SLICE_MS");
+    if(!value) return kDefaultBakeSliceMs;
+    return std::max(0.0f, std::strtof(value, nullptr));
+}
+
+//host visible, the shader reads it through its buffer address. a bake reads it once per sample per texel group, caches well
+static std::unique_ptr<JBuffer> uploadSampleTable(JDevice& device, const std::vector<PrefilterSample>& table){
+    auto buffer = std::make_unique<JBuffer>(device, std::max<size_t>(table.size(), 1) * sizeof(PrefilterSample),
+                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT|VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT|VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if(!table.empty()){
+        buffer->stagingAction(table.data());}
+    return buffer;
+}
+
+//rows: how many rows from perFrameData.rowOffset this dispatch covers (the whole mip unless the bake is sliced)
+static void dispatchPrefilter(VkCommandBuffer cmd, VkPipelineLayout layout, VkDescriptorSet set,
+                              const PerFrameData& perFrameData, uint32_t rows){
+    constexpr uint32_t shader_localX = 16;           // must match the shader
+    constexpr uint32_t shader_localY = 16;
+
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, 1, &set, 0, nullptr);
+    vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(perFrameData), &perFrameData);
+    //z = face
+    vkCmdDispatch(cmd,
+            (perFrameData.width + shader_localX - 1) / shader_localX,
+            (rows               + shader_localY - 1) / shader_localY, 6);
+}
+
+
+//what gets baked from the sky. irradiance is not baked any more, see projectIrradianceSH
+struct PrefilterBake{
+    uint32_t    distribution;
+    const char* path;
+    uint32_t    sampleCount;    };  //ceiling, mips get less where it doesnt show
+static constexpr PrefilterBake kPrefilterBake = {Distribution_GGX, kPrefilterEnvMapPath, kPrefilterSampleCount};
+
+
+//one piece of a stage. cost: texel samples it takes (width * rows * 6 * samples), 0 for copies / barriers,
+//those go along with whatever slice they fall into
+struct BakeStep{
+    uint64_t cost;
+    std::function<void(VkCommandBuffer)> record;    };
+
+
+//what the worker thread of an environment swap hands back
+struct EnvLoad{
+    uint32_t faceSize{0};
+    uint32_t mipLevels{0};
+    PrecomputeCacheEntry entry;                         //entry.output: where its prefiltered map is cached
+    std::vector<VkBufferImageCopy> regions;             //every mip x face, same packing for cube and prefiltered map
+    std::unique_ptr<JBuffer> staging;                   //the cube
+    std::unique_ptr<JBuffer> prefilterStaging;          //cached prefiltered map, nullptr: it has to be baked
+    std::vector<uint32_t> budgets;                      //calibrated before (manifest), empty: calibrate
+    std::array<glm::vec4, 9> irradianceSH{};
+};
+
+
+struct PrecomputeSystem::BakeJob{
+    enum class Stage{
+        Loading,                                    //swap: worker thread, nothing on the gpu yet
+        Uploading,                                  //swap: staging -> images on the compute queue
+        Calibrating,
+        Baking,     };
+    Stage       stage{Stage::Calibrating};
+    uint64_t    waitValue{0};                       //timeline value the last submit signals
+
+    //swaps own the cube they bake from, the startup bake uses the skybox the renderer holds
+    std::string path;
+    SamplerManager* samplerManager{nullptr};
+    std::future<EnvLoad> load;
+    EnvLoad     loaded;
+    std::shared_ptr<JCubemap> cube;
+
+    const JCubemap* source{nullptr};
+    PrefilterBake   bake{};
+    float           maxError{0.0f};
+    PrecomputeCacheEntry entry;
+    std::chrono::steady_clock::time_point start;
+
+    std::unique_ptr<JTextureBase> target;
+    uint32_t    levelCount{0};                      //mips that get baked
+    std::vector<uint32_t> budgets;
+    uint64_t    calibrationKey{0};                  //where calibrated budgets go in the manifest, 0: not recorded
+    bool        calibrated{false};                  //budgets came from the probes this time, not the manifest
+
+    //calibration. probedLevels[i] is readback block i, the mirror level is not probed
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> probedLevels;
+    std::unique_ptr<JTextureBase> probe;
+    std::unique_ptr<JBuffer> probeReadback;
+
+    //bake readback, becomes the ktx
+    std::unique_ptr<JBuffer> readback;
+    std::vector<VkBufferImageCopy> regions;
+
+    //time slicing: the current stage's steps, the next one to record, gpu time per frame (0 = all at once)
+    float       sliceMs{0.0f};
+    std::vector<BakeStep> steps;
+    size_t      nextStep{0};
+    VkPipeline  pipeline{VK_NULL_HANDLE};           //bound at the start of every slice, VK_NULL_HANDLE for copies
+    uint64_t    sliceCost{0};                       //of the slice in flight
+    bool        sliceTimed{false};
+
+    //only alive while their stage runs
+    std::unique_ptr<JCommandBuffer> commandBuffer;  //of the slice in flight
+    std::unique_ptr<JDescriptorAllocator> setAllocator;
+    std::vector<VkImageView> views;
+    std::unique_ptr<JBuffer> sampleTable;
+};
+
+
+
+
+PrecomputeSystem::PrecomputeSystem(JDevice& device):
+    device_app(device),
+    bakeCostPerMs_(kInitialCostPerMs)
 {
+    timeline_ = std::make_unique<JTimelineSemaphore>(device_app);
+    if(device_app.computeTimestampPeriod() > 0.0f){
+        VkQueryPoolCreateInfo queryInfo{};
+        queryInfo.sType      = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryInfo.queryType  = VK_QUERY_TYPE_TIMESTAMP;
+        queryInfo.queryCount = 2;
+        if(vkCreateQueryPool(device_app.device(), &queryInfo, nullptr, &timestampPool_) != VK_SUCCESS){
+            timestampPool_ = VK_NULL_HANDLE;}
+    }
     createComputePipeline();
-    generatePrecomputedMaps(cubemapBase);
 }
 
 
 PrecomputeSystem::~PrecomputeSystem(){
+    //a bake may still run on the compute queue, and the graphics queue may still wait on timeline_
+    vkDeviceWaitIdle(device_app.device());
+    if(job_){
+        abandoned_.push_back(std::move(job_));}
+    for(auto& job : abandoned_){
+        if(job->load.valid()){
+            job->load.wait();}
+        releaseSubmitResources(*job);
+    }
+    abandoned_.clear();
+    for(auto& write : cacheWrites_){
+        write.wait();}
+    if(timestampPool_ != VK_NULL_HANDLE){
+        vkDestroyQueryPool(device_app.device(), timestampPool_, nullptr);}
+}
+
+
+
+
+//prefiltered cache file of a swapped sky: same inputs as the manifest entry, so a change in any of them is another file
+static uint64_t prefilterCacheKey(const PrecomputeCacheEntry& entry){
+    const std::string id = "prefiltered " + entry.params + " " + std::to_string(entry.sampleCount) + " " + std::to_string(entry.spirvHash);
+    return TexUtils::hashBytes(id.data(), id.size(), entry.sourceHash);
+}
+
+//6 face ktx2 (raw or zstd) with every mip -> regions (Ktx2ReadbackRegions packing). false: missing, or not that shape
+static bool readCachedCube(const std::string& path, uint32_t faceSize, const std::vector<VkBufferImageCopy>& regions, uint8_t* dst){
+    if(!JCubemap::cacheEnabled() || !std::filesystem::exists(path)) return false;
+
+    MappedFile file(path);
+    TexUtils::Ktx2Header header;
+    const uint32_t levels = static_cast<uint32_t>(regions.size() / 6);
+    if(!TexUtils::parseKtx2Header(file, header) || header.vkFormat != kBakedMapFormat || !TexUtils::isKtx2Readable(header) ||
+       header.faceCount != 6 || header.pixelWidth != faceSize || header.pixelHeight != faceSize || header.levelCount != levels){
+        return false;}
+
+    //a level is its 6 faces back to back in the file and in the regions, so the regions' level starts are the layout
+    std::vector<VkDeviceSize> levelOffsets(levels);
+    for(uint32_t level = 0; level < levels; ++level){
+        const uint32_t size = std::max(1u, faceSize >> level);
+        const VkDeviceSize levelBytes = VkDeviceSize(size) * size * bytesPerPixel(kBakedMapFormat) * 6;
+        if(header.levels[level].uncompressedByteLength != levelBytes){
+            return false;}
+        levelOffsets[level] = regions[size_t(level) * 6].bufferOffset;
+    }
+    return TexUtils::ReadKtx2Levels(file, header, levelOffsets, dst);
+}
+
+//cube face + texel -> direction, same as uvToXYZ in the compute shaders. u, v in [-1, 1]
+static glm::vec3 cubeTexelDirection(uint32_t face, float u, float v){
+    switch(face){
+        case 0:  return { 1.0f,    -v,   -u};   // +X
+        case 1:  return {-1.0f,    -v,    u};   // -X
+        case 2:  return {    u,  1.0f,    v};   // +Y
+        case 3:  return {    u, -1.0f,   -v};   // -Y
+        case 4:  return {    u,    -v, 1.0f};   // +Z
+        default: return {   -u,    -v,-1.0f};   // -Z
+    }
+}
+
+//real sh basis up to l = 2
+static void shBasis9(const glm::vec3& d, float Y[9]){
+    Y[0] = 0.282095f;
+    Y[1] = 0.488603f * d.y;
+    Y[2] = 0.488603f * d.z;
+    Y[3] = 0.488603f * d.x;
+    Y[4] = 1.092548f * d.x * d.y;
+    Y[5] = 1.092548f * d.y * d.z;
+    Y[6] = 0.315392f * (3.0f * d.z * d.z - 1.0f);
+    Y[7] = 1.092548f * d.x * d.z;
+    Y[8] = 0.546274f * (d.x * d.x - d.y * d.y);
+}
+
+
+//sh9 of one cube mip, already convolved with the cosine lobe and / pi. texel(index, channel): radiance,
+//index = (face * faceSize + y) * faceSize + x
+template<typename Texel>
+static std::array<glm::vec4, 9> projectSH9(uint32_t faceSize, Texel&& texel){
+    //radiance * Y * solid angle, one partial sum per row (face * faceSize + y), added up afterwards
+    struct RowSum{
+        double rgb[9][3]{};
+        double weight{0.0};     };
+    std::vector<RowSum> rows(size_t(6) * faceSize);
+    util::parallelFor(static_cast<int>(rows.size()), 8, [&](int row){
+        const uint32_t face = uint32_t(row) / faceSize;
+        const uint32_t y    = uint32_t(row) % faceSize;
+        const float v = (float(y) + 0.5f) / float(faceSize) * 2.0f - 1.0f;
+        RowSum& sum = rows[row];
+        for(uint32_t x = 0; x < faceSize; ++x){
+            const float u = (float(x) + 0.5f) / float(faceSize) * 2.0f - 1.0f;
+            //texel solid angle up to a constant (scaled to 4 pi below): 1 / distance^3 of the texel center on the unit cube
+            const float r2 = 1.0f + u * u + v * v;
+            const double solidAngle = 1.0 / (double(r2) * std::sqrt(double(r2)));
+
+            float Y[9];
+            shBasis9(glm::normalize(cubeTexelDirection(face, u, v)), Y);
+            const size_t index = size_t(row) * faceSize + x;
+            const double radiance[3] = {texel(index, 0), texel(index, 1), texel(index, 2)};
+            for(int k = 0; k < 9; ++k){
+                for(int c = 0; c < 3; ++c){
+                    sum.rgb[k][c] += radiance[c] * Y[k] * solidAngle;}
+            }
+            sum.weight += solidAngle;
+        }
+    });
 
+    RowSum total;
+    for(const RowSum& sum : rows){
+        for(int k = 0; k < 9; ++k){
+            for(int c = 0; c < 3; ++c){
+                total.rgb[k][c] += sum.rgb[k][c];}
+        }
+        total.weight += sum.weight;
+    }
+
+    //solid angles scaled to add up to exactly 4 pi. then cosine lobe (pi, 2pi/3, pi/4 per band) and the 1 / pi
+    constexpr double pi = 3.14159265358979323846;
+    const double normalize = 4.0 * pi / total.weight;
+    const double band[9] = {1.0, 2.0 / 3.0, 2.0 / 3.0, 2.0 / 3.0, 0.25, 0.25, 0.25, 0.25, 0.25};
+    std::array<glm::vec4, 9> sh{};
+    for(int k = 0; k < 9; ++k){
+        sh[k] = glm::vec4(float(total.rgb[k][0] * normalize * band[k]),
+                          float(total.rgb[k][1] * normalize * band[k]),
+                          float(total.rgb[k][2] * normalize * band[k]), 0.0f);
+    }
+    return sh;
 }
 
 
+//worker thread half of an environment swap: hdr -> cube with every mip, packed for the upload. same result as
+//JCubemap's cpu path (and its cache file), then sh9 from the packed mips and the cached prefiltered map if this sky
+//was baked before with the same settings. no queue is touched, buffers are only created and written
+static EnvLoad loadEnvironment(JDevice& device, const std::string& path, PrefilterBake bake, uint64_t spirvHash, float maxError){
+    const auto start = std::chrono::steady_clock::now();
+
+    MappedFile file(path);
+    int width, height, fileChannels;
+    if(!TexUtils::queryImageInfo(file, width, height, fileChannels) || width < 4 || height <= 0){
+        throw std::runtime_error("failed to load environment ' " + path + " '");}
+
+    EnvLoad load;
+    load.faceSize  = static_cast<uint32_t>(width / 4);
+    load.mipLevels = static_cast<uint32_t>(std::floor(std::log2(load.faceSize))) + 1;
+    const uint64_t contentHash = JCubemap::cacheKey(file, "cpu", load.faceSize, kBakedMapFormat);
+    const VkDeviceSize bytes = TexUtils::Ktx2ReadbackRegions(kBakedMapFormat, load.faceSize, load.faceSize, load.mipLevels, 6, load.regions);
+
+    //built on the heap, write combined staging is slow to read back for the mips / sh
+    std::vector<uint8_t> packed(bytes);
+    const std::string cubeCache = TexUtils::convertedCachePath(contentHash);
+    if(readCachedCube(cubeCache, load.faceSize, load.regions, packed.data())){
+        if(TexUtils::loadStatsEnabled()){
+            std::cout << "DEBUG: environment cube from cache " << cubeCache << std::endl;}}
+    else{
+        TexUtils::HdrInfo hdr;
+        const bool isRGBE = TexUtils::parseHdr(file, hdr);
+        JBitmap in = isRGBE ? JBitmap(width, height, 4, eJBitmapFormat_UnsignedByte)
+                            : JBitmap(width, height, 4, eJBitmapFormat_Float);
+        if(isRGBE){
+            TexUtils::decodeHdrRGBE(file, hdr, in.data_.data());}
+        else{
+            TexUtils::decodeInto(file, 4, true, in.data_.data(), in.data_.size());}
+
+        //mip 0 faces are the first 6 regions, back to back
+        if(isRGBE){
+            convertRGBEEquirectToCubeMapFaces(in, packed.data(), eJBitmapFormat_Half);}
+        else{
+            convertEquirectangularMapToCubeMapFaces(in, packed.data(), eJBitmapFormat_Half);}
+
+        //2x2 box in half per face, what the blit chain of the cpu path gives for power of two faces
+        util::parallelFor(6, 1, [&](int face){
+            for(uint32_t mip = 1; mip < load.mipLevels; ++mip){
+                const int srcSize = static_cast<int>(std::max(1u, load.faceSize >> (mip - 1)));
+                const int dstSize = static_cast<int>(std::max(1u, load.faceSize >> mip));
+                const auto* src = reinterpret_cast<const uint16_t*>(packed.data() + load.regions[(mip - 1) * 6 + face].bufferOffset);
+                auto*       dst = reinterpret_cast<uint16_t*>(packed.data() + load.regions[mip * 6 + face].bufferOffset);
+                downsample2x(JBitmapView<eJBitmapFormat_Half, 4, false>(src, srcSize, srcSize),
+                             JBitmapView<eJBitmapFormat_Half, 4>(dst, dstSize, dstSize));
+            }
+        });
+
+        if(JCubemap::cacheEnabled()){
+            try{
+                TexUtils::WriteKtx2FromReadback(packed.data(), load.regions, kBakedMapFormat,
+                        load.faceSize, load.faceSize, load.mipLevels, 6, cubeCache);}
+            catch(const std::exception& e){
+                std::cout << "DEBUG: cubemap cache write skipped: " << e.what() << std::endl;}
+        }
+    }
+
+    uint32_t shMip = 0;
+    while((load.faceSize >> shMip) > kIrradianceSHFaceSize && shMip + 1 < load.mipLevels){
+        ++shMip;}
+    const auto* shTexels = reinterpret_cast<const uint16_t*>(packed.data() + load.regions[shMip * 6].bufferOffset);
+    load.irradianceSH = projectSH9(std::max(1u, load.faceSize >> shMip),
+                            [&](size_t index, int channel){ return halfToFloat(shTexels[index * 4 + channel]); });
+
+    load.staging = std::make_unique<JBuffer>(device, bytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT|VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    load.staging->stagingAction(packed.data());
+
+    //calibrated before: the bake goes straight on with those budgets
+    const uint32_t levelCount = bake.distribution == Distribution_Lambertian ? 1 : load.mipLevels;
+    load.budgets = PrecomputeManifest(kPrecomputeManifestPath).calibratedBudgets(
+                        calibrationKey(contentHash, load.faceSize, bake.distribution, bake.sampleCount, maxError), levelCount);
+
+    //baked before: only the upload is left
+    load.entry = prefilterCacheEntry("", contentHash, load.faceSize, bake.distribution, bake.sampleCount, spirvHash, maxError);
+    load.entry.output = TexUtils::convertedCachePath(prefilterCacheKey(load.entry));
+    if(bake.distribution == Distribution_GGX && readCachedCube(load.entry.output, load.faceSize, load.regions, packed.data())){
+        load.prefilterStaging = std::make_unique<JBuffer>(device, bytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT|VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        load.prefilterStaging->stagingAction(packed.data());
+    }
+
+    if(TexUtils::loadStatsEnabled()){
+        std::cout << "DEBUG: environment " << path << " face " << load.faceSize << " loaded on a worker in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms"
+                  << (load.prefilterStaging ? ", prefiltered map cached" : "") << std::endl;}
+    return load;
+}
+
+
+
+
+bool PrecomputeSystem::beginPrefilterBake(const JCubemap& cubemapBase, float sliceMs){
+    if(job_){
+        throw std::runtime_error("beginPrefilterBake: a bake is already running");}
+
+    const float maxError = maxSampleErrorFromEnv();
+    const PrecomputeCacheEntry entry = prefilterCacheEntry(kPrefilterBake.path, cubemapBase.getContentHash(),
+                                            static_cast<uint32_t>(cubemapBase.getTextureWidth()), kPrefilterBake.distribution,
+                                            kPrefilterBake.sampleCount, prefilterSpirvHash_, maxError);
 
+    //source hash 0: cube of unknown origin, always bake
+    if(entry.sourceHash != 0 && PrecomputeManifest(kPrecomputeManifestPath).isValid(entry)){
+        if(TexUtils::loadStatsEnabled()){
+            std::cout << "DEBUG: " << entry.output << " is up to date, bake skipped" << std::endl;}
+        return false;}
 
-//first generate these textures, then check how to properly create lighting system
-//individual one
-void PrecomputeSystem::processCubemap(const JCubemap& cubemapBase, 
-            uint32_t distributionIndex ,const char* OUT_ktxPath, uint32_t sampleCount){
+    auto job = std::make_unique<BakeJob>();
+    job->source   = &cubemapBase;
+    job->bake     = kPrefilterBake;
+    job->maxError = maxError;
+    job->entry    = entry;
+    job->sliceMs  = sliceMs;
+    job->start    = std::chrono::steady_clock::now();
 
-    //create empty env container (based on input cubemap)
+    //empty container (based on input cubemap), its first bake step moves it out of UNDEFINED
     TextureConfig prefilterEnvConfig = PrefilterEnvMapConfig(
                                             cubemapBase.getTextureWidth(),
                                             cubemapBase.getTextureHeight(),
-                                            VK_FORMAT_R32G32B32A32_SFLOAT);
-    //empty container
-    prefilterEnvmap_ = std::make_unique<JTextureBase>(device_app, prefilterEnvConfig);
+                                            kBakedMapFormat);
+    prefilterEnvConfig.transitionOnCreate = false;
+    job->target = std::make_unique<JTextureBase>(device_app, prefilterEnvConfig);
+    // For irradiance (Lambertian), only generate mip 0
+    // For prefilter (GGX), generate all mip levels
+    job->levelCount = (job->bake.distribution == Distribution_Lambertian) ? 1 : job->target->getMipLevels();
+
+    //calibrated before (same sky, size, ceiling, maxError): no probes
+    job->calibrationKey = calibrationKey(entry.sourceHash, static_cast<uint32_t>(cubemapBase.getTextureWidth()),
+                                         job->bake.distribution, job->bake.sampleCount, maxError);
+    job->budgets = PrecomputeManifest(kPrecomputeManifestPath).calibratedBudgets(job->calibrationKey, job->levelCount);
+    if(job->budgets.empty()){
+        recordCalibration(*job);}
+    else{
+        recordBake(*job);}
+    submitSlice(*job);
+    job_ = std::move(job);
+    if(TexUtils::loadStatsEnabled()){
+        std::cout << "DEBUG: " << entry.output << " baking on the " << (device_app.hasAsyncCompute() ? "async compute" : "graphics")
+                  << " queue" << std::endl;}
+    return true;
+}
+
 
- 
-    JDescriptorWriter writer(*descriptorSetLayout_app, descriptorAllocator_app->getDescriptorPool());
-    //for source env map, just one time set up
-    auto srcImageInfo = cubemapBase.getDescriptorImageInfo();
-    //use one descriptor set two bindings
-    VkDescriptorSet desSet;
+void PrecomputeSystem::requestEnvironment(const std::string& path, SamplerManager& samplerManager, float sliceMs){
+    releaseFinished();
+    if(job_){
+        if(TexUtils::loadStatsEnabled()){
+            std::cout << "DEBUG: bake of " << (job_->path.empty() ? job_->entry.output : job_->path)
+                      << " dropped for " << path << std::endl;}
+        abandoned_.push_back(std::move(job_));}
+
+    auto job = std::make_unique<BakeJob>();
+    job->stage          = BakeJob::Stage::Loading;
+    job->path           = path;
+    job->samplerManager = &samplerManager;
+    job->bake           = kPrefilterBake;
+    job->maxError       = maxSampleErrorFromEnv();
+    job->sliceMs        = sliceMs;
+    job->start          = std::chrono::steady_clock::now();
+    job->load = std::async(std::launch::async, loadEnvironment, std::ref(device_app), path,
+                           job->bake, prefilterSpirvHash_, job->maxError);
+    job_ = std::move(job);
+}
+
+
+std::optional<EnvironmentMaps> PrecomputeSystem::pollPrefilterBake(bool wait){
+    releaseFinished();
+    while(job_){
+        BakeJob& job = *job_;
+        if(job.stage == BakeJob::Stage::Loading){
+            if(!wait && job.load.wait_for(std::chrono::seconds(0)) != std::future_status::ready){
+                return std::nullopt;}
+            try{
+                job.loaded = job.load.get();}
+            catch(const std::exception& e){
+                std::cout << "warning: failed to load environment " << job.path << ": " << e.what() << std::endl;
+                job_.reset();
+                return std::nullopt;}
+            recordUpload(job);
+            continue;}
+
+        if(wait){
+            timeline_->wait(job.waitValue);}
+        else if(timeline_->value() < job.waitValue){
+            return std::nullopt;}
+        measureSlice(job);
+
+        //one slice a frame, the rest of the stage waits for the next poll
+        if(job.nextStep < job.steps.size()){
+            submitSlice(job);
+            if(!wait){
+                return std::nullopt;}
+            continue;}
+
+        releaseSubmitResources(job);
+        if(job.stage == BakeJob::Stage::Uploading){
+            if(job.loaded.prefilterStaging){
+                break;}
+            if(job.loaded.budgets.size() == job.levelCount){
+                job.budgets = job.loaded.budgets;
+                recordBake(job);}
+            else{
+                recordCalibration(job);}
+            continue;}
+        if(job.stage == BakeJob::Stage::Calibrating){
+            evaluateCalibration(job);
+            recordBake(job);
+            continue;}
+        break;
+    }
+    if(!job_){
+        return std::nullopt;}
 
-    std::vector<VkImageView> loopImageViews;
-    //placeholder for initial
-    VkImageView placeholder = prefilterEnvmap_->switchViewForMip(1, VK_IMAGE_VIEW_TYPE_2D_ARRAY);
-    loopImageViews.push_back(placeholder);  // all need to be destory in the end 
+    EnvironmentMaps maps = finishBake(*job_);
+    job_.reset();
+    return maps;
+}
 
 
-    VkDescriptorImageInfo dstImageInfo{};
-    dstImageInfo.imageView = placeholder; //dummy for now
-    dstImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+void PrecomputeSystem::generatePrecomputedMaps(const JCubemap& cubemapBase){
+    if(beginPrefilterBake(cubemapBase)){
+        pollPrefilterBake(true);}
+}
 
 
-    if(!writer  .writeImage(0, &srcImageInfo)
-                .writeImage(1, &dstImageInfo)
-                .build(desSet)){ throw std::runtime_error("failed to allocate descriptor set for cubemap!");}
 
 
-    //calculate working group size
-    uint32_t shader_localX = 16;           // must match the shader
-    uint32_t shader_localY = 16;
+void PrecomputeSystem::submitSlice(BakeJob& job){
+    //sliceMs 0: the whole stage in this submit
+    const double budget = job.sliceMs > 0.0f ? double(job.sliceMs) * bakeCostPerMs_
+                                             : std::numeric_limits<double>::infinity();
+
+    job.commandBuffer = std::make_unique<JCommandBuffer>(device_app, VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+                                                         device_app.getComputeCommandPool());
+    VkCommandBuffer cmd = job.commandBuffer->getCommandBuffer();
+    job.commandBuffer->beginSingleTimeCommands();
+    job.sliceTimed = (timestampPool_ != VK_NULL_HANDLE);
+    if(job.sliceTimed){
+        vkCmdResetQueryPool(cmd, timestampPool_, 0, 2);
+        vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPool_, 0);}
+    if(job.pipeline != VK_NULL_HANDLE){
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, job.pipeline);}
+
+    //at least one step, a step over the budget on its own still has to go. barriers between slices come
+    //from the steps themselves, a pipeline barrier covers earlier submits on the same queue too
+    job.sliceCost = 0;
+    do{
+        job.sliceCost += job.steps[job.nextStep].cost;
+        job.steps[job.nextStep++].record(cmd);
+    }while(job.nextStep < job.steps.size() && double(job.sliceCost + job.steps[job.nextStep].cost) <= budget);
+
+    if(job.sliceTimed){
+        vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool_, 1);}
+    job.waitValue = ++timelineValue_;
+    job.commandBuffer->endAndSubmit(device_app.computeQueue(), timeline_->semaphore(), job.waitValue);
+}
 
-    // For irradiance (Lambertian), only generate mip 0
-    // For prefilter (GGX), generate all mip levels
-    uint32_t maxMip = (distributionIndex == 0) ? 1 : prefilterEnvmap_->getMipLevels(); // Lambertian = 0, GGX = 1
-
-    
-    for (uint32_t mip = 0; mip < maxMip; mip++) {
-        uint32_t faceW = std::max(1u, static_cast<uint32_t>(prefilterEnvmap_->getTextureWidth())  >> mip);
-        uint32_t faceH = std::max(1u, static_cast<uint32_t>(prefilterEnvmap_->getTextureHeight()) >> mip);
-        uint32_t wkGrp_x = (faceW + shader_localX - 1) / shader_localX;
-        uint32_t wkGrp_y = (faceH + shader_localY - 1) / shader_localY;
-
-        JCommandBuffer commandBuffer(device_app, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
-        commandBuffer.beginSingleTimeCommands();
-
-        //image view+image layout  
-        VkImageView currentMip_imageView = prefilterEnvmap_->switchViewForMip(mip, VK_IMAGE_VIEW_TYPE_2D_ARRAY);
-        loopImageViews.push_back(currentMip_imageView);
-
-        //update vkdescriptor set
-        VkDescriptorImageInfo updateDstImageInfo{};
-        updateDstImageInfo.imageView = currentMip_imageView; 
-        updateDstImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-        
-        VkWriteDescriptorSet overwriteWrite{};
-        overwriteWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        overwriteWrite.dstSet = desSet;
-        overwriteWrite.dstBinding = 1;
-        overwriteWrite.descriptorCount = 1;
-        overwriteWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-        overwriteWrite.pImageInfo = &updateDstImageInfo;
-        vkUpdateDescriptorSets(device_app.device(), 1, &overwriteWrite, 0,nullptr);
-
-        vkCmdBindPipeline(commandBuffer.getCommandBuffer(), VK_PIPELINE_BIND_POINT_COMPUTE, prefilterComputePipeline_app->getComputePipeline());
-        vkCmdBindDescriptorSets(
-                    commandBuffer.getCommandBuffer(), 
-                    VK_PIPELINE_BIND_POINT_COMPUTE, 
-                    prefilterPipelineLayout_app->getPipelineLayout(),
-                    0,/* firstSet */
-                    1, /* descriptorSetCount */
-                    &desSet, /* *pDescriptorSets */
-                    0, 
-                    nullptr );
-                    
-        for (uint32_t face = 0; face < 6; face++) {
+
+void PrecomputeSystem::measureSlice(BakeJob& job){
+    if(!job.sliceTimed || job.sliceCost == 0){
+        return;}
+    job.sliceTimed = false;
+
+    uint64_t ticks[2];
+    if(vkGetQueryPoolResults(device_app.device(), timestampPool_, 0, 2, sizeof(ticks), ticks, sizeof(uint64_t),
+                             VK_QUERY_RESULT_64_BIT) != VK_SUCCESS || ticks[1] <= ticks[0]){
+        return;}
+    const double ms = double(ticks[1] - ticks[0]) * device_app.computeTimestampPeriod() / 1.0e6;
+    //averaged, a slice sometimes shares the gpu with a heavy frame
+    bakeCostPerMs_ = 0.75 * bakeCostPerMs_ + 0.25 * (double(job.sliceCost) / ms);
+}
+
+
+
+
+void PrecomputeSystem::recordUpload(BakeJob& job){
+    EnvLoad& loaded = job.loaded;
+    job.stage    = BakeJob::Stage::Uploading;
+    job.entry    = loaded.entry;
+    job.pipeline = VK_NULL_HANDLE;
+    job.steps.clear();
+    job.nextStep = 0;
+
+    //both stay UNDEFINED until the upload below, no graphics queue wait while they are created
+    job.cube = std::make_shared<JCubemap>(device_app, *job.samplerManager, loaded.faceSize, kBakedMapFormat, false);
+    job.cube->setContentHash(loaded.entry.sourceHash);
+    job.source = job.cube.get();
+
+    TextureConfig prefilterEnvConfig = PrefilterEnvMapConfig(loaded.faceSize, loaded.faceSize, kBakedMapFormat);
+    prefilterEnvConfig.transitionOnCreate = false;
+    job.target = std::make_unique<JTextureBase>(device_app, prefilterEnvConfig);
+    job.levelCount = (job.bake.distribution == Distribution_Lambertian) ? 1 : job.target->getMipLevels();
+    job.calibrationKey = calibrationKey(loaded.entry.sourceHash, loaded.faceSize, job.bake.distribution,
+                                        job.bake.sampleCount, job.maxError);
+
+    //copies are bandwidth bound and short next to the bake, they cost nothing in the slice budget.
+    //ends shader read only, for the bake (compute) and later the frames (graphics, after the timeline wait)
+    auto upload = [this](VkCommandBuffer cmd, VkImage image, uint32_t mipLevels, JBuffer& staging,
+                         const std::vector<VkBufferImageCopy>& regions){
+        device_app.transitionImageLayout(cmd, image,
+                VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_IMAGE_ASPECT_COLOR_BIT, mipLevels, 6);
+        vkCmdCopyBufferToImage(cmd, staging.buffer(), image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                static_cast<uint32_t>(regions.size()), regions.data());
+        device_app.transitionImageLayout(cmd, image,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_IMAGE_ASPECT_COLOR_BIT, mipLevels, 6);
+    };
+    job.steps.push_back({0, [&job, upload](VkCommandBuffer cmd){
+        upload(cmd, job.cube->textureImage(), job.cube->getMipLevels(), *job.loaded.staging, job.loaded.regions);}});
+    if(loaded.prefilterStaging){
+        job.steps.push_back({0, [&job, upload](VkCommandBuffer cmd){
+            upload(cmd, job.target->textureImage(), job.target->getMipLevels(), *job.loaded.prefilterStaging, job.loaded.regions);}});
+    }
+}
+
+
+void PrecomputeSystem::recordCalibration(BakeJob& job){
+    job.stage    = BakeJob::Stage::Calibrating;
+    job.pipeline = prefilterComputePipelines_app[job.bake.distribution]->getComputePipeline();
+    job.steps.clear();
+    job.nextStep = 0;
+
+    job.candidates = calibrationCandidates(job.bake.sampleCount);
+
+    //slot 0 = reference, slot i = candidates[i - 1]. each slot is 6 layers (faces) of the probe image
+    const uint32_t slotCount = static_cast<uint32_t>(job.candidates.size()) + 1;
+
+    TextureConfig probeConfig;
+    probeConfig.format      = kBakedMapFormat;
+    probeConfig.channels    = 4;
+    probeConfig.extent      = {kProbeSize, kProbeSize, 1};
+    probeConfig.mipLevels   = 1;
+    probeConfig.arrayLayers = 6 * slotCount;
+    probeConfig.viewType    = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+    probeConfig.usageFlags  = VK_IMAGE_USAGE_STORAGE_BIT|VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    probeConfig.newLayout   = VK_IMAGE_LAYOUT_GENERAL;
+    probeConfig.computeShared = true;
+    probeConfig.transitionOnCreate = false;
+    job.probe = std::make_unique<JTextureBase>(device_app, probeConfig);
+
+    for(uint32_t slot = 0; slot < slotCount; ++slot){
+        auto viewInfo = ImageViewCreateInfoBuilder(job.probe->textureImage())
+                        .viewType(VK_IMAGE_VIEW_TYPE_2D_ARRAY)
+                        .format(kBakedMapFormat)
+                        .mipLevels(0, 1)
+                        .arrayLayers(6 * slot, 6)
+                        .getInfo();
+        VkImageView view;
+        if(device_app.createImageViewWithInfo(viewInfo, view) != VK_SUCCESS){
+            throw std::runtime_error("failed to create probe view for sample calibration");}
+        job.views.push_back(view);
+    }
+    job.setAllocator = std::make_unique<JDescriptorAllocator>(device_app, slotCount);
+    const std::vector<VkDescriptorSet> slotSets = buildMipDescriptorSets(
+                                            *job.setAllocator, job.source->getDescriptorImageInfo(), job.views);
+
+    //every probed level's runs in one table
+    const uint32_t mipLevels   = job.target->getMipLevels();
+    const uint32_t envFaceSize = static_cast<uint32_t>(job.source->getTextureWidth());
+    std::vector<PrefilterSample> table;
+    std::vector<std::vector<SampleRun>> levelRuns;
+    job.budgets.assign(job.levelCount, job.bake.sampleCount);
+    for(uint32_t level = 0; level < job.levelCount; ++level){
+        const float roughness = levelRoughness(job.bake.distribution, level, mipLevels);
+        //mirror: every ggx sample is N itself
+        if(job.bake.distribution == Distribution_GGX && roughness == 0.0f){
+            job.budgets[level] = 1;
+            continue;}
+
+        //lod depends on the real mip size, the probe only picks which directions get compared
+        const uint32_t dstW = std::max(1u, envFaceSize >> level);
+        std::vector<SampleRun> runs;
+        runs.push_back(appendSamples(table, job.bake.distribution, roughness, kReferenceSampleCount, envFaceSize, dstW, dstW));
+        for(uint32_t count : job.candidates){
+            runs.push_back(appendSamples(table, job.bake.distribution, roughness, count, envFaceSize, dstW, dstW));}
+        levelRuns.push_back(std::move(runs));
+        job.probedLevels.push_back(level);
+    }
+
+    const VkDeviceSize blockBytes = VkDeviceSize(kProbeSize) * kProbeSize * 6 * slotCount * bytesPerPixel(kBakedMapFormat);
+    job.probeReadback = std::make_unique<JBuffer>(device_app, blockBytes * std::max<size_t>(1, job.probedLevels.size()),
+                     VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT|VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if(!table.empty()){
+        job.sampleTable = uploadSampleTable(device_app, table);}
+
+    const VkPipelineLayout layout = prefilterPipelineLayout_app->getPipelineLayout();
+    job.steps.push_back({0, [this, &job, slotCount](VkCommandBuffer cmd){
+        device_app.transitionImageLayout(cmd, job.probe->textureImage(),
+                VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+                VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_IMAGE_ASPECT_COLOR_BIT, 1, 6 * slotCount);}});
+
+    //one probe image, reused level after level: dispatch every slot, copy out to the level's block
+    for(size_t i = 0; i < job.probedLevels.size(); ++i){
+        for(uint32_t slot = 0; slot < slotCount; ++slot){
             PerFrameData perFrameData{};
-            perFrameData.face           = face;
-            
-            // Set roughness based on distribution type
-            if (distributionIndex == 0) { // Lambertian (irradiance)
-                perFrameData.roughness = 0.0f; // Maximum roughness for diffuse
-            } else { // GGX (prefilter)
-                perFrameData.roughness = (float)(mip) / (float)(prefilterEnvmap_->getMipLevels() - 1);
+            perFrameData.sampleTable    = job.sampleTable->getBufferAddress();
+            perFrameData.width          = kProbeSize;
+            perFrameData.height         = kProbeSize;
+            perFrameData.sampleOffset   = levelRuns[i][slot].offset;
+            perFrameData.sampleCount    = levelRuns[i][slot].count;
+            perFrameData.rowOffset      = 0;
+            const VkDescriptorSet set   = slotSets[slot];
+            job.steps.push_back({uint64_t(kProbeSize) * kProbeSize * 6 * perFrameData.sampleCount,
+                [layout, set, perFrameData](VkCommandBuffer cmd){
+                    dispatchPrefilter(cmd, layout, set, perFrameData, kProbeSize);}});
+        }
+
+        job.steps.push_back({0, [this, &job, slotCount, blockBytes, i](VkCommandBuffer cmd){
+            VkBufferImageCopy region{};
+            region.bufferOffset = blockBytes * i;
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel = 0;
+            region.imageSubresource.baseArrayLayer = 0;
+            region.imageSubresource.layerCount = 6 * slotCount;
+            region.imageExtent = {kProbeSize, kProbeSize, 1};
+            device_app.transitionImageLayout(cmd, job.probe->textureImage(),
+                    VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                    VK_IMAGE_ASPECT_COLOR_BIT, 1, 6 * slotCount);
+            vkCmdCopyImageToBuffer(cmd, job.probe->textureImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                    job.probeReadback->buffer(), 1, &region);
+            //next level overwrites the probe only after the copy read it
+            device_app.transitionImageLayout(cmd, job.probe->textureImage(),
+                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                    VK_IMAGE_ASPECT_COLOR_BIT, 1, 6 * slotCount);}});
+    }
+}
+
+
+void PrecomputeSystem::evaluateCalibration(BakeJob& job){
+    const uint32_t slotCount  = static_cast<uint32_t>(job.candidates.size()) + 1;
+    const size_t   slotTexels = size_t(kProbeSize) * kProbeSize * 6;
+
+    //relative rms of rgb over all probe texels, first candidate under maxError wins
+    job.probeReadback->map();
+    const uint16_t* blocks = reinterpret_cast<const uint16_t*>(job.probeReadback->getBufferMapped());
+    for(size_t i = 0; i < job.probedLevels.size(); ++i){
+        const uint16_t* texels = blocks + i * slotCount * slotTexels * 4;
+        const uint16_t* reference = texels;
+        for(size_t c = 0; c < job.candidates.size(); ++c){
+            const uint16_t* result = texels + (c + 1) * slotTexels * 4;
+            double errorSum = 0.0, referenceSum = 0.0;
+            for(size_t t = 0; t < slotTexels; ++t){
+                for(size_t ch = 0; ch < 3; ++ch){
+                    const double r = halfToFloat(reference[t * 4 + ch]);
+                    const double d = halfToFloat(result[t * 4 + ch]) - r;
+                    errorSum += d * d;
+                    referenceSum += r * r;
+                }
             }
-            
-            perFrameData.width          = faceW;
-            perFrameData.height         = faceH;
-            perFrameData.sampleCount    = sampleCount;
-            perFrameData.distribution   = distributionIndex;
-            
-            vkCmdPushConstants(commandBuffer.getCommandBuffer(), prefilterPipelineLayout_app->getPipelineLayout(), 
-                    VK_SHADER_STAGE_COMPUTE_BIT, 0, 
-                    sizeof(perFrameData), &perFrameData);
-            vkCmdDispatch(commandBuffer.getCommandBuffer(), wkGrp_x, wkGrp_y, 1);      
+            //black probe: anything passes
+            const double error = referenceSum > 0.0 ? std::sqrt(errorSum / referenceSum) : 0.0;
+            if(error <= job.maxError){
+                job.budgets[job.probedLevels[i]] = job.candidates[c];
+                break;}
+        }
+    }
+    job.probeReadback->unmap();
+    job.calibrated = true;
+
+    job.probeReadback.reset();
+    job.probe.reset();
+}
 
+
+void PrecomputeSystem::recordBake(BakeJob& job){
+    job.stage    = BakeJob::Stage::Baking;
+    job.pipeline = prefilterComputePipelines_app[job.bake.distribution]->getComputePipeline();
+    job.steps.clear();
+    job.nextStep = 0;
+
+    JTextureBase& target = *job.target;
+    const uint32_t mipLevels = target.getMipLevels();
+    const uint32_t width  = static_cast<uint32_t>(target.getTextureWidth());
+    const uint32_t height = static_cast<uint32_t>(target.getTextureHeight());
+
+    //budget per mip, all mips' samples in one table
+    std::vector<PrefilterSample> table;
+    std::vector<SampleRun> runs;
+    for(uint32_t mip = 0; mip < job.levelCount; ++mip){
+        runs.push_back(appendSamples(table, job.bake.distribution,
+                            levelRoughness(job.bake.distribution, mip, mipLevels), job.budgets[mip],
+                            static_cast<uint32_t>(job.source->getTextureWidth()),
+                            std::max(1u, width >> mip), std::max(1u, height >> mip)));
+    }
+    job.sampleTable = uploadSampleTable(device_app, table);
+
+    //one storage view + one set per mip, so any band of any mip can go into any slice
+    for(uint32_t mip = 0; mip < job.levelCount; ++mip){
+        job.views.push_back(target.switchViewForMip(mip, VK_IMAGE_VIEW_TYPE_2D_ARRAY));}
+    job.setAllocator = std::make_unique<JDescriptorAllocator>(device_app, job.levelCount);
+    const std::vector<VkDescriptorSet> mipSets = buildMipDescriptorSets(
+                                            *job.setAllocator, job.source->getDescriptorImageInfo(), job.views);
+
+    const VkDeviceSize readbackBytes = TexUtils::Ktx2ReadbackRegions(kBakedMapFormat, width, height, job.levelCount, 6, job.regions);
+    job.readback = std::make_unique<JBuffer>(device_app, readbackBytes,
+                          VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    job.steps.push_back({0, [this, &job, mipLevels](VkCommandBuffer cmd){
+        device_app.transitionImageLayout(cmd, job.target->textureImage(),
+                VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+                VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_IMAGE_ASPECT_COLOR_BIT, mipLevels, 6);}});
+
+    //mips / bands write different texels and only read the source cube, no barriers in between
+    const VkPipelineLayout layout = prefilterPipelineLayout_app->getPipelineLayout();
+    for(uint32_t mip = 0; mip < job.levelCount; mip++){
+        PerFrameData perFrameData{};
+        perFrameData.sampleTable    = job.sampleTable->getBufferAddress();
+        perFrameData.width          = std::max(1u, width  >> mip);
+        perFrameData.height         = std::max(1u, height >> mip);
+        perFrameData.sampleOffset   = runs[mip].offset;
+        perFrameData.sampleCount    = runs[mip].count;
+        const VkDescriptorSet set   = mipSets[mip];
+        for(uint32_t row = 0; row < perFrameData.height; row += kBakeBandRows){
+            perFrameData.rowOffset = row;
+            const uint32_t rows = std::min(kBakeBandRows, perFrameData.height - row);
+            job.steps.push_back({uint64_t(perFrameData.width) * rows * 6 * std::max(1u, perFrameData.sampleCount),
+                [layout, set, perFrameData, rows](VkCommandBuffer cmd){
+                    dispatchPrefilter(cmd, layout, set, perFrameData, rows);}});
         }
-  
-        VkImageMemoryBarrier barrier{};
-        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        barrier.image = prefilterEnvmap_->textureImage();
-        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        barrier.subresourceRange.baseMipLevel = mip;
-        barrier.subresourceRange.levelCount = 1;
-        barrier.subresourceRange.baseArrayLayer = 0;
-        barrier.subresourceRange.layerCount = 6;
-        barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
-        barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
-        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-        vkCmdPipelineBarrier(commandBuffer.getCommandBuffer(),
-                              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-                              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-                            0,0 , nullptr, 0, nullptr, 1, &barrier);
-
-
-        commandBuffer.endSingleTimeCommands(device_app.graphicsQueue());
     }
 
-    for(VkImageView view:loopImageViews){
-        vkDestroyImageView(device_app.device(), view, nullptr);
+    //last slice: copy out for the ktx, then ready to sample. compute queue has no fragment stage,
+    //graphics gets it through the timeline wait in finishBake
+    job.steps.push_back({0, [this, &job, mipLevels](VkCommandBuffer cmd){
+        device_app.transitionImageLayout(cmd, job.target->textureImage(),
+                VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_IMAGE_ASPECT_COLOR_BIT, mipLevels, 6);
+        vkCmdCopyImageToBuffer(cmd, job.target->textureImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                job.readback->buffer(), static_cast<uint32_t>(job.regions.size()), job.regions.data());
+        device_app.transitionImageLayout(cmd, job.target->textureImage(),
+                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_IMAGE_ASPECT_COLOR_BIT, mipLevels, 6);}});
+}
+
+
+EnvironmentMaps PrecomputeSystem::finishBake(BakeJob& job){
+    const bool swap = !job.path.empty();
+    if(job.readback){
+        if(TexUtils::loadStatsEnabled()){
+            std::cout << "DEBUG: " << (swap ? job.path : job.entry.output) << " samples per mip:";
+            for(uint32_t budget : job.budgets){
+                std::cout << " " << budget;}
+            std::cout << std::endl;}
+
+        //gpu image -> ktx (all generated mips, 6 faces) off the frame. startup bake: the file the viewer loads + manifest,
+        //swaps: the texture cache, so the same sky next time is only an upload.
+        //new budgets go into the manifest either way, the next bake of this sky skips the probes
+        const bool writeFile = !swap || JCubemap::cacheEnabled();
+        const uint64_t budgetsKey = job.calibrated ? job.calibrationKey : 0;
+        if(writeFile || budgetsKey != 0){
+            std::shared_ptr<JBuffer> readback = std::move(job.readback);
+            cacheWrites_.push_back(std::async(std::launch::async,
+                [readback, regions = job.regions, entry = job.entry, levelCount = job.levelCount, swap, writeFile,
+                 budgetsKey, budgets = job.budgets,
+                 width = static_cast<uint32_t>(job.target->getTextureWidth()),
+                 height = static_cast<uint32_t>(job.target->getTextureHeight())](){
+                    try{
+                        if(writeFile){
+                            readback->map();
+                            TexUtils::WriteKtx2FromReadback(reinterpret_cast<const uint8_t*>(readback->getBufferMapped()), regions,
+                                    kBakedMapFormat, width, height, levelCount, 6, entry.output);
+                            readback->unmap();}
+                        //read again, another write may have recorded since begin
+                        PrecomputeManifest manifest(kPrecomputeManifestPath);
+                        if(budgetsKey != 0){
+                            manifest.recordBudgets(budgetsKey, budgets);}
+                        if(!swap){
+                            manifest.record(entry);}
+                    }
+                    catch(const std::exception& e){
+                        std::cout << "DEBUG: " << entry.output << " not written: " << e.what() << std::endl;}
+                }));
+        }
+        job.readback.reset();
     }
 
+    //the host saw the value, graphics still has to wait on it for the writes to be visible there
+    timeline_->queueWait(device_app.graphicsQueue(), job.waitValue);
+
+    if(TexUtils::loadStatsEnabled()){
+        std::cout << "DEBUG: " << (swap ? job.path : std::string(job.bake.path)) << (job.budgets.empty() ? " uploaded" : " baked")
+                  << " (max " << job.bake.sampleCount << " samples) in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - job.start).count() << " ms" << std::endl;}
 
-    //transfer gpu data (image) to buffers;
-        std::vector<VkBufferImageCopy> dstBuffers;
-        VkDeviceSize totalSize = 0;
-        dstBuffers.clear();
+    EnvironmentMaps maps;
+    maps.path         = job.path;
+    maps.cubemap      = std::move(job.cube);
+    maps.prefiltered  = std::move(job.target);
+    maps.irradianceSH = job.loaded.irradianceSH;
+    return maps;
+}
 
-        VkDeviceSize offset = 0;
 
-        for(uint32_t mip = 0; mip < maxMip; ++mip){
-            uint32_t curWidth  = std::max(1u, static_cast<uint32_t>(prefilterEnvmap_->getTextureWidth()) >> mip);
-            uint32_t curHeight = std::max(1u, static_cast<uint32_t>(prefilterEnvmap_->getTextureHeight()) >> mip);
-            VkDeviceSize byteThisFace = VkDeviceSize(curWidth) * curHeight * 16; //32bit so use 16
+void PrecomputeSystem::releaseSubmitResources(BakeJob& job){
+    job.commandBuffer.reset();
+    for(VkImageView view : job.views){
+        vkDestroyImageView(device_app.device(), view, nullptr);}
+    job.views.clear();
+    job.setAllocator.reset();
+    job.sampleTable.reset();
+    job.loaded.staging.reset();
+    job.loaded.prefilterStaging.reset();
+    job.steps.clear();
+    job.nextStep = 0;
+}
 
-            for(uint32_t face = 0; face < 6; ++face){
-                VkBufferImageCopy dstBuf;
-                dstBuf.bufferOffset = offset;
-                dstBuf.bufferRowLength = 0;
-                dstBuf.bufferImageHeight = 0;
-                dstBuf.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                dstBuf.imageSubresource.mipLevel = mip;
-                dstBuf.imageSubresource.baseArrayLayer = face;
-                dstBuf.imageSubresource.layerCount = 1;
-                dstBuf.imageOffset = {0,0,0};
-                dstBuf.imageExtent = {curWidth, curHeight, 1};
-                dstBuffers.push_back(dstBuf);
 
-                offset = Align(offset+byteThisFace, 4); // Vulkan 要求 bufferOffset 至少 4 字节对齐；保持 4 字节对齐最稳
+void PrecomputeSystem::releaseFinished(){
+    //dropped jobs: once their last slice ran and their worker returned
+    std::erase_if(abandoned_, [&](std::unique_ptr<BakeJob>& job){
+        if(timeline_->value() < job->waitValue){
+            return false;}
+        if(job->load.valid() && job->load.wait_for(std::chrono::seconds(0)) != std::future_status::ready){
+            return false;}
+        releaseSubmitResources(*job);
+        return true;
+    });
+    std::erase_if(cacheWrites_, [](std::future<void>& write){
+        return write.wait_for(std::chrono::seconds(0)) == std::future_status::ready;});
+}
 
-            }
-            totalSize = offset;
-        }
-        
-        //staging buffer : on cpu
-        JBuffer stagingBuffer(device_app, totalSize, 
-                    VK_BUFFER_USAGE_TRANSFER_DST_BIT, 
-                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-
-        // 2. 复制 GPU image 到 staging buffer
-        JCommandBuffer copyBuffer(device_app, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
-        copyBuffer.beginSingleTimeCommands();
-    
-        // transition image layout first , Generak->transfer source
-        device_app.transitionImageLayout(copyBuffer.getCommandBuffer(),
-                prefilterEnvmap_->textureImage(),
-                VK_IMAGE_LAYOUT_GENERAL,  VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
-                VK_IMAGE_ASPECT_COLOR_BIT,  maxMip, 6);
-
-        vkCmdCopyImageToBuffer(copyBuffer.getCommandBuffer(),
-                prefilterEnvmap_->textureImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                stagingBuffer.buffer(), (uint32_t)dstBuffers.size(), dstBuffers.data());
-        
-        copyBuffer.endSingleTimeCommands(device_app.graphicsQueue());
-
-        //generate a CPU handle
-        stagingBuffer.map();
-
-    
-
-    //create an empty ktx file
-    ktxTextureCreateInfo ktxCreateInfo = {
-            .vkFormat         = VK_FORMAT_R32G32B32A32_SFLOAT,  
-            .baseWidth        = static_cast<ktx_uint32_t>(prefilterEnvmap_->getTextureWidth()),
-            .baseHeight       = static_cast<ktx_uint32_t>(prefilterEnvmap_->getTextureHeight()),
-            .baseDepth        = 1u,
-            .numDimensions    = 2u,
-            .numLevels        = maxMip,
-            .numLayers        = 1u,
-            .numFaces         = 6u,
-            .generateMipmaps  = KTX_FALSE,
-        };
-    ktxTexture2* outKtx = nullptr;
-    ktxTexture2_Create(&ktxCreateInfo, KTX_TEXTURE_CREATE_ALLOC_STORAGE, &outKtx);
-
-    //pointer to data
-    const uint8_t* src = reinterpret_cast<const uint8_t*>(stagingBuffer.getBufferMapped());
-    VkDeviceSize srcOffset = 0;
-    //write tto ktx
-    for(uint32_t mip = 0; mip < maxMip; ++mip){
-        uint32_t curWidth  = std::max(1u, static_cast<uint32_t>(prefilterEnvmap_->getTextureWidth()) >> mip);
-        uint32_t curHeight = std::max(1u, static_cast<uint32_t>(prefilterEnvmap_->getTextureHeight()) >> mip);
-        VkDeviceSize byteThisFace = VkDeviceSize(curWidth) * curHeight * 16; //32bit so use 16
-
-        for(uint32_t face = 0; face < 6; ++face){
-            size_t ktxOffset = 0;
-            ktxTexture2_GetImageOffset(outKtx, mip, 0/*layer*/,
-                                        face, &ktxOffset );
-            std::memcpy(outKtx->pData + ktxOffset, src + srcOffset, size_t(byteThisFace));
-            srcOffset = Align(srcOffset + byteThisFace, 4);      }
+
+
+
+
+std::shared_ptr<JCubemap> PrecomputeSystem::createCubemapFromEquirect(const std::string& path, SamplerManager& samplerManager){
+    const auto start = std::chrono::steady_clock::now();
+
+    MappedFile file(path);
+    int width, height, fileChannels;
+    if (!TexUtils::queryImageInfo(file, width, height, fileChannels)) {
+        throw std::runtime_error("failed to load equirect image ' " + path + " ' : "+ stbi_failure_reason());}
+
+    //face = width / 4, same as the cpu path. equirect texel density then matches cube mip 0, so lod = mip
+    const uint32_t faceSize = static_cast<uint32_t>(width / 4);
+    //own key: mip 0 maps like the cpu path, the lower mips sample equirect lods instead of the cpu's box chain.
+    //v2: half texel offsets of the cpu path
+    const uint64_t cacheKey = JCubemap::cacheKey(file, "gpu v2", faceSize, kBakedMapFormat);
+    if(auto cached = JCubemap::loadCached(cacheKey, faceSize, kBakedMapFormat, device_app, samplerManager)){
+        return cached;}
+
+    //equirect as a plain 2D float texture, decoded straight into staging. mips by blit, so lower cube mips can sample a matching lod
+    TextureConfig equirectConfig;
+    equirectConfig.format       = VK_FORMAT_R32G32B32A32_SFLOAT;
+    equirectConfig.channels     = 4;
+    equirectConfig.usageFlags   = VK_IMAGE_USAGE_SAMPLED_BIT|VK_IMAGE_USAGE_TRANSFER_SRC_BIT|VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    equirectConfig.extent       = {static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1};
+    const size_t equirectBytes  = size_t(width) * height * 4 * sizeof(float);
+    equirectConfig.writeData    = [&](void* dst){ TexUtils::decodeInto(file, 4, true, dst, equirectBytes); };
+    JTextureBase equirect(device_app, equirectConfig);
+
+    //wrap around horizontally, clamp at the poles
+    auto equirectSamplerInfo = SamplerCreateInfoBuilder()
+                        .addressMode(VK_SAMPLER_ADDRESS_MODE_REPEAT, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE)
+                        .maxLod(equirect.getMipLevels())
+                        .getInfo();
+    VkDescriptorImageInfo srcImageInfo = equirect.getDescriptorImageInfo(samplerManager.getOrCreate(equirectSamplerInfo));
+
+    auto cubemap = std::make_shared<JCubemap>(device_app, samplerManager, faceSize, kBakedMapFormat);
+
+    auto mipView = [&](uint32_t mip){
+        auto viewInfo = ImageViewCreateInfoBuilder(cubemap->textureImage())
+                        .viewType(VK_IMAGE_VIEW_TYPE_2D_ARRAY)
+                        .format(cubemap->getFormat())
+                        .mipLevels(mip, 1)
+                        .arrayLayers(0, 6)
+                        .getInfo();
+        VkImageView view;
+        if(device_app.createImageViewWithInfo(viewInfo, view) != VK_SUCCESS){
+            throw std::runtime_error("failed to create cubemap mip view for equirect conversion");}
+        return view;
+    };
+
+    //same as recordBake: views + sets for every mip up front, all mips in one submit
+    std::vector<VkImageView> mipViews;
+    for(uint32_t mip = 0; mip < cubemap->getMipLevels(); ++mip){
+        mipViews.push_back(mipView(mip));}
+    JDescriptorAllocator mipSetAllocator(device_app, cubemap->getMipLevels());
+    const std::vector<VkDescriptorSet> mipSets = buildMipDescriptorSets(mipSetAllocator, srcImageInfo, mipViews);
+
+    uint32_t shader_localX = 16;           // must match the shader
+    uint32_t shader_localY = 16;
+
+    //startup only (loadEnvMaps, before the first frame): one blocking submit on the graphics queue, nothing to
+    //overlap with yet. swaps convert on a worker instead (loadEnvironment)
+    JCommandBuffer commandBuffer(device_app, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+    commandBuffer.beginSingleTimeCommands();
+    vkCmdBindPipeline(commandBuffer.getCommandBuffer(), VK_PIPELINE_BIND_POINT_COMPUTE, equirectComputePipeline_app->getComputePipeline());
+
+    for(uint32_t mip = 0; mip < cubemap->getMipLevels(); ++mip){
+        const uint32_t faceW = std::max(1u, faceSize >> mip);
+
+        vkCmdBindDescriptorSets(commandBuffer.getCommandBuffer(), VK_PIPELINE_BIND_POINT_COMPUTE,
+                    prefilterPipelineLayout_app->getPipelineLayout(), 0, 1, &mipSets[mip], 0, nullptr);
+
+        EquirectPushData pushData{};
+        pushData.width  = faceW;
+        pushData.height = faceW;
+        pushData.lod    = static_cast<float>(mip);
+        vkCmdPushConstants(commandBuffer.getCommandBuffer(), prefilterPipelineLayout_app->getPipelineLayout(), 
+                    VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushData), &pushData);
+
+        //z = face
+        vkCmdDispatch(commandBuffer.getCommandBuffer(),
+                    (faceW + shader_localX - 1) / shader_localX,
+                    (faceW + shader_localY - 1) / shader_localY, 6);
     }
 
-    stagingBuffer.unmap();
+    device_app.transitionImageLayout(commandBuffer.getCommandBuffer(), cubemap->textureImage(),
+            VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT|VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_IMAGE_ASPECT_COLOR_BIT, cubemap->getMipLevels(), 6);
+    commandBuffer.endSingleTimeCommands(device_app.graphicsQueue());
+
+    for(VkImageView view : mipViews){
+        vkDestroyImageView(device_app.device(), view, nullptr);}
 
-    //write into file
-    ktxTexture2_WriteToNamedFile(outKtx, OUT_ktxPath);
-    ktxTexture2_Destroy(outKtx);
+    if(TexUtils::loadStatsEnabled()){
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "DEBUG: equirect " << width << "x" << height << " -> cubemap on gpu ("
+                  << cubemap->getMipLevels() << " mips) " << ms << " ms" << std::endl;}
+
+    cubemap->setContentHash(cacheKey);
+    cubemap->writeCache(cacheKey);
+    return cubemap;
 }
 
 
 
 
-//generate irradiance, prefilter
-void PrecomputeSystem::generatePrecomputedMaps(const JCubemap& cubemapBase){
-    processCubemap(cubemapBase, 1, "../data/prefilterEnvMap.ktx", 2048);
-    processCubemap(cubemapBase, 0, "../data/irradianceMap.ktx", 2048);
+std::array<glm::vec4, 9> PrecomputeSystem::projectIrradianceSH(const JCubemap& cubemap){
+    const auto start = std::chrono::steady_clock::now();
+
+    const uint32_t baseSize = static_cast<uint32_t>(cubemap.getTextureWidth());
+    uint32_t mip = 0;
+    while((baseSize >> mip) > kIrradianceSHFaceSize && mip + 1 < cubemap.getMipLevels()){
+        ++mip;}
+    const uint32_t faceSize = std::max(1u, baseSize >> mip);
+
+    const VkFormat format = cubemap.getFormat();
+    if(format != VK_FORMAT_R16G16B16A16_SFLOAT && format != VK_FORMAT_R32G32B32A32_SFLOAT){
+        throw std::runtime_error("projectIrradianceSH: cubemap has to be rgba16f or rgba32f");}
+    const bool isHalf = (format == VK_FORMAT_R16G16B16A16_SFLOAT);
 
+    const std::vector<uint8_t> texels = TexUtils::ReadImageLevel(device_app, cubemap.textureImage(), format,
+                                            baseSize, baseSize, mip, 6, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT|VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    const std::array<glm::vec4, 9> sh = projectSH9(faceSize, [&](size_t index, int channel){
+        return isHalf ? halfToFloat(reinterpret_cast<const uint16_t*>(texels.data())[index * 4 + channel])
+                      : reinterpret_cast<const float*>(texels.data())[index * 4 + channel];
+    });
+
+    if(TexUtils::loadStatsEnabled()){
+        std::cout << "DEBUG: irradiance sh9 from " << faceSize << "x" << faceSize << " mip in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms" << std::endl;}
+    return sh;
 }
 
 
 
-void PrecomputeSystem::createComputePipeline(){
-    //create poolsize
-    std::vector<VkDescriptorPoolSize> poolSizes = 
-    {
-        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1},
-        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,          1},
-    };
 
-    // create descriptor allocator (create descriptor pool)
-    descriptorAllocator_app = std::make_shared<JDescriptorAllocator>(device_app, poolSizes, 2);
+std::vector<VkDescriptorSet> PrecomputeSystem::buildMipDescriptorSets(JDescriptorAllocator& allocator,
+            const VkDescriptorImageInfo& srcImageInfo, const std::vector<VkImageView>& mipViews){
+    //all in one allocation, then written one by one
+    std::vector<VkDescriptorSet> sets(mipViews.size());
+    allocator.allocateDescriptorSets(*descriptorSetLayout_app, static_cast<uint32_t>(sets.size()), sets.data());
+    for(size_t mip = 0; mip < mipViews.size(); ++mip){
+        VkDescriptorImageInfo dstImageInfo{};
+        dstImageInfo.imageView = mipViews[mip];
+        dstImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        JDescriptorWriter writer(*descriptorSetLayout_app, allocator);
+        if(!writer  .writeImage(0, &srcImageInfo)
+                    .writeImage(1, &dstImageInfo)
+                    .overwrite(sets[mip])){ throw std::runtime_error("failed to write descriptor set for cubemap mip!");}
+    }
+    return sets;
+}
+
+
 
+void PrecomputeSystem::createComputePipeline(){
+    //sets come from an allocator per bake, first pool sized for its mip count
     descriptorSetLayout_app = JDescriptorSetLayout::Builder{device_app}
         //sampler+image view+image layout
         .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 1)
@@ -323,12 +1140,25 @@ void PrecomputeSystem::createComputePipeline(){
 
 
     //compute pipeline -- for prefiltered envmap
-    auto code = util::readFile("../shaders/computePrefilIrrad.comp.spv");
+    auto code = util::readSpirv("../shaders/computePrefilIrrad.comp.spv");
     prefilterComputeShader_ = std::make_unique<JShaderModule>(device_app.device(), code);
+    prefilterSpirvHash_ = TexUtils::hashBytes(code.data(), code.size());
 
 
-    prefilterComputePipeline_app = std::make_unique<JComputePipeline>(
+    //constant 0 = DISTRIBUTION
+    for(uint32_t distribution : {Distribution_Lambertian, Distribution_GGX}){
+        prefilterComputePipelines_app[distribution] = std::make_unique<JComputePipeline>(
                                 device_app, *prefilterComputeShader_,
+                                prefilterPipelineLayout_app->getPipelineLayout(),
+                                std::vector<uint32_t>{distribution});
+    }
+
+    //compute pipeline -- equirect to cubemap
+    auto equirectCode = util::readSpirv("../shaders/equirectToCube.comp.spv");
+    equirectComputeShader_ = std::make_unique<JShaderModule>(device_app.device(), equirectCode);
+
+    equirectComputePipeline_app = std::make_unique<JComputePipeline>(
+                                device_app, *equirectComputeShader_,
                                 prefilterPipelineLayout_app->getPipelineLayout());    
 
 
@@ -1,4 +1,4 @@
-//for BRDF, IBL-prefiltered map and irradiance map
+//for BRDF, IBL-prefiltered map and irradiance (SH9)
 // check ktx: convert ktx to exr files  , terminal:  ktx extract prefilterEnvMap.ktx prefilter --all
 
 
@@ -6,8 +6,15 @@
 #include <vulkan/vulkan.hpp>
 #include <memory>
 #include <algorithm>
+#include <array>
+#include <future>
 #include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
 #include "../VulkanCore/global.hpp"
+#include "precomputeCommon.hpp"
 
 class JCubemap;
 class JTextureBase;
@@ -17,13 +24,39 @@ class JPipelineLayout;
 class JComputePipeline;
 class JDescriptorAllocator;
 class JDescriptorSetLayout;
+class SamplerManager;
+class JTimelineSemaphore;
+
+
+//how the equirect hdr becomes a cubemap. CPU: JCubemap resamples on the host (headless baking)
+//GPU: equirect is uploaded as 2D texture and a compute shader writes every face and mip
+//runtime switch: JRENDERER_CUBEMAP_CONVERSION=gpu|cpu  (default cpu)
+enum class CubemapConversion{
+    CPU,
+    GPU,
+};
+CubemapConversion cubemapConversionFromEnv();
+
+
+//gpu time a bake may use per frame, in ms. the work is cut into dispatches of a few rows and as many go into a
+//frame's submit as fit, measured with timestamps. JRENDERER_IBL_SLICE_MS=0: every stage in one submit
+inline constexpr float kDefaultBakeSliceMs = 2.0f;
+float bakeSliceMsFromEnv();
+
+//what a finished bake hands to the renderer, everything the static set needs for that sky
+struct EnvironmentMaps{
+    std::string path;                               //hdr of an environment swap, empty for the startup bake
+    std::shared_ptr<JCubemap> cubemap;              //nullptr: startup bake, the sky that is bound stays
+    std::unique_ptr<JTextureBase> prefiltered;      //shader read only, graphics already waits for it
+    std::array<glm::vec4, 9> irradianceSH{};        //only for swaps, see projectIrradianceSH
+};
 
 
 
 class PrecomputeSystem{
 
 public:
-    PrecomputeSystem(JDevice& device, const JCubemap& cubemapBase);
+    PrecomputeSystem(JDevice& device);
     ~PrecomputeSystem();
 
     void createComputePipeline();
@@ -31,23 +64,85 @@ public:
 //optionally create 
 
 
+    //prefilter bake on the compute queue, nothing here waits for it. false: the file on disk is still
+    //current (manifest), nothing started, just load it. cubemapBase must stay alive until the bake is done.
+    //sliceMs: gpu time per frame (see kDefaultBakeSliceMs), 0 = one submit per stage
+    bool beginPrefilterBake(const JCubemap& cubemapBase, float sliceMs = 0.0f);
+    //another sky at runtime. decode, cube conversion, mips and sh9 run on a worker thread, upload and prefilter
+    //on the compute queue in slices of sliceMs a frame. a bake that is still running is dropped for this one.
+    //skies baked before come from the texture cache (cube and prefiltered map), only the upload is left then
+    void requestEnvironment(const std::string& path, SamplerManager& samplerManager, float sliceMs);
+    //call once per frame, submits the next slice. nullopt while the bake runs, then its maps once
+    //(ktx + manifest are written in the background). wait = block until it is done
+    std::optional<EnvironmentMaps> pollPrefilterBake(bool wait = false);
+    bool prefilterBakeRunning() const {return job_ != nullptr;}
+
+    //blocking version (begin + wait), only writes the file
     void generatePrecomputedMaps(const JCubemap& cubemapBase);
 
+    //diffuse irradiance as 9 SH coefficients (rgb, w unused), already convolved with the cosine lobe and / pi,
+    //so the shader only evaluates the basis: same value the old irradiance cubemap stored.
+    //reads back one small mip of the cube, a few ms, cheap enough to redo whenever the sky changes
+    std::array<glm::vec4, 9> projectIrradianceSH(const JCubemap& cubemap);
+
+    //equirect hdr -> cubemap on the gpu, all 6 faces and all mips. result is shader read only
+    std::shared_ptr<JCubemap> createCubemapFromEquirect(const std::string& path, SamplerManager& samplerManager);
+
 
 private:
     JDevice& device_app;
 
-    std::unique_ptr<JTextureBase> prefilterEnvmap_;
     std::unique_ptr<JShaderModule> prefilterComputeShader_;
+    uint64_t prefilterSpirvHash_{0};
 
-    std::unique_ptr<JComputePipeline> prefilterComputePipeline_app;
+    //indexed by distribution (lambertian, ggx), DISTRIBUTION spec constant drops the other branch
+    std::array<std::unique_ptr<JComputePipeline>, 2> prefilterComputePipelines_app;
     std::unique_ptr<JPipelineLayout> prefilterPipelineLayout_app;
 
-    std::vector<VkDescriptorSet> descriptorSets_;
-    std::shared_ptr<JDescriptorAllocator> descriptorAllocator_app;
+    //equirect -> cube, same set layout (sampler + storage image) and pipeline layout as prefilter
+    std::unique_ptr<JShaderModule> equirectComputeShader_;
+    std::unique_ptr<JComputePipeline> equirectComputePipeline_app;
+
     std::unique_ptr<JDescriptorSetLayout> descriptorSetLayout_app;
 
-    void processCubemap(const JCubemap& cubemapBase, uint32_t distributionIndex ,const char* OUT_ktxPath, uint32_t sampleCount);
+    //bake in flight. stages: (swaps) load on a worker + upload, calibration probes, then the bake itself
+    //(needs the probes' budgets). every stage is a list of steps, submitted a slice at a time
+    struct BakeJob;
+    std::unique_ptr<BakeJob> job_;
+    //replaced by a newer request, freed once their last slice / worker is done
+    std::vector<std::unique_ptr<BakeJob>> abandoned_;
+    //ktx + manifest writes of finished bakes
+    std::vector<std::future<void>> cacheWrites_;
+    std::unique_ptr<JTimelineSemaphore> timeline_;
+    uint64_t timelineValue_{0};
+
+    //gpu time of a slice (top / bottom timestamp). VK_NULL_HANDLE when the compute queue has no timestamps,
+    //then the slice size stays at the initial guess
+    VkQueryPool timestampPool_{VK_NULL_HANDLE};
+    //texel samples the gpu gets through per ms, moving average over the measured slices
+    double bakeCostPerMs_;
+
+    //samples per mip: smallest power of two whose result stays within maxError (relative rms) of a
+    //reference bake with a lot more samples. only a small probe grid per face is baked for this, so it is cheap.
+    //evaluateCalibration reads the result back once the last slice is done
+    void recordCalibration(BakeJob& job);
+    void evaluateCalibration(BakeJob& job);
+    //every mip with its budget in bands of rows, readback for the ktx, then shader read only
+    void recordBake(BakeJob& job);
+    //swaps: prefilter target + cube from the worker's staging, cached prefiltered map too if there is one
+    void recordUpload(BakeJob& job);
+    EnvironmentMaps finishBake(BakeJob& job);
+    //next steps of the current stage, up to the job's slice of gpu time, in one submit
+    void submitSlice(BakeJob& job);
+    void measureSlice(BakeJob& job);
+    //command buffer, sets, views, sample table of the stage that just finished
+    void releaseSubmitResources(BakeJob& job);
+    void releaseFinished();
+
+    //source + storage image of one mip per set, for recording every mip of a bake into one command buffer.
+    //allocator is owned by the caller and dropped after the submit
+    std::vector<VkDescriptorSet> buildMipDescriptorSets(JDescriptorAllocator& allocator,
+            const VkDescriptorImageInfo& srcImageInfo, const std::vector<VkImageView>& mipViews);
 
 
 
@@ -1,5 +1,6 @@
 #include "buffer.hpp"
 #include "./structs/uniforms.hpp"
+#include "./descriptor/descriptorSetCache.hpp"
 
 
 
@@ -60,6 +61,7 @@ uint64_t JBuffer::getBufferAddress() {
 
 JBuffer::~JBuffer(){
     if(buffer_ != VK_NULL_HANDLE){
+        JDescriptorSetCache::bufferDestroyed(buffer_);
         vkDestroyBuffer(device_app.device(), buffer_, nullptr); }
 
     if(bufferMemory_ != VK_NULL_HANDLE){
@@ -87,6 +89,7 @@ void JBuffer::stagingAction(const void* transferData){
 
 void JBuffer::destroyBuffer(JDevice& device_app, VkBuffer buffer, VkDeviceMemory bufferMemory){
     if(buffer != VK_NULL_HANDLE){
+        JDescriptorSetCache::bufferDestroyed(buffer);
         vkDestroyBuffer(device_app.device(), buffer, nullptr); }
 
     if(bufferMemory != VK_NULL_HANDLE){
@@ -4,8 +4,8 @@
 
 
 JCommandBuffer::JCommandBuffer(
-    JDevice& device,  VkCommandBufferLevel level):
-    device_app(device)
+    JDevice& device,  VkCommandBufferLevel level, VkCommandPool pool):
+    device_app(device), pool_(pool != VK_NULL_HANDLE ? pool : device.getCommandPool())
         
         //    commandPool(commandPool), device(device), renderPass(renderPass), graphicPipeline(graphicPipeline)
     
@@ -19,7 +19,7 @@ JCommandBuffer::JCommandBuffer(
 
 JCommandBuffer::~JCommandBuffer(){
 
-        vkFreeCommandBuffers(device_app.device(), device_app.getCommandPool(), 1, &commandBuffer_);
+        vkFreeCommandBuffers(device_app.device(), pool_, 1, &commandBuffer_);
 
 
 }
@@ -38,7 +38,7 @@ void JCommandBuffer::createCommandBuffer(JDevice& device, VkCommandBufferLevel l
 
     VkCommandBufferAllocateInfo allocInfo{}; // 告诉x个command buffer进入command pool
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.commandPool = device_app.getCommandPool();
+    allocInfo.commandPool = pool_;
     allocInfo.level = level;
     allocInfo.commandBufferCount = 1;
 
@@ -78,6 +78,28 @@ void JCommandBuffer::endSingleTimeCommands(VkQueue queue){
 
 
 
+void JCommandBuffer::endAndSubmit(VkQueue queue, VkSemaphore timeline, uint64_t signalValue){
+
+    VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer_));
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues = &signalValue;
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer_;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &timeline;
+
+    VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+}
+
+
+
 
 
 void JCommandBuffer::reset(){
@@ -11,19 +11,23 @@ class JCommandBuffer{
 public:
 
 
+    //pool: VK_NULL_HANDLE = device's graphics pool. queue you submit to must be of the pool's family
     JCommandBuffer(
-           JDevice& device,  VkCommandBufferLevel level);
+           JDevice& device,  VkCommandBufferLevel level, VkCommandPool pool = VK_NULL_HANDLE);
     ~JCommandBuffer();
 
     VkCommandBuffer& getCommandBuffer() {return commandBuffer_;}
 
     void beginSingleTimeCommands();
     void endSingleTimeCommands(VkQueue queue);
+    //end + submit without waiting. timeline semaphore is set to signalValue when the gpu is done
+    void endAndSubmit(VkQueue queue, VkSemaphore timeline, uint64_t signalValue);
     
     void reset();
 
 private:
     JDevice& device_app;
+    VkCommandPool pool_;
     VkCommandBuffer commandBuffer_;
 
     void createCommandBuffer(JDevice& device,  VkCommandBufferLevel level);
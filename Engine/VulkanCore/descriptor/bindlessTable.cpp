@@ -0,0 +1,190 @@
+#include "bindlessTable.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include "descriptor.hpp"
+#include "../buffer.hpp"
+#include "../device.hpp"
+
+
+
+JBindlessTable::JBindlessTable(JDevice& device, uint32_t maxTextures, uint32_t maxMaterials):
+    device_app(device), maxMaterials_(maxMaterials)
+{
+    if(!device_app.bindlessSupported()){
+        throw std::runtime_error("bindless table needs descriptor indexing, not supported on this device");}
+
+    //clamp to what update-after-bind allows on this gpu
+    VkPhysicalDeviceVulkan12Properties properties12{};
+    properties12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+    VkPhysicalDeviceProperties2 properties2{};
+    properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties2.pNext = &properties12;
+    vkGetPhysicalDeviceProperties2(device_app.physicalDevice(), &properties2);
+    maxTextures_ = std::min({maxTextures,
+                             properties12.maxDescriptorSetUpdateAfterBindSampledImages,
+                             properties12.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                             properties12.maxPerStageDescriptorUpdateAfterBindSamplers});
+
+    descriptorPool_ = JDescriptorPool::Builder{device_app}
+        .setMaxSets(1)
+        .reservePoolDescriptors(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxTextures_)
+        .reservePoolDescriptors(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1)
+        .setPoolFlags(VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT)
+        .build();
+
+    descriptorSetLayout_ = JDescriptorSetLayout::Builder{device_app}
+        .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, maxTextures_)
+        .setBindingFlags(0, VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                            VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+                            VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT)
+        .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
+        .setLayoutFlags(VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT)
+        .build();
+
+    if(!descriptorPool_->allocateDescriptorSet(descriptorSetLayout_->descriptorSetLayout(), descriptorSet_)){
+        throw std::runtime_error("failed to allocate bindless descriptor set");}
+
+    //material buffer is small and written from cpu, keep it mapped. a slice per frame in flight
+    materialBuffer_ = std::make_unique<JBuffer>(device_app, sizeof(BindlessMaterial) * maxMaterials_ * Global::MAX_FRAMES_IN_FLIGHT,
+                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    materialBuffer_->map();
+
+    VkDescriptorBufferInfo bufferInfo = materialBuffer_->descriptorInfo();
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = descriptorSet_;
+    write.dstBinding = 1;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.pBufferInfo = &bufferInfo;
+    vkUpdateDescriptorSets(device_app.device(), 1, &write, 0, nullptr);
+}
+
+
+JBindlessTable::~JBindlessTable(){
+    materialBuffer_->unmap();
+}
+
+
+
+size_t JBindlessTable::TextureKeyHash::operator()(const TextureKey& key) const{
+    size_t seed = std::hash<uint64_t>{}((uint64_t)(key.view));
+    seed ^= std::hash<uint64_t>{}((uint64_t)(key.sampler)) + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+    seed ^= std::hash<uint32_t>{}(key.layout) + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+    return seed;
+}
+
+
+uint32_t JBindlessTable::acquireTexture(const VkDescriptorImageInfo& imageInfo){
+    const TextureKey key{imageInfo.imageView, imageInfo.sampler, imageInfo.imageLayout};
+    if(auto it = textureSlots_.find(key); it != textureSlots_.end()){
+        ++textures_[it->second].refs;
+        return it->second;}
+
+    uint32_t index;
+    if(!freeTextures_.empty()){
+        index = freeTextures_.back();
+        freeTextures_.pop_back();
+    }else{
+        if(textures_.size() >= maxTextures_){
+            throw std::runtime_error("bindless table is full (textures)");}
+        index = static_cast<uint32_t>(textures_.size());
+        textures_.emplace_back();
+    }
+    //new or released MAX_FRAMES_IN_FLIGHT frames ago: no pending frame uses it
+    writeTexture(index, imageInfo);
+    textures_[index] = {key, 1};
+    textureSlots_.emplace(key, index);
+    return index;
+}
+
+
+void JBindlessTable::releaseTexture(uint32_t index){
+    TextureSlot& slot = textures_.at(index);
+    if(slot.refs == 0 || --slot.refs > 0) return;
+    //partially bound: the stale descriptor stays there, frames in flight may still sample it
+    textureSlots_.erase(slot.key);
+    retiredTextures_.push_back({index, frame_});
+}
+
+
+void JBindlessTable::writeTexture(uint32_t index, const VkDescriptorImageInfo& imageInfo){
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = descriptorSet_;
+    write.dstBinding = 0;
+    write.dstArrayElement = index;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo = &imageInfo;
+    vkUpdateDescriptorSets(device_app.device(), 1, &write, 0, nullptr);
+}
+
+
+
+uint32_t JBindlessTable::addMaterial(const BindlessMaterial& material){
+    uint32_t index;
+    if(!freeMaterials_.empty()){
+        index = freeMaterials_.back();
+        freeMaterials_.pop_back();
+    }else{
+        if(materials_.size() >= maxMaterials_){
+            throw std::runtime_error("bindless table is full (materials)");}
+        index = static_cast<uint32_t>(materials_.size());
+        materials_.emplace_back();
+    }
+    updateMaterial(index, material);
+    return index;
+}
+
+
+void JBindlessTable::updateMaterial(uint32_t index, const BindlessMaterial& material){
+    //slices of frames in flight are still read, every slice picks it up in its own beginFrame
+    materials_.at(index) = material;
+    dirtySlices_ = (1u << Global::MAX_FRAMES_IN_FLIGHT) - 1;
+}
+
+
+void JBindlessTable::removeMaterial(uint32_t index){
+    retiredMaterials_.push_back({index, frame_});
+}
+
+
+void JBindlessTable::beginFrame(uint32_t currentFrame){
+    ++frame_;
+    //frames that could still use these are done
+    auto recycle = [&](std::vector<Retired>& retired, std::vector<uint32_t>& free){
+        auto done = std::partition(retired.begin(), retired.end(),
+                                   [&](const Retired& r){ return r.frame + Global::MAX_FRAMES_IN_FLIGHT > frame_; });
+        for(auto it = done; it != retired.end(); ++it){
+            free.push_back(it->index);}
+        retired.erase(done, retired.end());
+    };
+    recycle(retiredTextures_, freeTextures_);
+    recycle(retiredMaterials_, freeMaterials_);
+
+    currentSlice_ = currentFrame;
+    if(dirtySlices_ & (1u << currentSlice_)){
+        auto* slice = static_cast<BindlessMaterial*>(materialBuffer_->getBufferMapped()) + size_t(currentSlice_) * maxMaterials_;
+        std::copy(materials_.begin(), materials_.end(), slice);
+        dirtySlices_ &= ~(1u << currentSlice_);}
+}
+
+
+
+void JBindlessTable::bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t setIndex) const{
+    vkCmdBindDescriptorSets(commandBuffer, 
+                VK_PIPELINE_BIND_POINT_GRAPHICS, 
+                pipelineLayout,
+                setIndex, /* set layout index */
+                1, /* descriptorSetCount */
+                &descriptorSet_, /* *pDescriptorSets */
+                0, 
+                nullptr );
+}
+
+
+
+
+
@@ -0,0 +1,110 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "../global.hpp"
+
+class JDevice;
+class JBuffer;
+class JDescriptorPool;
+class JDescriptorSetLayout;
+
+
+
+//one record per material in the material buffer, indices into the texture array
+//std430 in shader, keep it 16 bytes
+struct BindlessMaterial{
+    uint32_t albedo;
+    uint32_t orm;
+    uint32_t normal;
+    uint32_t pad{0};
+};
+
+
+/*  bindless set, bound once per frame
+    0: sampler2D textures[]   UPDATE_AFTER_BIND | PARTIALLY_BOUND | UPDATE_UNUSED_WHILE_PENDING
+    1: BindlessMaterial materials[]  (storage buffer, MAX_FRAMES_IN_FLIGHT slices of maxMaterials records)
+    nothing a pending frame uses is written: a texture slot is only written when it is new or was released
+    MAX_FRAMES_IN_FLIGHT frames ago, material records go to a cpu copy that is flushed into the slice of the
+    frame being recorded (beginFrame)   */
+class JBindlessTable{
+public:
+    JBindlessTable(JDevice& device, uint32_t maxTextures = 4096, uint32_t maxMaterials = 1024);
+    ~JBindlessTable();
+
+    NO_COPY(JBindlessTable);
+
+    //texture slots, one per view + sampler + layout: the same image gets the same slot (eg. default solid colors
+    //shared by every material), counted. a slot whose count drops to 0 is reused after MAX_FRAMES_IN_FLIGHT frames
+    uint32_t acquireTexture(const VkDescriptorImageInfo& imageInfo);
+    void releaseTexture(uint32_t index);
+
+    //material records. index stays the same for the material's lifetime, a released one is reused like a slot
+    uint32_t addMaterial(const BindlessMaterial& material);
+    void updateMaterial(uint32_t index, const BindlessMaterial& material);
+    void removeMaterial(uint32_t index);
+
+    //once per frame, after the frame's fence wait: reuse what was released long enough ago and write the
+    //material records into this frame's slice
+    void beginFrame(uint32_t currentFrame);
+    //what the shader indexes materials[] with in the frame being recorded
+    uint32_t materialRecord(uint32_t index) const               {return currentSlice_ * maxMaterials_ + index;}
+
+    const JDescriptorSetLayout& getDescriptorSetLayout() const  {return *descriptorSetLayout_;}
+    VkDescriptorSet getDescriptorSet() const                    {return descriptorSet_;}
+    uint32_t getMaxTextures() const                             {return maxTextures_;}
+
+    void bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t setIndex) const;
+
+private:
+    struct TextureKey{
+        VkImageView     view;
+        VkSampler       sampler;
+        VkImageLayout   layout;
+        bool operator==(const TextureKey& other) const{
+            return view == other.view && sampler == other.sampler && layout == other.layout;}
+    };
+    struct TextureKeyHash{
+        size_t operator()(const TextureKey& key) const;
+    };
+    struct TextureSlot{
+        TextureKey  key;
+        uint32_t    refs{0};
+    };
+    struct Retired{
+        uint32_t    index;
+        uint64_t    frame;      //released in this frame
+    };
+
+    JDevice&                                device_app;
+    uint32_t                                maxTextures_;
+    uint32_t                                maxMaterials_;
+
+    std::unique_ptr<JDescriptorPool>        descriptorPool_;
+    std::unique_ptr<JDescriptorSetLayout>   descriptorSetLayout_;
+    VkDescriptorSet                         descriptorSet_;
+    std::unique_ptr<JBuffer>                materialBuffer_;
+
+    std::vector<TextureSlot>                textures_;
+    std::unordered_map<TextureKey, uint32_t, TextureKeyHash> textureSlots_;
+    std::vector<uint32_t>                   freeTextures_;
+    std::vector<Retired>                    retiredTextures_;
+
+    std::vector<BindlessMaterial>           materials_;         //cpu copy, what the slices are written from
+    std::vector<uint32_t>                   freeMaterials_;
+    std::vector<Retired>                    retiredMaterials_;
+    uint32_t                                dirtySlices_{0};    //bit per slice that is behind materials_
+
+    uint64_t                                frame_{0};
+    uint32_t                                currentSlice_{0};
+
+    void writeTexture(uint32_t index, const VkDescriptorImageInfo& imageInfo);
+};
+
+
+
+
+
+
+
@@ -1,4 +1,7 @@
 #include "descriptor.hpp"
+#include "descriptorAllocator.hpp"
+#include "descriptorSetCache.hpp"
+#include <algorithm>
 ////////////////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////// Descriptor Pool /////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -71,30 +74,101 @@ bool JDescriptorPool::allocateDescriptorSet(const VkDescriptorSetLayout descript
 /////////////////////////////// Descriptor Set Layout //////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////
 
-JDescriptorSetLayout::JDescriptorSetLayout(JDevice& device, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings) 
+JDescriptorSetLayout::JDescriptorSetLayout(JDevice& device, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings,
+    const std::unordered_map<uint32_t, VkDescriptorBindingFlags>& bindingFlags,
+    VkDescriptorSetLayoutCreateFlags layoutFlags) 
     : device_app(device), bindings_(bindings)
 {
     std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings{};
+    std::vector<VkDescriptorBindingFlags> setBindingFlags{};  //same order as setLayoutBindings
     for (auto kv: bindings_){
         setLayoutBindings.push_back(kv.second);
+        auto flags = bindingFlags.find(kv.first);
+        setBindingFlags.push_back(flags != bindingFlags.end() ? flags->second : 0);
     }
 
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+    bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    bindingFlagsInfo.bindingCount = static_cast<uint32_t>(setBindingFlags.size());
+    bindingFlagsInfo.pBindingFlags = setBindingFlags.data();
+
     VkDescriptorSetLayoutCreateInfo layoutInfo{};
     layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext = bindingFlags.empty() ? nullptr : &bindingFlagsInfo;
+    layoutInfo.flags = layoutFlags;
     layoutInfo.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
     layoutInfo.pBindings = setLayoutBindings.data();
  
     if (vkCreateDescriptorSetLayout(device.device(), &layoutInfo, nullptr, &descriptorSetLayout_) != VK_SUCCESS) {
         throw std::runtime_error("failed to create descriptor set layout!");  }
+
+    if(bindingFlags.empty()){
+        createUpdateTemplate();}
 }
 
 
 
 JDescriptorSetLayout::~JDescriptorSetLayout(){
+    if(updateTemplate_ != VK_NULL_HANDLE){
+        vkDestroyDescriptorUpdateTemplate(device_app.device(), updateTemplate_, nullptr);}
     vkDestroyDescriptorSetLayout(device_app.device(), descriptorSetLayout_, nullptr);
 }
 
 
+void JDescriptorSetLayout::createUpdateTemplate(){
+    //bindings in order, each one reads descriptorCount JDescriptorData from its offset
+    std::vector<uint32_t> bindingNumbers;
+    for(const auto& [binding, layoutBinding] : bindings_){
+        bindingNumbers.push_back(binding);}
+    std::sort(bindingNumbers.begin(), bindingNumbers.end());
+
+    std::vector<VkDescriptorUpdateTemplateEntry> entries;
+    for(uint32_t binding : bindingNumbers){
+        const auto& layoutBinding = bindings_.at(binding);
+        VkDescriptorUpdateTemplateEntry entry{};
+        entry.dstBinding      = binding;
+        entry.dstArrayElement = 0;
+        entry.descriptorCount = layoutBinding.descriptorCount;
+        entry.descriptorType  = layoutBinding.descriptorType;
+        entry.offset          = templateDescriptorCount_ * sizeof(JDescriptorData);
+        entry.stride          = sizeof(JDescriptorData);
+        entries.push_back(entry);
+
+        templateOffsets_[binding] = templateDescriptorCount_;
+        templateDescriptorCount_ += layoutBinding.descriptorCount;
+    }
+
+    VkDescriptorUpdateTemplateCreateInfo templateInfo{};
+    templateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+    templateInfo.descriptorUpdateEntryCount = static_cast<uint32_t>(entries.size());
+    templateInfo.pDescriptorUpdateEntries = entries.data();
+    templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+    templateInfo.descriptorSetLayout = descriptorSetLayout_;
+
+    if (vkCreateDescriptorUpdateTemplate(device_app.device(), &templateInfo, nullptr, &updateTemplate_) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor update template!");  }
+}
+
+
+void JDescriptorSetLayout::update(VkDescriptorSet set, const JDescriptorData* data) const{
+    if(updateTemplate_ == VK_NULL_HANDLE){
+        throw std::runtime_error("descriptor set layout has no update template");}
+    vkUpdateDescriptorSetWithTemplate(device_app.device(), set, updateTemplate_, data);
+}
+
+
+std::vector<VkDescriptorPoolSize> JDescriptorSetLayout::poolSizes() const{
+    std::vector<VkDescriptorPoolSize> sizes;
+    for(const auto& [binding, layoutBinding] : bindings_){
+        auto it = std::find_if(sizes.begin(), sizes.end(),
+                               [&](const VkDescriptorPoolSize& size){ return size.type == layoutBinding.descriptorType; });
+        if(it != sizes.end()) it->descriptorCount += layoutBinding.descriptorCount;
+        else                  sizes.push_back({layoutBinding.descriptorType, layoutBinding.descriptorCount});
+    }
+    return sizes;
+}
+
+
 JDescriptorSetLayout::Builder& JDescriptorSetLayout::Builder::addBinding(  // by default count=1
     uint32_t binding,  VkDescriptorType descriptorType, VkShaderStageFlags stageFlags, uint32_t descriptorCount)
 {
@@ -108,8 +182,19 @@ JDescriptorSetLayout::Builder& JDescriptorSetLayout::Builder::addBinding(  // by
 }
 
 
+JDescriptorSetLayout::Builder& JDescriptorSetLayout::Builder::setBindingFlags(uint32_t binding, VkDescriptorBindingFlags flags){
+    bindingFlags[binding] = flags;
+    return *this;
+}
+
+JDescriptorSetLayout::Builder& JDescriptorSetLayout::Builder::setLayoutFlags(VkDescriptorSetLayoutCreateFlags flags){
+    layoutFlags = flags;
+    return *this;
+}
+
+
 std::unique_ptr<JDescriptorSetLayout>  JDescriptorSetLayout::Builder::build() const {
-    return std::make_unique<JDescriptorSetLayout>(device_app, bindings);
+    return std::make_unique<JDescriptorSetLayout>(device_app, bindings, bindingFlags, layoutFlags);
 }
 
 
@@ -122,11 +207,12 @@ std::unique_ptr<JDescriptorSetLayout>  JDescriptorSetLayout::Builder::build() co
 ////////////////////////////////////////////////////////////////////////////////////////
 // JDescriptorSets(JDescriptorSetLayout& descriptorSetLayout, JDescriptorPool& descriptorPool);
 
-JDescriptorWriter::JDescriptorWriter(JDescriptorSetLayout& descriptorSetLayout, VkDescriptorPool descriptorPool):
-    descriptorSetLayout_{descriptorSetLayout}, descriptorPool_{descriptorPool}
+JDescriptorWriter::JDescriptorWriter(const JDescriptorSetLayout& descriptorSetLayout, JDescriptorAllocator& descriptorAllocator):
+    descriptorSetLayout_{descriptorSetLayout}, descriptorAllocator_{descriptorAllocator}
 {
-    printf("DEBUG: JDescriptorWriter constructor received pool: %p\n", (void*)descriptorPool);
-    printf("DEBUG: JDescriptorWriter stored pool: %p\n", (void*)descriptorPool_);
+    if(descriptorSetLayout_.updateTemplate() != VK_NULL_HANDLE){
+        templateData_.resize(descriptorSetLayout_.templateDescriptorCount());
+        templateWritten_.assign(descriptorSetLayout_.templateDescriptorCount(), false);}
 }
 
 // JDescriptorWriter& writeBuffer(uint32_t binding, VkDescriptorBufferInfo* bufferInfo);
@@ -135,7 +221,7 @@ JDescriptorWriter::JDescriptorWriter(JDescriptorSetLayout& descriptorSetLayout,
 
 JDescriptorWriter &JDescriptorWriter::writeBuffer(uint32_t n_binding, const VkDescriptorBufferInfo* bufferInfo){
     assert(descriptorSetLayout_.bindings_.count(n_binding) == 1 && "Descriptor layout does not contain specified binding");
-    auto& bindingDescription = descriptorSetLayout_.bindings_[n_binding];
+    const auto& bindingDescription = descriptorSetLayout_.bindings_.at(n_binding);
 
     VkWriteDescriptorSet descriptorWrite{};
     descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -145,12 +231,16 @@ JDescriptorWriter &JDescriptorWriter::writeBuffer(uint32_t n_binding, const VkDe
     descriptorWrite.pBufferInfo = bufferInfo;
     
     descriptorWrites_.push_back(descriptorWrite);
+    if(!templateData_.empty()){
+        uint32_t slot = descriptorSetLayout_.templateOffset(n_binding);
+        templateData_[slot].buffer = *bufferInfo;
+        templateWritten_[slot] = true;}
     return *this;
 }
 
 JDescriptorWriter &JDescriptorWriter::writeImage(uint32_t n_binding, const VkDescriptorImageInfo* imageInfo){
     assert(descriptorSetLayout_.bindings_.count(n_binding) == 1 && "Descriptor layout does not contain specified binding");
-    auto& bindingDescription = descriptorSetLayout_.bindings_[n_binding];
+    const auto& bindingDescription = descriptorSetLayout_.bindings_.at(n_binding);
 
     VkWriteDescriptorSet descriptorWrite{};
     descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -160,28 +250,41 @@ JDescriptorWriter &JDescriptorWriter::writeImage(uint32_t n_binding, const VkDes
     descriptorWrite.pImageInfo = imageInfo;
 
     descriptorWrites_.push_back(descriptorWrite);
+    if(!templateData_.empty()){
+        uint32_t slot = descriptorSetLayout_.templateOffset(n_binding);
+        templateData_[slot].image = *imageInfo;
+        templateWritten_[slot] = true;}
     return *this;
 }
 
 
 bool JDescriptorWriter::build(VkDescriptorSet& set){
+    //allocator grows its pools itself, only a real vulkan error throws
+    set = descriptorAllocator_.allocateDescriptorSet(descriptorSetLayout_);
+    overwrite(set); 
+    return true;
+}
 
-    VkDescriptorSetAllocateInfo descriptorSetAllocInfo{};
-
-    descriptorSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    descriptorSetAllocInfo.descriptorPool = descriptorPool_;
-    descriptorSetAllocInfo.pSetLayouts = &descriptorSetLayout_.descriptorSetLayout();
-    descriptorSetAllocInfo.descriptorSetCount = 1;
 
-    printf("DEBUG: JDescriptorWriter::build using pool: %p\n", (void*)descriptorPool_);
-    if (vkAllocateDescriptorSets(descriptorSetLayout_.device_app.device(), &descriptorSetAllocInfo, &set) != VK_SUCCESS){
-        return false;}
-    overwrite(set); 
+bool JDescriptorWriter::build(VkDescriptorSet& set, JDescriptorSetCache& cache){
+    set = cache.getOrBuild(descriptorSetLayout_, descriptorWrites_, completeTemplateData());
     return true;
 }
 
 
+const JDescriptorData* JDescriptorWriter::completeTemplateData() const{
+    if(templateData_.empty()) return nullptr;
+    bool complete = std::all_of(templateWritten_.begin(), templateWritten_.end(), [](bool written){ return written; });
+    return complete ? templateData_.data() : nullptr;
+}
+
+
 bool JDescriptorWriter::overwrite(VkDescriptorSet& set){
+    //whole set written: one template update, no write structs for the driver to walk
+    if(const JDescriptorData* data = completeTemplateData()){
+        descriptorSetLayout_.update(set, data);
+        return true;}
+
     for (auto& write: descriptorWrites_){
         write.dstSet = set;  }
     vkUpdateDescriptorSets(descriptorSetLayout_.device_app.device(), 
@@ -8,6 +8,9 @@
 #include "../buffer.hpp"
 #include "../global.hpp"
 
+class JDescriptorAllocator;
+class JDescriptorSetCache;
+
 
 //descriptor ppol需要知道要用的descriptor sets的数量和descriptor有多少个。但是不涉及descriptor和descriptor set是否对的上
 class JDescriptorPool{
@@ -52,6 +55,15 @@ private:
 
 
 
+//one descriptor in the packed data of an update template. a set's data is an array of these, the bindings one
+//after another in binding order, arrays take descriptorCount slots (JDescriptorSetLayout::templateOffset)
+union JDescriptorData{
+    VkDescriptorImageInfo   image;
+    VkDescriptorBufferInfo  buffer;
+    VkBufferView            texelBuffer;
+};
+
+
 class JDescriptorSetLayout{
 
 public:
@@ -61,25 +73,50 @@ public:
 
             Builder& addBinding(uint32_t binding, VkDescriptorType descriptorType,
                 VkShaderStageFlags stageFlags, uint32_t descriptorCount = 1);
+            //descriptor indexing, eg. UPDATE_AFTER_BIND | PARTIALLY_BOUND for bindless array
+            Builder& setBindingFlags(uint32_t binding, VkDescriptorBindingFlags flags);
+            Builder& setLayoutFlags(VkDescriptorSetLayoutCreateFlags flags);
             std::unique_ptr<JDescriptorSetLayout> build() const;
 
         private:
             JDevice& device_app;
             std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings{};
+            std::unordered_map<uint32_t, VkDescriptorBindingFlags> bindingFlags{};
+            VkDescriptorSetLayoutCreateFlags layoutFlags = 0;
         };
-    JDescriptorSetLayout(JDevice& device, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings);
+    JDescriptorSetLayout(JDevice& device, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings,
+        const std::unordered_map<uint32_t, VkDescriptorBindingFlags>& bindingFlags = {},
+        VkDescriptorSetLayoutCreateFlags layoutFlags = 0);
     ~JDescriptorSetLayout();        
 
     NO_COPY(JDescriptorSetLayout);
 
     const VkDescriptorSetLayout& descriptorSetLayout() const   {return descriptorSetLayout_;}
     uint32_t bindingsCount() const                      {return bindings_.size();}
+    //descriptors one set of this layout needs, {type, count} per type. JDescriptorAllocator sizes its pools with it
+    std::vector<VkDescriptorPoolSize> poolSizes() const;
+
+    //update template over every binding, made with the layout. VK_NULL_HANDLE for layouts with binding flags
+    //(bindless arrays are written a few slots at a time, not as a whole set)
+    VkDescriptorUpdateTemplate updateTemplate() const   {return updateTemplate_;}
+    //JDescriptorData a whole set takes
+    uint32_t templateDescriptorCount() const            {return templateDescriptorCount_;}
+    //first slot of binding in the packed data
+    uint32_t templateOffset(uint32_t binding) const     {return templateOffsets_.at(binding);}
+    //every descriptor of set in one call, data: templateDescriptorCount() entries
+    void update(VkDescriptorSet set, const JDescriptorData* data) const;
 
 private:
     JDevice& device_app;
     VkDescriptorSetLayout descriptorSetLayout_;
     std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings_;
 
+    VkDescriptorUpdateTemplate updateTemplate_{VK_NULL_HANDLE};
+    std::unordered_map<uint32_t, uint32_t> templateOffsets_;
+    uint32_t templateDescriptorCount_{0};
+
+    void createUpdateTemplate();
+
     friend class JDescriptorWriter;
 };
 
@@ -92,7 +129,8 @@ private:
 class JDescriptorWriter{
 public:
 
-    JDescriptorWriter(JDescriptorSetLayout& descriptorSetLayout, VkDescriptorPool descriptorPool);
+    //build() allocates from the allocator's chain of this layout
+    JDescriptorWriter(const JDescriptorSetLayout& descriptorSetLayout, JDescriptorAllocator& descriptorAllocator);
     JDescriptorWriter(const JDescriptorWriter&) = delete;
     JDescriptorWriter& operator=(const JDescriptorWriter&) = delete;
 
@@ -100,15 +138,26 @@ public:
     JDescriptorWriter& writeBuffer(uint32_t binding, const VkDescriptorBufferInfo* bufferInfo);
     JDescriptorWriter& writeImage(uint32_t binding, const VkDescriptorImageInfo* imageInfo);
 
+    //writes every binding of a layout with an update template: one vkUpdateDescriptorSetWithTemplate,
+    //otherwise the VkWriteDescriptorSets
     bool build(VkDescriptorSet& set);
+    //same layout + handles as a set already in the cache: that set, nothing allocated or written.
+    //the set is shared, dont overwrite() it
+    bool build(VkDescriptorSet& set, JDescriptorSetCache& cache);
     bool overwrite(VkDescriptorSet& set);
     
     
 private:
 
-    JDescriptorSetLayout &descriptorSetLayout_;
-    VkDescriptorPool descriptorPool_;
+    const JDescriptorSetLayout &descriptorSetLayout_;
+    JDescriptorAllocator &descriptorAllocator_;
     std::vector<VkWriteDescriptorSet> descriptorWrites_;
+    //same descriptors packed for the layout's template, and which slots have been written
+    std::vector<JDescriptorData> templateData_;
+    std::vector<bool> templateWritten_;
+
+    //template data if every slot is written, nullptr: go through descriptorWrites_
+    const JDescriptorData* completeTemplateData() const;
 
 
     // std::vector<VkDescriptorSet> descriptorSets_;
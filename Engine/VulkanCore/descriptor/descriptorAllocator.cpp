@@ -1,5 +1,7 @@
 #include "descriptorAllocator.hpp"
+#include "descriptor.hpp"
 #include "../device.hpp"
+#include <algorithm>
 
 
 
@@ -9,97 +11,167 @@ JDescriptorAllocator::JDescriptorAllocator(
             JDevice& device, 
             const std::vector<VkDescriptorPoolSize>& p_poolSizes,
             uint32_t initialSetsCount  ):
-    device_app(device), p_poolSizes_(p_poolSizes), maxSetsCounter_(initialSetsCount)
+    device_app(device), initialSetsCount_(std::max(1u, initialSetsCount))
 {
-    // when initialize DescriptorAllocator one pool with at least 10 set is created
-    currentPool_ = createPool(initialSetsCount);
-    printf("DEBUG: Created descriptor pool: %p\n", (void*)currentPool_);
+    rawChain_.poolSizes = p_poolSizes;
+    rawChain_.baseSets  = initialSetsCount_;
+    rawChain_.nextSets  = initialSetsCount_;
 }
 
 
-JDescriptorAllocator::~JDescriptorAllocator(){
-    vkDestroyDescriptorPool(device_app.device(), currentPool_, nullptr);
-    if(usedPool_.size() != 0){
-        for (auto pool : usedPool_){
-            vkDestroyDescriptorPool(device_app.device(), pool, nullptr);
-        }
-    }
+JDescriptorAllocator::JDescriptorAllocator(JDevice& device, uint32_t initialSetsCount):
+    device_app(device), initialSetsCount_(std::max(1u, initialSetsCount))
+{
+}
 
+
+JDescriptorAllocator::~JDescriptorAllocator(){
+    destroyChain(rawChain_);
+    for(auto& [layout, chain] : layoutChains_){
+        destroyChain(chain);}
 }
 
 
+void JDescriptorAllocator::destroyChain(Chain& chain){
+    if(chain.current.pool){
+        vkDestroyDescriptorPool(device_app.device(), chain.current.pool, nullptr);}
+    for(const Pool& pool : chain.full){
+        vkDestroyDescriptorPool(device_app.device(), pool.pool, nullptr);}
+    for(const Pool& pool : chain.ready){
+        vkDestroyDescriptorPool(device_app.device(), pool.pool, nullptr);}
+    chain = Chain{};
+}
 
 
-// descriptor pool 动态扩容简单版本：失败时自动扩容
 
 
 VkDescriptorSet JDescriptorAllocator::allocateDescriptorSet(VkDescriptorSetLayout descriptorSetLayout){
+    if(rawChain_.poolSizes.empty()){
+        throw std::runtime_error("descriptor allocator has no pool sizes for raw layouts, allocate with JDescriptorSetLayout");}
     VkDescriptorSet descriptorSet;
+    allocateFromChain(rawChain_, &descriptorSetLayout, 1, &descriptorSet);
+    return descriptorSet;
+}
 
-    VkDescriptorSetAllocateInfo descriptorSetAllocInfo{};
-    descriptorSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    descriptorSetAllocInfo.descriptorPool = currentPool_;
-    descriptorSetAllocInfo.pSetLayouts = &descriptorSetLayout;
-    descriptorSetAllocInfo.descriptorSetCount = 1;
-
-    VkResult result = vkAllocateDescriptorSets(device_app.device(), &descriptorSetAllocInfo, &descriptorSet);
-
-    if (result == VK_ERROR_FRAGMENTED_POOL || result == VK_ERROR_OUT_OF_POOL_MEMORY){
-        //get rid of current pool
-        usedPool_.push_back(currentPool_);
-
-        maxSetsCounter_++; 
-        VkDescriptorPool newPool_ = createPool(maxSetsCounter_);
-        currentPool_ = newPool_;
-        descriptorSetAllocInfo.descriptorPool = currentPool_;
-        
-        if (vkAllocateDescriptorSets(device_app.device(), &descriptorSetAllocInfo, &descriptorSet) != VK_SUCCESS){
-            throw std::runtime_error("failed to allocate the descriptor set even after expanding the descriptor pool");
-        };       
-    }
-    else if (result != VK_SUCCESS){
-        throw std::runtime_error("failed to allocate the descriptor set (through descriptor allocator)");
-    }
+
+VkDescriptorSet JDescriptorAllocator::allocateDescriptorSet(const JDescriptorSetLayout& descriptorSetLayout){
+    VkDescriptorSet descriptorSet;
+    allocateFromChain(layoutChain(descriptorSetLayout), &descriptorSetLayout.descriptorSetLayout(), 1, &descriptorSet);
     return descriptorSet;
 }
 
 
+void JDescriptorAllocator::allocateDescriptorSets(const JDescriptorSetLayout& descriptorSetLayout, uint32_t count, VkDescriptorSet* sets){
+    if(count == 0) return;
+    const std::vector<VkDescriptorSetLayout> layouts(count, descriptorSetLayout.descriptorSetLayout());
+    allocateFromChain(layoutChain(descriptorSetLayout), layouts.data(), count, sets);
+}
 
 
-//  set有多少是和有多少material相关的，所以适合set layout相关的？
-// 之后应该根据之前的cache来调整，现在先直接根据set layout
-VkDescriptorPool JDescriptorAllocator::createPool(uint32_t maxSetsCounter_){
+void JDescriptorAllocator::reset(){
+    auto resetChain = [&](Chain& chain){
+        if(chain.current.pool){
+            chain.full.push_back(chain.current);
+            chain.current = Pool{};}
+        for(const Pool& pool : chain.full){
+            vkResetDescriptorPool(device_app.device(), pool.pool, 0);
+            chain.ready.push_back(pool);}
+        chain.full.clear();
+    };
+    resetChain(rawChain_);
+    for(auto& [layout, chain] : layoutChains_){
+        resetChain(chain);}
+}
 
-    //poolsize: {descriptor type, count}
-    VkDescriptorPoolCreateInfo descriptorPoolInfo{};
-    descriptorPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    descriptorPoolInfo.poolSizeCount = static_cast<uint32_t>(p_poolSizes_.size());
-    descriptorPoolInfo.pPoolSizes = p_poolSizes_.data();
-    descriptorPoolInfo.maxSets = maxSetsCounter_;
-    descriptorPoolInfo.flags = 0;
 
-    VkDescriptorPool pool;
-    if (vkCreateDescriptorPool(device_app.device(), &descriptorPoolInfo, nullptr, &pool) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create descriptor pool!");}
-    
-    return pool;
+uint32_t JDescriptorAllocator::poolCount() const{
+    auto count = [](const Chain& chain){
+        return uint32_t(chain.current.pool != VK_NULL_HANDLE) + uint32_t(chain.full.size() + chain.ready.size());};
+    uint32_t total = count(rawChain_);
+    for(const auto& [layout, chain] : layoutChains_){
+        total += count(chain);}
+    return total;
 }
 
 
 
 
+//pool sizes of a layout chain: what one set of the layout holds
+JDescriptorAllocator::Chain& JDescriptorAllocator::layoutChain(const JDescriptorSetLayout& descriptorSetLayout){
+    auto [it, inserted] = layoutChains_.try_emplace(descriptorSetLayout.descriptorSetLayout());
+    if(inserted){
+        it->second.poolSizes = descriptorSetLayout.poolSizes();
+        it->second.baseSets  = 1;
+        it->second.nextSets  = initialSetsCount_;}
+    return it->second;
+}
 
 
+// descriptor pool 扩容：满了就换下一个，每次翻倍
+void JDescriptorAllocator::allocateFromChain(Chain& chain, const VkDescriptorSetLayout* layouts, uint32_t count, VkDescriptorSet* sets){
+    if(chain.current.pool && tryAllocate(chain.current.pool, layouts, count, sets)){
+        return;}
 
+    if(chain.current.pool){
+        chain.full.push_back(chain.current);}
+    chain.current = nextPool(chain, count);
+
+    if(!tryAllocate(chain.current.pool, layouts, count, sets)){
+        throw std::runtime_error("failed to allocate the descriptor set even after expanding the descriptor pool");}
+}
 
 
+bool JDescriptorAllocator::tryAllocate(VkDescriptorPool pool, const VkDescriptorSetLayout* layouts, uint32_t count, VkDescriptorSet* sets){
+    VkDescriptorSetAllocateInfo descriptorSetAllocInfo{};
+    descriptorSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descriptorSetAllocInfo.descriptorPool = pool;
+    descriptorSetAllocInfo.pSetLayouts = layouts;
+    descriptorSetAllocInfo.descriptorSetCount = count;
+
+    const VkResult result = vkAllocateDescriptorSets(device_app.device(), &descriptorSetAllocInfo, sets);
+    if(result == VK_SUCCESS) return true;
+    if(result == VK_ERROR_FRAGMENTED_POOL || result == VK_ERROR_OUT_OF_POOL_MEMORY) return false;
+    throw std::runtime_error("failed to allocate the descriptor set (through descriptor allocator)");
+}
 
 
+JDescriptorAllocator::Pool JDescriptorAllocator::nextPool(Chain& chain, uint32_t minSets){
+    auto reusable = std::find_if(chain.ready.begin(), chain.ready.end(),
+                                 [&](const Pool& pool){ return pool.maxSets >= minSets; });
+    if(reusable != chain.ready.end()){
+        const Pool pool = *reusable;
+        chain.ready.erase(reusable);
+        return pool;}
 
+    Pool pool;
+    pool.maxSets = std::max(chain.nextSets, minSets);
+    pool.pool = createPool(chain, pool.maxSets);
+    chain.nextSets = std::min(chain.nextSets * 2, std::max(kMaxSetsPerPool, chain.nextSets));
+    return pool;
+}
 
 
+//descriptors of baseSets sets, scaled to maxSets (rounded up)
+VkDescriptorPool JDescriptorAllocator::createPool(const Chain& chain, uint32_t maxSets){
+    std::vector<VkDescriptorPoolSize> poolSizes = chain.poolSizes;
+    for(VkDescriptorPoolSize& size : poolSizes){
+        const uint64_t scaled = (uint64_t(size.descriptorCount) * maxSets + chain.baseSets - 1) / chain.baseSets;
+        size.descriptorCount = static_cast<uint32_t>(std::max<uint64_t>(1, scaled));}
 
+    //poolsize: {descriptor type, count}
+    VkDescriptorPoolCreateInfo descriptorPoolInfo{};
+    descriptorPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descriptorPoolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    descriptorPoolInfo.pPoolSizes = poolSizes.data();
+    descriptorPoolInfo.maxSets = maxSets;
+    descriptorPoolInfo.flags = 0;
 
+    VkDescriptorPool pool;
+    if (vkCreateDescriptorPool(device_app.device(), &descriptorPoolInfo, nullptr, &pool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor pool!");}
+    
+    return pool;
+}
 
 
 
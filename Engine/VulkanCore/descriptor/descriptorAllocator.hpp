@@ -1,52 +1,86 @@
 #pragma once
 #include <vulkan/vulkan.hpp>
+#include <unordered_map>
+#include <vector>
+#include "../global.hpp"
 
 class JDevice;
+class JDescriptorSetLayout;
 
 
 
 // ---------------------------------
-
+//sets come from chains of pools: one chain per layout (pool sizes = that layout's descriptors x maxSets),
+//plus one for raw VkDescriptorSetLayout handles, sized from the poolSizes given to the constructor.
+//a full pool is kept until reset(), the next one is twice as big (up to kMaxSetsPerPool), so 1000 sets are
+//a handful of pools. reset() gives every pool back at once and they are reused before anything new is created
 class JDescriptorAllocator{
 
-
-
 public:
+    static constexpr uint32_t kMaxSetsPerPool = 4096;
 
+    //poolSizes: descriptors for initialSetsCount sets of the raw handle chain, scaled with the pool's maxSets
     JDescriptorAllocator( JDevice& device, 
                 const std::vector<VkDescriptorPoolSize>& p_poolSizes,
                 uint32_t initialSetsCount = 10);
+    //only layout chains (allocate with JDescriptorSetLayout), first pool of each holds initialSetsCount sets
+    JDescriptorAllocator(JDevice& device, uint32_t initialSetsCount);
     ~JDescriptorAllocator();
+    NO_COPY(JDescriptorAllocator);
 
     //function
+    //raw handle: pool sizes of the constructor
     VkDescriptorSet allocateDescriptorSet(VkDescriptorSetLayout descriptorSetLayout);
+    //pool sizes from the layout's bindings
+    VkDescriptorSet allocateDescriptorSet(const JDescriptorSetLayout& descriptorSetLayout);
+    //count sets of one layout in one vkAllocateDescriptorSets, all from the same pool
+    void allocateDescriptorSets(const JDescriptorSetLayout& descriptorSetLayout, uint32_t count, VkDescriptorSet* sets);
 
-    //getter
-    VkDescriptorPool getDescriptorPool() const {
-        printf("DEBUG: getDescriptorPool returning: %p\n", (void*)currentPool_);
-        return currentPool_;
-    }
+    //every set from this allocator is freed (vkResetDescriptorPool), the pools stay for the next round.
+    //for transient sets: nothing allocated here may still be used by the gpu
+    void reset();
+
+    uint32_t poolCount() const;
 
 
 
 
 private:
+    struct Pool{
+        VkDescriptorPool    pool{VK_NULL_HANDLE};
+        uint32_t            maxSets{0};     };
+
+    struct Chain{
+        std::vector<VkDescriptorPoolSize>   poolSizes;      //descriptors for baseSets sets
+        uint32_t                            baseSets{1};
+        uint32_t                            nextSets{1};    //maxSets of the next new pool
+        Pool                                current;
+        std::vector<Pool>                   full;           //no room left, until reset()
+        std::vector<Pool>                   ready;          //reset, reused before a new one is created
+    };
+
     JDevice&                            device_app;
+    uint32_t                            initialSetsCount_;
 
-    VkDescriptorPool                    currentPool_;
-    std::vector<VkDescriptorPool>       usedPool_;
+    Chain                               rawChain_;
+    std::unordered_map<VkDescriptorSetLayout, Chain> layoutChains_;
 
-    uint32_t                            maxSetsCounter_;
 
-    std::vector<VkDescriptorPoolSize>   p_poolSizes_{};  // {descriptor type, count}
+    Chain& layoutChain(const JDescriptorSetLayout& descriptorSetLayout);
+    void allocateFromChain(Chain& chain, const VkDescriptorSetLayout* layouts, uint32_t count, VkDescriptorSet* sets);
+    //false: pool is full / fragmented
+    bool tryAllocate(VkDescriptorPool pool, const VkDescriptorSetLayout* layouts, uint32_t count, VkDescriptorSet* sets);
+    //from the free list if one is big enough, else a new one
+    Pool nextPool(Chain& chain, uint32_t minSets);
+    VkDescriptorPool createPool(const Chain& chain, uint32_t maxSets);
+    void destroyChain(Chain& chain);
 
 
 
-    VkDescriptorPool createPool(uint32_t maxSetsCounter_);
 
 
 
+};
 
 
 
-};
\ No newline at end of file
@@ -0,0 +1,164 @@
+#include "descriptorSetCache.hpp"
+#include "descriptorAllocator.hpp"
+#include "descriptor.hpp"
+#include "../device.hpp"
+#include <algorithm>
+#include <mutex>
+
+
+
+namespace{
+
+//live caches, destroy hooks can come from any texture / buffer. one lock for the registry and every cache in it
+struct CacheRegistry{
+    std::mutex                          mutex;
+    std::vector<JDescriptorSetCache*>   caches;
+};
+
+CacheRegistry& registry(){
+    static CacheRegistry instance;
+    return instance;
+}
+
+//non dispatchable handles are pointers or uint64_t depending on the platform
+template<typename T>
+uint64_t handleBits(T handle){
+    return (uint64_t)(handle);
+}
+
+inline void hashCombine(size_t& seed, uint64_t value){
+    seed ^= std::hash<uint64_t>{}(value) + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+}
+
+} // namespace
+
+
+
+JDescriptorSetCache::JDescriptorSetCache(JDevice& device, JDescriptorAllocator& descriptorAllocator):
+    device_app(device), descriptorAllocator_(descriptorAllocator)
+{
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    registry().caches.push_back(this);
+}
+
+
+JDescriptorSetCache::~JDescriptorSetCache(){
+    //sets stay in the allocator's pools, they go with it
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    auto& caches = registry().caches;
+    caches.erase(std::remove(caches.begin(), caches.end(), this), caches.end());
+}
+
+
+size_t JDescriptorSetCache::KeyHash::operator()(const Key& key) const{
+    size_t seed = std::hash<uint64_t>{}(handleBits(key.setLayout));
+    for(const Binding& binding : key.bindings){
+        hashCombine(seed, (uint64_t(binding.binding) << 32) | uint64_t(binding.type));
+        hashCombine(seed, binding.handle);
+        hashCombine(seed, binding.sampler);
+        hashCombine(seed, binding.layout);
+    }
+    return seed;
+}
+
+
+VkDescriptorSet JDescriptorSetCache::getOrBuild(const JDescriptorSetLayout& descriptorSetLayout,
+                                                const std::vector<VkWriteDescriptorSet>& writes,
+                                                const JDescriptorData* templateData){
+    Key key{descriptorSetLayout.descriptorSetLayout(), {}};
+    key.bindings.reserve(writes.size());
+    for(const auto& write : writes){
+        Binding binding{write.dstBinding, write.descriptorType, 0, 0, 0};
+        if(write.pImageInfo){
+            binding.handle  = handleBits(write.pImageInfo->imageView);
+            binding.sampler = handleBits(write.pImageInfo->sampler);
+            binding.layout  = write.pImageInfo->imageLayout;}
+        else if(write.pBufferInfo){
+            binding.handle  = handleBits(write.pBufferInfo->buffer);
+            binding.sampler = write.pBufferInfo->offset;
+            binding.layout  = write.pBufferInfo->range;}
+        key.bindings.push_back(binding);
+    }
+    std::sort(key.bindings.begin(), key.bindings.end(),
+              [](const Binding& a, const Binding& b){ return a.binding < b.binding; });
+
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    if(auto it = sets_.find(key); it != sets_.end()){
+        ++hits_;
+        return it->second;}
+    ++misses_;
+
+    //a set dropped long enough ago, else a new one
+    VkDescriptorSet set;
+    auto& freeSets = freeSets_[key.setLayout];
+    if(!freeSets.empty()){
+        set = freeSets.back();
+        freeSets.pop_back();}
+    else{
+        set = descriptorAllocator_.allocateDescriptorSet(descriptorSetLayout);}
+
+    if(templateData){
+        descriptorSetLayout.update(set, templateData);}
+    else{
+        std::vector<VkWriteDescriptorSet> setWrites = writes;
+        for(auto& write : setWrites){
+            write.dstSet = set;}
+        vkUpdateDescriptorSets(device_app.device(), static_cast<uint32_t>(setWrites.size()), setWrites.data(), 0, nullptr);}
+
+    for(const Binding& binding : key.bindings){
+        if(binding.handle){ ++handleRefs_[binding.handle]; }}
+    sets_.emplace(std::move(key), set);
+    return set;
+}
+
+
+void JDescriptorSetCache::beginFrame(){
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    ++frame_;
+    //frames that could still have these bound are done
+    auto done = std::partition(retired_.begin(), retired_.end(),
+                               [&](const Retired& r){ return r.frame + Global::MAX_FRAMES_IN_FLIGHT > frame_; });
+    for(auto it = done; it != retired_.end(); ++it){
+        freeSets_[it->setLayout].push_back(it->set);}
+    retired_.erase(done, retired_.end());
+}
+
+
+size_t JDescriptorSetCache::size() const{
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    return sets_.size();
+}
+
+
+void JDescriptorSetCache::invalidate(uint64_t handle){
+    if(handleRefs_.find(handle) == handleRefs_.end()) return;
+
+    for(auto it = sets_.begin(); it != sets_.end(); ){
+        const auto& bindings = it->first.bindings;
+        bool referenced = std::any_of(bindings.begin(), bindings.end(),
+                                      [&](const Binding& b){ return b.handle == handle; });
+        if(!referenced){ ++it; continue; }
+
+        for(const Binding& binding : bindings){
+            auto ref = handleRefs_.find(binding.handle);
+            if(ref != handleRefs_.end() && --ref->second == 0){ handleRefs_.erase(ref); }}
+        retired_.push_back({it->first.setLayout, it->second, frame_});
+        it = sets_.erase(it);
+    }
+}
+
+
+void JDescriptorSetCache::imageViewDestroyed(VkImageView imageView){
+    if(imageView == VK_NULL_HANDLE) return;
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    for(JDescriptorSetCache* cache : registry().caches){
+        cache->invalidate(handleBits(imageView));}
+}
+
+
+void JDescriptorSetCache::bufferDestroyed(VkBuffer buffer){
+    if(buffer == VK_NULL_HANDLE) return;
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    for(JDescriptorSetCache* cache : registry().caches){
+        cache->invalidate(handleBits(buffer));}
+}
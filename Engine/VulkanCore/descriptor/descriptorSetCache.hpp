@@ -0,0 +1,83 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "../global.hpp"
+
+class JDevice;
+class JDescriptorAllocator;
+class JDescriptorSetLayout;
+union JDescriptorData;
+
+
+
+//same layout + same handles (sampler / view / image layout, buffer / offset / range per binding) -> same set.
+//JDescriptorWriter::build(set, cache) only allocates and writes on a miss, eg. every material on the default
+//solid colors shares one set. a cached set is never written again while it can be looked up.
+//when a view or buffer is destroyed (JTextureBase, JBuffer...) every entry that references it is dropped,
+//its set is rewritten for a new entry once MAX_FRAMES_IN_FLIGHT frames have passed (beginFrame)
+class JDescriptorSetCache{
+public:
+    //sets come from allocator, it must outlive the cache
+    JDescriptorSetCache(JDevice& device, JDescriptorAllocator& descriptorAllocator);
+    ~JDescriptorSetCache();
+    NO_COPY(JDescriptorSetCache);
+
+    //writes: one descriptor each (JDescriptorWriter), dstSet is ignored. they are the key.
+    //templateData: the same descriptors for the layout's update template, a miss writes with that instead
+    VkDescriptorSet getOrBuild(const JDescriptorSetLayout& descriptorSetLayout, const std::vector<VkWriteDescriptorSet>& writes,
+                               const JDescriptorData* templateData = nullptr);
+
+    //once per frame, after the frame's fence wait
+    void beginFrame();
+
+    size_t size() const;
+    uint64_t hits() const       {return hits_;}
+    uint64_t misses() const     {return misses_;}
+
+    //called right before the handle is destroyed, goes to every live cache
+    static void imageViewDestroyed(VkImageView imageView);
+    static void bufferDestroyed(VkBuffer buffer);
+
+private:
+    //one descriptor: image (sampler, view, layout) or buffer (buffer, offset, range)
+    struct Binding{
+        uint32_t            binding;
+        VkDescriptorType    type;
+        uint64_t            handle;         //view or buffer, what invalidation looks for
+        uint64_t            sampler;        //sampler or offset
+        uint64_t            layout;         //image layout or range
+        bool operator==(const Binding& other) const{
+            return binding == other.binding && type == other.type && handle == other.handle &&
+                   sampler == other.sampler && layout == other.layout;}
+    };
+    struct Key{
+        VkDescriptorSetLayout   setLayout;
+        std::vector<Binding>    bindings;   //sorted by binding
+        bool operator==(const Key& other) const{
+            return setLayout == other.setLayout && bindings == other.bindings;}
+    };
+    struct KeyHash{
+        size_t operator()(const Key& key) const;
+    };
+    struct Retired{
+        VkDescriptorSetLayout   setLayout;
+        VkDescriptorSet         set;
+        uint64_t                frame;      //dropped in this frame
+    };
+
+    JDevice&                            device_app;
+    JDescriptorAllocator&               descriptorAllocator_;
+
+    std::unordered_map<Key, VkDescriptorSet, KeyHash>                       sets_;
+    //entries per view / buffer handle, so a destroyed handle nobody cached costs a lookup only
+    std::unordered_map<uint64_t, uint32_t>                                  handleRefs_;
+    std::vector<Retired>                                                    retired_;
+    std::unordered_map<VkDescriptorSetLayout, std::vector<VkDescriptorSet>> freeSets_;
+    uint64_t                            frame_{0};
+    uint64_t                            hits_{0};
+    uint64_t                            misses_{0};
+
+    void invalidate(uint64_t handle);
+};
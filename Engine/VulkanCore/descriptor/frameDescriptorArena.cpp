@@ -0,0 +1,23 @@
+#include "frameDescriptorArena.hpp"
+#include "descriptorAllocator.hpp"
+
+
+
+JFrameDescriptorArena::JFrameDescriptorArena(JDevice& device, uint32_t initialSetsCount){
+    for(auto& allocator : allocators_){
+        allocator = std::make_unique<JDescriptorAllocator>(device, initialSetsCount);}
+}
+
+
+JFrameDescriptorArena::~JFrameDescriptorArena() = default;
+
+
+void JFrameDescriptorArena::beginFrame(uint32_t currentFrame){
+    currentFrame_ = currentFrame % Global::MAX_FRAMES_IN_FLIGHT;
+    allocators_[currentFrame_]->reset();
+}
+
+
+VkDescriptorSet JFrameDescriptorArena::allocate(const JDescriptorSetLayout& descriptorSetLayout){
+    return allocators_[currentFrame_]->allocateDescriptorSet(descriptorSetLayout);
+}
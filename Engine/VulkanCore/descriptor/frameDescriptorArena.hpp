@@ -0,0 +1,35 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <array>
+#include <memory>
+#include "../global.hpp"
+
+class JDevice;
+class JDescriptorAllocator;
+class JDescriptorSetLayout;
+
+
+
+//descriptor sets that only live for one frame. one JDescriptorAllocator per frame in flight, reset wholesale
+//(vkResetDescriptorPool) once that frame's fence has signaled. passes can build their sets every frame:
+//no free, no leak, pools are reused so nothing fragments or grows after the first frames
+class JFrameDescriptorArena{
+public:
+    //initialSetsCount: first pool of each layout, per frame
+    JFrameDescriptorArena(JDevice& device, uint32_t initialSetsCount = 16);
+    ~JFrameDescriptorArena();
+    NO_COPY(JFrameDescriptorArena);
+
+    //after the fence wait of currentFrame (Renderer::beginFrame), before the frame allocates anything.
+    //every set allocated the last time this frame slot was used is gone
+    void beginFrame(uint32_t currentFrame);
+
+    //valid until this frame slot comes around again
+    VkDescriptorSet allocate(const JDescriptorSetLayout& descriptorSetLayout);
+    //current frame's allocator, eg. for JDescriptorWriter::build
+    JDescriptorAllocator& allocator()           {return *allocators_[currentFrame_];}
+
+private:
+    std::array<std::unique_ptr<JDescriptorAllocator>, Global::MAX_FRAMES_IN_FLIGHT> allocators_;
+    uint32_t currentFrame_{0};
+};
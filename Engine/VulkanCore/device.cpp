@@ -14,6 +14,7 @@ JDevice::JDevice(JWindow& window):window_app(window){
 
 
 JDevice::~JDevice(){
+    vkDestroyCommandPool(device_, computeCommandPool_, nullptr);
     vkDestroyCommandPool(device_, commandPool_, nullptr);
     vkDestroyDevice(device_, nullptr);
 
@@ -247,16 +248,27 @@ void JDevice::createLogicalDevice(){
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
     std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value() , indices.presentFamily.value()};   // remove duplicated
     //得到的set里面的数字代表的是其中至少一个是带graphic的一个是带present的
+
+    //compute queue for background bakes: compute only family > 2nd queue of the graphics family > graphics queue
+    uint32_t computeQueueIndex = 0;
+    if(indices.computeFamily){
+        computeQueueFamily_ = indices.computeFamily.value();
+        uniqueQueueFamilies.insert(computeQueueFamily_);
+    }else{
+        computeQueueFamily_ = indices.graphicsFamily.value();
+        computeQueueIndex = indices.graphicsQueueCount > 1 ? 1 : 0;
+    }
     
     // queue priority must be set. Most of time for basic render, just one queue
-    float queuePriority = 1.0f;
+    //2nd one (background compute on the graphics family) gets lower priority
+    float queuePriorities[] = {1.0f, 0.5f};
     for (uint32_t queueFamily: uniqueQueueFamilies){
         //queue
         VkDeviceQueueCreateInfo queueCreateInfo{};
         queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
         queueCreateInfo.queueFamilyIndex = queueFamily;
-        queueCreateInfo.queueCount = 1;
-        queueCreateInfo.pQueuePriorities = &queuePriority;
+        queueCreateInfo.queueCount = (queueFamily == computeQueueFamily_) ? computeQueueIndex + 1 : 1;
+        queueCreateInfo.pQueuePriorities = queuePriorities;
         queueCreateInfos.push_back(queueCreateInfo);
     }
  
@@ -269,6 +281,29 @@ void JDevice::createLogicalDevice(){
     VkPhysicalDeviceVulkan12Features vulkan12Features{};
     vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
     vulkan12Features.bufferDeviceAddress = VK_TRUE;
+    vulkan12Features.timelineSemaphore = VK_TRUE;   //background bakes signal one, the frame loop polls it
+
+    //descriptor indexing, only turn on for bindless when all of them are there
+    VkPhysicalDeviceVulkan12Features supported12{};
+    supported12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    VkPhysicalDeviceFeatures2 supportedFeatures2{};
+    supportedFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supportedFeatures2.pNext = &supported12;
+    vkGetPhysicalDeviceFeatures2(physicalDevice_, &supportedFeatures2);
+    bindlessSupported_ = supported12.descriptorIndexing &&
+                         supported12.runtimeDescriptorArray &&
+                         supported12.descriptorBindingPartiallyBound &&
+                         supported12.descriptorBindingSampledImageUpdateAfterBind &&
+                         supported12.descriptorBindingUpdateUnusedWhilePending &&
+                         supported12.shaderSampledImageArrayNonUniformIndexing;
+    if(bindlessSupported_){
+        vulkan12Features.descriptorIndexing                             = VK_TRUE;
+        vulkan12Features.runtimeDescriptorArray                         = VK_TRUE;
+        vulkan12Features.descriptorBindingPartiallyBound                = VK_TRUE;
+        vulkan12Features.descriptorBindingSampledImageUpdateAfterBind   = VK_TRUE;
+        vulkan12Features.descriptorBindingUpdateUnusedWhilePending      = VK_TRUE;
+        vulkan12Features.shaderSampledImageArrayNonUniformIndexing      = VK_TRUE;
+    }
 
     VkPhysicalDeviceVulkan11Features vulkan11Features{};
     vulkan11Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
@@ -293,6 +328,9 @@ void JDevice::createLogicalDevice(){
     if(!vulkan12Features.bufferDeviceAddress){
         throw std::runtime_error("Buffer device address not supported!");
     }
+    if(!supported12.timelineSemaphore){
+        throw std::runtime_error("Timeline semaphore not supported!");
+    }
     if(!vulkan11Features.storageBuffer16BitAccess){
         throw std::runtime_error("16-bit storage not supported!");
     }
@@ -317,6 +355,19 @@ void JDevice::createLogicalDevice(){
     //create queue -- the queues are automatically created along with the logical device
     vkGetDeviceQueue(device_, indices.graphicsFamily.value(), 0, &graphicsQueue_);
     vkGetDeviceQueue(device_, indices.presentFamily.value(), 0, &presentQueue_);
+    vkGetDeviceQueue(device_, computeQueueFamily_, computeQueueIndex, &computeQueue_);
+    if(computeQueueFamily_ != indices.graphicsFamily.value()){
+        computeSharingFamilies_ = {indices.graphicsFamily.value(), computeQueueFamily_};}
+
+    //timestamps on the compute queue measure time sliced bakes. 0 valid bits: that family cant write them
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice_, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice_, &familyCount, families.data());
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice_, &properties);
+    computeTimestampPeriod_ = families[computeQueueFamily_].timestampValidBits ? properties.limits.timestampPeriod : 0.0f;
+    std::cout << "DEBUG: compute queue: " << (indices.computeFamily ? "own family" : (computeQueueIndex ? "2nd graphics queue" : "graphics queue")) << std::endl;
 }
 
 
@@ -406,10 +457,19 @@ QueueFamilyIndices JDevice::findQueueFamilies(VkPhysicalDevice device){
         }
         // if both satisfied
         if(indices.isComplete()){
+            indices.graphicsQueueCount = queueFamilies[indices.graphicsFamily.value()].queueCount;
             break; //early exit, as soon as find one graphic family
         }
         i++;
     }
+
+    //async compute: compute without graphics
+    for(uint32_t family = 0; family < queueFamilyCount; ++family){
+        const VkQueueFlags flags = queueFamilies[family].queueFlags;
+        if((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT)){
+            indices.computeFamily = family;
+            break;}
+    }
     return indices;
 }
 
@@ -548,6 +608,11 @@ void JDevice::createCommandPool(){
 
     if(vkCreateCommandPool(device_, &poolInfo, nullptr, &commandPool_) != VK_SUCCESS) {
         throw std::runtime_error("failed to create command pool!");}
+
+    //compute queue work is recorded from its own pool, even when it is the graphics family
+    poolInfo.queueFamilyIndex = computeQueueFamily_;
+    if(vkCreateCommandPool(device_, &poolInfo, nullptr, &computeCommandPool_) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create compute command pool!");}
 }
 
 
@@ -650,6 +715,12 @@ void JDevice::transitionImageLayout( VkCommandBuffer commandBuffer, VkImage imag
         // Make sure any shader reads from the image have been finished
         barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
         break;
+
+    case VK_IMAGE_LAYOUT_GENERAL:
+        // Image is a storage image (compute output)
+        // Make sure any shader writes to the image have been finished
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        break;
     default:
         // Other source layouts aren't handled (yet)
         break;
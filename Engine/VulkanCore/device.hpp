@@ -15,6 +15,8 @@ class JWindow;
 struct QueueFamilyIndices{
     std::optional<uint32_t> graphicsFamily;  //optional is a wrapper that contains no value until you assign something to it
     std::optional<uint32_t> presentFamily;
+    std::optional<uint32_t> computeFamily;   //compute only family (async compute), not every gpu has one
+    uint32_t graphicsQueueCount{0};
 
     bool isComplete(){ return graphicsFamily.has_value()&&presentFamily.has_value();}
 };
@@ -40,6 +42,14 @@ public:
     VkSurfaceKHR surface()                                  const { return surface_; }
     VkQueue graphicsQueue()                                 const { return graphicsQueue_; }
     VkQueue presentQueue()                                  const { return presentQueue_; }
+    //background gpu work (ibl bakes). own family if there is one, else a 2nd graphics queue, else the graphics queue itself
+    VkQueue computeQueue()                                  const { return computeQueue_; }
+    VkCommandPool getComputeCommandPool()                   const { return computeCommandPool_; }
+    bool hasAsyncCompute()                                  const { return computeQueue_ != graphicsQueue_; }
+    //graphics + compute family when they differ (images both queues touch are created CONCURRENT), empty otherwise
+    const std::vector<uint32_t>& computeSharingFamilies()   const { return computeSharingFamilies_; }
+    //ns per timestamp tick on the compute queue, 0 when it has no timestamps
+    float computeTimestampPeriod()                          const { return computeTimestampPeriod_; }
     VkPhysicalDevice physicalDevice()                       const {return physicalDevice_;}
     VkCommandPool getCommandPool()                          const {return commandPool_;}
     VkPhysicalDeviceDriverProperties getDriverProperties()  const {return driverProperties_;}
@@ -60,6 +70,7 @@ public:
         VkImageAspectFlags aspectMasek,  uint32_t mipLevels, uint32_t layerCount=1);
 
     VkSampleCountFlagBits msaaSamples() const {return msaaSamples_;}
+    bool bindlessSupported() const {return bindlessSupported_;} //descriptor indexing for sampled image arrays
 
     VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates, 
         VkImageTiling tiling, VkFormatFeatureFlags features);
@@ -77,9 +88,15 @@ private:
     VkQueue graphicsQueue_;
     VkSurfaceKHR surface_;
     VkQueue presentQueue_;
+    VkQueue computeQueue_;
     VkCommandPool commandPool_;
+    VkCommandPool computeCommandPool_;
+    uint32_t computeQueueFamily_{0};
+    std::vector<uint32_t> computeSharingFamilies_;
+    float computeTimestampPeriod_{0.0f};
     VkSampleCountFlagBits msaaSamples_ = VK_SAMPLE_COUNT_1_BIT;
     VkPhysicalDeviceDriverProperties driverProperties_ = {};
+    bool bindlessSupported_ = false;
 
     // will be checked if supported
     const std::vector<const char*> validationLayers = {"VK_LAYER_KHRONOS_validation" };
@@ -226,6 +243,15 @@ struct ImageCreateInfoBuilder{
         imageInfo.format = _format; return *this; }
     ImageCreateInfoBuilder& flags(VkImageCreateFlags _flags){
         imageInfo.flags = _flags; return *this; }
+    //CONCURRENT over these families, eg. JDevice::computeSharingFamilies(). fewer than 2 keeps EXCLUSIVE.
+    //the vector is pointed to, it has to outlive the create call
+    ImageCreateInfoBuilder& queueFamilies(const std::vector<uint32_t>& _families){
+        if(_families.size() > 1){
+            imageInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+            imageInfo.queueFamilyIndexCount = static_cast<uint32_t>(_families.size());
+            imageInfo.pQueueFamilyIndices = _families.data();
+        }
+        return *this; }
 
     VkImageCreateInfo getInfo() const {return imageInfo;}
 
@@ -6,6 +6,7 @@
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
+#include <limits>
 
 
 JModel::JModel(JDevice& device, const JModel::Builder& builder):
@@ -13,7 +14,7 @@ JModel::JModel(JDevice& device, const JModel::Builder& builder):
 {
     createVertexBuffer(builder.vertices_);
     createIndexBuffer(builder.indices_);
-
+    computeBounds(builder.vertices_);
 }
 
 
@@ -65,6 +66,20 @@ void JModel::createIndexBuffer(const std::vector<uint32_t>&indices){
 
 }
 
+void JModel::computeBounds(const std::vector<Vertex>& vertices){
+    glm::vec3 minP{std::numeric_limits<float>::max()};
+    glm::vec3 maxP{std::numeric_limits<float>::lowest()};
+    for(const auto& v : vertices){
+        minP = glm::min(minP, v.pos);
+        maxP = glm::max(maxP, v.pos);  }
+
+    boundsCenter_ = (minP + maxP) * 0.5f;
+    boundsRadius_ = 0.f;
+    for(const auto& v : vertices){
+        boundsRadius_ = std::max(boundsRadius_, glm::length(v.pos - boundsCenter_));  }
+}
+
+
 std::unique_ptr<JModel> JModel::loadModelFromFile(JDevice& device, const std::string& filepath){
     Builder builder{};
     builder.loadModel(filepath);
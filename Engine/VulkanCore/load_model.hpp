@@ -104,6 +104,10 @@ class JModel{
     void bind(VkCommandBuffer commandBuffer);
     void draw(VkCommandBuffer commandBuffer);
 
+    //bounding sphere in model space, used for texture streaming
+    glm::vec3 getBoundsCenter() const     {return boundsCenter_;}
+    float getBoundsRadius() const         {return boundsRadius_;}
+
   private:
     void createVertexBuffer(const std::vector<Vertex>&vertices);
     void createIndexBuffer(const std::vector<uint32_t>&indices);
@@ -115,6 +119,10 @@ class JModel{
     bool hasIndexBuffer = false;
     uint32_t indexCount;
 
+    glm::vec3 boundsCenter_{0.f};
+    float boundsRadius_{0.f};
+    void computeBounds(const std::vector<Vertex>& vertices);
+
 };
 
 
@@ -1,30 +1,51 @@
 #include "PBRmaterial.hpp"
+#include <algorithm>
 #include "../descriptor/descriptorAllocator.hpp"
+#include "../descriptor/bindlessTable.hpp"
+#include "../descriptor/descriptorSetCache.hpp"
 #include "load_texture.hpp"
+#include "streamingTexture.hpp"
 #include "../device.hpp"
 
 
 //first when initialize, build all default solid color for all channels
-//then when call setXXXtexture, overwrite the pimageInfo, 
-//one vector for descriptor writes, one vector for pimageinfo, overwrite pimageinfo one
+//then when call setXXXtexture, overwrite that slot of the packed data and push the whole set with the template
+
+namespace{
+
+//default textures are the same for every material, made by the first one, gone with the last one
+std::shared_ptr<JSolidColor> sharedSolidColor(std::weak_ptr<JSolidColor>& shared, JDevice& device, float r, float g, float b){
+    auto color = shared.lock();
+    if(!color){
+        color = std::make_shared<JSolidColor>(device, r, g, b);
+        shared = color;}
+    return color;
+}
+
+} // namespace
 
 JPBRMaterial::JPBRMaterial(
             JDevice& device, 
             std::shared_ptr<JDescriptorAllocator> descriptorAllocator,
-            VkDescriptorSetLayout descriptorSetLayout,
-            SamplerManager& samplerManager
+            const JDescriptorSetLayout& descriptorSetLayout,
+            SamplerManager& samplerManager,
+            JBindlessTable* bindlessTable,
+            JDescriptorSetCache* descriptorSetCache
     ):
-    device_app(device), descriptorAllocator(descriptorAllocator), samplerManager(samplerManager)
+    device_app(device), descriptorAllocator(descriptorAllocator), samplerManager(samplerManager),
+    descriptorSetLayout_(descriptorSetLayout), descriptorSetCache_(descriptorSetCache),
+    bindlessTable_(bindlessTable)
 {
-    defaultWhite_ = std::make_shared<JSolidColor>(device, 1.0f, 1.0f, 1.0f);
-    defaultBlack_ = std::make_shared<JSolidColor>(device, 0.0f, 0.0f, 0.0f);
-    defaultGrey_  = std::make_shared<JSolidColor>(device, 0.5f, 0.5f, 0.5f);
+    static std::weak_ptr<JSolidColor> sharedWhite, sharedORM, sharedNormal;
+    defaultWhite_ = sharedSolidColor(sharedWhite, device, 1.0f, 1.0f, 1.0f);
+    //ao 1, roughness 0.5, metallic 0
+    defaultORM_   = sharedSolidColor(sharedORM, device, 1.0f, 0.5f, 0.0f);
     // defaultNormal_= std::make_shared<JSolidColor>(device, 1.0f, 1.0f, 1.0f);
-    defaultNormal_= std::make_shared<JSolidColor>(device, 0.5f, 0.5f, 1.0f);
+    defaultNormal_= sharedSolidColor(sharedNormal, device, 0.5f, 0.5f, 1.0f);
     
 
-    //when create a new material (initialize a material)->allocate a desriptor set
-    matDescriptorSet_ = descriptorAllocator->allocateDescriptorSet(descriptorSetLayout);
+    //own descriptor set is allocated by update()
+    //bindless: textures go into the shared table instead. cache: set comes from the cache in update()
     // matDescriptorSets_.push_back(matDescriptorSet_);
     initDefault();
     update();
@@ -34,97 +55,131 @@ JPBRMaterial::JPBRMaterial(
 
 
 JPBRMaterial::~JPBRMaterial(){
+    //streaming textures may outlive this material (streamer only hold weak_ptr, but be safe)
+    for(auto& texture : streamingTextures_){
+        if(texture){ texture->setOnResidencyChanged(nullptr); }  }
+
+    //table keeps slot and record until the frames in flight are done with them
+    if(bindlessTable_){
+        for(uint32_t index : bindlessTextures_){ bindlessTable_->releaseTexture(index); }
+        bindlessTable_->removeMaterial(bindlessMaterial_);  }
 }
 
 
 void JPBRMaterial::initDefault(){
-    pImageInfos_.clear();
-    pImageInfos_.reserve(4); 
-    pImageInfos_.push_back(defaultWhite_->getDescriptorImageInfo(samplerManager.getSampler(SamplerType::TextureGlobal)));
-    pImageInfos_.push_back(defaultGrey_->getDescriptorImageInfo(samplerManager.getSampler(SamplerType::TextureGlobal)));
-    pImageInfos_.push_back(defaultBlack_->getDescriptorImageInfo(samplerManager.getSampler(SamplerType::TextureGlobal)));
-    pImageInfos_.push_back(defaultNormal_->getDescriptorImageInfo(samplerManager.getSampler(SamplerType::TextureGlobal)));
-
-    VkDescriptorType desType{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER};
-
-    /* 0 : albedo */
-    VkWriteDescriptorSet descriptorWrite_Albedo = {
-        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-        .dstSet = matDescriptorSet_,
-        .dstBinding = 0,
-        .descriptorCount = 1,
-        .descriptorType = desType,
-        .pImageInfo = &pImageInfos_[0],
-    } ;
-    descriptorWrites_.push_back(descriptorWrite_Albedo);
-
-    /* 1 : roughness */
-    VkWriteDescriptorSet descriptorWrite_Roughness= {
-        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-        .dstSet = matDescriptorSet_,
-        .dstBinding = 1,
-        .descriptorCount = 1,
-        .descriptorType = desType,
-        .pImageInfo = &pImageInfos_[1],
-    };
-    descriptorWrites_.push_back(descriptorWrite_Roughness);
-
-    /* 2 : metallic */
-    VkWriteDescriptorSet descriptorWrite_Metallic= {
-        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-        .dstSet = matDescriptorSet_,
-        .dstBinding = 2,
-        .descriptorCount = 1,
-        .descriptorType = desType,
-        .pImageInfo = &pImageInfos_[2],
-    };
-    descriptorWrites_.push_back(descriptorWrite_Metallic);
-
-
-    /* 3: normal */
-    VkWriteDescriptorSet descriptorWrite_Normal= {
-        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-        .dstSet = matDescriptorSet_,
-        .dstBinding = 3,
-        .descriptorCount = 1,
-        .descriptorType = desType,
-        .pImageInfo = &pImageInfos_[3],
-    };
-    descriptorWrites_.push_back(descriptorWrite_Normal);
+    VkSampler sampler = samplerManager.getSampler(SamplerType::TextureGlobal);
+    descriptors_[static_cast<uint32_t>(Slot::Albedo)].image = defaultWhite_->getDescriptorImageInfo(sampler);
+    descriptors_[static_cast<uint32_t>(Slot::ORM)].image    = defaultORM_->getDescriptorImageInfo(sampler);
+    descriptors_[static_cast<uint32_t>(Slot::Normal)].image = defaultNormal_->getDescriptorImageInfo(sampler);
+
+    if(bindlessTable_){
+        //defaults are shared, so are their slots: every material after the first just counts them up
+        for(size_t i = 0; i < bindlessTextures_.size(); ++i){
+            bindlessTextures_[i] = bindlessTable_->acquireTexture(descriptors_[i].image);  }
+        bindlessMaterial_ = bindlessTable_->addMaterial(bindlessRecord());
+    }
+}
+
+
+BindlessMaterial JPBRMaterial::bindlessRecord() const{
+    return {
+        .albedo = bindlessTextures_[static_cast<uint32_t>(Slot::Albedo)],
+        .orm    = bindlessTextures_[static_cast<uint32_t>(Slot::ORM)],
+        .normal = bindlessTextures_[static_cast<uint32_t>(Slot::Normal)],  };
 }
 
 
 void JPBRMaterial::update(){
-    printf("DEBUG: vkdescriptor update is called \n");
-    vkUpdateDescriptorSets(device_app.device(), descriptorWrites_.size(), descriptorWrites_.data(), 0, nullptr);
+    if(bindlessTable_){ return; } //table slots are written in setSlot
+    if(descriptorSetCache_){
+        //cached sets are shared, never written again: switch to the set of the new textures
+        JDescriptorWriter(descriptorSetLayout_, *descriptorAllocator)
+            .writeImage(0, &descriptors_[0].image)
+            .writeImage(1, &descriptors_[1].image)
+            .writeImage(2, &descriptors_[2].image)
+            .build(matDescriptorSet_, *descriptorSetCache_);
+        return;}
+    //frames in flight may have the current set bound (residency changes come in mid run): write another one,
+    //the current one is reused once they are done (beginFrame)
+    VkDescriptorSet set;
+    if(!freeSets_.empty()){
+        set = freeSets_.back();
+        freeSets_.pop_back();
+    }else{
+        set = descriptorAllocator->allocateDescriptorSet(descriptorSetLayout_);}
+    //all three bindings in one call
+    descriptorSetLayout_.update(set, descriptors_.data());
+    if(matDescriptorSet_ != VK_NULL_HANDLE){
+        retiredSets_.push_back({matDescriptorSet_, frame_});}
+    matDescriptorSet_ = set;
 }
 
-void JPBRMaterial::setAlbedoTexture(const JTexture2D& albedo_map){
-    pImageInfos_[0] = albedo_map.getDescriptorImageInfo(samplerManager.getSampler(SamplerType::TextureGlobal));
-    update();
+
+void JPBRMaterial::beginFrame(){
+    ++frame_;
+    auto done = std::partition(retiredSets_.begin(), retiredSets_.end(),
+                               [&](const RetiredSet& r){ return r.frame + Global::MAX_FRAMES_IN_FLIGHT > frame_; });
+    for(auto it = done; it != retiredSets_.end(); ++it){
+        freeSets_.push_back(it->set);}
+    retiredSets_.erase(done, retiredSets_.end());
 }
 
-void JPBRMaterial::setRoughnessTexture(const JTexture2D& roughness_map){
-    pImageInfos_[1] = roughness_map.getDescriptorImageInfo(samplerManager.getSampler(SamplerType::TextureGlobal));
+void JPBRMaterial::setSlot(Slot slot, const JTextureBase& texture){
+    auto& descriptor = descriptors_[static_cast<uint32_t>(slot)];
+    descriptor.image = texture.getDescriptorImageInfo(samplerManager.getSampler(SamplerType::TextureGlobal));
+    if(bindlessTable_){
+        //never rewrite a slot a pending frame may sample: the new view gets its own slot, the record points
+        //there from the next frame's slice on, the old slot is reused once the frames in flight are done
+        uint32_t& index = bindlessTextures_[static_cast<uint32_t>(slot)];
+        const uint32_t old = index;
+        index = bindlessTable_->acquireTexture(descriptor.image);
+        bindlessTable_->updateMaterial(bindlessMaterial_, bindlessRecord());
+        bindlessTable_->releaseTexture(old);
+        return; }
     update();
 }
 
-void JPBRMaterial::setMetallicTexture(const JTexture2D& metallic_map){
-    pImageInfos_[2] = metallic_map.getDescriptorImageInfo(samplerManager.getSampler(SamplerType::TextureGlobal));
-    update();
+void JPBRMaterial::setAlbedoTexture(const JTextureBase& albedo_map){
+    clearStreamingTexture(Slot::Albedo);
+    setSlot(Slot::Albedo, albedo_map);
 }
 
-void JPBRMaterial::setNormalTexture(const JTexture2D& normal_map){
-    printf("DEBUG: set normal is called \n");
-    pImageInfos_[3] = normal_map.getDescriptorImageInfo(samplerManager.getSampler(SamplerType::TextureGlobal));
-    printf("DEBUG: set normal is calling update \n");
-    update();
+void JPBRMaterial::setORMTexture(const JTextureBase& orm_map){
+    clearStreamingTexture(Slot::ORM);
+    setSlot(Slot::ORM, orm_map);
+}
+
+void JPBRMaterial::setNormalTexture(const JTextureBase& normal_map){
+    clearStreamingTexture(Slot::Normal);
+    setSlot(Slot::Normal, normal_map);
+}
+
+
+void JPBRMaterial::clearStreamingTexture(Slot slot){
+    //the texture may live on (RenderingSystem::textures_), its callback would write the slot again
+    auto& current = streamingTextures_[static_cast<uint32_t>(slot)];
+    if(current){
+        current->setOnResidencyChanged(nullptr);
+        current.reset();  }
+}
+
+
+void JPBRMaterial::setStreamingTexture(Slot slot, std::shared_ptr<JStreamingTexture2D> texture){
+    //view is recreated when mips come in / get evicted
+    auto& current = streamingTextures_[static_cast<uint32_t>(slot)];
+    if(current && current != texture){
+        current->setOnResidencyChanged(nullptr);  }
+
+    texture->setOnResidencyChanged([this, slot](const JTextureBase& tex){ setSlot(slot, tex); });
+    setSlot(slot, *texture);
+    current = std::move(texture);
 }
 
 
 
 
 void JPBRMaterial::bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout){
+    if(bindlessTable_){ return; } //nothing per draw, table is bound once
 
 
     vkCmdBindDescriptorSets(commandBuffer, 
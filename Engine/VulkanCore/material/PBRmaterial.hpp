@@ -2,40 +2,55 @@
 #include <vulkan/vulkan.hpp>
 #include <memory>
 #include <unordered_map>
+#include <array>
+#include <vector>
 #include <glm/glm.hpp>
 #include <glm/gtx/hash.hpp>
+#include "../descriptor/descriptor.hpp"
 
 
 
 class JDevice;
 class JDescriptorAllocator;
-class JTexture2D;
+class JDescriptorSetLayout;
+class JDescriptorSetCache;
+class JTextureBase;
 class JSolidColor;
+class JStreamingTexture2D;
 class SamplerManager;
+class JBindlessTable;
+struct BindlessMaterial;
 
 
 // -----------------------------
 
 /*  0: albedo
-    1 : roughness
-    2 : metallic
-    3 : normal     */
+    1 : occlusion / roughness / metallic (r, g, b)
+    2 : normal     */
 class JPBRMaterial{
 
 
 public:
+    enum class Slot : uint32_t { Albedo = 0, ORM = 1, Normal = 2 };
 
+    //with bindless table: no own descriptor set, textures live in the table, draw only push material index
+    //with set cache: set is looked up by its textures, materials with the same textures share one
     JPBRMaterial(JDevice& device, 
                     std::shared_ptr<JDescriptorAllocator> descriptorAllocator,
-                    VkDescriptorSetLayout descriptorSetLayout,
-                    SamplerManager& samplerManager);
+                    const JDescriptorSetLayout& descriptorSetLayout,
+                    SamplerManager& samplerManager,
+                    JBindlessTable* bindlessTable = nullptr,
+                    JDescriptorSetCache* descriptorSetCache = nullptr);
     ~JPBRMaterial();
 
     // bind loaded in texture, with, the corresponding pbr set layout, and this material's descriptor set
-    void setAlbedoTexture(const JTexture2D& albedo_map);
-    void setRoughnessTexture(const JTexture2D& roughness_map);
-    void setMetallicTexture(const JTexture2D& metallic_map);
-    void setNormalTexture(const JTexture2D& normal_map);
+    void setAlbedoTexture(const JTextureBase& albedo_map);
+    void setORMTexture(const JTextureBase& orm_map);  //packed, see JORMTexture
+    void setNormalTexture(const JTextureBase& normal_map);
+
+    // streaming texture: material keeps it alive, and rewrite the slot when its residency changed
+    void setStreamingTexture(Slot slot, std::shared_ptr<JStreamingTexture2D> texture);
+    const std::array<std::shared_ptr<JStreamingTexture2D>, 3>& getStreamingTextures() const {return streamingTextures_;}
 
     // build material after loading all textures
     void update();
@@ -44,24 +59,47 @@ public:
     // bind with pipeline during command call
     void bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout);
 
+    // once per frame, after the frame's fence wait: own sets no frame in flight has bound anymore are free again
+    void beginFrame();
+
+    // index into the bindless material buffer
+    uint32_t getMaterialIndex() const {return bindlessMaterial_;}
+
 private:
     JDevice&                                    device_app;
     SamplerManager&                             samplerManager;
     std::shared_ptr<JDescriptorAllocator>       descriptorAllocator;
-    VkDescriptorSet                             matDescriptorSet_;
-
-    // base color
+    const JDescriptorSetLayout&                 descriptorSetLayout_;
+    JDescriptorSetCache*                        descriptorSetCache_;
+    VkDescriptorSet                             matDescriptorSet_{VK_NULL_HANDLE};
+    //own set mode: the bound set is never written, update() switches to another one (streaming swaps views mid run)
+    struct RetiredSet{
+        VkDescriptorSet set;
+        uint64_t        frame;      //replaced in this frame
+    };
+    std::vector<RetiredSet>                     retiredSets_;
+    std::vector<VkDescriptorSet>                freeSets_;
+    uint64_t                                    frame_{0};
+    JBindlessTable*                             bindlessTable_;
+    std::array<uint32_t, 3>                     bindlessTextures_{};
+    uint32_t                                    bindlessMaterial_{0};
+
+    // base color, shared by every material (same handles -> same cached set)
     std::shared_ptr<JSolidColor> defaultWhite_;
-    std::shared_ptr<JSolidColor> defaultBlack_;
-    std::shared_ptr<JSolidColor> defaultGrey_;
+    std::shared_ptr<JSolidColor> defaultORM_;
     std::shared_ptr<JSolidColor> defaultNormal_;
     
 
-    //descriptor writes, will flush in the end
-    std::vector<VkWriteDescriptorSet> descriptorWrites_;
-    std::vector<VkDescriptorImageInfo> pImageInfos_;
+    //packed for the layout's update template, indexed by Slot (= binding, one descriptor each)
+    std::array<JDescriptorData, 3> descriptors_{};
+
+    std::array<std::shared_ptr<JStreamingTexture2D>, 3> streamingTextures_;
 
     void initDefault();
+    BindlessMaterial bindlessRecord() const;
+    void setSlot(Slot slot, const JTextureBase& texture);
+    //drop the streaming texture of slot and its residency callback
+    void clearStreamingTexture(Slot slot);
 };
 
 
@@ -1,4 +1,7 @@
 #include "bitmap.hpp"
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 
 
 
@@ -22,4 +25,69 @@ JBitmap::JBitmap(int w, int h, int channels, eJBitmapFormat format, const void*
     if(!data_.data()){     
         throw std::runtime_error("DEBUG: No data copied for Bitmap!");
     }
-}
\ No newline at end of file
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////////
+//bulk half conversion
+
+namespace {
+
+void floatToHalf_scalar(const float* src, uint16_t* dst, size_t begin, size_t count){
+    for(size_t i = begin; i < count; ++i) dst[i] = floatToHalf(src[i]);
+}
+void halfToFloat_scalar(const uint16_t* src, float* dst, size_t begin, size_t count){
+    for(size_t i = begin; i < count; ++i) dst[i] = halfToFloat(src[i]);
+}
+
+#if defined(__x86_64__)
+//8 per instruction. only called when the cpu has f16c
+__attribute__((target("avx,f16c")))
+void floatToHalf_F16C(const float* src, uint16_t* dst, size_t count){
+    size_t i = 0;
+    for(; i + 8 <= count; i += 8){
+        const __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), h);   }
+    floatToHalf_scalar(src, dst, i, count);
+}
+
+__attribute__((target("avx,f16c")))
+void halfToFloat_F16C(const uint16_t* src, float* dst, size_t count){
+    size_t i = 0;
+    for(; i + 8 <= count; i += 8){
+        const __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));   }
+    halfToFloat_scalar(src, dst, i, count);
+}
+
+bool hasF16C(){
+    static const bool supported = [](){
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+    }();
+    return supported;
+}
+#endif
+
+} // namespace
+
+
+void floatToHalfN(const float* src, uint16_t* dst, size_t count){
+#if defined(__x86_64__)
+    if(hasF16C()){ floatToHalf_F16C(src, dst, count); return; }
+#endif
+    floatToHalf_scalar(src, dst, 0, count);
+}
+
+void halfToFloatN(const uint16_t* src, float* dst, size_t count){
+#if defined(__x86_64__)
+    if(hasF16C()){ halfToFloat_F16C(src, dst, count); return; }
+#endif
+    halfToFloat_scalar(src, dst, 0, count);
+}
+
+
+
+
@@ -4,6 +4,11 @@
 #include <vulkan/vulkan.hpp>
 #include <string.h>
 #include <vector>
+#include <array>
+#include <algorithm>
+#include <type_traits>
+#include <cmath>
+#include <cstdint>
 #include <iostream>
 
 #include <glm/glm.hpp>
@@ -18,9 +23,61 @@ enum eJBitmapType{
 enum eJBitmapFormat{
     eJBitmapFormat_UnsignedByte,
     eJBitmapFormat_Float,
+    eJBitmapFormat_Half,    //IEEE 754 binary16, stored as raw uint16_t bits
 };
 
 
+
+///////////////////////////////////////////////////////////////////////////////////////////
+//half float <-> float. scalar versions round to nearest even, same as F16C
+
+inline uint16_t floatToHalf(float value){
+    uint32_t x;
+    memcpy(&x, &value, sizeof(x));
+    const uint32_t sign = (x >> 16) & 0x8000u;
+    const uint32_t absx = x & 0x7FFFFFFFu;
+
+    if(absx >= 0x7F800000u){ //inf / nan (keep nan quiet)
+        return uint16_t(sign | 0x7C00u | (absx > 0x7F800000u ? 0x200u : 0u));}
+    if(absx >= 0x477FF000u){ //rounds to >= 65536 -> inf
+        return uint16_t(sign | 0x7C00u);}
+    if(absx < 0x38800000u){  //below 2^-14: half denormal (or 0), value in units of 2^-24
+        float a;
+        memcpy(&a, &absx, sizeof(a));
+        return uint16_t(sign | uint32_t(std::nearbyint(a * 16777216.0f)));}
+
+    //normal: rebias exponent (127 - 15), drop 13 mantissa bits with round to nearest even
+    uint32_t h = (absx - 0x38000000u) >> 13;
+    const uint32_t rest = absx & 0x1FFFu;
+    if(rest > 0x1000u || (rest == 0x1000u && (h & 1u))) h += 1;
+    return uint16_t(sign | h);
+}
+
+inline float halfToFloat(uint16_t value){
+    const uint32_t sign = uint32_t(value & 0x8000u) << 16;
+    const uint32_t exp  = (value >> 10) & 0x1Fu;
+    const uint32_t mant = value & 0x3FFu;
+
+    uint32_t bits;
+    if(exp == 0){ //zero / denormal
+        const float f = float(mant) * (1.0f / 16777216.0f);
+        memcpy(&bits, &f, sizeof(bits));
+        bits |= sign;   }
+    else if(exp == 31){ //inf / nan, nan comes out quiet like F16C
+        bits = sign | 0x7F800000u | (mant << 13) | (mant ? 0x400000u : 0u);}
+    else{
+        bits = sign | ((exp + 112u) << 23) | (mant << 13);}
+
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+//bulk, F16C when the cpu has it (checked once), scalar otherwise
+void floatToHalfN(const float* src, uint16_t* dst, size_t count);
+void halfToFloatN(const uint16_t* src, float* dst, size_t count);
+
+
 struct JBitmap
 {
 
@@ -43,6 +100,7 @@ struct JBitmap
     static int getBytesPerChannel(eJBitmapFormat format){
         if(format == eJBitmapFormat_UnsignedByte) return 1; //unsigned byte is 1 byte (8bits)
         if(format == eJBitmapFormat_Float)        return 4; //float is 4 bytes (32 bits)
+        if(format == eJBitmapFormat_Half)         return 2; //half is 2 bytes (16 bits)
         return 0;
     }
     void setPixel(int x, int y, const glm::vec4& color){
@@ -75,6 +133,11 @@ private:
             setPixelFunc = &JBitmap::setPixelFloat;
             getPixelFunc = &JBitmap::getPixelFloat;
             break;
+
+        case eJBitmapFormat_Half:
+            setPixelFunc = &JBitmap::setPixelHalf;
+            getPixelFunc = &JBitmap::getPixelHalf;
+            break;
         }
     }
 
@@ -113,6 +176,37 @@ private:
 			channels_ > 3 ? data[offset + 3] : 0.0f);
 	}
 
+    void setPixelHalf(int x, int y, const glm::vec4& color){
+        if (!(x >= 0 && x < w_ && y >= 0 && y < h_)) {
+            std::cout << "setPixelHalf out of range: (" << x << ", " << y << ") size=("
+                      << w_ << ", " << h_ << ")" << std::endl;
+            throw std::out_of_range("setPixelHalf out of range");
+        }
+
+        const int offset = channels_ * (y*w_ + x);
+        uint16_t* data = reinterpret_cast<uint16_t*>(data_.data());
+        if(channels_ > 0) { data[offset+0] = floatToHalf(color.r); }
+        if(channels_ > 1) { data[offset+1] = floatToHalf(color.g); }
+        if(channels_ > 2) { data[offset+2] = floatToHalf(color.b); }
+        if(channels_ > 3) { data[offset+3] = floatToHalf(color.a); }
+    }
+
+    glm::vec4 getPixelHalf(int x, int y) const{
+        if (!(x >= 0 && x < w_ && y >= 0 && y < h_)) {
+            std::cout << "getPixelHalf out of range: (" << x << ", " << y << ") size=("
+                      << w_ << ", " << h_ << ")" << std::endl;
+            throw std::out_of_range("getPixelHalf out of range");
+        }
+
+        const int offset = channels_ * (y*w_ + x);
+        const uint16_t* data = reinterpret_cast<const uint16_t*>(data_.data());
+        return glm::vec4(
+            channels_ > 0 ? halfToFloat(data[offset + 0]) : 0.0f,
+            channels_ > 1 ? halfToFloat(data[offset + 1]) : 0.0f,
+            channels_ > 2 ? halfToFloat(data[offset + 2]) : 0.0f,
+            channels_ > 3 ? halfToFloat(data[offset + 3]) : 0.0f);
+    }
+
     //rgbrgbrgb, not rrrgggbbb. stbi use interleaved (rgbrgbrgb)
     void setPixelUnsignedByte(int x, int y, const glm::vec4& color){
         const int offset = channels_ * (y*w_ + x);
@@ -154,6 +248,16 @@ private:
             default: break;
             }
             break;
+
+        case eJBitmapFormat_Half:
+            switch (channel) {
+            case 1: return VK_FORMAT_R16_SFLOAT;
+            case 2: return VK_FORMAT_R16G16_SFLOAT;
+            case 3: return VK_FORMAT_R16G16B16_SFLOAT;
+            case 4: return VK_FORMAT_R16G16B16A16_SFLOAT;
+            default: break;
+            }
+            break;
     }
 
     // if no compatibale
@@ -165,6 +269,201 @@ private:
 
 
 
+///////////////////////////////////////////////////////////////////////////////////////////
+//typed views over bitmap memory (JBitmap storage, mapped staging, ...)
+//format and channel count are template params: accessors are plain inline loads, no member
+//function pointer / channel branches / vec4, so the bulk loops below can be vectorized.
+//JBitmap::getPixel / setPixel stay for debug use
+
+template<eJBitmapFormat Format> struct JBitmapChannelType;
+template<> struct JBitmapChannelType<eJBitmapFormat_UnsignedByte>  { using type = uint8_t; };
+template<> struct JBitmapChannelType<eJBitmapFormat_Float>         { using type = float;   };
+template<> struct JBitmapChannelType<eJBitmapFormat_Half>          { using type = uint16_t;};  //raw bits
+
+
+//channel value as float, no normalization (unsigned byte stays 0..255)
+template<eJBitmapFormat F>
+inline float channelToFloat(typename JBitmapChannelType<F>::type v){
+    if constexpr (F == eJBitmapFormat_Half) return halfToFloat(v);
+    else                                    return float(v);
+}
+template<eJBitmapFormat F>
+inline typename JBitmapChannelType<F>::type floatToChannel(float v){
+    if constexpr (F == eJBitmapFormat_Half)              return floatToHalf(v);
+    else if constexpr (F == eJBitmapFormat_UnsignedByte) return uint8_t(v);
+    else                                                 return v;
+}
+
+
+template<eJBitmapFormat Format, int Channels, bool Mutable = true>
+struct JBitmapView{
+    static_assert(Channels >= 1 && Channels <= 4, "JBitmapView: 1 to 4 channels");
+
+    using Channel = typename JBitmapChannelType<Format>::type;
+    using Pointer = std::conditional_t<Mutable, Channel*, const Channel*>;
+    using Pixel   = std::array<Channel, Channels>;
+    static constexpr eJBitmapFormat format = Format;
+    static constexpr int channels = Channels;
+
+    Pointer data{nullptr};
+    int     w{0};
+    int     h{0};
+    size_t  rowStride{0}; //in channels. w * Channels, unless it is a sub view
+
+    JBitmapView() = default;
+    JBitmapView(Pointer ptr, int width, int height, size_t stride = 0):
+        data(ptr), w(width), h(height), rowStride(stride ? stride : size_t(width) * Channels) {}
+
+    //whole bitmap, cube layers are stacked as rows (h * depth)
+    explicit JBitmapView(JBitmap& bitmap):
+        JBitmapView(reinterpret_cast<Pointer>(bitmap.data_.data()), bitmap.w_, bitmap.h_ * bitmap.depth_)
+        { checkLayout(bitmap); }
+    explicit JBitmapView(const JBitmap& bitmap) requires (!Mutable):
+        JBitmapView(reinterpret_cast<Pointer>(bitmap.data_.data()), bitmap.w_, bitmap.h_ * bitmap.depth_)
+        { checkLayout(bitmap); }
+
+    //mutable view converts to read only one
+    operator JBitmapView<Format, Channels, false>() const requires Mutable
+        { return JBitmapView<Format, Channels, false>(data, w, h, rowStride); }
+
+    Pointer row(int y) const                    {return data + size_t(y) * rowStride;}
+    Pointer pixel(int x, int y) const           {return row(y) + size_t(x) * Channels;}
+    JBitmapView sub(int x, int y, int width, int height) const
+        {return JBitmapView(pixel(x, y), width, height, rowStride);}
+
+    Pixel get(int x, int y) const{
+        Pixel p;
+        const Channel* src = pixel(x, y);
+        for(int c = 0; c < Channels; ++c) p[c] = src[c];
+        return p;
+    }
+    void set(int x, int y, const Pixel& p) const requires Mutable{
+        Channel* dst = pixel(x, y);
+        for(int c = 0; c < Channels; ++c) dst[c] = p[c];
+    }
+
+private:
+    static void checkLayout(const JBitmap& bitmap){
+        if(bitmap.format_ != Format || bitmap.channels_ != Channels){
+            throw std::runtime_error("JBitmapView: bitmap format / channels do not match the view");}
+    }
+};
+
+
+
+//call fn with the matching typed view of a runtime bitmap (read only)
+template<typename Fn>
+void visitBitmapView(const JBitmap& bitmap, Fn&& fn){
+    auto visit = [&](auto format){
+        constexpr eJBitmapFormat F = decltype(format)::value;
+        switch(bitmap.channels_){
+            case 1: fn(JBitmapView<F, 1, false>(bitmap)); return;
+            case 2: fn(JBitmapView<F, 2, false>(bitmap)); return;
+            case 3: fn(JBitmapView<F, 3, false>(bitmap)); return;
+            case 4: fn(JBitmapView<F, 4, false>(bitmap)); return;
+            default: throw std::runtime_error("visitBitmapView: unsupported channel count");
+        }
+    };
+    if(bitmap.format_ == eJBitmapFormat_Float){
+        visit(std::integral_constant<eJBitmapFormat, eJBitmapFormat_Float>{});}
+    else if(bitmap.format_ == eJBitmapFormat_Half){
+        visit(std::integral_constant<eJBitmapFormat, eJBitmapFormat_Half>{});}
+    else{
+        visit(std::integral_constant<eJBitmapFormat, eJBitmapFormat_UnsignedByte>{});}
+}
+
+
+
+//---------------------------------------------------------------------------------------
+//bulk operations
+
+template<eJBitmapFormat F, int C>
+void fillPixels(const JBitmapView<F, C>& dst, const typename JBitmapView<F, C>::Pixel& value){
+    for(int y = 0; y < dst.h; ++y){
+        auto* row = dst.row(y);
+        for(int x = 0; x < dst.w; ++x){
+            for(int c = 0; c < C; ++c) row[x * C + c] = value[c];  }
+    }
+}
+
+
+//same format, row by row memcpy (sub views are fine)
+template<eJBitmapFormat F, int C, bool M>
+void copyPixels(const JBitmapView<F, C, M>& src, const JBitmapView<F, C>& dst){
+    const size_t rowBytes = size_t(std::min(src.w, dst.w)) * C * sizeof(typename JBitmapView<F, C>::Channel);
+    for(int y = 0; y < std::min(src.h, dst.h); ++y){
+        memcpy(dst.row(y), src.row(y), rowBytes);}
+}
+
+
+//copy rotated by 180 degree (dst(x, y) = src(w-1-x, h-1-y))
+template<eJBitmapFormat F, int C, bool M>
+void copyPixelsRotated180(const JBitmapView<F, C, M>& src, const JBitmapView<F, C>& dst){
+    for(int y = 0; y < dst.h; ++y){
+        const auto* s = src.pixel(src.w - 1, src.h - 1 - y);
+        auto* d = dst.row(y);
+        for(int x = 0; x < dst.w; ++x){
+            for(int c = 0; c < C; ++c) d[x * C + c] = s[-x * C + c];  }
+    }
+}
+
+
+//unsigned byte [0, 255] <-> float / half [0, 1]. float <-> half row by row with F16C.
+//same format is a plain copy
+template<eJBitmapFormat SrcF, eJBitmapFormat DstF, int C, bool M>
+void convertPixels(const JBitmapView<SrcF, C, M>& src, const JBitmapView<DstF, C>& dst){
+    for(int y = 0; y < std::min(src.h, dst.h); ++y){
+        const auto* s = src.row(y);
+        auto* d = dst.row(y);
+        const int n = std::min(src.w, dst.w) * C;
+        if constexpr (SrcF == eJBitmapFormat_Float && DstF == eJBitmapFormat_Half){
+            floatToHalfN(s, d, size_t(n));  continue;}
+        else if constexpr (SrcF == eJBitmapFormat_Half && DstF == eJBitmapFormat_Float){
+            halfToFloatN(s, d, size_t(n));  continue;}
+
+        for(int i = 0; i < n; ++i){
+            if constexpr (SrcF == DstF){
+                d[i] = s[i];}
+            else if constexpr (SrcF == eJBitmapFormat_UnsignedByte){
+                d[i] = floatToChannel<DstF>(float(s[i]) * (1.0f / 255.0f));}
+            else if constexpr (DstF == eJBitmapFormat_UnsignedByte){
+                d[i] = uint8_t(std::clamp(channelToFloat<SrcF>(s[i]), 0.0f, 1.0f) * 255.0f + 0.5f);}
+        }
+    }
+}
+
+
+//2x2 box filter, one level. dst may be the same memory as src (in place): output row y only
+//reads rows >= 2y, so nothing is overwritten before it is read. odd sizes clamp the last row / column
+template<eJBitmapFormat F, int C, bool M>
+void downsample2x(const JBitmapView<F, C, M>& src, const JBitmapView<F, C>& dst){
+    for(int y = 0; y < dst.h; ++y){
+        const auto* r0 = src.row(std::min(2 * y, src.h - 1));
+        const auto* r1 = src.row(std::min(2 * y + 1, src.h - 1));
+        auto* d = dst.row(y);
+        for(int x = 0; x < dst.w; ++x){
+            const int x0 = std::min(2 * x, src.w - 1) * C;
+            const int x1 = std::min(2 * x + 1, src.w - 1) * C;
+            for(int c = 0; c < C; ++c){
+                if constexpr (F == eJBitmapFormat_UnsignedByte){
+                    d[x * C + c] = uint8_t((uint32_t(r0[x0 + c]) + r0[x1 + c] + r1[x0 + c] + r1[x1 + c] + 2) / 4);}
+                else if constexpr (F == eJBitmapFormat_Half){
+                    d[x * C + c] = floatToHalf((halfToFloat(r0[x0 + c]) + halfToFloat(r0[x1 + c]) +
+                                                halfToFloat(r1[x0 + c]) + halfToFloat(r1[x1 + c])) * 0.25f);}
+                else{
+                    d[x * C + c] = (r0[x0 + c] + r0[x1 + c] + r1[x0 + c] + r1[x1 + c]) * 0.25f;}
+            }
+        }
+    }
+}
+
+
+
+
+
+
+
+
 
 
 
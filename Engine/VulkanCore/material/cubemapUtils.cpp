@@ -1,4 +1,14 @@
 #include "cubemapUtils.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <vector>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+#include "../utility.hpp"
+#include "imageDecode.hpp"
 
 
 
@@ -21,6 +31,294 @@ glm::vec3 faceCoordsToXYZ(int i, int j, int faceID, int faceSize){
 
 
 
+///////////////////////////////////////////////////////////////////////////////////////////
+// equirect sampling kernel
+// per output row: direction -> (Uf, Vf) in the equirect image is vectorized (AVX2 / SSE2 / scalar),
+// then the 4-tap bilinear fetch reads the raw bitmap memory, no getPixel / bounds check.
+
+namespace {
+
+constexpr float kPi     = 3.14159265358979323846f;
+constexpr float kHalfPi = 1.57079632679489661923f;
+
+//atan(t) on [0, 1], minimax polynomial (Abramowitz & Stegun 4.4.49 style)
+//|error| < 1e-5 rad. in pixels that is 2F/pi * 1e-5, ~0.013 px for an 8K input (F = 2048)
+constexpr float kAtan0 =  0.99997726f;
+constexpr float kAtan1 = -0.33262347f;
+constexpr float kAtan2 =  0.19354346f;
+constexpr float kAtan3 = -0.11643287f;
+constexpr float kAtan4 =  0.05265332f;
+constexpr float kAtan5 = -0.01172120f;
+
+
+inline float fastAtan2(float y, float x){
+    const float ax = std::fabs(x);
+    const float ay = std::fabs(y);
+    const float mx = std::max(ax, ay);
+    const float t  = mx > 0.0f ? std::min(ax, ay) / mx : 0.0f;
+    const float t2 = t * t;
+    float r = t * (kAtan0 + t2 * (kAtan1 + t2 * (kAtan2 + t2 * (kAtan3 + t2 * (kAtan4 + t2 * kAtan5)))));
+    if(ay > ax)          r = kHalfPi - r;
+    if(std::signbit(x))  r = kPi - r;
+    return std::copysign(r, y); //sign of y, like std::atan2 (also for -0)
+}
+
+
+//P(i) = P0 + i * dP along one output row. writes Uf / Vf for i in [begin, count)
+void equirectUV_scalar(const glm::vec3& P0, const glm::vec3& dP, int begin, int count, float faceSize, float* U, float* V){
+    const float scale = 2.0f * faceSize / kPi;
+    for(int i = begin; i < count; ++i){
+        const glm::vec3 P = P0 + float(i) * dP;
+        const float R     = std::sqrt(P.x * P.x + P.y * P.y);
+        const float theta = fastAtan2(P.y, P.x);
+        const float phi   = fastAtan2(P.z, R);
+        U[i] = theta * scale + 2.0f * faceSize;  // 2F * (theta + pi) / pi
+        V[i] = faceSize - phi * scale;           // 2F * (pi/2 - phi) / pi
+    }
+}
+
+
+#if defined(__x86_64__)
+
+inline __m128 atan2_SSE2(__m128 y, __m128 x){
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    const __m128 ax = _mm_andnot_ps(signMask, x);
+    const __m128 ay = _mm_andnot_ps(signMask, y);
+    const __m128 mx = _mm_max_ps(ax, ay);
+    //0/0 -> nan, masked to 0
+    const __m128 t  = _mm_and_ps(_mm_div_ps(_mm_min_ps(ax, ay), mx), _mm_cmpgt_ps(mx, _mm_setzero_ps()));
+    const __m128 t2 = _mm_mul_ps(t, t);
+
+    __m128 p = _mm_set1_ps(kAtan5);
+    p = _mm_add_ps(_mm_mul_ps(p, t2), _mm_set1_ps(kAtan4));
+    p = _mm_add_ps(_mm_mul_ps(p, t2), _mm_set1_ps(kAtan3));
+    p = _mm_add_ps(_mm_mul_ps(p, t2), _mm_set1_ps(kAtan2));
+    p = _mm_add_ps(_mm_mul_ps(p, t2), _mm_set1_ps(kAtan1));
+    p = _mm_add_ps(_mm_mul_ps(p, t2), _mm_set1_ps(kAtan0));
+    __m128 r = _mm_mul_ps(p, t);
+
+    //no blendv in SSE2, select with and / andnot / or
+    const __m128 swap = _mm_cmpgt_ps(ay, ax);
+    r = _mm_or_ps(_mm_and_ps(swap, _mm_sub_ps(_mm_set1_ps(kHalfPi), r)), _mm_andnot_ps(swap, r));
+    const __m128 xNeg = _mm_castsi128_ps(_mm_srai_epi32(_mm_castps_si128(x), 31));
+    r = _mm_or_ps(_mm_and_ps(xNeg, _mm_sub_ps(_mm_set1_ps(kPi), r)), _mm_andnot_ps(xNeg, r));
+    return _mm_or_ps(r, _mm_and_ps(y, signMask)); //r >= 0 here, copy sign of y
+}
+
+
+void equirectUV_SSE2(const glm::vec3& P0, const glm::vec3& dP, int count, float faceSize, float* U, float* V){
+    const __m128 scale  = _mm_set1_ps(2.0f * faceSize / kPi);
+    const __m128 offU   = _mm_set1_ps(2.0f * faceSize);
+    const __m128 offV   = _mm_set1_ps(faceSize);
+    const __m128 lane   = _mm_setr_ps(0.f, 1.f, 2.f, 3.f);
+
+    int i = 0;
+    for(; i + 4 <= count; i += 4){
+        const __m128 fi = _mm_add_ps(_mm_set1_ps(float(i)), lane);
+        const __m128 x  = _mm_add_ps(_mm_set1_ps(P0.x), _mm_mul_ps(fi, _mm_set1_ps(dP.x)));
+        const __m128 y  = _mm_add_ps(_mm_set1_ps(P0.y), _mm_mul_ps(fi, _mm_set1_ps(dP.y)));
+        const __m128 z  = _mm_add_ps(_mm_set1_ps(P0.z), _mm_mul_ps(fi, _mm_set1_ps(dP.z)));
+        const __m128 R  = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)));
+
+        const __m128 theta = atan2_SSE2(y, x);
+        const __m128 phi   = atan2_SSE2(z, R);
+        _mm_storeu_ps(U + i, _mm_add_ps(_mm_mul_ps(theta, scale), offU));
+        _mm_storeu_ps(V + i, _mm_sub_ps(offV, _mm_mul_ps(phi, scale)));
+    }
+    equirectUV_scalar(P0, dP, i, count, faceSize, U, V);
+}
+
+
+//compiled for avx2 regardless of the project flags, only called when the cpu has it
+__attribute__((target("avx2")))
+inline __m256 atan2_AVX2(__m256 y, __m256 x){
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+    const __m256 ax = _mm256_andnot_ps(signMask, x);
+    const __m256 ay = _mm256_andnot_ps(signMask, y);
+    const __m256 mx = _mm256_max_ps(ax, ay);
+    const __m256 t  = _mm256_and_ps(_mm256_div_ps(_mm256_min_ps(ax, ay), mx),
+                                    _mm256_cmp_ps(mx, _mm256_setzero_ps(), _CMP_GT_OQ));
+    const __m256 t2 = _mm256_mul_ps(t, t);
+
+    __m256 p = _mm256_set1_ps(kAtan5);
+    p = _mm256_add_ps(_mm256_mul_ps(p, t2), _mm256_set1_ps(kAtan4));
+    p = _mm256_add_ps(_mm256_mul_ps(p, t2), _mm256_set1_ps(kAtan3));
+    p = _mm256_add_ps(_mm256_mul_ps(p, t2), _mm256_set1_ps(kAtan2));
+    p = _mm256_add_ps(_mm256_mul_ps(p, t2), _mm256_set1_ps(kAtan1));
+    p = _mm256_add_ps(_mm256_mul_ps(p, t2), _mm256_set1_ps(kAtan0));
+    __m256 r = _mm256_mul_ps(p, t);
+
+    r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(kHalfPi), r), _mm256_cmp_ps(ay, ax, _CMP_GT_OQ));
+    r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(kPi), r), x); //blendv only looks at the sign bit
+    return _mm256_or_ps(r, _mm256_and_ps(y, signMask));
+}
+
+
+__attribute__((target("avx2")))
+void equirectUV_AVX2(const glm::vec3& P0, const glm::vec3& dP, int count, float faceSize, float* U, float* V){
+    const __m256 scale  = _mm256_set1_ps(2.0f * faceSize / kPi);
+    const __m256 offU   = _mm256_set1_ps(2.0f * faceSize);
+    const __m256 offV   = _mm256_set1_ps(faceSize);
+    const __m256 lane   = _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f);
+
+    int i = 0;
+    for(; i + 8 <= count; i += 8){
+        const __m256 fi = _mm256_add_ps(_mm256_set1_ps(float(i)), lane);
+        const __m256 x  = _mm256_add_ps(_mm256_set1_ps(P0.x), _mm256_mul_ps(fi, _mm256_set1_ps(dP.x)));
+        const __m256 y  = _mm256_add_ps(_mm256_set1_ps(P0.y), _mm256_mul_ps(fi, _mm256_set1_ps(dP.y)));
+        const __m256 z  = _mm256_add_ps(_mm256_set1_ps(P0.z), _mm256_mul_ps(fi, _mm256_set1_ps(dP.z)));
+        const __m256 R  = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)));
+
+        const __m256 theta = atan2_AVX2(y, x);
+        const __m256 phi   = atan2_AVX2(z, R);
+        _mm256_storeu_ps(U + i, _mm256_add_ps(_mm256_mul_ps(theta, scale), offU));
+        _mm256_storeu_ps(V + i, _mm256_sub_ps(offV, _mm256_mul_ps(phi, scale)));
+    }
+    equirectUV_scalar(P0, dP, i, count, faceSize, U, V);
+}
+
+#endif // __x86_64__
+
+
+using EquirectUVKernel = void(*)(const glm::vec3&, const glm::vec3&, int, float, float*, float*);
+
+void equirectUV_scalarRow(const glm::vec3& P0, const glm::vec3& dP, int count, float faceSize, float* U, float* V){
+    equirectUV_scalar(P0, dP, 0, count, faceSize, U, V);
+}
+
+//picked once, at first use
+EquirectUVKernel selectEquirectUVKernel(const char*& name){
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")){
+        name = "AVX2";
+        return equirectUV_AVX2;     }
+    name = "SSE2";
+    return equirectUV_SSE2;
+#else
+    name = "scalar";
+    return equirectUV_scalarRow;
+#endif
+}
+
+
+//4-sample bilinear fetch for one row of Uf / Vf, dst is channels-interleaved like the source
+//same clamping / weights as the old getPixel path. channel count is a template param so the
+//inner channel loop is unrolled
+template<typename View>
+void bilinearRow(const View& src, const float* U, const float* V, int count, typename View::Channel* dst){
+    using T = typename View::Channel;
+    constexpr int C = View::channels;
+    const int clampW = src.w - 1;
+    const int clampH = src.h - 1;
+
+    for(int n = 0; n < count; ++n){
+        const int U1 = std::clamp(int(std::floor(U[n])), 0, clampW);
+        const int V1 = std::clamp(int(std::floor(V[n])), 0, clampH);
+        const int U2 = std::min(U1 + 1, clampW);
+        const int V2 = std::min(V1 + 1, clampH);
+        const float s = U[n] - U1;
+        const float t = V[n] - V1;
+
+        const float wA = (1 - s) * (1 - t);
+        const float wB = (s)     * (1 - t);
+        const float wC = (1 - s) * (t);
+        const float wD = (s)     * (t);
+        const T* A = src.pixel(U1, V1);
+        const T* B = src.pixel(U2, V1);
+        const T* Cc= src.pixel(U1, V2);
+        const T* D = src.pixel(U2, V2);
+
+        for(int c = 0; c < C; ++c){
+            //unsigned byte: /255 and *255 cancel out. half: decode, blend, encode
+            if constexpr (View::format == eJBitmapFormat_Half){
+                dst[c] = floatToHalf(halfToFloat(A[c]) * wA + halfToFloat(B[c]) * wB +
+                                     halfToFloat(Cc[c]) * wC + halfToFloat(D[c]) * wD);}
+            else{
+                dst[c] = T(float(A[c]) * wA + float(B[c]) * wB + float(Cc[c]) * wC + float(D[c]) * wD);}
+        }
+        dst += C;
+    }
+}
+
+
+//same fetch from radiance rgbe texels (4 bytes each). the exponent scale of each texel is folded
+//into its weight, so up to float rounding it matches sampling the stbi float image. dst is rgba float, alpha 1
+void bilinearRowRGBE(const JBitmapView<eJBitmapFormat_UnsignedByte, 4, false>& src,
+                     const float* U, const float* V, int count, float* dst){
+    const auto& kScale = TexUtils::rgbeScaleTable();
+    const int clampW = src.w - 1;
+    const int clampH = src.h - 1;
+
+    for(int n = 0; n < count; ++n){
+        const int U1 = std::clamp(int(std::floor(U[n])), 0, clampW);
+        const int V1 = std::clamp(int(std::floor(V[n])), 0, clampH);
+        const int U2 = std::min(U1 + 1, clampW);
+        const int V2 = std::min(V1 + 1, clampH);
+        const float s = U[n] - U1;
+        const float t = V[n] - V1;
+
+        const float wA = (1 - s) * (1 - t) * kScale[src.pixel(U1, V1)[3]];
+        const float wB = (s)     * (1 - t) * kScale[src.pixel(U2, V1)[3]];
+        const float wC = (1 - s) * (t)     * kScale[src.pixel(U1, V2)[3]];
+        const float wD = (s)     * (t)     * kScale[src.pixel(U2, V2)[3]];
+        const uint8_t* A = src.pixel(U1, V1);
+        const uint8_t* B = src.pixel(U2, V1);
+        const uint8_t* Cc= src.pixel(U1, V2);
+        const uint8_t* D = src.pixel(U2, V2);
+
+        for(int c = 0; c < 3; ++c){
+            dst[c] = float(A[c]) * wA + float(B[c]) * wB + float(Cc[c]) * wC + float(D[c]) * wD;}
+        dst[3] = 1.0f;
+        dst += 4;
+    }
+}
+
+
+//equirect pixel coords (U, V) of row j of cross face `face`. thread local storage, valid until the next call.
+//reversed: row right to left (-z face of the cube is stored rotated 180 in the cross)
+void equirectRowUV(int face, int j, int faceSize, bool reversed, const float*& U, const float*& V){
+    static const char* kernelName = nullptr;
+    static const EquirectUVKernel uvKernel = selectEquirectUVKernel(kernelName);
+
+    thread_local std::vector<float> Us, Vs;
+    Us.resize(faceSize);
+    Vs.resize(faceSize);
+
+    const glm::vec3 P0 = faceCoordsToXYZ(0, j, face, faceSize);
+    const glm::vec3 dP = faceCoordsToXYZ(1, j, face, faceSize) - P0;
+    uvKernel(P0, dP, faceSize, float(faceSize), Us.data(), Vs.data());
+    if(reversed){
+        std::reverse(Us.begin(), Us.end());
+        std::reverse(Vs.begin(), Vs.end());   }
+    U = Us.data();
+    V = Vs.data();
+}
+
+
+//one row j of cross face `face`, sampled into dst (faceSize pixels)
+void sampleEquirectRow(const JBitmap& bitmap, int face, int j, int faceSize, uint8_t* dst, bool reversed){
+    const float* U;
+    const float* V;
+    equirectRowUV(face, j, faceSize, reversed, U, V);
+
+    visitBitmapView(bitmap, [&](const auto& src){
+        using Channel = typename std::decay_t<decltype(src)>::Channel;
+        bilinearRow(src, U, V, faceSize, reinterpret_cast<Channel*>(dst));
+    });
+}
+
+} // namespace
+
+
+const char* equirectKernelName(){
+    static const char* name = nullptr;
+    if(!name) selectEquirectUVKernel(name);
+    return name;
+}
+
+
+
 JBitmap convertEquirectangularMapToVerticalCross (const JBitmap& bitmap){
     // convert equirectangular map to vertical cross (like box) , using 4-samples bilinear interpolation
     if(bitmap.type_ != eJBitmapType_2D) return JBitmap();
@@ -39,118 +337,163 @@ JBitmap convertEquirectangularMapToVerticalCross (const JBitmap& bitmap){
         glm::ivec2(faceSize    , faceSize * 2)
     };
 
-    const int clampW = bitmap.w_ - 1;
-    const int clampH = bitmap.h_ - 1;
-
-    for (int face = 0; face != 6; face++){
-        for (int i = 0; i != faceSize ; i++){
-            for (int j = 0; j != faceSize; j++){
-                //spherical coordinates
-                const glm::vec3 P = faceCoordsToXYZ(i , j, face, faceSize);
-                const float R = hypot(P.x, P.y);
-                const float theta = atan2(P.y, P.x);
-                const float phi = atan2(P.z, R);
-                //convert spherical image to floating-point pixel coordinates (notebook)
-                const float Uf = float(2.0f * faceSize * (theta + M_PI) / M_PI);
-                const float Vf = float(2.0f * faceSize * (M_PI / 2.f - phi) / M_PI);
-                //4 samples for bilinear interpolation // 在上面取到的floating point附近的四个像素index
-                const int U1 = glm::clamp( int(floor(Uf)) , 0 , clampW); // pixel index
-                const int V1 = glm::clamp( int(floor(Vf)) , 0 , clampH);
-                const int U2 = glm::clamp ( U1 + 1, 0, clampW);
-                const int V2 = glm::clamp ( V1 + 1, 0, clampH);
-				// fractional part  比例
-                const float s = Uf - U1;
-                const float t = Vf - V1;
-                // fetch 4-samples
-                const glm::vec4 A = bitmap.getPixel(U1, V1);
-                const glm::vec4 B = bitmap.getPixel(U2, V1);
-                const glm::vec4 C = bitmap.getPixel(U1, V2);
-                const glm::vec4 D = bitmap.getPixel(U2, V2);
-                //bilinear interpolation
-                const glm::vec4 color = 
-                    A * (1-s) * (1-t) + 
-                    B * (s)   * (1-t) + 
-                    C * (1-s) * (t)   +
-                    D * (s)   * (t)   ;
-                result.setPixel( i + kFaceOffsets[face].x  ,  j + kFaceOffsets[face].y  ,  color);
-            }
-        }
-    };
+    const size_t pixelSize = size_t(bitmap.channels_) * JBitmap::getBytesPerChannel(bitmap.format_);
+    const auto start = std::chrono::steady_clock::now();
+
+    // one task = one row of one face. in the cross layout a face row is a contiguous run of pixels
+    // old loop was i outer / j inner (column by column), this walks i inside a row instead
+    util::parallelFor(6 * faceSize, 16, [&](int task){
+        const int face = task / faceSize;
+        const int j    = task % faceSize;
+        uint8_t* row = result.data_.data() +
+            ((size_t(j) + kFaceOffsets[face].y) * w + kFaceOffsets[face].x) * pixelSize;
+        sampleEquirectRow(bitmap, face, j, faceSize, row, false);
+    });
+
+    if(TexUtils::loadStatsEnabled()){
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "DEBUG: equirect " << bitmap.w_ << "x" << bitmap.h_ << " -> vertical cross ("
+                  << equirectKernelName() << ", " << std::thread::hardware_concurrency() << " threads) " << ms << " ms" << std::endl;}
     return result;
 }
 
 
 
 
-JBitmap convertVerticalCrossToCubeMapFaces(const JBitmap& bitmap){
-    const int faceWidth  = bitmap.w_ / 3;
-    const int faceHeight = bitmap.h_ / 4;
+void convertEquirectangularMapToCubeMapFaces(const JBitmap& bitmap, void* dstData){
+    convertEquirectangularMapToCubeMapFaces(bitmap, dstData, bitmap.format_);
+}
 
-    //6 depths
-    JBitmap cubemap(faceWidth, faceHeight, 6, bitmap.channels_, bitmap.format_);
-    cubemap.type_ = eJBitmapType_Cube;
 
-    const uint8_t* src = bitmap.data_.data();
-    uint8_t* dst       = cubemap.data_.data();
-    const int pixelSize = cubemap.channels_ * JBitmap::getBytesPerChannel(cubemap.format_);  // byte size
-
-    for(int face = 0 ; face!=6; ++face){
-        for(int j = 0; j!= faceHeight; ++j){
-            for(int i = 0; i!= faceWidth; ++i){
-                int x = 0;
-                int y = 0;
-
-                switch(face){
-                    case 0: // +x
-                      x = 2*faceWidth + i;
-                      y = 1*faceHeight + j;
-                      break;
-                    case 1: // -x
-                      x = i;
-                      y = faceHeight + j;
-                      break;
-                    case 2: // +y
-                      x = 1*faceWidth + i;
-                      y = j;
-                      break;
-                    case 3: // -y
-                      x = 1*faceWidth + i;
-                      y = 2*faceHeight + j;
-                      break;
-                    case 4: // +z
-                      x = faceWidth + i;
-                      y = faceHeight + j;
-                      break;
-                    case 5: // -z
-                      x = 2 * faceWidth - (i + 1);
-                      y = bitmap.h_ - (j + 1);
-                      break;          }
-                    memcpy(dst, 
-                           src + (y * bitmap.w_ + x) * pixelSize, 
-                           pixelSize);
-                    dst += pixelSize;
-            }  }  }
+void convertEquirectangularMapToCubeMapFaces(const JBitmap& bitmap, void* dstData, eJBitmapFormat dstFormat){
+    //float -> half is the only narrowing we do here (hdr env maps into rgba16f)
+    const bool toHalf = (bitmap.format_ == eJBitmapFormat_Float && dstFormat == eJBitmapFormat_Half);
+    if(dstFormat != bitmap.format_ && !toHalf){
+        throw std::runtime_error("convertEquirectangularMapToCubeMapFaces: unsupported format conversion");}
 
-    return cubemap;
+    const int faceSize = bitmap.w_ / 4;
+    const size_t pixelSize = size_t(bitmap.channels_) * JBitmap::getBytesPerChannel(dstFormat);
+    const size_t rowBytes  = size_t(faceSize) * pixelSize;
+    const size_t rowValues = size_t(faceSize) * bitmap.channels_;
+    uint8_t* dst = static_cast<uint8_t*>(dstData);
+
+    //vulkan layer -> face of the cross (kFaceOffsets order above), see convertVerticalCrossToCubeMapFaces
+    //  +x:3  -x:1  +y:4  -y:5  +z:2  -z:0 (rotated 180)
+    const int kCrossFace[6] = {3, 1, 4, 5, 2, 0};
+    const auto start = std::chrono::steady_clock::now();
+
+    util::parallelFor(6 * faceSize, 16, [&](int task){
+        const int layer = task / faceSize;
+        const int row   = task % faceSize;
+        const bool flip = (layer == 5);
+        uint8_t* dstRow = dst + (size_t(layer) * faceSize + row) * rowBytes;
+        const int j = flip ? faceSize - 1 - row : row;
+        if(!toHalf){
+            sampleEquirectRow(bitmap, kCrossFace[layer], j, faceSize, dstRow, flip);
+            return;}
+
+        //sample in float, then narrow the whole row at once (F16C)
+        thread_local std::vector<float> floatRow;
+        floatRow.resize(rowValues);
+        sampleEquirectRow(bitmap, kCrossFace[layer], j, faceSize, reinterpret_cast<uint8_t*>(floatRow.data()), flip);
+        floatToHalfN(floatRow.data(), reinterpret_cast<uint16_t*>(dstRow), rowValues);
+    });
+
+    if(TexUtils::loadStatsEnabled()){
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "DEBUG: equirect " << bitmap.w_ << "x" << bitmap.h_ << " -> cube faces"
+                  << (toHalf ? " rgba16f" : "") << " ("
+                  << equirectKernelName() << ", " << std::thread::hardware_concurrency() << " threads) " << ms << " ms" << std::endl;}
 }
 
 
 
 
+void convertRGBEEquirectToCubeMapFaces(const JBitmap& rgbe, void* dstData, eJBitmapFormat dstFormat){
+    if(rgbe.format_ != eJBitmapFormat_UnsignedByte || rgbe.channels_ != 4 ||
+       (dstFormat != eJBitmapFormat_Float && dstFormat != eJBitmapFormat_Half)){
+        throw std::runtime_error("convertRGBEEquirectToCubeMapFaces: needs 4 byte rgbe in, float / half out");}
 
+    const JBitmapView<eJBitmapFormat_UnsignedByte, 4, false> src(rgbe);
+    const int faceSize = rgbe.w_ / 4;
+    const size_t rowValues = size_t(faceSize) * 4;
+    const size_t rowBytes  = rowValues * JBitmap::getBytesPerChannel(dstFormat);
+    uint8_t* dst = static_cast<uint8_t*>(dstData);
 
+    const int kCrossFace[6] = {3, 1, 4, 5, 2, 0}; //see convertEquirectangularMapToCubeMapFaces
+    const auto start = std::chrono::steady_clock::now();
 
+    util::parallelFor(6 * faceSize, 16, [&](int task){
+        const int layer = task / faceSize;
+        const int row   = task % faceSize;
+        const bool flip = (layer == 5);
+        const float* U;
+        const float* V;
+        equirectRowUV(kCrossFace[layer], flip ? faceSize - 1 - row : row, faceSize, flip, U, V);
 
+        uint8_t* dstRow = dst + (size_t(layer) * faceSize + row) * rowBytes;
+        if(dstFormat == eJBitmapFormat_Float){
+            bilinearRowRGBE(src, U, V, faceSize, reinterpret_cast<float*>(dstRow));
+            return;}
 
+        thread_local std::vector<float> floatRow;
+        floatRow.resize(rowValues);
+        bilinearRowRGBE(src, U, V, faceSize, floatRow.data());
+        floatToHalfN(floatRow.data(), reinterpret_cast<uint16_t*>(dstRow), rowValues);
+    });
 
+    if(TexUtils::loadStatsEnabled()){
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "DEBUG: rgbe equirect " << rgbe.w_ << "x" << rgbe.h_ << " -> cube faces ("
+                  << equirectKernelName() << ", " << std::thread::hardware_concurrency() << " threads) " << ms << " ms" << std::endl;}
+}
 
 
 
 
+JBitmap convertVerticalCrossToCubeMapFaces(const JBitmap& bitmap){
+    const int faceWidth  = bitmap.w_ / 3;
+    const int faceHeight = bitmap.h_ / 4;
 
+    //6 depths
+    JBitmap cubemap(faceWidth, faceHeight, 6, bitmap.channels_, bitmap.format_);
+    cubemap.type_ = eJBitmapType_Cube;
 
+    convertVerticalCrossToCubeMapFaces(bitmap, cubemap.data_.data());
+    return cubemap;
+}
 
 
 
+void convertVerticalCrossToCubeMapFaces(const JBitmap& bitmap, void* dstData){
+    const int faceWidth  = bitmap.w_ / 3;
+    const int faceHeight = bitmap.h_ / 4;
+
+    //top left of each face inside the cross, in layer order
+    const int kCrossOffsets[6][2] = {
+        {2 * faceWidth, faceHeight    }, // +x
+        {0            , faceHeight    }, // -x
+        {faceWidth    , 0             }, // +y
+        {faceWidth    , 2 * faceHeight}, // -y
+        {faceWidth    , faceHeight    }, // +z
+        {faceWidth    , 3 * faceHeight}, // -z, stored rotated 180
+    };
+
+    visitBitmapView(bitmap, [&](const auto& src){
+        using View = std::decay_t<decltype(src)>;
+        using Channel = typename View::Channel;
+        using DstView = JBitmapView<View::format, View::channels>;
+        Channel* dst = static_cast<Channel*>(dstData);
+
+        for(int face = 0; face != 6; ++face){
+            const auto region = src.sub(kCrossOffsets[face][0], kCrossOffsets[face][1], faceWidth, faceHeight);
+            DstView layer(dst + size_t(face) * faceWidth * faceHeight * View::channels, faceWidth, faceHeight);
+            if(face == 5) copyPixelsRotated180(region, layer);
+            else          copyPixels(region, layer);
+        }
+    });
+}
+
+
 
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <vector>
 // #include <algorithm>
 #include "bitmap.hpp"
 
@@ -10,6 +11,15 @@ glm::vec3 faceCoordsToXYZ(int i, int j, int faceID, int faceSize);
 
 JBitmap convertEquirectangularMapToVerticalCross (const JBitmap& bitmap);
 
+//equirect -> 6 faces (layer after layer, same as convertVerticalCrossToCubeMapFaces gives) in one pass,
+//no vertical cross in between. dst size: (w/4) * (w/4) * 6 * pixel size, eg. mapped staging memory
+void convertEquirectangularMapToCubeMapFaces(const JBitmap& bitmap, void* dst);
+//same, dst written as dstFormat. float -> half supported (size then uses 2 bytes per channel)
+void convertEquirectangularMapToCubeMapFaces(const JBitmap& bitmap, void* dst, eJBitmapFormat dstFormat);
+//same, but the equirect holds radiance rgbe quads (TexUtils::decodeHdrRGBE, 4 bytes a pixel, a quarter
+//of the float image). texels are decoded per fetch. dstFormat float or half, rgba
+void convertRGBEEquirectToCubeMapFaces(const JBitmap& rgbe, void* dst, eJBitmapFormat dstFormat);
+
 
   /*
         ------
@@ -25,9 +35,10 @@ JBitmap convertEquirectangularMapToVerticalCross (const JBitmap& bitmap);
 
 JBitmap convertVerticalCrossToCubeMapFaces(const JBitmap& bitmap);
 
+//same, but write the 6 faces (face after face) into dst, eg. mapped staging memory.
+//dst size: (w/3) * (h/4) * 6 * pixel size
+void convertVerticalCrossToCubeMapFaces(const JBitmap& bitmap, void* dst);
 
 
-
-
-
-
+//uv kernel the equirect conversions picked for this cpu (avx2 / sse2 / scalar), for the logs and JBench
+const char* equirectKernelName();
@@ -0,0 +1,612 @@
+#include "imageDecode.hpp"
+#include <stb_image.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <ktx.h>
+#include <zstd.h>
+#include "load_texture.hpp"
+
+
+
+MappedFile::MappedFile(const std::string& path):
+    path_(path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0){
+        throw std::runtime_error("failed to open file: " + path);}
+
+    struct stat st{};
+    if(fstat(fd, &st) != 0 || st.st_size <= 0){
+        close(fd);
+        throw std::runtime_error("failed to stat file (or it is empty): " + path);}
+    size_ = static_cast<size_t>(st.st_size);
+
+    void* mapped = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); //mapping keeps its own reference
+    if(mapped == MAP_FAILED){
+        throw std::runtime_error("failed to mmap file: " + path);}
+
+    //decoders read front to back once
+    madvise(mapped, size_, MADV_SEQUENTIAL);
+    data_ = static_cast<const uint8_t*>(mapped);
+}
+
+
+MappedFile::~MappedFile(){
+    if(data_){
+        munmap(const_cast<uint8_t*>(data_), size_);}
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////
+
+namespace TexUtils{
+
+namespace detail{
+
+//the output buffer stbi is going to allocate. while decodeInto() runs, the first allocation of
+//exactly `size` bytes is given this memory instead of the heap.
+//only one owner at a time: realloc moves it to heap, free just releases it
+struct DecodeTarget{
+    void*   ptr{nullptr};
+    size_t  size{0};
+    bool    inUse{false};
+};
+thread_local DecodeTarget g_target;
+
+
+void* stbiMalloc(size_t size){
+    if(g_target.ptr && !g_target.inUse && size == g_target.size){
+        g_target.inUse = true;
+        return g_target.ptr;    }
+    return std::malloc(size);
+}
+
+void* stbiRealloc(void* ptr, size_t newSize){
+    if(ptr && ptr == g_target.ptr){
+        void* moved = std::malloc(newSize);
+        if(!moved) return nullptr;
+        std::memcpy(moved, ptr, std::min(newSize, g_target.size));
+        g_target.inUse = false;
+        return moved;   }
+    return std::realloc(ptr, newSize);
+}
+
+void stbiFree(void* ptr){
+    if(ptr && ptr == g_target.ptr){
+        g_target.inUse = false;
+        return;     }
+    std::free(ptr);
+}
+
+} // namespace detail
+
+
+
+bool queryImageInfo(const MappedFile& file, int& width, int& height, int& channels){
+    return stbi_info_from_memory(file.data(), static_cast<int>(file.size()), &width, &height, &channels) != 0;
+}
+
+
+
+DecodeResult decodeInto(const MappedFile& file, int desiredChannels, bool isFloat, void* dst, size_t dstSize){
+    DecodeResult result;
+
+    //radiance hdr: own parallel decoder, rows go straight into dst
+    HdrInfo hdr;
+    if(isFloat && (desiredChannels == 3 || desiredChannels == 4) && parseHdr(file, hdr)){
+        if(size_t(hdr.width) * hdr.height * desiredChannels * sizeof(float) != dstSize){
+            throw std::runtime_error("decoded image size does not match destination: " + file.path());}
+        decodeHdrFloat(file, hdr, desiredChannels, static_cast<float*>(dst));
+        result.width        = hdr.width;
+        result.height       = hdr.height;
+        result.fileChannels = 3;
+        result.inPlace      = true;
+        return result;
+    }
+
+    detail::g_target = {dst, dstSize, false};
+
+    void* pixels = isFloat
+        ? static_cast<void*>(stbi_loadf_from_memory(file.data(), static_cast<int>(file.size()),
+                                &result.width, &result.height, &result.fileChannels, desiredChannels))
+        : static_cast<void*>(stbi_load_from_memory(file.data(), static_cast<int>(file.size()),
+                                &result.width, &result.height, &result.fileChannels, desiredChannels));
+    detail::g_target = {};
+
+    if(!pixels){
+        throw std::runtime_error("failed to decode image ' " + file.path() + " ' : " + stbi_failure_reason());}
+
+    const size_t decodedSize = static_cast<size_t>(result.width) * result.height * desiredChannels * (isFloat ? sizeof(float) : 1);
+    if(decodedSize != dstSize){
+        if(pixels != dst) stbi_image_free(pixels);
+        throw std::runtime_error("decoded image size does not match destination: " + file.path());}
+
+    result.inPlace = (pixels == dst);
+    if(!result.inPlace){
+        //decoder needed its own buffer (eg. channel conversion), one copy left
+        std::memcpy(dst, pixels, dstSize);
+        stbi_image_free(pixels);    }
+    return result;
+}
+
+
+
+bool loadStatsEnabled(){
+    static const bool enabled = [](){
+        const char* env = std::getenv("JRENDERER_LOAD_STATS");
+        return env && std::string(env) == "1";
+    }();
+    return enabled;
+}
+
+
+void logLoadStats(const std::string& what){
+    if(!loadStatsEnabled()) return;
+
+    struct rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    const size_t peakBytes = static_cast<size_t>(usage.ru_maxrss) * 1024; //linux reports kB
+    std::cout << "DEBUG: " << what << ", peak RSS " << peakBytes / (1024 * 1024) << " MB" << std::endl;
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////////
+//Radiance hdr
+//header: "#?RADIANCE" / "#?RGBE", text lines, empty line, "-Y h +X w", then h scanlines.
+//new style rle scanline: 2 2 w_hi w_lo, then 4 planes (r, g, b, e) each run length coded:
+//count > 128 -> next byte repeated count - 128 times, else count literal bytes
+
+namespace {
+
+//reads one '\n' terminated line starting at pos, moves pos past it. false at end of file
+bool readHdrLine(const MappedFile& file, size_t& pos, std::string& line){
+    if(pos >= file.size()) return false;
+    const uint8_t* begin = file.data() + pos;
+    const uint8_t* nl = static_cast<const uint8_t*>(std::memchr(begin, '\n', file.size() - pos));
+    const size_t len = nl ? size_t(nl - begin) : file.size() - pos;
+    line.assign(reinterpret_cast<const char*>(begin), len);
+    pos += len + (nl ? 1 : 0);
+    return true;
+}
+
+//skips one rle plane of `width` values, false on broken data
+bool skipHdrPlane(const MappedFile& file, size_t& pos, int width){
+    int left = width;
+    while(left > 0){
+        if(pos >= file.size()) return false;
+        int count = file.data()[pos++];
+        if(count > 128){
+            count -= 128;
+            pos += 1;   }
+        else{
+            pos += count;   }
+        if(count == 0 || count > left || pos > file.size()) return false;
+        left -= count;
+    }
+    return true;
+}
+
+} // namespace
+
+
+bool parseHdr(const MappedFile& file, HdrInfo& info){
+    size_t pos = 0;
+    std::string line;
+    if(!readHdrLine(file, pos, line) || (line != "#?RADIANCE" && line != "#?RGBE")){
+        return false;}
+
+    bool rgbeFormat = false;
+    while(readHdrLine(file, pos, line) && !line.empty()){
+        if(line == "FORMAT=32-bit_rle_rgbe") rgbeFormat = true;}
+    if(!rgbeFormat) return false;
+
+    //only the standard orientation (top to bottom, left to right), same as stbi
+    int width = 0, height = 0;
+    if(!readHdrLine(file, pos, line) || std::sscanf(line.c_str(), "-Y %d +X %d", &height, &width) != 2 ||
+       width <= 0 || height <= 0 || width > (1 << 24) || height > (1 << 24)){
+        return false;}
+
+    info.width  = width;
+    info.height = height;
+    info.scanlines.resize(height);
+
+    //too narrow / wide for rle, or first scanline has no rle marker: flat rgbe quads
+    const uint8_t* p = file.data();
+    info.rle = (width >= 8 && width < 32768 && pos + 4 <= file.size() &&
+                p[pos] == 2 && p[pos + 1] == 2 && !(p[pos + 2] & 0x80));
+    if(!info.rle){
+        if(pos + size_t(width) * height * 4 > file.size()) return false;
+        for(int y = 0; y < height; ++y) info.scanlines[y] = pos + size_t(y) * width * 4;
+        return true;
+    }
+
+    //index pass: only walks the run counts, no pixel is decoded here
+    for(int y = 0; y < height; ++y){
+        if(pos + 4 > file.size()) return false;
+        //stbi would restart the image as flat when a later scanline has no marker, we leave that to stbi
+        if(p[pos] != 2 || p[pos + 1] != 2 || ((p[pos + 2] << 8) | p[pos + 3]) != width) return false;
+        info.scanlines[y] = pos;
+        pos += 4;
+        for(int k = 0; k < 4; ++k){
+            if(!skipHdrPlane(file, pos, width)) return false;}
+    }
+    return true;
+}
+
+
+
+void decodeHdrScanline(const MappedFile& file, const HdrInfo& info, int y, uint8_t* rgbe){
+    const uint8_t* p = file.data() + info.scanlines[y];
+    if(!info.rle){
+        std::memcpy(rgbe, p, size_t(info.width) * 4);
+        return;}
+
+    //parseHdr already checked every run fits the scanline and the file
+    p += 4;
+    for(int k = 0; k < 4; ++k){
+        uint8_t* dst = rgbe + k;
+        int left = info.width;
+        while(left > 0){
+            int count = *p++;
+            if(count > 128){
+                count -= 128;
+                const uint8_t value = *p++;
+                for(int i = 0; i < count; ++i, dst += 4) *dst = value; }
+            else{
+                for(int i = 0; i < count; ++i, dst += 4) *dst = *p++; }
+            left -= count;
+        }
+    }
+}
+
+
+
+const std::array<float, 256>& rgbeScaleTable(){
+    //exponent bias 128 and the 8 bit mantissa scale in one
+    static const auto table = [](){
+        std::array<float, 256> t{};
+        for(int e = 1; e < 256; ++e) t[e] = std::ldexp(1.0f, e - (128 + 8));
+        return t;
+    }();
+    return table;
+}
+
+
+void rgbeToFloat(const uint8_t* rgbe, float* dst, int count, int channels){
+    const auto& kScale = rgbeScaleTable();
+    for(int i = 0; i < count; ++i, rgbe += 4, dst += channels){
+        const float f = kScale[rgbe[3]];
+        dst[0] = rgbe[0] * f;
+        dst[1] = rgbe[1] * f;
+        dst[2] = rgbe[2] * f;
+        if(channels == 4) dst[3] = 1.0f;
+    }
+}
+
+
+
+void decodeHdrRGBE(const MappedFile& file, const HdrInfo& info, uint8_t* dst){
+    const size_t rowBytes = size_t(info.width) * 4;
+    util::parallelFor(info.height, 16, [&](int y){
+        decodeHdrScanline(file, info, y, dst + size_t(y) * rowBytes);
+    });
+}
+
+
+void decodeHdrFloat(const MappedFile& file, const HdrInfo& info, int channels, float* dst){
+    const size_t rowValues = size_t(info.width) * channels;
+    util::parallelFor(info.height, 16, [&](int y){
+        thread_local std::vector<uint8_t> rgbe;
+        rgbe.resize(size_t(info.width) * 4);
+        decodeHdrScanline(file, info, y, rgbe.data());
+        rgbeToFloat(rgbe.data(), dst + size_t(y) * rowValues, info.width, channels);
+    });
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////////
+//KTX2 layout: identifier(12) | header(36) | index(32) | level index (24 * levelCount) | ...
+//level data is stored smallest mip first, so all levels together are one contiguous range
+
+namespace {
+template<typename T>
+T readLE(const uint8_t* p){ T v; std::memcpy(&v, p, sizeof(T)); return v; }
+
+const uint8_t kKtx2Identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+}
+
+
+bool parseKtx2Header(const MappedFile& file, Ktx2Header& header){
+    const uint8_t* p = file.data();
+    if(file.size() < 80 || std::memcmp(p, kKtx2Identifier, sizeof(kKtx2Identifier)) != 0){
+        return false;}
+
+    header.vkFormat               = static_cast<VkFormat>(readLE<uint32_t>(p + 12));
+    header.typeSize               = readLE<uint32_t>(p + 16);
+    header.pixelWidth             = readLE<uint32_t>(p + 20);
+    header.pixelHeight            = std::max(1u, readLE<uint32_t>(p + 24));
+    header.pixelDepth             = readLE<uint32_t>(p + 28);
+    header.layerCount             = readLE<uint32_t>(p + 32);
+    header.faceCount              = readLE<uint32_t>(p + 36);
+    header.levelCount             = std::max(1u, readLE<uint32_t>(p + 40));
+    header.supercompressionScheme = readLE<uint32_t>(p + 44);
+
+    //channel count = sample count of the basic data format descriptor block
+    const uint32_t dfdOffset = readLE<uint32_t>(p + 48);
+    header.numComponents = 0;
+    if(dfdOffset + 12 <= file.size()){
+        const uint32_t blockSize = readLE<uint32_t>(p + dfdOffset + 8) >> 16;
+        header.numComponents = blockSize > 24 ? (blockSize - 24) / 16 : 0;  }
+
+    const size_t levelIndexEnd = 80 + size_t(header.levelCount) * 24;
+    if(file.size() < levelIndexEnd){
+        return false;}
+
+    header.levels.resize(header.levelCount);
+    for(uint32_t i = 0; i < header.levelCount; ++i){
+        const uint8_t* entry = p + 80 + size_t(i) * 24;
+        header.levels[i] = { readLE<uint64_t>(entry), readLE<uint64_t>(entry + 8), readLE<uint64_t>(entry + 16) };
+        if(header.levels[i].byteOffset + header.levels[i].byteLength > file.size()){
+            return false;}
+    }
+    return true;
+}
+
+
+bool isKtx2Readable(const Ktx2Header& header){
+    return header.supercompressionScheme == 0 || header.supercompressionScheme == kKtx2SupercompressionZstd;
+}
+
+
+VkDeviceSize Ktx2LevelLayout(const Ktx2Header& header, std::vector<VkDeviceSize>& levelOffsets){
+    levelOffsets.assign(header.levelCount, 0);
+    if(header.supercompressionScheme == 0){
+        uint64_t begin = UINT64_MAX, end = 0;
+        for(const auto& level : header.levels){
+            begin = std::min(begin, level.byteOffset);
+            end   = std::max(end, level.byteOffset + level.byteLength);    }
+        for(uint32_t i = 0; i < header.levelCount; ++i){
+            levelOffsets[i] = header.levels[i].byteOffset - begin;}
+        return header.levels.empty() ? 0 : end - begin;
+    }
+
+    VkDeviceSize offset = 0;
+    for(uint32_t i = header.levelCount; i-- > 0;){
+        levelOffsets[i] = offset;
+        offset = (offset + header.levels[i].uncompressedByteLength + 15) & ~VkDeviceSize(15);}
+    return offset;
+}
+
+
+bool ReadKtx2Levels(const MappedFile& file, const Ktx2Header& header, const std::vector<VkDeviceSize>& levelOffsets, uint8_t* dst,
+                    bool dstWriteCombined){
+    if(header.supercompressionScheme == 0){
+        for(uint32_t i = 0; i < header.levelCount; ++i){
+            std::memcpy(dst + levelOffsets[i], file.data() + header.levels[i].byteOffset,
+                        static_cast<size_t>(header.levels[i].byteLength));}
+        return true;
+    }
+    if(header.supercompressionScheme != kKtx2SupercompressionZstd) return false;
+
+    //every level is its own zstd frame. mip 0 is 3/4 of the data, so it goes first and the small ones fill in
+    std::atomic<bool> ok{true};
+    util::parallelFor(static_cast<int>(header.levelCount), 1, [&](int i){
+        const Ktx2Level& level = header.levels[i];
+        const size_t size = static_cast<size_t>(level.uncompressedByteLength);
+        //write combined only: not thread_local, mip 0 of a 2k cube is 200 MB, it should not stay around after the load
+        std::unique_ptr<uint8_t[]> scratch(dstWriteCombined ? new uint8_t[size] : nullptr);
+        uint8_t* out = dstWriteCombined ? scratch.get() : dst + levelOffsets[i];
+        const size_t written = ZSTD_decompress(out, size,
+                                               file.data() + level.byteOffset, static_cast<size_t>(level.byteLength));
+        if(ZSTD_isError(written) || written != size){
+            ok = false;
+            return;}
+        if(dstWriteCombined){
+            std::memcpy(dst + levelOffsets[i], scratch.get(), size);}
+    });
+    return ok;
+}
+
+
+bool ReadKtx2Level(const MappedFile& file, const Ktx2Header& header, uint32_t level, uint8_t* dst, size_t dstSize,
+                   bool dstWriteCombined){
+    if(level >= header.levelCount || header.levels[level].uncompressedByteLength != dstSize) return false;
+    const Ktx2Level& src = header.levels[level];
+    if(header.supercompressionScheme == 0){
+        if(src.byteLength != dstSize) return false;
+        std::memcpy(dst, file.data() + src.byteOffset, dstSize);
+        return true;
+    }
+    if(header.supercompressionScheme != kKtx2SupercompressionZstd) return false;
+
+    std::unique_ptr<uint8_t[]> scratch(dstWriteCombined ? new uint8_t[dstSize] : nullptr);
+    uint8_t* out = dstWriteCombined ? scratch.get() : dst;
+    const size_t written = ZSTD_decompress(out, dstSize, file.data() + src.byteOffset, static_cast<size_t>(src.byteLength));
+    if(ZSTD_isError(written) || written != dstSize) return false;
+    if(dstWriteCombined){
+        std::memcpy(dst, scratch.get(), dstSize);}
+    return true;
+}
+
+
+
+TextureConfig Ktx2TextureConfig(const Ktx2Header& header){
+    const bool isCube = (header.faceCount == 6);
+
+    TextureConfig config;
+    config.format       = header.vkFormat;
+    config.channels     = header.numComponents;
+    config.imageType    = VK_IMAGE_TYPE_2D;
+    config.usageFlags   = VK_IMAGE_USAGE_SAMPLED_BIT|VK_IMAGE_USAGE_TRANSFER_SRC_BIT|VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    config.createFlags  = isCube ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0u;
+    config.extent       = {header.pixelWidth, header.pixelHeight, 1};
+    config.mipLevels    = header.levelCount;
+    config.newLayout    = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    config.viewType     = isCube ? VK_IMAGE_VIEW_TYPE_CUBE : VK_IMAGE_VIEW_TYPE_2D;
+    config.arrayLayers  = isCube ? 6u : 1u;
+    return config;
+}
+
+
+
+VkDeviceSize Ktx2ReadbackRegions(VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t faceCount,
+                                 std::vector<VkBufferImageCopy>& regions){
+    const VkDeviceSize pixelBytes = static_cast<VkDeviceSize>(bytesPerPixel(format));
+
+    //one region per mip / face, tightly packed in the same order ktx2 stores them inside a level
+    regions.clear();
+    VkDeviceSize offset = 0;
+    for(uint32_t mip = 0; mip < mipLevels; ++mip){
+        const uint32_t w = std::max(1u, width >> mip);
+        const uint32_t h = std::max(1u, height >> mip);
+        const VkDeviceSize faceBytes = VkDeviceSize(w) * h * pixelBytes;
+
+        for(uint32_t face = 0; face < faceCount; ++face){
+            VkBufferImageCopy region{};
+            region.bufferOffset = offset;
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel = mip;
+            region.imageSubresource.baseArrayLayer = face;
+            region.imageSubresource.layerCount = 1;
+            region.imageOffset = {0, 0, 0};
+            region.imageExtent = {w, h, 1};
+            regions.push_back(region);
+            offset = (offset + faceBytes + 3) & ~VkDeviceSize(3); //bufferOffset must be 4 byte aligned
+        }
+    }
+    return offset;
+}
+
+
+void WriteKtx2FromReadback(const uint8_t* data, const std::vector<VkBufferImageCopy>& regions, VkFormat format,
+                           uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t faceCount, const std::string& path){
+    ktxTextureCreateInfo createInfo = {
+            .vkFormat         = static_cast<ktx_uint32_t>(format),
+            .baseWidth        = width,
+            .baseHeight       = height,
+            .baseDepth        = 1u,
+            .numDimensions    = 2u,
+            .numLevels        = mipLevels,
+            .numLayers        = 1u,
+            .numFaces         = faceCount,
+            .generateMipmaps  = KTX_FALSE,
+        };
+    ktxTexture2* outKtx = nullptr;
+    if(ktxTexture2_Create(&createInfo, KTX_TEXTURE_CREATE_ALLOC_STORAGE, &outKtx) != KTX_SUCCESS){
+        throw std::runtime_error("WriteImageToKtx2: ktxTexture2_Create failed for " + path);}
+
+    const size_t pixelBytes = bytesPerPixel(format);
+    for(const VkBufferImageCopy& region : regions){
+        const uint32_t mip  = region.imageSubresource.mipLevel;
+        const uint32_t face = region.imageSubresource.baseArrayLayer;
+        ktx_size_t ktxOffset = 0;
+        ktxTexture2_GetImageOffset(outKtx, mip, 0/*layer*/, face, &ktxOffset);
+        std::memcpy(outKtx->pData + ktxOffset, data + region.bufferOffset,
+                    size_t(region.imageExtent.width) * region.imageExtent.height * pixelBytes);
+    }
+
+    //levels are deflated one frame each, the loaders inflate them in parallel (ReadKtx2Levels)
+    if(ktxTexture2_DeflateZstd(outKtx, kKtx2ZstdLevel) != KTX_SUCCESS){
+        ktxTexture2_Destroy(outKtx);
+        throw std::runtime_error("WriteImageToKtx2: zstd deflate failed for " + path);}
+
+    const std::filesystem::path outPath(path);
+    if(outPath.has_parent_path()){
+        std::filesystem::create_directories(outPath.parent_path());}
+    const std::string tmpPath = path + ".tmp";
+    const KTX_error_code result = ktxTexture2_WriteToNamedFile(outKtx, tmpPath.c_str());
+    ktxTexture2_Destroy(outKtx);
+    if(result != KTX_SUCCESS || std::rename(tmpPath.c_str(), path.c_str()) != 0){
+        std::remove(tmpPath.c_str());
+        throw std::runtime_error("WriteImageToKtx2: failed to write " + path);}
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////////////
+//converted texture cache
+
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed){
+    //xxhash64 style: 4 independent lanes over 32 byte stripes, then fold + avalanche
+    constexpr uint64_t P1 = 0x9E3779B185EBCA87ull;
+    constexpr uint64_t P2 = 0xC2B2AE3D27D4EB4Full;
+    constexpr uint64_t P3 = 0x165667B19E3779F9ull;
+    auto rotl  = [](uint64_t v, int r){ return (v << r) | (v >> (64 - r)); };
+    auto mixLane = [&](uint64_t acc, uint64_t lane){ return rotl(acc + lane * P2, 31) * P1; };
+
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    const uint8_t* end = p + size;
+    uint64_t h;
+
+    if(size >= 32){
+        uint64_t v[4] = {seed + P1 + P2, seed + P2, seed, seed - P1};
+        for(; p + 32 <= end; p += 32){
+            for(int i = 0; i < 4; ++i) v[i] = mixLane(v[i], readLE<uint64_t>(p + i * 8));}
+        h = rotl(v[0], 1) + rotl(v[1], 7) + rotl(v[2], 12) + rotl(v[3], 18);
+        for(int i = 0; i < 4; ++i) h = (h ^ mixLane(0, v[i])) * P1 + P3;
+    }
+    else{
+        h = seed + P3;  }
+
+    h += static_cast<uint64_t>(size);
+    for(; p + 8 <= end; p += 8){
+        h = rotl(h ^ mixLane(0, readLE<uint64_t>(p)), 27) * P1 + P3;}
+    for(; p < end; ++p){
+        h = rotl(h ^ (*p * P3), 11) * P1;}
+
+    h ^= h >> 33;  h *= P2;
+    h ^= h >> 29;  h *= P3;
+    h ^= h >> 32;
+    return h;
+}
+
+
+
+uint64_t convertedCacheKey(const MappedFile& source, const std::string& params){
+    const uint64_t contentHash = hashBytes(source.data(), source.size());
+    return hashBytes(params.data(), params.size(), contentHash);
+}
+
+
+//bump when the equirect -> cube output changes (sampling, face layout, mip generation ...)
+static constexpr int kCubemapConversionVersion = 2;  //2: zstd cache files
+
+uint64_t equirectCubeCacheKey(const MappedFile& source, const char* method, uint32_t faceSize, VkFormat format){
+    const std::string params = "equirect->cube v" + std::to_string(kCubemapConversionVersion) + " " + method +
+                               " face=" + std::to_string(faceSize) + " format=" + std::to_string(format);
+    return convertedCacheKey(source, params);
+}
+
+
+std::string convertedCachePath(uint64_t key){
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.ktx2", static_cast<unsigned long long>(key));
+    return (std::filesystem::path(kTextureCacheDir) / name).string();
+}
+
+
+} // namespace TexUtils
+
+
+
+
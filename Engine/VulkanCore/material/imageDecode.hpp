@@ -0,0 +1,189 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <array>
+#include "../global.hpp"
+class JDevice;
+class JTextureBase;
+struct TextureConfig;
+
+
+
+//read only mmap of the whole file. pages come from page cache, no heap copy
+class MappedFile{
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+    NO_COPY(MappedFile);
+
+    const uint8_t* data() const         {return data_;}
+    size_t size() const                 {return size_;}
+    const std::string& path() const     {return path_;}
+
+private:
+    std::string     path_;
+    const uint8_t*  data_{nullptr};
+    size_t          size_{0};
+};
+
+
+
+//decode / parse / hash here have no vulkan calls (only its types). everything taking a JDevice
+//lives in imageUpload.cpp, so gpu-less tools (Tools/IBLBaker) can build this file alone
+namespace TexUtils{
+
+struct DecodeResult{
+    int  width{0};
+    int  height{0};
+    int  fileChannels{0};
+    bool inPlace{false};  //false: decoder used its own buffer and we copied once into dst
+};
+
+//header only
+bool queryImageInfo(const MappedFile& file, int& width, int& height, int& channels);
+
+//decode (anything stbi reads) straight into dst. dst is usually mapped staging memory.
+//stbi's output buffer allocation is redirected to dst when size matches, so no intermediate heap image.
+//dstSize must be width * height * desiredChannels * (isFloat ? 4 : 1)
+DecodeResult decodeInto(const MappedFile& file, int desiredChannels, bool isFloat, void* dst, size_t dstSize);
+
+//JRENDERER_LOAD_STATS=1: "DEBUG: <what>, peak RSS <n> MB" (getrusage) after a load. off by default, then it is
+//a cached flag check only
+void logLoadStats(const std::string& what);
+//same flag, for load / bake timing lines
+bool loadStatsEnabled();
+
+
+//---------------------------------------------------------------------------------------
+//Radiance .hdr (RGBE). header + scanline start offsets are read once, after that every scanline
+//decodes on its own, so rows go wide over threads. same output as stbi_loadf
+struct HdrInfo{
+    int  width{0};
+    int  height{0};
+    bool rle{true};                     //false: flat file, 4 bytes per pixel, no run length
+    std::vector<size_t> scanlines;      //file offset of each scanline, top row first
+};
+
+//false if it is not a radiance file, or one we cant index (old style rle, flipped orientation ...). use stbi then
+bool parseHdr(const MappedFile& file, HdrInfo& info);
+
+//scanline y -> width rgbe quads (rgbe must hold width * 4 bytes)
+void decodeHdrScanline(const MappedFile& file, const HdrInfo& info, int y, uint8_t* rgbe);
+
+//rgbe -> linear float, channels 3 or 4 (alpha 1). same math as stbi
+void rgbeToFloat(const uint8_t* rgbe, float* dst, int count, int channels);
+//2^(e - 136) for every exponent byte (0 -> 0): the value of a channel is mantissa byte * table[e]
+const std::array<float, 256>& rgbeScaleTable();
+
+//whole image, scanlines in parallel. rgbe: width * height * 4 bytes, a quarter of the float image
+void decodeHdrRGBE(const MappedFile& file, const HdrInfo& info, uint8_t* dst);
+//float: width * height * channels floats, written row by row, no intermediate image
+void decodeHdrFloat(const MappedFile& file, const HdrInfo& info, int channels, float* dst);
+
+
+//---------------------------------------------------------------------------------------
+//KTX2, parse header + level index ourselves so raw levels go straight from the mmapped file to staging
+//and zstd ones are inflated in parallel, instead of level after level in libktx
+struct Ktx2Level{
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+};
+
+struct Ktx2Header{
+    VkFormat    vkFormat;
+    uint32_t    typeSize;
+    uint32_t    pixelWidth;
+    uint32_t    pixelHeight;
+    uint32_t    pixelDepth;
+    uint32_t    layerCount;
+    uint32_t    faceCount;
+    uint32_t    levelCount;
+    uint32_t    supercompressionScheme;
+    uint32_t    numComponents;
+    std::vector<Ktx2Level> levels;
+};
+
+bool parseKtx2Header(const MappedFile& file, Ktx2Header& header);
+
+//what we write: every ktx2 we bake / cache is zstd supercompressed at this level. written once, read every start,
+//higher levels take seconds on a 2k cube for a few % on half float
+inline constexpr uint32_t kKtx2SupercompressionZstd = 2;     //KTX_SS_ZSTD
+inline constexpr int      kKtx2ZstdLevel            = 9;
+
+//raw or zstd: level data we can read without libktx
+bool isKtx2Readable(const Ktx2Header& header);
+//where every level lands once uncompressed, in one buffer (returns its size). raw files keep the file's own
+//layout, zstd levels are packed smallest mip first too, 16 byte aligned
+VkDeviceSize Ktx2LevelLayout(const Ktx2Header& header, std::vector<VkDeviceSize>& levelOffsets);
+//level data -> dst at those offsets (or any other per level offsets). zstd levels are inflated in parallel, one level a task,
+//straight into dst. dstWriteCombined: dst is mapped staging (host visible, not cached). zstd reads back what it already
+//wrote for its matches, very slow from that memory, so each level is inflated into a heap scratch and copied once.
+//false: unsupported scheme, or a level that is out of the file / does not inflate to its uncompressed size
+bool ReadKtx2Levels(const MappedFile& file, const Ktx2Header& header, const std::vector<VkDeviceSize>& levelOffsets, uint8_t* dst,
+                    bool dstWriteCombined = false);
+//one level only (dstSize = its uncompressed size), same rules. false: bad size / scheme / data
+bool ReadKtx2Level(const MappedFile& file, const Ktx2Header& header, uint32_t level, uint8_t* dst, size_t dstSize,
+                   bool dstWriteCombined = false);
+
+//config for a sampled texture that can hold the whole ktx file
+TextureConfig Ktx2TextureConfig(const Ktx2Header& header);
+
+//level data -> staging (one copy, from the mapping) -> image, then transition to shader read
+void UploadKtx2ToTexture(JDevice& device, const MappedFile& file, const Ktx2Header& header, JTextureBase& dstTex);
+//same for any image that has all levels / faces of the file. image must be in TRANSFER_DST_OPTIMAL
+void UploadKtx2ToImage(JDevice& device, const MappedFile& file, const Ktx2Header& header, VkImage image);
+
+//read every mip / face of a color image back and write it as zstd ktx2 (faceCount 6 = cubemap).
+//image is in `layout` (last used at `stage`) and goes back to it afterwards.
+//written to path + ".tmp" first then renamed, so a crash never leaves half a file behind
+void WriteImageToKtx2(JDevice& device, VkImage image, VkFormat format,
+                      uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t faceCount,
+                      VkImageLayout layout, VkPipelineStageFlags stage, const std::string& path);
+
+//the two halves of WriteImageToKtx2, for when the copy is recorded into some other submit (eg. a compute queue bake):
+//regions that pack every mip / face into one buffer (returns its size), then that buffer -> ktx2 file
+VkDeviceSize Ktx2ReadbackRegions(VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t faceCount,
+                                 std::vector<VkBufferImageCopy>& regions);
+void WriteKtx2FromReadback(const uint8_t* data, const std::vector<VkBufferImageCopy>& regions, VkFormat format,
+                           uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t faceCount, const std::string& path);
+
+//one mip of every face back to the host, faces tightly packed one after another. width / height are of mip 0.
+//same layout contract as WriteImageToKtx2
+std::vector<uint8_t> ReadImageLevel(JDevice& device, VkImage image, VkFormat format,
+                                    uint32_t width, uint32_t height, uint32_t mip, uint32_t faceCount,
+                                    VkImageLayout layout, VkPipelineStageFlags stage);
+
+
+//---------------------------------------------------------------------------------------
+//converted texture cache. results of slow conversions (eg. hdr equirect -> cube + mips) go to
+//kTextureCacheDir as ktx2, named by a hash of the source file content + the conversion params.
+//changing either one gives a new name, stale files are just never read again
+inline constexpr const char* kTextureCacheDir = "../cache/textures";
+
+//64 bit, not cryptographic. several GB/s, a 1k hdr takes well under a ms
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 0);
+
+//hash of the source file content + conversion params, names the cache file
+uint64_t convertedCacheKey(const MappedFile& source, const std::string& params);
+//equirect -> cube (JCubemap::cacheKey / getContentHash). method tells cpu / gpu conversion apart
+uint64_t equirectCubeCacheKey(const MappedFile& source, const char* method, uint32_t faceSize, VkFormat format);
+//kTextureCacheDir/<key>.ktx2. the file may not exist yet
+std::string convertedCachePath(uint64_t key);
+
+
+namespace detail{
+//stbi allocator hooks, see STBI_MALLOC in load_texture.cpp
+void* stbiMalloc(size_t size);
+void* stbiRealloc(void* ptr, size_t newSize);
+void  stbiFree(void* ptr);
+}
+
+} // namespace TexUtils
+
+
+
+
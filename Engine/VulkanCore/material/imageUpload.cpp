@@ -0,0 +1,163 @@
+//the part of TexUtils that talks to a JDevice: uploads and readbacks.
+//imageDecode.cpp has no vulkan calls, so tools without a gpu (Tools/IBLBaker) can build it alone
+#include "imageDecode.hpp"
+#include <cstring>
+#include <algorithm>
+#include "load_texture.hpp"
+#include "../buffer.hpp"
+#include "../device.hpp"
+#include "../commandBuffer.hpp"
+
+
+namespace TexUtils{
+
+
+
+void UploadKtx2ToTexture(JDevice& device, const MappedFile& file, const Ktx2Header& header, JTextureBase& dstTex){
+    UploadKtx2ToImage(device, file, header, dstTex.textureImage());
+}
+
+
+
+void UploadKtx2ToImage(JDevice& device, const MappedFile& file, const Ktx2Header& header, VkImage image){
+    if(!isKtx2Readable(header)){
+        throw std::runtime_error("UploadKtx2ToImage: basis / zlib ktx2 is not raw, use libktx path: " + file.path());}
+
+    std::vector<VkDeviceSize> levelOffsets;
+    const VkDeviceSize dataSize = Ktx2LevelLayout(header, levelOffsets);
+
+    //the only host copy: mapped file pages (raw) or the inflated levels (zstd) -> mapped staging
+    JBuffer stagingBuffer(device, dataSize,
+                          VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    void* mapped = nullptr;
+    vkMapMemory(device.device(), stagingBuffer.bufferMemory(), 0, stagingBuffer.getSize(), 0, &mapped);
+    const bool read = ReadKtx2Levels(file, header, levelOffsets, static_cast<uint8_t*>(mapped), true);
+    vkUnmapMemory(device.device(), stagingBuffer.bufferMemory());
+    if(!read){
+        throw std::runtime_error("UploadKtx2ToImage: broken level data in " + file.path());}
+
+    //inside a level: layer -> face -> image, all same size
+    const uint32_t faceCount = std::max(1u, header.faceCount);
+    std::vector<VkBufferImageCopy> regions;
+    regions.reserve(header.levelCount * faceCount);
+
+    for(uint32_t level = 0; level < header.levelCount; ++level){
+        const uint32_t w = std::max(1u, header.pixelWidth >> level);
+        const uint32_t h = std::max(1u, header.pixelHeight >> level);
+        const VkDeviceSize faceBytes = header.levels[level].uncompressedByteLength / faceCount;
+
+        for(uint32_t face = 0; face < faceCount; ++face){
+            VkBufferImageCopy region{};
+            region.bufferOffset = levelOffsets[level] + faceBytes * face;
+            region.bufferRowLength = 0;
+            region.bufferImageHeight = 0;
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel = level;
+            region.imageSubresource.baseArrayLayer = face;
+            region.imageSubresource.layerCount = 1;
+            region.imageOffset = {0, 0, 0};
+            region.imageExtent = { w, h, 1 };
+            regions.push_back(region);        }
+    }
+
+    JCommandBuffer cmd(device, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+    cmd.beginSingleTimeCommands();
+
+    vkCmdCopyBufferToImage(cmd.getCommandBuffer(),
+                           stagingBuffer.buffer(),
+                           image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           static_cast<uint32_t>(regions.size()),
+                           regions.data());
+
+    device.transitionImageLayout(cmd.getCommandBuffer(), image,
+                                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                                 VK_IMAGE_ASPECT_COLOR_BIT, header.levelCount, faceCount);
+
+    cmd.endSingleTimeCommands(device.graphicsQueue());
+}
+
+
+
+void WriteImageToKtx2(JDevice& device, VkImage image, VkFormat format,
+                      uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t faceCount,
+                      VkImageLayout layout, VkPipelineStageFlags stage, const std::string& path){
+    std::vector<VkBufferImageCopy> regions;
+    const VkDeviceSize bytes = Ktx2ReadbackRegions(format, width, height, mipLevels, faceCount, regions);
+
+    JBuffer stagingBuffer(device, bytes,
+                          VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    JCommandBuffer cmd(device, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+    cmd.beginSingleTimeCommands();
+    device.transitionImageLayout(cmd.getCommandBuffer(), image,
+                                 layout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                 stage, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 VK_IMAGE_ASPECT_COLOR_BIT, mipLevels, faceCount);
+    vkCmdCopyImageToBuffer(cmd.getCommandBuffer(), image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           stagingBuffer.buffer(), static_cast<uint32_t>(regions.size()), regions.data());
+    device.transitionImageLayout(cmd.getCommandBuffer(), image,
+                                 VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, layout,
+                                 VK_PIPELINE_STAGE_TRANSFER_BIT, stage,
+                                 VK_IMAGE_ASPECT_COLOR_BIT, mipLevels, faceCount);
+    cmd.endSingleTimeCommands(device.graphicsQueue());
+
+    stagingBuffer.map();
+    WriteKtx2FromReadback(reinterpret_cast<const uint8_t*>(stagingBuffer.getBufferMapped()), regions,
+                          format, width, height, mipLevels, faceCount, path);
+    stagingBuffer.unmap();
+}
+
+
+
+std::vector<uint8_t> ReadImageLevel(JDevice& device, VkImage image, VkFormat format,
+                                    uint32_t width, uint32_t height, uint32_t mip, uint32_t faceCount,
+                                    VkImageLayout layout, VkPipelineStageFlags stage){
+    const uint32_t w = std::max(1u, width >> mip);
+    const uint32_t h = std::max(1u, height >> mip);
+    const VkDeviceSize bytes = VkDeviceSize(w) * h * bytesPerPixel(format) * faceCount;
+
+    JBuffer stagingBuffer(device, bytes,
+                          VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    //all layers of the mip in one region, they land one after another in the buffer
+    VkBufferImageCopy region{};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = mip;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = faceCount;
+    region.imageExtent = {w, h, 1};
+
+    //transitionImageLayout always starts at mip 0, so 0..mip go to transfer src and back
+    JCommandBuffer cmd(device, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+    cmd.beginSingleTimeCommands();
+    device.transitionImageLayout(cmd.getCommandBuffer(), image,
+                                 layout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                 stage, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 VK_IMAGE_ASPECT_COLOR_BIT, mip + 1, faceCount);
+    vkCmdCopyImageToBuffer(cmd.getCommandBuffer(), image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           stagingBuffer.buffer(), 1, &region);
+    device.transitionImageLayout(cmd.getCommandBuffer(), image,
+                                 VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, layout,
+                                 VK_PIPELINE_STAGE_TRANSFER_BIT, stage,
+                                 VK_IMAGE_ASPECT_COLOR_BIT, mip + 1, faceCount);
+    cmd.endSingleTimeCommands(device.graphicsQueue());
+
+    std::vector<uint8_t> texels(static_cast<size_t>(bytes));
+    stagingBuffer.map();
+    std::memcpy(texels.data(), stagingBuffer.getBufferMapped(), texels.size());
+    stagingBuffer.unmap();
+    return texels;
+}
+
+
+
+} // namespace TexUtils
+
+
+
+
@@ -1,4 +1,9 @@
 #include "load_texture.hpp"
+#include "imageDecode.hpp"
+//stbi output buffers can land in mapped staging memory, see TexUtils::decodeInto
+#define STBI_MALLOC(sz)         TexUtils::detail::stbiMalloc(sz)
+#define STBI_REALLOC(p, newsz)  TexUtils::detail::stbiRealloc(p, newsz)
+#define STBI_FREE(p)            TexUtils::detail::stbiFree(p)
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 #define STB_IMAGE_WRITE_IMPLEMENTATION
@@ -7,9 +12,88 @@
 #include "../buffer.hpp"
 #include "../device.hpp"
 #include "../commandBuffer.hpp"
+#include "../descriptor/descriptorSetCache.hpp"
+#include "../../Renderers/precomputeCommon.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
 
 
 ///////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+inline void hashCombine(size_t& seed, size_t value){
+    seed ^= value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+}
+
+//fields that dont matter are reset, so they dont create a new sampler
+VkSamplerCreateInfo normalizeSamplerInfo(const VkSamplerCreateInfo& info){
+    VkSamplerCreateInfo key = info;
+    key.pNext = nullptr;
+    if(!key.anisotropyEnable){ key.maxAnisotropy = 1.0f; }
+    if(!key.compareEnable){ key.compareOp = VK_COMPARE_OP_ALWAYS; }
+    return key;
+}
+
+//single channel 8 bit, bilinear with texel centres lined up. brings the ORM sources to one size
+std::vector<uint8_t> resampleGrey(const uint8_t* src, int srcW, int srcH, int dstW, int dstH){
+    std::vector<uint8_t> dst(static_cast<size_t>(dstW) * dstH);
+    const float scaleX = static_cast<float>(srcW) / dstW;
+    const float scaleY = static_cast<float>(srcH) / dstH;
+    for(int y = 0; y < dstH; ++y){
+        const float fy = std::clamp((y + 0.5f) * scaleY - 0.5f, 0.0f, static_cast<float>(srcH - 1));
+        const int   y0 = static_cast<int>(fy);
+        const int   y1 = std::min(y0 + 1, srcH - 1);
+        const float ty = fy - y0;
+        for(int x = 0; x < dstW; ++x){
+            const float fx = std::clamp((x + 0.5f) * scaleX - 0.5f, 0.0f, static_cast<float>(srcW - 1));
+            const int   x0 = static_cast<int>(fx);
+            const int   x1 = std::min(x0 + 1, srcW - 1);
+            const float tx = fx - x0;
+            const float top    = src[y0 * srcW + x0] * (1.0f - tx) + src[y0 * srcW + x1] * tx;
+            const float bottom = src[y1 * srcW + x0] * (1.0f - tx) + src[y1 * srcW + x1] * tx;
+            dst[static_cast<size_t>(y) * dstW + x] = static_cast<uint8_t>(top * (1.0f - ty) + bottom * ty + 0.5f);
+        }
+    }
+    return dst;
+}
+}
+
+size_t SamplerInfoHash::operator()(const VkSamplerCreateInfo& info) const{
+    size_t seed = 0;
+    hashCombine(seed, info.flags);
+    hashCombine(seed, info.magFilter);
+    hashCombine(seed, info.minFilter);
+    hashCombine(seed, info.mipmapMode);
+    hashCombine(seed, info.addressModeU);
+    hashCombine(seed, info.addressModeV);
+    hashCombine(seed, info.addressModeW);
+    hashCombine(seed, std::hash<float>{}(info.mipLodBias));
+    hashCombine(seed, info.anisotropyEnable);
+    hashCombine(seed, std::hash<float>{}(info.maxAnisotropy));
+    hashCombine(seed, info.compareEnable);
+    hashCombine(seed, info.compareOp);
+    hashCombine(seed, std::hash<float>{}(info.minLod));
+    hashCombine(seed, std::hash<float>{}(info.maxLod));
+    hashCombine(seed, info.borderColor);
+    hashCombine(seed, info.unnormalizedCoordinates);
+    return seed;
+}
+
+bool SamplerInfoEqual::operator()(const VkSamplerCreateInfo& a, const VkSamplerCreateInfo& b) const{
+    return a.flags == b.flags &&
+           a.magFilter == b.magFilter && a.minFilter == b.minFilter && a.mipmapMode == b.mipmapMode &&
+           a.addressModeU == b.addressModeU && a.addressModeV == b.addressModeV && a.addressModeW == b.addressModeW &&
+           a.mipLodBias == b.mipLodBias &&
+           a.anisotropyEnable == b.anisotropyEnable && a.maxAnisotropy == b.maxAnisotropy &&
+           a.compareEnable == b.compareEnable && a.compareOp == b.compareOp &&
+           a.minLod == b.minLod && a.maxLod == b.maxLod &&
+           a.borderColor == b.borderColor &&
+           a.unnormalizedCoordinates == b.unnormalizedCoordinates;
+}
+
+
+
 SamplerManager::SamplerManager(JDevice& device):
     device_app(device)
 {
@@ -17,6 +101,7 @@ SamplerManager::SamplerManager(JDevice& device):
     VkPhysicalDeviceProperties properties{};
     vkGetPhysicalDeviceProperties(device_app.physicalDevice(), &properties);
     maxSamplerAnisotropy_ = properties.limits.maxSamplerAnisotropy;
+    maxSamplerAllocationCount_ = properties.limits.maxSamplerAllocationCount;
     initDefault();
 }
 
@@ -32,18 +117,41 @@ void SamplerManager::initDefault(){
 
 
 void SamplerManager::destroy(){
-    //destroy default samplers
-    for(auto& pair:defaultSamplers_){
+    //default and customized ones are only names of cached samplers
+    for(auto& pair: samplers_){
         vkDestroySampler(device_app.device(), pair.second, nullptr);   }
+    samplers_.clear();
     defaultSamplers_.clear();
-    //destory customized samplers. dont need to check if it has something already
-    for(auto& pair: customSamplers_){
-        vkDestroySampler(device_app.device(), pair.second, nullptr);   }
     customSamplers_.clear();
 }
 
-void SamplerManager::addSampler(const std::string& name, VkSampler newSampler){
-    customSamplers_[name] = newSampler;
+
+VkSampler SamplerManager::getOrCreate(const VkSamplerCreateInfo& samplerInfo){
+    if(samplerInfo.pNext != nullptr){
+        throw std::runtime_error("SamplerManager: sampler create info with pNext chain is not supported");}
+
+    const VkSamplerCreateInfo key = normalizeSamplerInfo(samplerInfo);
+    auto found = samplers_.find(key);
+    if(found != samplers_.end()){
+        return found->second;   }
+
+    if(samplers_.size() >= maxSamplerAllocationCount_){
+        throw std::runtime_error("SamplerManager: reached maxSamplerAllocationCount (" + std::to_string(maxSamplerAllocationCount_) + ")");}
+
+    VkSampler sampler;
+    if (vkCreateSampler(device_app.device(), &key, nullptr, &sampler) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create sampler!");         }
+    samplers_.emplace(key, sampler);
+
+    std::cout << "DEBUG: sampler cache " << samplers_.size() << " / " << maxSamplerAllocationCount_ << std::endl;
+    return sampler;
+}
+
+
+VkSampler SamplerManager::addSampler(const std::string& name, const VkSamplerCreateInfo& samplerInfo){
+    VkSampler sampler = getOrCreate(samplerInfo);
+    customSamplers_[name] = sampler;
+    return sampler;
 }
 
 
@@ -53,10 +161,7 @@ VkSampler SamplerManager::build(SamplerType samplerType){
             {auto samplerInfo = SamplerCreateInfoBuilder()
                                 .maxAnisotropy(maxSamplerAnisotropy_)
                                 .getInfo();
-            VkSampler sampler_;
-            if (vkCreateSampler(device_app.device(), &samplerInfo, nullptr, &sampler_) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create TextureGlobal sampler!");         }
-            return sampler_;
+            return getOrCreate(samplerInfo);
             break;}
 
         
@@ -66,10 +171,7 @@ VkSampler SamplerManager::build(SamplerType samplerType){
                                 .compareOp(VK_COMPARE_OP_NEVER)
                                 .maxAnisotropy(maxSamplerAnisotropy_)
                                 .getInfo();
-            VkSampler sampler_;
-            if (vkCreateSampler(device_app.device(), &samplerInfo, nullptr, &sampler_) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create Skybox_LinearClamp sampler!");         }
-            return sampler_;
+            return getOrCreate(samplerInfo);
             break;}
         
         default:
@@ -125,19 +227,14 @@ JTextureBase::JTextureBase(JDevice& device, TextureConfig& textureConfig):
 
 
 JTextureBase:: ~JTextureBase(){
-    if(customSampler_){
-        vkDestroySampler(device_app.device(), *customSampler_, nullptr);
-    }
+    JDescriptorSetCache::imageViewDestroyed(textureBaseImageView_);
     vkDestroyImageView(device_app.device(), textureBaseImageView_, nullptr);
     vkDestroyImage(device_app.device(), textureBaseImage_, nullptr);
     vkFreeMemory(device_app.device(), textureBaseImageMemory_, nullptr);
 }
 
-void JTextureBase::createCustomSampler(const VkSamplerCreateInfo& samplerInfo){
-    VkSampler tempSampler = VK_NULL_HANDLE;
-    if (vkCreateSampler(device_app.device(), &samplerInfo, nullptr, &tempSampler) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create customized sampler!"); }
-        customSampler_ = tempSampler;
+void JTextureBase::createCustomSampler(SamplerManager& samplerManager, const VkSamplerCreateInfo& samplerInfo){
+    customSampler_ = samplerManager.getOrCreate(samplerInfo);
 }
 
 
@@ -157,14 +254,16 @@ VkImageView JTextureBase::switchViewForMip(uint32_t selectMip, VkImageViewType v
 
 
 void JTextureBase::createTextureBase(){
-    auto imageInfo = ImageCreateInfoBuilder(texWidth, texHeight)
+    auto imageBuilder = ImageCreateInfoBuilder(texWidth, texHeight)
                     .imageType(config_.imageType)
                     .format(config_.format)
                     .arrayLayers(config_.arrayLayers)
                     .mipLevels(mipLevels_)
                     .flags(config_.createFlags)
-                    .usage(config_.usageFlags)
-                    .getInfo();
+                    .usage(config_.usageFlags);
+    if(config_.computeShared){
+        imageBuilder.queueFamilies(device_app.computeSharingFamilies());}
+    auto imageInfo = imageBuilder.getInfo();
     if(device_app.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureBaseImage_, textureBaseImageMemory_)!=VK_SUCCESS){
         throw std::runtime_error("Failed to create VkImage for Texture Base");
     };
@@ -180,6 +279,9 @@ void JTextureBase::createTextureBase(){
         throw std::runtime_error("Failed to create VkImageView for Texture Base");
     };
 
+    //left UNDEFINED, whoever fills it first transitions it in its own submit (no data upload then)
+    if(!config_.transitionOnCreate) return;
+
     //transition image layout for all
     JCommandBuffer commandBuffer(device_app, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
     commandBuffer.beginSingleTimeCommands();
@@ -191,14 +293,17 @@ void JTextureBase::createTextureBase(){
 
     commandBuffer.endSingleTimeCommands(device_app.graphicsQueue());
 
-    if(config_.data){ //if user provide data
+    if(config_.data || config_.writeData){ //if user provide data
         VkDeviceSize imageSize = texWidth * texHeight * bytesPerPixel(config_.format) * config_.arrayLayers;
         JBuffer stagingBuffer(device_app, imageSize, 
             VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT|VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
         
         void* dstData;
         vkMapMemory(device_app.device(), stagingBuffer.bufferMemory(), 0, stagingBuffer.getSize(), 0, &dstData);
-        memcpy(dstData, *config_.data, static_cast<size_t>(imageSize));
+        if(config_.writeData){
+            config_.writeData(dstData); }
+        else{
+            memcpy(dstData, *config_.data, static_cast<size_t>(imageSize)); }
         vkUnmapMemory(device_app.device(), stagingBuffer.bufferMemory());
         
         commandBuffer.beginSingleTimeCommands();
@@ -247,6 +352,15 @@ void JTextureBase::copyBufferToImage(VkCommandBuffer commandBuffer,VkBuffer buff
  void JTextureBase::generateMipmaps(VkImage image, VkFormat imageFormat, 
                       int32_t texWidth, int32_t texHeight, 
                       uint32_t mipLevels, uint32_t layerCount){
+    VkCommandBuffer commandBuffer = util::beginSingleTimeCommands(device_app.device(), device_app.getCommandPool());
+    recordMipmaps(commandBuffer, image, imageFormat, texWidth, texHeight, mipLevels, layerCount);
+    util::endSingleTimeCommands(device_app.device(), commandBuffer, device_app.getCommandPool(), device_app.graphicsQueue());
+}
+
+
+void JTextureBase::recordMipmaps(VkCommandBuffer commandBuffer, VkImage image, VkFormat imageFormat,
+                      int32_t texWidth, int32_t texHeight,
+                      uint32_t mipLevels, uint32_t layerCount){
 
     VkFormatProperties formatProperties;
     vkGetPhysicalDeviceFormatProperties(device_app.physicalDevice(), imageFormat, &formatProperties);
@@ -254,8 +368,6 @@ void JTextureBase::copyBufferToImage(VkCommandBuffer commandBuffer,VkBuffer buff
     if(!(formatProperties.optimalTilingFeatures&VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)){
         throw std::runtime_error("texture image format does not support linear blitting!"); }
     
-    VkCommandBuffer commandBuffer = util::beginSingleTimeCommands(device_app.device(), device_app.getCommandPool());
-    
     VkImageMemoryBarrier barrier{};
     barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
     barrier.image = image;
@@ -328,8 +440,6 @@ void JTextureBase::copyBufferToImage(VkCommandBuffer commandBuffer,VkBuffer buff
             0, nullptr,
             0, nullptr,
             1, &barrier );
-
-    util::endSingleTimeCommands(device_app.device(), commandBuffer, device_app.getCommandPool(), device_app.graphicsQueue());
 }
 
 
@@ -344,18 +454,25 @@ void JTextureBase::copyBufferToImage(VkCommandBuffer commandBuffer,VkBuffer buff
 JTexture2D::JTexture2D(JDevice& device, const std::string& path, VkFormat format):
      JTextureBase(device)
 {
-    config_ = createConfig(path, format);
-    createTextureImage();
+    MappedFile file(path);
+    config_ = createConfig(file, format);
+    createTextureImage(file);
     createTextureImageView();
 }
 
-TextureConfig JTexture2D::createConfig(const std::string& path, VkFormat format){
-    //here can read data directly
-    pixels_ = stbi_load(path.data(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+TextureConfig JTexture2D::createConfig(const MappedFile& file, VkFormat format){
+    //decode to exactly the channels of the vkformat, so single channel maps can be R8 / R8G8
+    const int desiredChannels = bytesPerPixel(format);
+    if(desiredChannels == 3){
+        throw std::runtime_error("3 channels 8bit format is not supported for sampled image, use R8G8B8A8");}
+
+    //header only, pixels are decoded later straight into staging
+    int fileChannels;
+    if(!TexUtils::queryImageInfo(file, texWidth, texHeight, fileChannels)){
+        throw std::runtime_error("failed to load texture image: " + file.path());}
+    texChannels = desiredChannels;
     
     mipLevels_ = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight))))+1;
-    if (!pixels_) {
-        throw std::runtime_error("failed to load texture image!");}
 
     TextureConfig config;
     config.imageType        = VK_IMAGE_TYPE_2D;
@@ -370,19 +487,18 @@ TextureConfig JTexture2D::createConfig(const std::string& path, VkFormat format)
 }
 
 
-void JTexture2D::createTextureImage(){
+void JTexture2D::createTextureImage(const MappedFile& file){
 
-    VkDeviceSize imageSize = texWidth * texHeight * 4; // Always 4 channels due to STBI_rgb_alpha; 
-    //if i fill in texchannels not correct, fill in bytesperpixel(by vkformat) still not correct, need to investigate later
+    VkDeviceSize imageSize = texWidth * texHeight * texChannels; // stbi decoded to the vkformat channels
     JBuffer stagingBuffer(device_app, imageSize, 
         VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT|VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
 
     void* data;
     vkMapMemory(device_app.device(), stagingBuffer.bufferMemory(), 0, stagingBuffer.getSize(), 0, &data);
-    memcpy(data, pixels_, static_cast<size_t>(imageSize));
+    auto decoded = TexUtils::decodeInto(file, texChannels, false, data, static_cast<size_t>(imageSize));
     vkUnmapMemory(device_app.device(), stagingBuffer.bufferMemory());
-    stbi_image_free(pixels_);
+    TexUtils::logLoadStats("texture " + file.path() + (decoded.inPlace ? " decoded in place" : " decoded with one copy"));
 
     auto imageInfo = ImageCreateInfoBuilder(texWidth, texHeight)
                 .mipLevels(mipLevels_)
@@ -433,6 +549,97 @@ JTexture2D::~JTexture2D(){
 
 
 
+JORMTexture::JORMTexture(JDevice& device,
+                         const std::string& occlusionPath,
+                         const std::string& roughnessPath,
+                         const std::string& metallicPath,
+                         float occlusion, float roughness, float metallic):
+    JTextureBase(device)
+{
+    const std::string* paths[3] = {&occlusionPath, &roughnessPath, &metallicPath};
+    const float constants[3]    = {occlusion, roughness, metallic};
+
+    //read every source as grey. sizes can differ (eg. half res ao), the smaller ones are resampled to the largest
+    stbi_uc* sources[3] = {nullptr, nullptr, nullptr};
+    int widths[3] = {0, 0, 0}, heights[3] = {0, 0, 0};
+    int width = 0, height = 0;
+    for(int i = 0; i < 3; ++i){
+        if(paths[i]->empty()) continue;
+        int& w = widths[i];
+        int& h = heights[i];
+        int c;
+        std::unique_ptr<MappedFile> file;
+        try{
+            file = std::make_unique<MappedFile>(*paths[i]);
+        }catch(...){
+            for(auto* src : sources){ if(src) stbi_image_free(src); }
+            throw;  }
+        sources[i] = stbi_load_from_memory(file->data(), static_cast<int>(file->size()), &w, &h, &c, STBI_grey);
+        if(!sources[i]){
+            for(auto* src : sources){ if(src) stbi_image_free(src); }
+            throw std::runtime_error("failed to load ORM source image: " + *paths[i]);}
+        width  = std::max(width, w);
+        height = std::max(height, h);
+    }
+    if(width == 0){ width = 4; height = 4; } //nothing loaded, just constant
+
+    std::vector<uint8_t> resampled[3];
+    const uint8_t* channels[3] = {sources[0], sources[1], sources[2]};
+    for(int i = 0; i < 3; ++i){
+        if(!sources[i] || (widths[i] == width && heights[i] == height)) continue;
+        std::cout << "warning: " << *paths[i] << " is " << widths[i] << "x" << heights[i]
+                  << ", resampled to " << width << "x" << height << " for the ORM texture" << std::endl;
+        resampled[i] = resampleGrey(sources[i], widths[i], heights[i], width, height);
+        channels[i]  = resampled[i].data();
+        stbi_image_free(sources[i]);
+        sources[i] = nullptr;
+    }
+
+    const size_t totalPixels = static_cast<size_t>(width) * height;
+
+    texWidth    = width;
+    texHeight   = height;
+    texChannels = 4;
+    mipLevels_  = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight))))+1;
+
+    config_.imageType   = VK_IMAGE_TYPE_2D;
+    config_.viewType    = VK_IMAGE_VIEW_TYPE_2D;
+    config_.format      = VK_FORMAT_R8G8B8A8_UNORM;
+    config_.channels    = 4;
+    config_.extent      = {static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1};
+    config_.mipLevels   = mipLevels_;
+    config_.arrayLayers = 1;
+    config_.usageFlags  = VK_IMAGE_USAGE_TRANSFER_DST_BIT|VK_IMAGE_USAGE_TRANSFER_SRC_BIT|VK_IMAGE_USAGE_SAMPLED_BIT;
+    config_.newLayout   = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    //pack straight into the mapped staging memory
+    config_.writeData   = [&](void* dst){
+        uint8_t* packed = static_cast<uint8_t*>(dst);
+        for(int c = 0; c < 3; ++c){
+            const uint8_t value = static_cast<uint8_t>(constants[c] * 255.0f);
+            for(size_t i = 0; i < totalPixels; ++i){
+                packed[i * 4 + c] = channels[c] ? channels[c][i] : value;  }
+        }
+        for(size_t i = 0; i < totalPixels; ++i){ packed[i * 4 + 3] = 255; }
+    };
+
+    try{
+        createTextureBase();
+    }catch(...){
+        for(auto* src : sources){ if(src) stbi_image_free(src); }
+        throw;  }
+    config_.writeData = nullptr; //sources are gone after this
+    for(auto* src : sources){ if(src) stbi_image_free(src); }
+}
+
+
+JORMTexture::~JORMTexture(){
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////
+
+
+
 //create 2dTexture automatically from path
 JSolidColor::JSolidColor(JDevice& device, float r, float g, float b):
      JTextureBase(device)
@@ -453,16 +660,10 @@ void JSolidColor::generateData(float r, float g, float b){
     uint8_t green = static_cast<uint8_t>(g* 255.0f);
     uint8_t blue  = static_cast<uint8_t>(b* 255.0f);
 
-    int totalPixels = texWidth*texHeight;
-    int totalBytes = totalPixels * texChannels;
+    int totalBytes = texWidth * texHeight * texChannels;
 
     pixels_ = new uint8_t[totalBytes];
-
-    for(int i = 0; i < totalPixels; ++i){
-        pixels_[i * texChannels + 0] = red;
-        pixels_[i * texChannels + 1] = green;
-        pixels_[i * texChannels + 2] = blue;      
-        pixels_[i * texChannels + 3] = 255.0f;   }
+    fillPixels(JBitmapView<eJBitmapFormat_UnsignedByte, 4>(pixels_, texWidth, texHeight), {red, green, blue, 255});
 }
 
 
@@ -557,7 +758,9 @@ JTexture::JTexture(const std::string& path, JDevice& device):
 
 
 JTexture::~JTexture(){  //order is important
-    vkDestroySampler(device_app.device(), textureSampler_, nullptr);
+    if(ownsSampler_){
+        vkDestroySampler(device_app.device(), textureSampler_, nullptr);}
+    JDescriptorSetCache::imageViewDestroyed(textureImageView_);
     vkDestroyImageView(device_app.device(), textureImageView_, nullptr);
     vkDestroyImage(device_app.device(), textureImage_, nullptr);
     vkFreeMemory(device_app.device(), textureImageMemory_, nullptr);
@@ -575,21 +778,19 @@ void JTexture::createDescriptorInfo(){
 
 void JTexture::createTextureImage(const std::string& path, JDevice& device_app) {
     // int texWidth, texHeight, texChannels;
-    stbi_uc* pixels = stbi_load(path.data(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+    MappedFile file(path);
+    if (!TexUtils::queryImageInfo(file, texWidth, texHeight, texChannels)) {
+        throw std::runtime_error("failed to load texture image!");}
     VkDeviceSize imageSize = texWidth * texHeight * 4; // 4 channels, integer, so each channel 1 byte
     mipLevels_ = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight))))+1;
 
-    if (!pixels) {
-        throw std::runtime_error("failed to load texture image!");}
-
 
     JBuffer stagingBuffer(device_app, imageSize, 
                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT|VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
     void* data;
     vkMapMemory(device_app.device(), stagingBuffer.bufferMemory(), 0, stagingBuffer.getSize(), 0, &data);
-    memcpy(data, pixels, static_cast<size_t>(imageSize));
+    TexUtils::decodeInto(file, STBI_rgb_alpha, false, data, static_cast<size_t>(imageSize));
     vkUnmapMemory(device_app.device(), stagingBuffer.bufferMemory());
-    stbi_image_free(pixels);
 
     auto imageInfo = ImageCreateInfoBuilder(texWidth, texHeight)
                     .mipLevels(mipLevels_)
@@ -771,14 +972,64 @@ void JTexture::createTextureSampler() {
      ----Cube Map-----
 
     ------------------*/
-JCubemap::JCubemap(const std::string& path, JDevice& device):
+JCubemap::JCubemap(const std::string& path, JDevice& device, SamplerManager& samplerManager):
     JTexture(device)
 {
     createCubemapImage(path, device_app);
     createCubemapImageView();
-    createCubemapSampler();
+    createCubemapSampler(samplerManager);
+    createDescriptorInfo();
+
+}
+
+
+
+JCubemap::JCubemap(JDevice& device, SamplerManager& samplerManager, uint32_t faceSize, VkFormat format, bool transition):
+    JTexture(device)
+{
+    cubemapFormat_ = format;
+    texWidth = static_cast<int>(faceSize);
+    texHeight = static_cast<int>(faceSize);
+    texChannels = 4;
+    mipLevels_ = static_cast<uint32_t>(std::floor(std::log2(faceSize)))+1;
+
+    auto imageInfo = ImageCreateInfoBuilder(texWidth, texHeight)
+                    .mipLevels(mipLevels_)
+                    .arrayLayers(6)
+                    .format(cubemapFormat_)
+                    .flags(VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT)
+                    .usage(VK_IMAGE_USAGE_STORAGE_BIT|VK_IMAGE_USAGE_SAMPLED_BIT|VK_IMAGE_USAGE_TRANSFER_SRC_BIT|VK_IMAGE_USAGE_TRANSFER_DST_BIT)
+                    .queueFamilies(device_app.computeSharingFamilies())    //env cubes are read by the bakes on the compute queue
+                    .getInfo();
+    VkResult result = device_app.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage_, textureImageMemory_);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create empty cubemap image! VkResult: " + std::to_string(result));
+    }
+
+    if(transition){
+        JCommandBuffer commandBuffer(device_app, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+        commandBuffer.beginSingleTimeCommands();
+        device_app.transitionImageLayout(commandBuffer.getCommandBuffer(), textureImage_,
+            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, 
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_IMAGE_ASPECT_COLOR_BIT, mipLevels_, 6);
+        commandBuffer.endSingleTimeCommands(device_app.graphicsQueue());
+    }
+
+    createCubemapImageView();
+    createCubemapSampler(samplerManager);
     createDescriptorInfo();
+}
+
+
 
+JCubemap::JCubemap(JDevice& device, SamplerManager& samplerManager, const MappedFile& ktx2File, const TexUtils::Ktx2Header& header):
+    JTexture(device)
+{
+    createCubemapImageFromKtx2(ktx2File, header);
+    createCubemapImageView();
+    createCubemapSampler(samplerManager);
+    createDescriptorInfo();
 }
 
 
@@ -789,67 +1040,178 @@ JCubemap::~JCubemap(){
 
 
 
-void JCubemap::createCubemapImage(const std::string& path, JDevice& device_app) {
+namespace {
+bool isFullCube(const TexUtils::Ktx2Header& header, uint32_t faceSize, VkFormat format){
+    const uint32_t fullMips = static_cast<uint32_t>(std::floor(std::log2(faceSize))) + 1;
+    return header.vkFormat == format && TexUtils::isKtx2Readable(header) &&
+           header.faceCount == 6 && header.layerCount == 0 &&
+           header.pixelWidth == faceSize && header.pixelHeight == faceSize &&
+           header.levelCount == fullMips;
+}
+}
 
-    int width, height;
-    const float* pixels = stbi_loadf(path.data(), &width, &height, nullptr, 4);
-        if (!pixels) {
-            std::string reason = stbi_failure_reason();
-            throw std::runtime_error("failed to load cubemap image ' " + path + " ' : "+ reason);}
-        if (width<=0||height<=0){
-            throw std::runtime_error("Loaded cubemap image has invalid dimensions!");
-        }
 
-    
-    JBitmap in(width, height, 4, eJBitmapFormat_Float, pixels); 
-    //convert to vertical cross
-    JBitmap out = convertEquirectangularMapToVerticalCross(in);    
-    stbi_image_free((void*)pixels);
-    
-    //write to disk to debug
-    // stbi_write_hdr("./loaded_hdr_toVertical.hdr", out.w_, out.h_, out.channels_,
-    //                 (const float*)out.data_.data());
-    
-    cubemap_ = convertVerticalCrossToCubeMapFaces(out);  //create cubemap
-    VkDeviceSize faceSize = cubemap_.w_ * cubemap_.h_ * cubemap_.channels_ * JBitmap::getBytesPerChannel(cubemap_.format_) ; //float, 4 channels
-    VkDeviceSize totalSize = faceSize * 6;
+uint64_t JCubemap::cacheKey(const MappedFile& source, const char* method, uint32_t faceSize, VkFormat format){
+    return TexUtils::equirectCubeCacheKey(source, method, faceSize, format);
+}
 
-    //find miplevels figure
-    mipLevels_ = static_cast<uint32_t>(std::floor(std::log2(std::max(cubemap_.w_, cubemap_.h_))))+1;
-    //tex width is one cubemap_ face width
-    texWidth = cubemap_.w_;
-    texHeight = cubemap_.h_;
-    texChannels = cubemap_.channels_;
+
+bool JCubemap::cacheEnabled(){
+    const char* env = std::getenv("JRENDERER_TEXTURE_CACHE");
+    return !(env && std::string(env) == "0");
+}
+
+
+std::shared_ptr<JCubemap> JCubemap::loadCached(uint64_t key, uint32_t faceSize, VkFormat format,
+                                               JDevice& device, SamplerManager& samplerManager){
+    const std::string cachePath = TexUtils::convertedCachePath(key);
+    if(!cacheEnabled() || !std::filesystem::exists(cachePath)) return nullptr;
+
+    MappedFile file(cachePath);
+    TexUtils::Ktx2Header header;
+    if(!TexUtils::parseKtx2Header(file, header) || !isFullCube(header, faceSize, format)){
+        std::cout << "DEBUG: cubemap cache " << cachePath << " does not match, converting again" << std::endl;
+        return nullptr;}
+
+    if(TexUtils::loadStatsEnabled()){
+        std::cout << "DEBUG: cubemap cache hit " << cachePath << std::endl;}
+    auto cubemap = std::make_shared<JCubemap>(device, samplerManager, file, header);
+    cubemap->setContentHash(key);
+    return cubemap;
+}
+
+
+void JCubemap::writeCache(uint64_t key) const{
+    if(!cacheEnabled()) return;
+    const std::string cachePath = TexUtils::convertedCachePath(key);
+    try{
+        TexUtils::WriteImageToKtx2(device_app, textureImage_, cubemapFormat_,
+                static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight), mipLevels_, 6,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT|VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, cachePath);
+        if(TexUtils::loadStatsEnabled()){
+            std::cout << "DEBUG: cubemap cached to " << cachePath << std::endl;}
+    }
+    catch(const std::exception& e){
+        std::cout << "DEBUG: cubemap cache write skipped: " << e.what() << std::endl;}
+}
 
 
-    // Debug checks
-    std::cout << "DEBUG: cubemap_.data_.size() = " << cubemap_.data_.size() << std::endl;
-    std::cout << "DEBUG: cubemap_.depth_ = " << cubemap_.depth_ << std::endl;
-    std::cout << "DEBUG: cubemap dimensions: " << cubemap_.w_ << "x" << cubemap_.h_ << "x" << cubemap_.channels_ << std::endl;
 
-    // Verify data size matches expectation
-    if (cubemap_.data_.size() != totalSize) {
-        throw std::runtime_error("Cubemap data size mismatch!");
+void JCubemap::createCubemapImageFromKtx2(const MappedFile& ktx2File, const TexUtils::Ktx2Header& header){
+    if(header.faceCount != 6){
+        throw std::runtime_error("ktx2 is not a cubemap: " + ktx2File.path());}
+
+    cubemapFormat_ = header.vkFormat;
+    texWidth = static_cast<int>(header.pixelWidth);
+    texHeight = static_cast<int>(header.pixelHeight);
+    texChannels = static_cast<int>(header.numComponents);
+    mipLevels_ = header.levelCount;
+
+    auto imageInfo = ImageCreateInfoBuilder(texWidth, texHeight)
+                    .mipLevels(mipLevels_)
+                    .arrayLayers(6)
+                    .format(cubemapFormat_)
+                    .flags(VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT)
+                    .usage(VK_IMAGE_USAGE_TRANSFER_DST_BIT|VK_IMAGE_USAGE_TRANSFER_SRC_BIT|VK_IMAGE_USAGE_SAMPLED_BIT)
+                    .queueFamilies(device_app.computeSharingFamilies())
+                    .getInfo();
+    VkResult result = device_app.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage_, textureImageMemory_);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create cubemap image! VkResult: " + std::to_string(result));
+    }
+
+    JCommandBuffer commandBuffer(device_app, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+    commandBuffer.beginSingleTimeCommands();
+    device_app.transitionImageLayout(commandBuffer.getCommandBuffer(), textureImage_,
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_IMAGE_ASPECT_COLOR_BIT, mipLevels_, 6);
+    commandBuffer.endSingleTimeCommands(device_app.graphicsQueue());
+
+    //every mip is in the file, no mip generation. ends in SHADER_READ_ONLY
+    TexUtils::UploadKtx2ToImage(device_app, ktx2File, header, textureImage_);
+}
+
+
+
+void JCubemap::createCubemapImage(const std::string& path, JDevice& device_app) {
+
+    MappedFile file(path);
+    int width, height, fileChannels;
+    if (!TexUtils::queryImageInfo(file, width, height, fileChannels)) {
+        std::string reason = stbi_failure_reason();
+        throw std::runtime_error("failed to load cubemap image ' " + path + " ' : "+ reason);}
+    if (width<=0||height<=0){
+        throw std::runtime_error("Loaded cubemap image has invalid dimensions!");
     }
-    if (cubemap_.depth_ != 6) {
-        throw std::runtime_error("Cubemap depth is not 6!");
+
+    //already converted once: upload the finished cube (all mips) from the cache, no decode / resample / mip gen
+    const uint64_t key = cacheKey(file, "cpu", static_cast<uint32_t>(width / 4), kBakedMapFormat);
+    const std::string cacheFile = TexUtils::convertedCachePath(key);
+    contentHash_ = key;
+    if(cacheEnabled() && std::filesystem::exists(cacheFile)){
+        MappedFile cached(cacheFile);
+        TexUtils::Ktx2Header header;
+        if(TexUtils::parseKtx2Header(cached, header) &&
+           isFullCube(header, static_cast<uint32_t>(width / 4), kBakedMapFormat)){
+            createCubemapImageFromKtx2(cached, header);
+            if(TexUtils::loadStatsEnabled()){
+                std::cout << "DEBUG: cubemap " << path << " loaded from cache " << cacheFile << std::endl;}
+            return;}
     }
 
-    //Staging buffer
+    //radiance hdr stays rgbe (4 bytes a pixel) and is decoded per fetch by the cube sampling,
+    //a quarter of the float equirect. anything else: float bitmap, decoded straight into its storage
+    TexUtils::HdrInfo hdr;
+    const bool isRGBE = TexUtils::parseHdr(file, hdr);
+    const auto decodeStart = std::chrono::steady_clock::now();
+    JBitmap in = isRGBE ? JBitmap(width, height, 4, eJBitmapFormat_UnsignedByte)
+                        : JBitmap(width, height, 4, eJBitmapFormat_Float);
+    if(isRGBE){
+        TexUtils::decodeHdrRGBE(file, hdr, in.data_.data());}
+    else{
+        TexUtils::decodeInto(file, 4, true, in.data_.data(), in.data_.size());}
+    if(TexUtils::loadStatsEnabled()){
+        std::cout << "DEBUG: cubemap source " << width << "x" << height << (isRGBE ? " rgbe" : " float") << " decoded in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - decodeStart).count() << " ms" << std::endl;}
+
+    //face size of the cube. faces are sampled from the equirect straight into staging, no vertical cross
+    const int faceWidth  = in.w_ / 4;
+    const int faceHeight = faceWidth;
+    cubemapFormat_ = kBakedMapFormat;
+    VkDeviceSize faceSize = faceWidth * faceHeight * in.channels_ * JBitmap::getBytesPerChannel(eJBitmapFormat_Half) ; //half, 4 channels
+    VkDeviceSize totalSize = faceSize * 6;
+
+    //find miplevels figure
+    mipLevels_ = static_cast<uint32_t>(std::floor(std::log2(std::max(faceWidth, faceHeight))))+1;
+    //tex width is one cubemap face width
+    texWidth = faceWidth;
+    texHeight = faceHeight;
+    texChannels = in.channels_;
+
+    std::cout << "DEBUG: cubemap dimensions: " << texWidth << "x" << texHeight << "x" << texChannels << std::endl;
+
+    //Staging buffer, the 6 faces are written into it layer after layer
     JBuffer stagingBuffer(device_app, totalSize, 
                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT|VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
     void* data;
     vkMapMemory(device_app.device(), stagingBuffer.bufferMemory(), 0, stagingBuffer.getSize(), 0, &data);
-    memcpy(data, cubemap_.data_.data(), static_cast<size_t>(totalSize));
+    if(isRGBE){
+        convertRGBEEquirectToCubeMapFaces(in, data, eJBitmapFormat_Half);}
+    else{
+        convertEquirectangularMapToCubeMapFaces(in, data, eJBitmapFormat_Half);}
     vkUnmapMemory(device_app.device(), stagingBuffer.bufferMemory());
+    TexUtils::logLoadStats("cubemap " + path + " loaded");
 
     // image create info
     auto imageInfo = ImageCreateInfoBuilder(texWidth, texHeight)
                     .mipLevels(mipLevels_)
-                    .arrayLayers(cubemap_.depth_)
-                    .format(cubemap_.getVkFormat())
+                    .arrayLayers(6)
+                    .format(cubemapFormat_)
                     .flags(VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT) // for cubemap_ especially
                     .usage(VK_IMAGE_USAGE_TRANSFER_DST_BIT|VK_IMAGE_USAGE_TRANSFER_SRC_BIT|VK_IMAGE_USAGE_SAMPLED_BIT)
+                    .queueFamilies(device_app.computeSharingFamilies())
                     .getInfo();
     VkResult result = device_app.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage_, textureImageMemory_);
     if (result != VK_SUCCESS) {
@@ -876,7 +1238,9 @@ void JCubemap::createCubemapImage(const std::string& path, JDevice& device_app)
     commandBuffer.endSingleTimeCommands(device_app.graphicsQueue());
 
     //generate mipmaps for cubemap (6 layers)
-    generateMipmaps(textureImage_, cubemap_.getVkFormat(), texWidth, texHeight, mipLevels_, 6);
+    generateMipmaps(textureImage_, cubemapFormat_, texWidth, texHeight, mipLevels_, 6);
+
+    writeCache(key);
 
 }
 
@@ -887,8 +1251,8 @@ void JCubemap::createCubemapImageView(){
     auto viewInfo = ImageViewCreateInfoBuilder(textureImage_)
                     .mipLevels(0, mipLevels_)
                     .viewType(VK_IMAGE_VIEW_TYPE_CUBE)
-                    .format(cubemap_.getVkFormat())
-                    .arrayLayers(0, static_cast<uint32_t>(cubemap_.depth_))
+                    .format(cubemapFormat_)
+                    .arrayLayers(0, 6)
                     .getInfo();
     VkResult result = device_app.createImageViewWithInfo(viewInfo, textureImageView_);
     if (result != VK_SUCCESS) {
@@ -899,20 +1263,16 @@ void JCubemap::createCubemapImageView(){
 
 
 
-void JCubemap::createCubemapSampler() {
-    VkPhysicalDeviceProperties properties{};
-    vkGetPhysicalDeviceProperties(device_app.physicalDevice(), &properties);
-
+void JCubemap::createCubemapSampler(SamplerManager& samplerManager) {
     auto samplerInfo = SamplerCreateInfoBuilder()
                         .addressMode(VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE)
                         .maxLod(mipLevels_)
                         .compareOp(VK_COMPARE_OP_NEVER)
-                        .maxAnisotropy(properties.limits.maxSamplerAnisotropy)
+                        .maxAnisotropy(samplerManager.maxAnisotropy())
                         .getInfo();
 
-    if (vkCreateSampler(device_app.device(), &samplerInfo, nullptr, &textureSampler_) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create cubemap sampler!");
-    }
+    textureSampler_ = samplerManager.getOrCreate(samplerInfo);
+    ownsSampler_ = false;
 }
 
 
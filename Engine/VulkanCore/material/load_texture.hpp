@@ -1,11 +1,15 @@
 #pragma once
 #include <vulkan/vulkan.hpp>
+#include <functional>
+#include <memory>
 #include <optional>
 #include <string>
 #include <unordered_map>
 #include "../utility.hpp"
 #include "bitmap.hpp"
 class JDevice;
+class MappedFile;
+namespace TexUtils{ struct Ktx2Header; }
 
 
 
@@ -26,6 +30,7 @@ inline int bytesPerPixel(VkFormat format){
 
         case VK_FORMAT_R8G8B8A8_UNORM:
         case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_R16G16_SFLOAT:
             return 4;
 
         case VK_FORMAT_R16G16B16A16_SFLOAT:
@@ -55,6 +60,14 @@ enum class SamplerType {
 
 //universe sampler, the miplevel is controlled by image view, not the sampler side
 
+//only the fields that change the sampler. pNext chains are not supported
+struct SamplerInfoHash{
+    size_t operator()(const VkSamplerCreateInfo& info) const;
+};
+struct SamplerInfoEqual{
+    bool operator()(const VkSamplerCreateInfo& a, const VkSamplerCreateInfo& b) const;
+};
+
 class SamplerManager{
 public:
     explicit SamplerManager(JDevice& device);
@@ -64,23 +77,34 @@ public:
     //init all universal ones
     void initDefault();
 
-    void addSampler(const std::string& name, VkSampler newSampler);
+    //hash-consed: same create info -> same VkSampler. samplers are immutable and owned here,
+    //textures / materials never destroy them
+    VkSampler getOrCreate(const VkSamplerCreateInfo& samplerInfo);
+
+    //give a name to a cached sampler
+    VkSampler addSampler(const std::string& name, const VkSamplerCreateInfo& samplerInfo);
 
     VkSampler getSampler(const std::string& name); //get customized
     VkSampler getSampler(SamplerType samplerType); //get default
 
+    uint32_t samplerCount() const               {return static_cast<uint32_t>(samplers_.size());}
+    uint32_t maxSamplerCount() const            {return maxSamplerAllocationCount_;}
+    float maxAnisotropy() const                 {return maxSamplerAnisotropy_;}
+
     void destroy();  //need explicit call
 private:
     JDevice& device_app;
     float maxSamplerAnisotropy_;
+    uint32_t maxSamplerAllocationCount_;
 
+    std::unordered_map<VkSamplerCreateInfo, VkSampler, SamplerInfoHash, SamplerInfoEqual> samplers_; //owns all
     std::unordered_map<std::string, VkSampler> customSamplers_;
     std::unordered_map<SamplerType, VkSampler> defaultSamplers_;
     //individual build
     VkSampler build(SamplerType samplerType);
 };
 
-//individual one just use the samplerInfoBuilder.. all been added to samplers_, in the end they all be destroyed
+//individual one just use the samplerInfoBuilder + getOrCreate.. in the end they all be destroyed
 
 
 ///////////////////////////////////////////////////////////////////////////////////////////
@@ -101,8 +125,11 @@ struct TextureConfig{
     std::optional<uint32_t> mipLevels;
 
     std::optional<void*>    data; //can provide, or just empty one
+    std::function<void(void*)> writeData; //or write straight into the mapped staging memory, no host copy
 
     VkImageLayout           newLayout{VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL};
+    bool                    computeShared{false}; //also used on JDevice::computeQueue(), CONCURRENT when that is another family
+    bool                    transitionOnCreate{true}; //false: stays UNDEFINED, the first submit using it transitions it (no graphics queue wait)
     
     //imageview
     VkImageViewType         viewType{VK_IMAGE_VIEW_TYPE_2D};  //2D or cube
@@ -136,6 +163,7 @@ inline TextureConfig PrefilterEnvMapConfig(uint32_t width, uint32_t height, VkFo
     TextureConfig config = CubeMapConfig(width, height, format, mips_);
 
     config.usageFlags |= VK_IMAGE_USAGE_STORAGE_BIT;
+    config.computeShared = true;    //baked on the compute queue, sampled by graphics
 
     return config;
 }
@@ -165,8 +193,8 @@ public:
 
     //optional functions
     VkImageView switchViewForMip(uint32_t selectMip, VkImageViewType vType);
-    //only use when has customized sampler.. doing this for manage customized sampler inside this texture life cycle
-    void createCustomSampler(const VkSamplerCreateInfo& samplerInfo); //create sampler inside, so store in the class
+    //only use when has customized sampler. the sampler is shared and owned by SamplerManager
+    void createCustomSampler(SamplerManager& samplerManager, const VkSamplerCreateInfo& samplerInfo);
 
     VkDescriptorImageInfo getDesImageInfo() const 
         {   if(!customSampler_.has_value()){throw std::runtime_error("No sampler assigned when creating this texture object");}
@@ -175,10 +203,17 @@ public:
                 textureBaseImageView_,
                 VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,   };        
         }
-private:
+    //with a shared sampler (from sampler manager)
+    VkDescriptorImageInfo getDescriptorImageInfo(VkSampler sampler) const 
+        {return  VkDescriptorImageInfo{
+            sampler,
+            textureBaseImageView_,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,   };        
+        }
+protected:
+    //child class fill config_ (and data) first, then call this
     void createTextureBase();
 
-protected:
     JDevice& device_app;
     TextureConfig config_;    
 
@@ -190,7 +225,7 @@ protected:
     VkImageView                 textureBaseImageView_;
     VkDeviceMemory              textureBaseImageMemory_;
 
-    std::optional<VkSampler>    customSampler_; //for unique customized sampler store inside
+    std::optional<VkSampler>    customSampler_; //not owned, from SamplerManager
 
     //for use
     void copyBufferToImage(VkCommandBuffer commandBuffer,VkBuffer buffer, 
@@ -199,6 +234,10 @@ protected:
 
     void generateMipmaps(VkImage image, VkFormat imageFormat, 
         int32_t texWidth, int32_t texHeight, uint32_t mipLevels, uint32_t layerCount=1);
+    //same blit chain into a command buffer the caller submits (no queue wait). mip 0 in TRANSFER_DST,
+    //every mip ends in SHADER_READ_ONLY
+    void recordMipmaps(VkCommandBuffer commandBuffer, VkImage image, VkFormat imageFormat,
+        int32_t texWidth, int32_t texHeight, uint32_t mipLevels, uint32_t layerCount=1);
 
 protected:
     // protected constructor for child class
@@ -219,21 +258,28 @@ public:
     JTexture2D(JDevice& device, const std::string& path, VkFormat format);
     ~JTexture2D() override;
 
-    VkDescriptorImageInfo getDescriptorImageInfo(VkSampler sampler) const 
-        {return  VkDescriptorImageInfo{
-            sampler,
-            textureBaseImageView_,
-            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,   };        
-        }
-
 private:
-    stbi_uc* pixels_;
-    TextureConfig createConfig(const std::string& path, VkFormat format);
+    TextureConfig createConfig(const MappedFile& file, VkFormat format);
 
-    void createTextureImage();
+    void createTextureImage(const MappedFile& file);
     void createTextureImageView();
 };
 
+//---------------------------------------------------------------------------------------
+//occlusion / roughness / metallic packed into one rgba8 texture (r: ao, g: roughness, b: metallic)
+//each source is read as single channel. empty path -> constant value, smaller sources are resampled to the largest
+//rgba not rgb, rgb8 has no optimal tiling / linear blit support on most gpu
+class JORMTexture: public JTextureBase{
+
+public:
+    JORMTexture(JDevice& device,
+                const std::string& occlusionPath,
+                const std::string& roughnessPath,
+                const std::string& metallicPath,
+                float occlusion = 1.0f, float roughness = 0.5f, float metallic = 0.0f);
+    ~JORMTexture() override;
+};
+
 //---------------------------------------------------------------------------------------
 class JSolidColor: public JTextureBase{
 
@@ -241,13 +287,6 @@ class JSolidColor: public JTextureBase{
         JSolidColor(JDevice& device, float r, float g, float b);
         ~JSolidColor() override;
     
-        VkDescriptorImageInfo getDescriptorImageInfo(VkSampler sampler) const 
-            {return  VkDescriptorImageInfo{
-                sampler,
-                textureBaseImageView_,
-                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,   };        
-            }
-    
     private:
         uint8_t* pixels_;
         TextureConfig createConfig();
@@ -268,6 +307,7 @@ public:
     JTexture(const std::string& path, JDevice& device);
     virtual ~JTexture();
     
+    VkImage textureImage() const                    {return textureImage_;}
     VkImageView textureImageView() const            {return textureImageView_;}
     VkSampler textureSampler() const                {return textureSampler_;}
     int getTextureWidth() const                     {return texWidth;}
@@ -295,6 +335,7 @@ protected:
     VkImageView                 textureImageView_;
     VkDeviceMemory              textureImageMemory_;
     VkSampler                   textureSampler_;
+    bool                        ownsSampler_{true}; //false when it comes from SamplerManager
     VkDescriptorImageInfo       descriptorImageInfo_;
 
  
@@ -322,15 +363,38 @@ protected:
 
 class JCubemap: public JTexture{
 public:
-    JCubemap(const std::string& path, JDevice& device);
+    JCubemap(const std::string& path, JDevice& device, SamplerManager& samplerManager);
+    //empty cube (all mips), storage + sampled, left in VK_IMAGE_LAYOUT_GENERAL.
+    //for the gpu equirect conversion (PrecomputeSystem::createCubemapFromEquirect), which fills it.
+    //transition false: stays UNDEFINED for an upload on another queue (environment swaps)
+    JCubemap(JDevice& device, SamplerManager& samplerManager, uint32_t faceSize, VkFormat format, bool transition = true);
+    //cube straight from a raw or zstd 6 face ktx2 (all mips in the file), eg. the converted cube cache
+    JCubemap(JDevice& device, SamplerManager& samplerManager, const MappedFile& ktx2File, const TexUtils::Ktx2Header& header);
     ~JCubemap() override;
 
+    VkFormat getFormat() const                      {return cubemapFormat_;}
+    //what the cube was made from (source file content + conversion, see cacheKey). 0: unknown
+    uint64_t getContentHash() const                 {return contentHash_;}
+    void setContentHash(uint64_t hash)              {contentHash_ = hash;}
+
+    //converted cube cache (TexUtils::convertedCacheKey). method tells cpu / gpu conversion apart
+    static uint64_t cacheKey(const MappedFile& source, const char* method, uint32_t faceSize, VkFormat format);
+    //off with JRENDERER_TEXTURE_CACHE=0
+    static bool cacheEnabled();
+    //cube from the cache file if it exists and holds a full cube of that size / format, nullptr otherwise
+    static std::shared_ptr<JCubemap> loadCached(uint64_t key, uint32_t faceSize, VkFormat format,
+                                                JDevice& device, SamplerManager& samplerManager);
+    //all mips -> cache file of key. cube must be in SHADER_READ_ONLY. only logs on failure, the cache is optional
+    void writeCache(uint64_t key) const;
+
 private:
-    JBitmap cubemap_;
+    VkFormat cubemapFormat_;
+    uint64_t contentHash_{0};
 
     void createCubemapImage(const std::string& path, JDevice& device);
+    void createCubemapImageFromKtx2(const MappedFile& ktx2File, const TexUtils::Ktx2Header& header);
     void createCubemapImageView();
-    void createCubemapSampler();
+    void createCubemapSampler(SamplerManager& samplerManager);
     void copyBufferToImage_multiple(VkCommandBuffer commandBuffer,
         VkBuffer buffer, VkImage image, 
         uint32_t imgWidth, uint32_t imgHeight, 
@@ -0,0 +1,486 @@
+#include "streamingTexture.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <stb_image.h>
+#include "imageDecode.hpp"
+#include "bitmap.hpp"
+#include "../buffer.hpp"
+#include "../device.hpp"
+#include "../commandBuffer.hpp"
+#include "../sync.hpp"
+#include "../descriptor/descriptorSetCache.hpp"
+
+
+
+//2x2 box filter on rgba8, one level. dst can be src (see downsample2x).
+//only used for the level we upload, rest is blitted on gpu
+static void halveRGBA8(const uint8_t* src, uint32_t w, uint32_t h, uint8_t* dst)
+{
+    using View = JBitmapView<eJBitmapFormat_UnsignedByte, 4>;
+    const int nw = static_cast<int>(std::max(1u, w / 2));
+    const int nh = static_cast<int>(std::max(1u, h / 2));
+    downsample2x(JBitmapView<eJBitmapFormat_UnsignedByte, 4, false>(src, static_cast<int>(w), static_cast<int>(h)),
+                 View(dst, nw, nh));
+}
+
+
+//bump when the cached chain changes (filter, layout ...)
+static constexpr int kStreamMipCacheVersion = 1;
+
+//one level of the mip cache into dst, false if the file is not there (yet) or does not fit
+static bool readCachedLevel(const std::string& cachePath, uint32_t mip, uint8_t* dst, size_t levelSize){
+    if(cachePath.empty() || !std::filesystem::exists(cachePath)) return false;
+    MappedFile file(cachePath);
+    TexUtils::Ktx2Header header;
+    if(!TexUtils::parseKtx2Header(file, header)) return false;
+    //dst is mapped staging
+    return TexUtils::ReadKtx2Level(file, header, mip, dst, levelSize, true);
+}
+
+
+
+JStreamingTexture2D::JStreamingTexture2D(JDevice& device, const std::string& path, VkFormat format, uint32_t tailSize):
+    JTextureBase(device), path_(path)
+{
+    //stbi always give rgba8 here
+    if(bytesPerPixel(format) != 4){
+        throw std::runtime_error("streaming texture only support 4 channels 8bit format for now");   }
+
+    //header only, no decode
+    int w, h, comp;
+    if(!stbi_info(path_.c_str(), &w, &h, &comp)){
+        throw std::runtime_error("failed to read streaming texture header: " + path_);    }
+
+    fullWidth_      = static_cast<uint32_t>(w);
+    fullHeight_     = static_cast<uint32_t>(h);
+    fullMipLevels_  = static_cast<uint32_t>(std::floor(std::log2(std::max(w, h))))+1;
+
+    //smallest mip whose bigger side <= tailSize
+    tailMip_ = 0;
+    while(tailMip_ + 1 < fullMipLevels_ &&
+          std::max(fullWidth_ >> tailMip_, fullHeight_ >> tailMip_) > tailSize){
+        ++tailMip_;   }
+
+    residentMip_    = fullMipLevels_; //nothing resident yet
+    requestedMip_   = tailMip_;
+
+    config_.imageType   = VK_IMAGE_TYPE_2D;
+    config_.viewType    = VK_IMAGE_VIEW_TYPE_2D;
+    config_.format      = format;
+    config_.channels    = 4;
+    config_.arrayLayers = 1;
+    config_.usageFlags  = VK_IMAGE_USAGE_TRANSFER_DST_BIT|VK_IMAGE_USAGE_TRANSFER_SRC_BIT|VK_IMAGE_USAGE_SAMPLED_BIT;
+    config_.newLayout   = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+
+    MappedFile file(path_);
+    if(tailMip_ > 0){
+        const std::string params = "stream mips v" + std::to_string(kStreamMipCacheVersion) +
+                                   " format=" + std::to_string(format);
+        mipCachePath_ = TexUtils::convertedCachePath(TexUtils::convertedCacheKey(file, params));  }
+
+    //tail right away, on this thread: small, and the texture must be usable when it is created
+    const uint32_t levelW = std::max(1u, fullWidth_ >> tailMip_);
+    const uint32_t levelH = std::max(1u, fullHeight_ >> tailMip_);
+    const VkDeviceSize levelSize = static_cast<VkDeviceSize>(levelW) * levelH * 4;
+    JBuffer stagingBuffer(device_app, levelSize,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT|VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    stagingBuffer.map();
+    uint8_t* mapped = static_cast<uint8_t*>(stagingBuffer.getBufferMapped());
+    if(tailMip_ == 0){
+        TexUtils::decodeInto(file, 4, false, mapped, static_cast<size_t>(levelSize));  }
+    else if(!readCachedLevel(mipCachePath_, tailMip_, mapped, static_cast<size_t>(levelSize))){
+        //first time this file is seen: the decode we need for the tail anyway gives the whole chain
+        buildMipCache(file, tailMip_, mapped, static_cast<size_t>(levelSize));  }
+    stagingBuffer.unmap();
+
+    VkImage image;
+    VkDeviceMemory memory;
+    allocateImage(tailMip_, image, memory);
+    JCommandBuffer commandBuffer(device_app, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+    commandBuffer.beginSingleTimeCommands();
+    recordStreamIn(commandBuffer.getCommandBuffer(), stagingBuffer.buffer(), image, tailMip_);
+    commandBuffer.endSingleTimeCommands(device_app.graphicsQueue());
+    swapImage(tailMip_, image, memory, 0);
+}
+
+
+JStreamingTexture2D::~JStreamingTexture2D(){
+    if(pending_){
+        //worker writes into the staging buffer, gpu may still copy into the new image
+        if(pending_->decode.valid()){ pending_->decode.wait(); }
+        if(pending_->timelineValue){ pending_->timeline->wait(pending_->timelineValue); }
+        vkDestroyImage(device_app.device(), pending_->image, nullptr);
+        vkFreeMemory(device_app.device(), pending_->memory, nullptr);
+        pending_.reset();   }
+    for(const auto& retired : retired_){
+        destroyRetired(retired); }
+    if(mipCacheWrite_.valid()){ mipCacheWrite_.wait(); }
+}
+
+
+uint32_t JStreamingTexture2D::targetMip() const{
+    return pending_ ? pending_->mip : residentMip_;
+}
+
+
+VkDeviceSize JStreamingTexture2D::chainBytes(uint32_t mip) const{
+    VkDeviceSize total = 0;
+    for(uint32_t m = mip; m < fullMipLevels_; ++m){
+        total += static_cast<VkDeviceSize>(std::max(1u, fullWidth_ >> m)) *
+                 std::max(1u, fullHeight_ >> m) * bytesPerPixel(config_.format);    }
+    return total;
+}
+
+
+void JStreamingTexture2D::request(uint32_t mip, float priority, uint64_t frame){
+    mip = std::clamp(mip, finestMip_, tailMip_);
+    if(frame != lastRequestFrame_){ //first request in this frame
+        requestedMip_       = mip;
+        priority_           = priority;
+        lastRequestFrame_   = frame;
+        return;  }
+    requestedMip_   = std::min(requestedMip_, mip);
+    priority_       = std::max(priority_, priority);
+}
+
+
+void JStreamingTexture2D::beginResidency(uint32_t mip){
+    mip = std::clamp(mip, finestMip_, tailMip_);
+    if(pending_ || mip == residentMip_) return;
+
+    pending_ = std::make_unique<PendingResidency>();
+    pending_->mip = mip;
+    allocateImage(mip, pending_->image, pending_->memory);
+
+    if(mip < residentMip_){
+        const uint32_t levelW = std::max(1u, fullWidth_ >> mip);
+        const uint32_t levelH = std::max(1u, fullHeight_ >> mip);
+        const VkDeviceSize levelSize = static_cast<VkDeviceSize>(levelW) * levelH * 4;
+        pending_->staging = std::make_unique<JBuffer>(device_app, levelSize,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT|VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        pending_->staging->map();
+        uint8_t* mapped = static_cast<uint8_t*>(pending_->staging->getBufferMapped());
+        //only the paths and the mapped staging, the worker does not touch the texture
+        pending_->decode = std::async(std::launch::async, [path = path_, mipCache = mipCachePath_, mip, mapped, levelSize](){
+            decodeLevel(path, mipCache, mip, mapped, static_cast<size_t>(levelSize)); });
+        return;
+    }
+
+    //evict: coarser mips are already on gpu, nothing to decode
+    pending_->commandBuffer = std::make_unique<JCommandBuffer>(device_app, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+    pending_->commandBuffer->beginSingleTimeCommands();
+    recordEvict(pending_->commandBuffer->getCommandBuffer(), pending_->image, mip);
+}
+
+
+bool JStreamingTexture2D::pollResidency(const std::shared_ptr<JTimelineSemaphore>& timeline, uint64_t& timelineValue, uint64_t frame){
+    //frames recorded before a swap are done once MAX_FRAMES_IN_FLIGHT more have started
+    auto done = std::partition(retired_.begin(), retired_.end(), [&](const RetiredImage& retired){
+        return frame < retired.frame + Global::MAX_FRAMES_IN_FLIGHT; });
+    for(auto it = done; it != retired_.end(); ++it){
+        destroyRetired(*it); }
+    retired_.erase(done, retired_.end());
+
+    if(!pending_) return false;
+
+    //decode finished: record the upload (get() rethrows what the worker threw)
+    if(pending_->decode.valid()){
+        if(pending_->decode.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return false;
+        try{
+            pending_->decode.get();  }
+        catch(const std::exception& e){
+            //a file that went bad is no reason to stop the viewer: keep what is resident, dont ask for finer again
+            std::cout << "warning: failed to stream mip " << pending_->mip << " of " << path_ << ": " << e.what() << std::endl;
+            pending_->staging->unmap();
+            vkDestroyImage(device_app.device(), pending_->image, nullptr);
+            vkFreeMemory(device_app.device(), pending_->memory, nullptr);
+            pending_.reset();
+            finestMip_      = residentMip_;
+            requestedMip_   = std::max(requestedMip_, finestMip_);
+            return false;  }
+        pending_->staging->unmap();
+        pending_->commandBuffer = std::make_unique<JCommandBuffer>(device_app, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+        pending_->commandBuffer->beginSingleTimeCommands();
+        recordStreamIn(pending_->commandBuffer->getCommandBuffer(), pending_->staging->buffer(), pending_->image, pending_->mip);
+    }
+
+    //recorded, not submitted yet. same queue as the frames, so the frames after it see the final barriers
+    if(!pending_->timelineValue){
+        pending_->timeline      = timeline;
+        pending_->timelineValue = ++timelineValue;
+        pending_->commandBuffer->endAndSubmit(device_app.graphicsQueue(), timeline->semaphore(), pending_->timelineValue);
+        return false;
+    }
+
+    if(timeline->value() < pending_->timelineValue) return false;
+
+    auto pending = std::move(pending_);
+    swapImage(pending->mip, pending->image, pending->memory, frame);
+    return true;
+}
+
+
+void JStreamingTexture2D::decodeLevel(const std::string& path, const std::string& mipCache, uint32_t mip, uint8_t* dst, size_t levelSize){
+    if(readCachedLevel(mipCache, mip, dst, levelSize)) return;
+
+    MappedFile file(path);
+    if(mip == 0){
+        TexUtils::decodeInto(file, 4, false, dst, levelSize);
+        return;}
+
+    //no cache yet (being written, or the write failed). stbi can only decode the whole image, halve in place,
+    //last level is written into dst
+    int w, h, comp;
+    stbi_uc* pixels = stbi_load_from_memory(file.data(), static_cast<int>(file.size()), &w, &h, &comp, STBI_rgb_alpha);
+    if(!pixels){
+        throw std::runtime_error("failed to stream texture: " + path);}
+
+    uint32_t curW = static_cast<uint32_t>(w);
+    uint32_t curH = static_cast<uint32_t>(h);
+    for(uint32_t m = 0; m < mip; ++m){
+        halveRGBA8(pixels, curW, curH, m + 1 == mip ? dst : pixels);
+        curW = std::max(1u, curW / 2);
+        curH = std::max(1u, curH / 2);   }
+    stbi_image_free(pixels);
+}
+
+
+void JStreamingTexture2D::buildMipCache(const MappedFile& file, uint32_t mip, uint8_t* dst, size_t levelSize){
+    //same packing as a readback, so the writer can take it as is
+    std::vector<VkBufferImageCopy> regions;
+    auto chain = std::make_shared<std::vector<uint8_t>>(
+        TexUtils::Ktx2ReadbackRegions(config_.format, fullWidth_, fullHeight_, fullMipLevels_, 1, regions));
+    TexUtils::decodeInto(file, 4, false, chain->data(), static_cast<size_t>(fullWidth_) * fullHeight_ * 4);
+    for(uint32_t m = 1; m < fullMipLevels_; ++m){
+        halveRGBA8(chain->data() + regions[m - 1].bufferOffset,
+                   std::max(1u, fullWidth_ >> (m - 1)), std::max(1u, fullHeight_ >> (m - 1)),
+                   chain->data() + regions[m].bufferOffset);   }
+    std::memcpy(dst, chain->data() + regions[mip].bufferOffset, levelSize);
+
+    //zstd takes a while on a big chain, texture is usable before that. a stream in that comes first decodes the source
+    mipCacheWrite_ = std::async(std::launch::async,
+        [chain, regions = std::move(regions), format = config_.format, w = fullWidth_, h = fullHeight_,
+         levels = fullMipLevels_, cachePath = mipCachePath_](){
+            try{
+                TexUtils::WriteKtx2FromReadback(chain->data(), regions, format, w, h, levels, 1, cachePath);  }
+            catch(const std::exception& e){
+                std::cout << "warning: " << e.what() << std::endl;  }
+        });
+}
+
+
+void JStreamingTexture2D::allocateImage(uint32_t mip, VkImage& image, VkDeviceMemory& memory){
+    const uint32_t w = std::max(1u, fullWidth_ >> mip);
+    const uint32_t h = std::max(1u, fullHeight_ >> mip);
+
+    auto imageInfo = ImageCreateInfoBuilder(w, h)
+                .mipLevels(fullMipLevels_ - mip)
+                .format(config_.format)
+                .usage(config_.usageFlags)
+                .getInfo();
+    if(device_app.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, memory)!=VK_SUCCESS){
+        throw std::runtime_error("Failed to create VkImage for streaming texture");
+    };
+}
+
+
+void JStreamingTexture2D::recordStreamIn(VkCommandBuffer commandBuffer, VkBuffer staging, VkImage image, uint32_t mip){
+    const uint32_t levelW = std::max(1u, fullWidth_ >> mip);
+    const uint32_t levelH = std::max(1u, fullHeight_ >> mip);
+    const uint32_t newMips = fullMipLevels_ - mip;
+
+    device_app.transitionImageLayout(commandBuffer, image,
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_IMAGE_ASPECT_COLOR_BIT, newMips, 1);
+
+    VkBufferImageCopy region{};
+    region.imageSubresource.aspectMask      = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel        = 0;
+    region.imageSubresource.baseArrayLayer  = 0;
+    region.imageSubresource.layerCount      = 1;
+    region.imageExtent                      = {levelW, levelH, 1};
+    vkCmdCopyBufferToImage(commandBuffer, staging, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    recordMipmaps(commandBuffer, image, config_.format, static_cast<int32_t>(levelW), static_cast<int32_t>(levelH), newMips);
+}
+
+
+void JStreamingTexture2D::recordEvict(VkCommandBuffer commandBuffer, VkImage image, uint32_t mip){
+    const uint32_t newMips = fullMipLevels_ - mip;
+    const uint32_t skip = mip - residentMip_;
+
+    device_app.transitionImageLayout(commandBuffer, image,
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_IMAGE_ASPECT_COLOR_BIT, newMips, 1);
+    device_app.transitionImageLayout(commandBuffer, textureBaseImage_,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_IMAGE_ASPECT_COLOR_BIT, mipLevels_, 1);
+
+    std::vector<VkImageCopy> regions(newMips);
+    for(uint32_t i = 0; i < newMips; ++i){
+        regions[i].srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, skip + i, 0, 1};
+        regions[i].dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1};
+        regions[i].srcOffset      = {0, 0, 0};
+        regions[i].dstOffset      = {0, 0, 0};
+        regions[i].extent         = { std::max(1u, fullWidth_ >> (mip + i)),
+                                      std::max(1u, fullHeight_ >> (mip + i)), 1 };  }
+    vkCmdCopyImage(commandBuffer,
+        textureBaseImage_, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        static_cast<uint32_t>(regions.size()), regions.data());
+
+    device_app.transitionImageLayout(commandBuffer, image,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+        VK_IMAGE_ASPECT_COLOR_BIT, newMips, 1);
+    //frames until the swap still sample the old image
+    device_app.transitionImageLayout(commandBuffer, textureBaseImage_,
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+        VK_IMAGE_ASPECT_COLOR_BIT, mipLevels_, 1);
+}
+
+
+void JStreamingTexture2D::swapImage(uint32_t mip, VkImage image, VkDeviceMemory memory, uint64_t frame){
+    //old image stays until the frames that may have it bound are done (pollResidency)
+    if(textureBaseImageView_ != VK_NULL_HANDLE){
+        JDescriptorSetCache::imageViewDestroyed(textureBaseImageView_);
+        retired_.push_back({textureBaseImage_, textureBaseImageMemory_, textureBaseImageView_, frame});  }
+
+    textureBaseImage_       = image;
+    textureBaseImageMemory_ = memory;
+    residentMip_            = mip;
+    mipLevels_              = fullMipLevels_ - mip;
+    texWidth                = static_cast<int>(std::max(1u, fullWidth_ >> mip));
+    texHeight               = static_cast<int>(std::max(1u, fullHeight_ >> mip));
+    texChannels             = 4;
+    config_.extent          = {static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight), 1};
+    config_.mipLevels       = mipLevels_;
+
+    auto viewInfo = ImageViewCreateInfoBuilder(textureBaseImage_)
+                    .viewType(VK_IMAGE_VIEW_TYPE_2D)
+                    .format(config_.format)
+                    .mipLevels(0, mipLevels_)
+                    .getInfo();
+    if(device_app.createImageViewWithInfo(viewInfo, textureBaseImageView_)!=VK_SUCCESS){
+        throw std::runtime_error("Failed to create VkImageView for streaming texture");
+    };
+
+    if(onResidencyChanged_){
+        onResidencyChanged_(*this); }
+}
+
+
+void JStreamingTexture2D::destroyRetired(const RetiredImage& retired){
+    vkDestroyImageView(device_app.device(), retired.view, nullptr);
+    vkDestroyImage(device_app.device(), retired.image, nullptr);
+    vkFreeMemory(device_app.device(), retired.memory, nullptr);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////
+
+TextureStreamer::TextureStreamer(JDevice& device, VkDeviceSize budgetBytes,
+                                 uint32_t maxUploadsPerFrame, uint32_t evictAfterFrames, uint32_t maxEvictionsPerFrame):
+    device_app(device), budgetBytes_(budgetBytes),
+    maxUploadsPerFrame_(maxUploadsPerFrame), evictAfterFrames_(evictAfterFrames),
+    maxEvictionsPerFrame_(maxEvictionsPerFrame)
+{
+    timeline_ = std::make_shared<JTimelineSemaphore>(device_app);
+}
+
+
+TextureStreamer::~TextureStreamer() = default;
+
+
+void TextureStreamer::add(const std::shared_ptr<JStreamingTexture2D>& texture){
+    textures_.push_back(texture);
+}
+
+
+uint32_t TextureStreamer::mipForScreenSize(uint32_t texWidth, uint32_t texHeight, float screenPixels){
+    if(screenPixels <= 1.f){
+        return UINT32_MAX; } //clamped to tail by request()
+    const float texels = static_cast<float>(std::max(texWidth, texHeight));
+    const float ratio = texels / screenPixels;
+    if(ratio <= 1.f) return 0;
+    return static_cast<uint32_t>(std::floor(std::log2(ratio)));
+}
+
+
+void TextureStreamer::update(uint64_t frame){
+    //drop textures nobody hold anymore
+    textures_.erase(std::remove_if(textures_.begin(), textures_.end(),
+                        [](const std::weak_ptr<JStreamingTexture2D>& t){ return t.expired(); }),
+                    textures_.end());
+
+    struct Pending{
+        std::shared_ptr<JStreamingTexture2D> texture;
+        uint32_t targetMip;
+    };
+    std::vector<Pending> streamIns;
+    std::vector<Pending> evictions;
+    residentBytes_ = 0;
+
+    for(auto& weak : textures_){
+        auto texture = weak.lock();
+        //what finished since last frame is swapped in, decodes that are done get submitted
+        texture->pollResidency(timeline_, timelineValue_, frame);
+
+        //a change in flight counts with the mip it will have
+        residentBytes_ += texture->chainBytes(std::min(texture->residentMip(), texture->targetMip()));
+        if(texture->busy()) continue;
+
+        //not requested for a while == out of view, fall back to the tail
+        const bool stale = frame > texture->lastRequestFrame() + evictAfterFrames_;
+        const uint32_t target = stale ? texture->tailMip() : texture->requestedMip();
+
+        if(target > texture->residentMip()){
+            evictions.push_back({texture, target});  }
+        else if(target < texture->residentMip()){
+            streamIns.push_back({texture, target});   }
+    }
+
+    //least important first, a few a frame like uploads: each one is an image allocation and a copy
+    std::sort(evictions.begin(), evictions.end(), [](const Pending& a, const Pending& b){
+        return a.texture->priority() < b.texture->priority(); });
+    const size_t evictCount = std::min<size_t>(evictions.size(), maxEvictionsPerFrame_);
+    for(size_t i = 0; i < evictCount; ++i){
+        evictions[i].texture->beginResidency(evictions[i].targetMip);   }
+
+    //biggest on screen first
+    std::sort(streamIns.begin(), streamIns.end(), [](const Pending& a, const Pending& b){
+        return a.texture->priority() > b.texture->priority(); });
+
+    uint32_t uploads = 0;
+    for(auto& pending : streamIns){
+        if(uploads >= maxUploadsPerFrame_) break;
+
+        auto& texture = pending.texture;
+        const VkDeviceSize currentBytes = texture->chainBytes(texture->residentMip());
+        //step toward target but stay in budget
+        uint32_t mip = pending.targetMip;
+        while(mip < texture->residentMip() &&
+              residentBytes_ - currentBytes + texture->chainBytes(mip) > budgetBytes_){
+            ++mip;  }
+        if(mip >= texture->residentMip()) continue;
+
+        //decode starts on a worker, the upload goes out with a later update
+        texture->beginResidency(mip);
+        residentBytes_ = residentBytes_ - currentBytes + texture->chainBytes(mip);
+        ++uploads;
+    }
+
+    //evictions were recorded right away, submit them this frame
+    for(size_t i = 0; i < evictCount; ++i){
+        evictions[i].texture->pollResidency(timeline_, timelineValue_, frame);   }
+}
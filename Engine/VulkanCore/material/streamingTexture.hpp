@@ -0,0 +1,154 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+#include "load_texture.hpp"
+class JDevice;
+class JBuffer;
+class JCommandBuffer;
+class JTimelineSemaphore;
+class MappedFile;
+
+
+
+//streaming 2d texture. only the small tail mips are resident when created, so it is usable immediately.
+//higher mips are streamed in by TextureStreamer at frame boundary.
+//residency change re-allocates the image: vkimage mip 0 == residentMip_ of the full chain,
+//so the sampler/shader side dont need to know anything.
+//a change never blocks the frame: the level is decoded on a worker, the upload / copy is submitted with a timeline
+//value and the new image is swapped in on a later frame once the gpu reached it. the old image is kept until
+//frames in flight are done with it.
+//the source is decoded once: the first time a file is seen its whole chain goes to the converted texture cache
+//(ktx2, kTextureCacheDir), stream ins read just their level from there
+class JStreamingTexture2D: public JTextureBase{
+public:
+    JStreamingTexture2D(JDevice& device, const std::string& path, VkFormat format, uint32_t tailSize = 128);
+    ~JStreamingTexture2D() override;
+
+    //full chain info (not the resident one)
+    uint32_t getFullWidth() const               {return fullWidth_;}
+    uint32_t getFullHeight() const              {return fullHeight_;}
+    uint32_t getFullMipLevels() const           {return fullMipLevels_;}
+
+    uint32_t residentMip() const                {return residentMip_;}
+    uint32_t tailMip() const                    {return tailMip_;}
+    uint32_t requestedMip() const               {return requestedMip_;}
+    float priority() const                      {return priority_;}
+    uint64_t lastRequestFrame() const           {return lastRequestFrame_;}
+
+    //a residency change is on its way (decode / gpu), no new one until it is swapped in
+    bool busy() const                           {return pending_ != nullptr;}
+    //mip it will have once the pending change is in, residentMip() otherwise
+    uint32_t targetMip() const;
+
+    //bytes of mip chain start from `mip`
+    VkDeviceSize chainBytes(uint32_t mip) const;
+
+    //keep the finest mip / highest priority requested in this frame
+    void request(uint32_t mip, float priority, uint64_t frame);
+
+    //start the change to `mip` (TextureStreamer::update). stream in: decode starts on a worker. evict: copy recorded
+    void beginResidency(uint32_t mip);
+    //once per frame: submit what is ready (signals the next timeline value), swap in what the gpu finished,
+    //destroy images no frame in flight uses anymore. true: residency changed this frame
+    bool pollResidency(const std::shared_ptr<JTimelineSemaphore>& timeline, uint64_t& timelineValue, uint64_t frame);
+
+    //descriptors which point to the old view need to be rewritten
+    void setOnResidencyChanged(std::function<void(const JTextureBase&)> callback) {onResidencyChanged_ = std::move(callback);}
+
+private:
+    std::string                 path_;
+    uint32_t                    fullWidth_;
+    uint32_t                    fullHeight_;
+    uint32_t                    fullMipLevels_;
+    uint32_t                    tailMip_;
+    uint32_t                    residentMip_;
+
+    uint32_t                    requestedMip_;
+    uint32_t                    finestMip_{0};      //a stream in failed: never asked below what was resident then
+    float                       priority_{0.f};
+    uint64_t                    lastRequestFrame_{0};
+
+    std::function<void(const JTextureBase&)> onResidencyChanged_;
+
+    //the change in flight
+    struct PendingResidency{
+        uint32_t                        mip;
+        std::unique_ptr<JBuffer>        staging;        //stream in only, the worker decodes into it
+        std::future<void>               decode;
+        std::unique_ptr<JCommandBuffer> commandBuffer;  //recorded once the decode is done (evict: right away)
+        VkImage                         image{VK_NULL_HANDLE};
+        VkDeviceMemory                  memory{VK_NULL_HANDLE};
+        std::shared_ptr<JTimelineSemaphore> timeline;   //shared: the texture can outlive the streamer
+        uint64_t                        timelineValue{0};   //0: not submitted yet
+    };
+    std::unique_ptr<PendingResidency> pending_;
+
+    //swapped out, frames recorded before the swap may still sample it
+    struct RetiredImage{
+        VkImage         image;
+        VkDeviceMemory  memory;
+        VkImageView     view;
+        uint64_t        frame;
+    };
+    std::vector<RetiredImage> retired_;
+
+    std::string                 mipCachePath_;      //empty: tail is mip 0, nothing to stream
+    std::future<void>           mipCacheWrite_;     //zstd + write of the chain, on a worker
+
+    //decode `mip` of the file into dst (levelSize bytes of rgba8). from the mip cache if it is there, the source
+    //otherwise (first run, cache still being written). runs on a worker
+    static void decodeLevel(const std::string& path, const std::string& mipCache, uint32_t mip, uint8_t* dst, size_t levelSize);
+    //whole chain from one decode of the source: `mip` into dst, the chain into the mip cache (written on a worker)
+    void buildMipCache(const MappedFile& file, uint32_t mip, uint8_t* dst, size_t levelSize);
+    //new image, copy staging into mip 0, blit the rest, shader read only
+    void recordStreamIn(VkCommandBuffer commandBuffer, VkBuffer staging, VkImage image, uint32_t mip);
+    //coarser mips copied out of the current image, which goes back to shader read only (still sampled)
+    void recordEvict(VkCommandBuffer commandBuffer, VkImage image, uint32_t mip);
+    void allocateImage(uint32_t mip, VkImage& image, VkDeviceMemory& memory);
+    void swapImage(uint32_t mip, VkImage image, VkDeviceMemory memory, uint64_t frame);
+    void destroyRetired(const RetiredImage& retired);
+};
+
+
+
+//---------------------------------------------------------------------------------------
+//decide which mip each streaming texture should have, at most a few uploads and evictions started per frame.
+//nothing here waits on the gpu, finished changes are picked up by the next update.
+//textures are held as weak_ptr, material owns them
+class TextureStreamer{
+public:
+    TextureStreamer(JDevice& device,
+                    VkDeviceSize budgetBytes = 1024ull * 1024ull * 1024ull,
+                    uint32_t maxUploadsPerFrame = 2,
+                    uint32_t evictAfterFrames = 120,
+                    uint32_t maxEvictionsPerFrame = 4);
+    ~TextureStreamer();
+
+    void add(const std::shared_ptr<JStreamingTexture2D>& texture);
+
+    //mip that give ~1 texel per pixel for the covered screen size
+    static uint32_t mipForScreenSize(uint32_t texWidth, uint32_t texHeight, float screenPixels);
+
+    //call at frame boundary, before recording
+    void update(uint64_t frame);
+
+    VkDeviceSize residentBytes() const          {return residentBytes_;}
+
+private:
+    JDevice& device_app;
+    VkDeviceSize budgetBytes_;
+    uint32_t maxUploadsPerFrame_;
+    uint32_t evictAfterFrames_;
+    uint32_t maxEvictionsPerFrame_;
+    VkDeviceSize residentBytes_{0};
+
+    //every upload / evict copy signals the next value
+    std::shared_ptr<JTimelineSemaphore> timeline_;
+    uint64_t timelineValue_{0};
+
+    std::vector<std::weak_ptr<JStreamingTexture2D>> textures_;
+};
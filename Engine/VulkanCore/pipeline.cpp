@@ -229,11 +229,12 @@ std::unique_ptr<JPipelineLayout> JPipelineLayout::Builder::build() const{
 ////////////////////////////////////////////////////////////
 JComputePipeline::JComputePipeline(JDevice& device, 
                                    const JShaderModule& shaderModule,
-                                   const VkPipelineLayout pipelineLayout)
+                                   const VkPipelineLayout pipelineLayout,
+                                   const std::vector<uint32_t>& specConstants)
                                    :
     device_app(device)
 {
-    createComputePipeline(pipelineLayout, shaderModule);
+    createComputePipeline(pipelineLayout, shaderModule, specConstants);
 }
 
 
@@ -243,21 +244,25 @@ JComputePipeline::~JComputePipeline(){
 
 //pname
 void JComputePipeline::createComputePipeline(const VkPipelineLayout pipelineLayout, 
-                                            const JShaderModule& shaderModule)
+                                            const JShaderModule& shaderModule,
+                                            const std::vector<uint32_t>& specConstants)
 {
-
-    VkSpecializationMapEntry entries[]={
-        {  .constantID = 0,
-          .offset= 0,
-          .size = sizeof(uint32_t)
-        }};
+    //constants the shader does not declare are ignored
+    const std::vector<uint32_t> constants = specConstants.empty() ? std::vector<uint32_t>{numSamples} : specConstants;
+
+    std::vector<VkSpecializationMapEntry> entries(constants.size());
+    for(uint32_t i = 0; i < entries.size(); ++i){
+        entries[i].constantID = i;
+        entries[i].offset     = i * sizeof(uint32_t);
+        entries[i].size       = sizeof(uint32_t);
+    }
       //dynamic get from the file
 
     VkSpecializationInfo specInfo{};
-    specInfo.mapEntryCount  = 1;
-    specInfo.pMapEntries    = entries;
-    specInfo.dataSize       = sizeof(uint32_t);
-    specInfo.pData          = &numSamples;
+    specInfo.mapEntryCount  = static_cast<uint32_t>(entries.size());
+    specInfo.pMapEntries    = entries.data();
+    specInfo.dataSize       = constants.size() * sizeof(uint32_t);
+    specInfo.pData          = constants.data();
 
 
     VkPipelineShaderStageCreateInfo stageInfo{};
@@ -125,7 +125,9 @@ private:
 class JComputePipeline{
 
   public:
-    JComputePipeline(JDevice& device, const JShaderModule& shaderModule, const VkPipelineLayout pipelineLayout);
+    //specConstants[i] -> constant_id i. empty keeps the old default: constant 0 = numSamples
+    JComputePipeline(JDevice& device, const JShaderModule& shaderModule, const VkPipelineLayout pipelineLayout,
+                     const std::vector<uint32_t>& specConstants = {});
     ~JComputePipeline();
 
     VkPipeline getComputePipeline() const {return computePipeline_;}
@@ -135,7 +137,8 @@ class JComputePipeline{
     VkPipeline computePipeline_;
 
     void createComputePipeline(const VkPipelineLayout pipelineLayout, 
-                               const JShaderModule& shaderModule);
+                               const JShaderModule& shaderModule,
+                               const std::vector<uint32_t>& specConstants);
 
     uint32_t numSamples = 1024;
 
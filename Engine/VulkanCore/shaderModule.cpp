@@ -56,7 +56,7 @@ void JShaderModule::createShaderModule(const std::vector<char>& code) {
 
 
  JShaderStages::Builder& JShaderStages::Builder::setVert(const std::string& filepath){
-    auto code = util::readFile(filepath);
+    auto code = util::readSpirv(filepath);
     vertShaderModule_.emplace(device_app.device(), code);
     
     VkPipelineShaderStageCreateInfo info{};
@@ -72,7 +72,7 @@ void JShaderModule::createShaderModule(const std::vector<char>& code) {
 
 
  JShaderStages::Builder& JShaderStages::Builder::setFrag(const std::string& filepath){
-    auto code = util::readFile(filepath);
+    auto code = util::readSpirv(filepath);
     fragShaderModule_.emplace(device_app.device(), code);
 
     VkPipelineShaderStageCreateInfo info{};
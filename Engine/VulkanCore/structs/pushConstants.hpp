@@ -23,15 +23,14 @@ struct pushTransformation{
     int inputRoughnessPath;
     int inputMetallicPath;
     int inputNormalPath;
+    int inputOcclusionPath;
+
+    //bindless: index into material buffer
+    int materialIndex;
 };
 
 
 
-struct pushBRDFStruct{
-    uint32_t BRDF_W;
-    uint32_t BRDF_H;
-    uint64_t bufferAddr;
-};
 
 
 
@@ -18,6 +18,7 @@ struct GlobalUbo {
     alignas(16) glm::mat4 view{1.f};
     alignas(16) glm::mat4 invView{1.f};
     alignas(16) glm::vec3 camPos{1.f};
+    alignas(16) glm::vec4 irradianceSH[9]{};   //rgb, w unused. PrecomputeSystem::projectIrradianceSH
 
   };
 
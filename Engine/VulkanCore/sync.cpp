@@ -30,8 +30,58 @@ JSync::~JSync(){
 
 
 
+JTimelineSemaphore::JTimelineSemaphore(JDevice& device, uint64_t initialValue):
+    device_app(device)
+{
+    VkSemaphoreTypeCreateInfo typeInfo{};
+    typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeInfo.initialValue = initialValue;
 
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &typeInfo;
+
+    VK_CHECK_RESULT(vkCreateSemaphore(device_app.device(), &semaphoreInfo, nullptr, &semaphore_));
+}
 
 
+JTimelineSemaphore::~JTimelineSemaphore(){
+    vkDestroySemaphore(device_app.device(), semaphore_, nullptr);
+}
+
+
+uint64_t JTimelineSemaphore::value() const{
+    uint64_t value = 0;
+    VK_CHECK_RESULT(vkGetSemaphoreCounterValue(device_app.device(), semaphore_, &value));
+    return value;
+}
+
+
+void JTimelineSemaphore::wait(uint64_t value) const{
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &semaphore_;
+    waitInfo.pValues = &value;
+    VK_CHECK_RESULT(vkWaitSemaphores(device_app.device(), &waitInfo, UINT64_MAX));
+}
+
+
+void JTimelineSemaphore::queueWait(VkQueue queue, uint64_t value, VkPipelineStageFlags stage) const{
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.waitSemaphoreValueCount = 1;
+    timelineInfo.pWaitSemaphoreValues = &value;
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.waitSemaphoreCount = 1;
+    submitInfo.pWaitSemaphores = &semaphore_;
+    submitInfo.pWaitDstStageMask = &stage;
+
+    VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+}
 
 
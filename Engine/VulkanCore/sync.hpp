@@ -30,3 +30,27 @@ private:
 };
 
 
+
+//counts up, each submit signals the next value. poll with value(), or block in wait()
+class JTimelineSemaphore{
+
+public:
+    JTimelineSemaphore(JDevice& device, uint64_t initialValue = 0);
+    ~JTimelineSemaphore();
+
+    NO_COPY(JTimelineSemaphore);
+
+    VkSemaphore semaphore() const {return semaphore_;}
+    uint64_t value() const;
+    void wait(uint64_t value) const;
+    //empty submit: everything submitted to queue after this waits (on the gpu) until value is reached.
+    //how another queue's results become visible here
+    void queueWait(VkQueue queue, uint64_t value, VkPipelineStageFlags stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT) const;
+
+private:
+    JDevice& device_app;
+    VkSemaphore semaphore_;
+
+};
+
+
@@ -0,0 +1,66 @@
+#include "threadPool.hpp"
+#include <deque>
+#include <thread>
+#include <vector>
+
+
+
+namespace util{
+
+struct ThreadPool::State{
+    std::mutex                          mutex;
+    std::condition_variable             wake;
+    std::deque<std::function<void()>>   jobs;
+    std::vector<std::thread>            threads;
+    bool                                stop{false};
+};
+
+
+ThreadPool& ThreadPool::instance(){
+    static ThreadPool pool;
+    return pool;
+}
+
+
+ThreadPool::ThreadPool():
+    state_(std::make_unique<State>())
+{
+    threadCount_ = static_cast<int>(std::max(1u, std::thread::hardware_concurrency())) - 1;
+    for(int t = 0; t < threadCount_; ++t){
+        state_->threads.emplace_back([state = state_.get()](){
+            for(;;){
+                std::function<void()> job;
+                {
+                    std::unique_lock<std::mutex> lock(state->mutex);
+                    state->wake.wait(lock, [&](){ return state->stop || !state->jobs.empty(); });
+                    if(state->jobs.empty()) return; //stop, and nothing left
+                    job = std::move(state->jobs.front());
+                    state->jobs.pop_front();
+                }
+                job();
+            }
+        });
+    }
+}
+
+
+ThreadPool::~ThreadPool(){
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        state_->stop = true;
+    }
+    state_->wake.notify_all();
+    for(auto& thread : state_->threads){
+        thread.join();}
+}
+
+
+void ThreadPool::submit(std::function<void()> job){
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        state_->jobs.push_back(std::move(job));
+    }
+    state_->wake.notify_one();
+}
+
+} // namespace util
@@ -0,0 +1,92 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+
+
+//worker threads that live for the whole process (hardware threads - 1, the caller of parallelFor is the last one).
+//util::parallelFor hands its helpers to it instead of spawning threads every call
+namespace util{
+
+class ThreadPool{
+public:
+    static ThreadPool& instance();
+
+    int threadCount() const             {return threadCount_;}
+    //runs on some pool thread later. job must not throw
+    void submit(std::function<void()> job);
+
+private:
+    ThreadPool();
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    struct State;
+    std::unique_ptr<State> state_;
+    int threadCount_{0};
+};
+
+
+
+//run fn(i) for i in [0, count) on the pool + the calling thread. work is handed out in chunks of `grain`
+//so rows of an image etc. stay together. returns after every index is done.
+//the caller never waits for a helper that has not started, so it can be called from inside a pool job / async worker.
+//first exception thrown by fn stops handing out chunks and is rethrown here
+template<typename Fn>
+void parallelFor(int count, int grain, Fn&& fn){
+    if(count <= 0) return;
+    grain = std::max(1, grain);
+    const int chunks = (count + grain - 1) / grain;
+    ThreadPool& pool = ThreadPool::instance();
+    const int helpers = std::min(chunks, pool.threadCount() + 1) - 1;
+
+    //shared: a helper may only get to run after this call returned, it then finds no chunk and never touches fn
+    struct Shared{
+        std::atomic<int>        next{0};
+        std::mutex              mutex;
+        std::condition_variable done;
+        int                     active{0};
+        std::exception_ptr      error;
+    };
+    auto shared = std::make_shared<Shared>();
+
+    auto work = [&fn, count, grain, chunks](Shared& s){
+        for(int chunk = s.next.fetch_add(1); chunk < chunks; chunk = s.next.fetch_add(1)){
+            try{
+                const int end = std::min(count, (chunk + 1) * grain);
+                for(int i = chunk * grain; i < end; ++i){
+                    fn(i);}
+            }catch(...){
+                std::lock_guard<std::mutex> lock(s.mutex);
+                if(!s.error){ s.error = std::current_exception(); }
+                s.next.store(chunks);   //nobody picks up more
+            }
+        }
+    };
+
+    for(int h = 0; h < helpers; ++h){
+        pool.submit([shared, work](){
+            {
+                std::lock_guard<std::mutex> lock(shared->mutex);
+                ++shared->active;
+            }
+            work(*shared);
+            std::lock_guard<std::mutex> lock(shared->mutex);
+            if(--shared->active == 0){ shared->done.notify_all(); }
+        });
+    }
+    work(*shared); //calling thread works too
+
+    //every chunk is claimed now, only wait for the helpers still inside one
+    std::unique_lock<std::mutex> lock(shared->mutex);
+    shared->done.wait(lock, [&](){ return shared->active == 0; });
+    if(shared->error){ std::rethrow_exception(shared->error); }
+}
+
+} // namespace util
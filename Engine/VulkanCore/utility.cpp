@@ -1,4 +1,5 @@
 #include "utility.hpp"
+#include <cstring>
 
 
 namespace util{
@@ -24,6 +25,22 @@ namespace util{
     }
 
 
+    std::vector<char> readSpirv(const std::string& filename) {
+        if (!std::ifstream(filename).is_open()) {
+            throw std::runtime_error("failed to open shader " + filename +
+                                     ", build compile_shaders (needs glslc) or copy it from shaders/prebuilt");
+        }
+
+        std::vector<char> code = readFile(filename);
+        uint32_t magic = 0;
+        if (code.size() >= sizeof(magic)) { std::memcpy(&magic, code.data(), sizeof(magic)); }
+        if (code.size() % 4 != 0 || magic != 0x07230203u) {
+            throw std::runtime_error("not a spir-v binary: " + filename);
+        }
+        return code;
+    }
+
+
 
     uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, VkPhysicalDevice physicalDevice){
         VkPhysicalDeviceMemoryProperties memProperties;
@@ -9,6 +9,7 @@
 #include <ktx.h>
 
 #include "global.hpp"
+#include "threadPool.hpp"   //util::parallelFor
 
 namespace util{
 
@@ -16,6 +17,8 @@ namespace util{
 
 
 std::vector<char> readFile(const std::string& filename);
+//readFile for a .spv: says which one is missing / not spir-v (built by compile_shaders, or ./compile.sh)
+std::vector<char> readSpirv(const std::string& filename);
 
 
 
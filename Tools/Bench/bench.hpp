@@ -0,0 +1,34 @@
+//JBench: microbenchmarks of the engine's hot paths, outside the product binaries (JRenderer / JIBLBaker).
+//DEBUG lines only, nothing is written
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+class JDevice;
+class JDescriptorSetLayout;
+
+
+//old scalar loop (one thread, std::atan2, getPixel) against convertEquirectangularMapToVerticalCross on a
+//synthetic rgb float equirect per width (w x w/2). prints time, Mtexel/s, speedup and the largest difference.
+//8192 needs ~1.6GB
+void benchmarkEquirectConversion(const std::vector<int>& widths);
+
+//per pixel throughput of getPixel / setPixel loops against the JBitmapView ops (fill, convert, downsample)
+//on size x size rgba, single thread
+void benchmarkBitmapAccess(int size);
+
+//a radiance .hdr: stbi_loadf (one thread) against TexUtils::decodeHdrFloat and decodeHdrRGBE (scanlines in
+//parallel), time, Mpix/s and how far the float output is from stbi's
+void benchmarkHdrDecode(const std::string& path);
+
+//allocation throughput at setCount sets of one layout: one by one, bulk, and again after reset()
+void benchmarkDescriptorAllocator(JDevice& device, const JDescriptorSetLayout& descriptorSetLayout, uint32_t setCount);
+
+//writing setCount sets of a layout of single combined image samplers at bindings 0..n-1 (material layout), all
+//imageInfo: vkUpdateDescriptorSets with a write per binding vs. one vkUpdateDescriptorSetWithTemplate
+void benchmarkDescriptorUpdates(JDevice& device, const JDescriptorSetLayout& descriptorSetLayout,
+                                const VkDescriptorImageInfo& imageInfo, uint32_t setCount);
+
+//descriptor benches on a small window + device, with the viewer's material layout (RenderingSystem)
+void runDescriptorBench(uint32_t setCount);
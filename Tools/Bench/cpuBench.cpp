@@ -0,0 +1,256 @@
+#include "bench.hpp"
+#include "VulkanCore/material/bitmap.hpp"
+#include "VulkanCore/material/cubemapUtils.hpp"
+#include "VulkanCore/material/imageDecode.hpp"
+#include <stb_image.h>
+#include "VulkanCore/utility.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////////
+//equirect -> vertical cross (JBench --equirect)
+
+namespace {
+
+//the loop convertEquirectangularMapToVerticalCross had before: one thread, std::atan2, getPixel / setPixel
+JBitmap referenceEquirectToVerticalCross(const JBitmap& bitmap){
+    const int faceSize = bitmap.w_ / 4;
+    JBitmap result(faceSize * 3, faceSize * 4, bitmap.channels_, bitmap.format_);
+    const glm::ivec2 kFaceOffsets[] = {
+        glm::ivec2(faceSize    , faceSize * 3),
+        glm::ivec2(0           , faceSize    ),
+        glm::ivec2(faceSize    , faceSize    ),
+        glm::ivec2(faceSize * 2, faceSize    ),
+        glm::ivec2(faceSize    , 0           ),
+        glm::ivec2(faceSize    , faceSize * 2)
+    };
+    const int clampW = bitmap.w_ - 1;
+    const int clampH = bitmap.h_ - 1;
+
+    for(int face = 0; face != 6; face++){
+        for(int i = 0; i != faceSize; i++){
+            for(int j = 0; j != faceSize; j++){
+                const glm::vec3 P = faceCoordsToXYZ(i, j, face, faceSize);
+                const float R     = hypot(P.x, P.y);
+                const float theta = atan2(P.y, P.x);
+                const float phi   = atan2(P.z, R);
+                const float Uf = float(2.0f * faceSize * (theta + M_PI) / M_PI);
+                const float Vf = float(2.0f * faceSize * (M_PI / 2.f - phi) / M_PI);
+                const int U1 = glm::clamp(int(floor(Uf)), 0, clampW);
+                const int V1 = glm::clamp(int(floor(Vf)), 0, clampH);
+                const int U2 = glm::clamp(U1 + 1, 0, clampW);
+                const int V2 = glm::clamp(V1 + 1, 0, clampH);
+                const float s = Uf - U1;
+                const float t = Vf - V1;
+                const glm::vec4 color =
+                    bitmap.getPixel(U1, V1) * (1 - s) * (1 - t) +
+                    bitmap.getPixel(U2, V1) * (s)     * (1 - t) +
+                    bitmap.getPixel(U1, V2) * (1 - s) * (t)     +
+                    bitmap.getPixel(U2, V2) * (s)     * (t);
+                result.setPixel(i + kFaceOffsets[face].x, j + kFaceOffsets[face].y, color);
+            }
+        }
+    }
+    return result;
+}
+
+
+//smooth hdr-ish rgb float equirect, w x w/2
+JBitmap syntheticEquirect(int width){
+    const int height = width / 2;
+    JBitmap bitmap(width, height, 3, eJBitmapFormat_Float);
+    float* data = reinterpret_cast<float*>(bitmap.data_.data());
+    util::parallelFor(height, 16, [&](int y){
+        const float v = float(y) / height;
+        for(int x = 0; x < width; ++x){
+            const float u = float(x) / width;
+            float* p = data + (size_t(y) * width + x) * 3;
+            p[0] = 1.0f + std::sin(u * 37.0f) * std::cos(v * 23.0f);
+            p[1] = 0.5f + 0.5f * std::sin((u + v) * 51.0f);
+            p[2] = 4.0f * v * v + 0.1f;}
+    });
+    return bitmap;
+}
+
+double msSince(std::chrono::steady_clock::time_point start){
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+
+void benchmarkEquirectConversion(const std::vector<int>& widths){
+    for(int width : widths){
+        const JBitmap equirect = syntheticEquirect(width);
+        const int faceSize = width / 4;
+
+        auto start = std::chrono::steady_clock::now();
+        const JBitmap reference = referenceEquirectToVerticalCross(equirect);
+        const double referenceMs = msSince(start);
+
+        //best of 3, first run also warms the pool / page faults
+        double kernelMs = 0.0;
+        JBitmap cross;
+        for(int run = 0; run < 3; ++run){
+            start = std::chrono::steady_clock::now();
+            cross = convertEquirectangularMapToVerticalCross(equirect);
+            const double ms = msSince(start);
+            kernelMs = run == 0 ? ms : std::min(kernelMs, ms);}
+
+        const float* a = reinterpret_cast<const float*>(reference.data_.data());
+        const float* b = reinterpret_cast<const float*>(cross.data_.data());
+        float maxDiff = 0.0f;
+        for(size_t i = 0, n = reference.data_.size() / sizeof(float); i < n; ++i){
+            maxDiff = std::max(maxDiff, std::fabs(a[i] - b[i]));}
+
+        const double texels = 6.0 * faceSize * faceSize;
+        std::cout << "DEBUG: bench equirect " << width << "x" << width / 2 << " -> " << faceSize << "^2 faces: reference "
+                  << referenceMs << " ms (" << texels / referenceMs / 1000.0 << " Mtexel/s), "
+                  << equirectKernelName() << " x" << util::ThreadPool::instance().threadCount() + 1 << " threads "
+                  << kernelMs << " ms (" << texels / kernelMs / 1000.0 << " Mtexel/s), speedup "
+                  << referenceMs / kernelMs << "x, max abs diff " << maxDiff << std::endl;
+    }
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////////
+//getPixel / setPixel vs JBitmapView (JBench --bitmap)
+
+namespace {
+
+//best of 3, in Mpixel/s
+template<typename Fn>
+double mpixPerSecond(double pixels, Fn&& fn){
+    double best = 0.0;
+    for(int run = 0; run < 3; ++run){
+        const auto start = std::chrono::steady_clock::now();
+        fn();
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        best = std::max(best, pixels / ms / 1000.0);}
+    return best;
+}
+
+float maxDifference(const JBitmap& a, const JBitmap& b){
+    const float* x = reinterpret_cast<const float*>(a.data_.data());
+    const float* y = reinterpret_cast<const float*>(b.data_.data());
+    float diff = 0.0f;
+    for(size_t i = 0, n = a.data_.size() / sizeof(float); i < n; ++i){
+        diff = std::max(diff, std::fabs(x[i] - y[i]));}
+    return diff;
+}
+
+void report(const char* name, double before, double after, float diff){
+    std::cout << "DEBUG: bench bitmap " << name << ": getPixel/setPixel " << before << " Mpix/s, JBitmapView "
+              << after << " Mpix/s (" << after / before << "x), max abs diff " << diff << std::endl;
+}
+
+} // namespace
+
+
+void benchmarkBitmapAccess(int size){
+    const double pixels = double(size) * size;
+    const glm::vec4 color(0.25f, 0.5f, 0.75f, 1.0f);
+
+    JBitmap rgba8(size, size, 4, eJBitmapFormat_UnsignedByte);
+    for(size_t i = 0; i < rgba8.data_.size(); ++i){
+        rgba8.data_[i] = uint8_t(i * 2654435761u >> 24);}
+    JBitmap before(size, size, 4, eJBitmapFormat_Float);
+    JBitmap after(size, size, 4, eJBitmapFormat_Float);
+
+    //fill: solid color textures
+    double slow = mpixPerSecond(pixels, [&](){
+        for(int y = 0; y < size; ++y){
+            for(int x = 0; x < size; ++x){
+                before.setPixel(x, y, color);}}
+    });
+    double fast = mpixPerSecond(pixels, [&](){
+        fillPixels(JBitmapView<eJBitmapFormat_Float, 4>(after), {color.r, color.g, color.b, color.a});
+    });
+    report("fill rgba32f", slow, fast, maxDifference(before, after));
+
+    //convert: unsigned byte -> float
+    slow = mpixPerSecond(pixels, [&](){
+        for(int y = 0; y < size; ++y){
+            for(int x = 0; x < size; ++x){
+                before.setPixel(x, y, rgba8.getPixel(x, y));}}
+    });
+    fast = mpixPerSecond(pixels, [&](){
+        convertPixels(JBitmapView<eJBitmapFormat_UnsignedByte, 4, false>(rgba8), JBitmapView<eJBitmapFormat_Float, 4>(after));
+    });
+    report("convert rgba8 -> rgba32f", slow, fast, maxDifference(before, after));
+
+    //resample: 2x2 box down, one mip level. throughput in source pixels
+    const int half = size / 2;
+    JBitmap mipBefore(half, half, 4, eJBitmapFormat_Float);
+    JBitmap mipAfter(half, half, 4, eJBitmapFormat_Float);
+    slow = mpixPerSecond(pixels, [&](){
+        for(int y = 0; y < half; ++y){
+            for(int x = 0; x < half; ++x){
+                const glm::vec4 sum = after.getPixel(2 * x, 2 * y)     + after.getPixel(2 * x + 1, 2 * y) +
+                                      after.getPixel(2 * x, 2 * y + 1) + after.getPixel(2 * x + 1, 2 * y + 1);
+                mipBefore.setPixel(x, y, sum * 0.25f);}}
+    });
+    fast = mpixPerSecond(pixels, [&](){
+        downsample2x(JBitmapView<eJBitmapFormat_Float, 4, false>(after), JBitmapView<eJBitmapFormat_Float, 4>(mipAfter));
+    });
+    report("downsample rgba32f", slow, fast, maxDifference(mipBefore, mipAfter));
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////////
+//radiance hdr decode (JBench --hdr)
+
+void benchmarkHdrDecode(const std::string& path){
+    const MappedFile file(path);
+    TexUtils::HdrInfo hdr;
+    if(!TexUtils::parseHdr(file, hdr)){
+        throw std::runtime_error("benchmarkHdrDecode: " + path + " is not a radiance file the decoder indexes");}
+    const double pixels = double(hdr.width) * hdr.height;
+
+    //best of 3 in ms, first run also warms the pool / page cache
+    auto bestMs = [](auto&& fn){
+        double best = 0.0;
+        for(int run = 0; run < 3; ++run){
+            const auto start = std::chrono::steady_clock::now();
+            fn();
+            const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            best = run == 0 ? ms : std::min(best, ms);}
+        return best;
+    };
+
+    std::vector<float> reference;
+    const double stbiMs = bestMs([&](){
+        int w, h, channels;
+        float* pixels = stbi_loadf_from_memory(file.data(), static_cast<int>(file.size()), &w, &h, &channels, 4);
+        if(!pixels) throw std::runtime_error("benchmarkHdrDecode: stbi failed on " + path);
+        reference.assign(pixels, pixels + size_t(w) * h * 4);
+        stbi_image_free(pixels);
+    });
+
+    std::vector<float> decoded(size_t(hdr.width) * hdr.height * 4);
+    const double floatMs = bestMs([&](){ TexUtils::decodeHdrFloat(file, hdr, 4, decoded.data()); });
+
+    std::vector<uint8_t> rgbe(size_t(hdr.width) * hdr.height * 4);
+    const double rgbeMs = bestMs([&](){ TexUtils::decodeHdrRGBE(file, hdr, rgbe.data()); });
+
+    float maxDiff = 0.0f;
+    for(size_t i = 0; i < decoded.size(); ++i){
+        maxDiff = std::max(maxDiff, std::fabs(decoded[i] - reference[i]));}
+
+    std::cout << "DEBUG: bench hdr " << hdr.width << "x" << hdr.height << (hdr.rle ? " rle" : " flat") << ": stbi_loadf "
+              << stbiMs << " ms (" << pixels / stbiMs / 1000.0 << " Mpix/s), decodeHdrFloat " << floatMs << " ms ("
+              << pixels / floatMs / 1000.0 << " Mpix/s), decodeHdrRGBE " << rgbeMs << " ms (" << pixels / rgbeMs / 1000.0
+              << " Mpix/s, " << rgbe.size() / (1024 * 1024) << " vs " << decoded.size() * sizeof(float) / (1024 * 1024)
+              << " MB), max abs diff " << maxDiff << std::endl;
+}
@@ -0,0 +1,108 @@
+#include "bench.hpp"
+#include "VulkanCore/window.hpp"
+#include "VulkanCore/device.hpp"
+#include "VulkanCore/descriptor/descriptor.hpp"
+#include "VulkanCore/descriptor/descriptorAllocator.hpp"
+#include "VulkanCore/material/load_texture.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+
+
+
+void benchmarkDescriptorAllocator(JDevice& device, const JDescriptorSetLayout& descriptorSetLayout, uint32_t setCount){
+    auto msSince = [](std::chrono::steady_clock::time_point start){
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();};
+    auto report = [&](const char* what, double ms, const JDescriptorAllocator& allocator){
+        std::cout << "DEBUG: descriptor bench " << what << ": " << setCount << " sets in " << ms << " ms ("
+                  << (ms > 0.0 ? setCount / ms * 1000.0 : 0.0) << " sets/s), " << allocator.poolCount() << " pools" << std::endl;};
+
+    std::vector<VkDescriptorSet> sets(setCount);
+    JDescriptorAllocator allocator(device, 10);
+
+    auto start = std::chrono::steady_clock::now();
+    for(uint32_t i = 0; i < setCount; ++i){
+        sets[i] = allocator.allocateDescriptorSet(descriptorSetLayout);}
+    report("one by one", msSince(start), allocator);
+
+    //same pools again, nothing created
+    allocator.reset();
+    start = std::chrono::steady_clock::now();
+    for(uint32_t i = 0; i < setCount; ++i){
+        sets[i] = allocator.allocateDescriptorSet(descriptorSetLayout);}
+    report("one by one after reset", msSince(start), allocator);
+
+    //bulk, 256 a call like a per frame batch
+    allocator.reset();
+    start = std::chrono::steady_clock::now();
+    for(uint32_t i = 0; i < setCount; i += 256){
+        allocator.allocateDescriptorSets(descriptorSetLayout, std::min(256u, setCount - i), sets.data() + i);}
+    report("bulk 256", msSince(start), allocator);
+
+    JDescriptorAllocator bulkAllocator(device, 10);
+    start = std::chrono::steady_clock::now();
+    bulkAllocator.allocateDescriptorSets(descriptorSetLayout, setCount, sets.data());
+    report("bulk all, cold", msSince(start), bulkAllocator);
+}
+
+
+void benchmarkDescriptorUpdates(JDevice& device, const JDescriptorSetLayout& descriptorSetLayout,
+                                const VkDescriptorImageInfo& imageInfo, uint32_t setCount){
+    auto msSince = [](std::chrono::steady_clock::time_point start){
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();};
+    auto report = [&](const char* what, double ms){
+        std::cout << "DEBUG: descriptor bench " << what << ": " << setCount << " sets in " << ms << " ms ("
+                  << (ms > 0.0 ? setCount / ms * 1000.0 : 0.0) << " sets/s)" << std::endl;};
+
+    std::vector<VkDescriptorSet> sets(setCount);
+    JDescriptorAllocator allocator(device, 10);
+    allocator.allocateDescriptorSets(descriptorSetLayout, setCount, sets.data());
+
+    const uint32_t descriptorCount = descriptorSetLayout.templateDescriptorCount();
+    std::vector<JDescriptorData> data(descriptorCount);
+    std::vector<VkWriteDescriptorSet> writes(descriptorCount);
+    for(uint32_t i = 0; i < descriptorCount; ++i){
+        data[i].image = imageInfo;
+        writes[i] = {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstBinding = i,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .pImageInfo = &data[i].image,  };
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for(VkDescriptorSet set : sets){
+        for(auto& write : writes){ write.dstSet = set; }
+        vkUpdateDescriptorSets(device.device(), descriptorCount, writes.data(), 0, nullptr);}
+    report("vkUpdateDescriptorSets", msSince(start));
+
+    start = std::chrono::steady_clock::now();
+    for(VkDescriptorSet set : sets){
+        descriptorSetLayout.update(set, data.data());}
+    report("update template", msSince(start));
+}
+
+
+
+void runDescriptorBench(uint32_t setCount){
+    JWindow window(64, 64, "JBench");
+    JDevice device(window);
+
+    //0: albedo , 1: occlusion/roughness/metallic packed, 2: normal. same as the viewer's
+    auto materialLayout = JDescriptorSetLayout::Builder{device}
+        .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
+        .addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
+        .addBinding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
+        .build();
+
+    benchmarkDescriptorAllocator(device, *materialLayout, setCount);
+
+    //material updates: write structs vs template, on a default solid color
+    SamplerManager samplerManager(device);
+    JSolidColor texture(device, 1.0f, 1.0f, 1.0f);
+    benchmarkDescriptorUpdates(device, *materialLayout,
+                               texture.getDescriptorImageInfo(samplerManager.getSampler(SamplerType::TextureGlobal)), setCount);
+}
@@ -0,0 +1,81 @@
+//JBench: the engine's microbenchmarks, one binary off the product ones. every bench prints DEBUG lines and
+//returns, nothing is written. build with cmake -DJRENDERER_BUILD_BENCH=ON
+//
+//  JBench --equirect [1024,2048,4096,8192]   old vs current equirect -> cross conversion
+//  JBench --bitmap [4096]                    getPixel / setPixel vs JBitmapView per pixel
+//  JBench --hdr <file.hdr>                   stbi_loadf vs the parallel radiance decoder
+//  JBench --descriptors [10000]        descriptor set allocation and updates (write structs vs template),
+//                                      material layout. opens a small window for the device
+#include "bench.hpp"
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+
+namespace{
+
+struct Options{
+    std::vector<int> equirect;              //equirect widths, empty: no benchmark
+    uint32_t    bitmap              = 0;    //bitmap size, 0: no benchmark
+    std::string hdr;                        //radiance file, empty: no benchmark
+    uint32_t    descriptorSets      = 0;    //0: no benchmark
+};
+
+void printUsage(){
+    std::cout << "usage: JBench [--equirect [w,w,...]] [--bitmap [size]] [--hdr file] [--descriptors [sets]]" << std::endl;
+}
+
+bool parseArgs(int argc, char** argv, Options& options){
+    for(int i = 1; i < argc; ++i){
+        const std::string arg = argv[i];
+        //optional value: the next argument unless it is another option
+        auto optional = [&](uint32_t fallback){
+            return (i + 1 < argc && argv[i + 1][0] != '-') ? static_cast<uint32_t>(std::stoul(argv[++i])) : fallback;};
+
+        if(arg == "--equirect"){
+            std::string widths = "1024,2048,4096,8192";
+            if(i + 1 < argc && argv[i + 1][0] != '-') widths = argv[++i];
+            std::stringstream list(widths);
+            for(std::string width; std::getline(list, width, ',');){
+                options.equirect.push_back(std::stoi(width));}
+        }
+        else if(arg == "--bitmap")              options.bitmap = optional(4096);
+        else if(arg == "--hdr"){
+            if(i + 1 >= argc) throw std::runtime_error("missing value after " + arg);
+            options.hdr = argv[++i];}
+        else if(arg == "--descriptors")         options.descriptorSets = optional(10000);
+        else if(arg == "-h" || arg == "--help") return false;
+        else                                    throw std::runtime_error("unknown option " + arg);
+    }
+    return !options.equirect.empty() || options.bitmap > 0 || !options.hdr.empty() || options.descriptorSets > 0;
+}
+
+} // namespace
+
+
+
+int main(int argc, char** argv){
+    Options options;
+    try{
+        if(!parseArgs(argc, argv, options)){
+            printUsage();
+            return 2;}
+        if(!options.equirect.empty()){
+            benchmarkEquirectConversion(options.equirect);}
+        if(options.bitmap > 0){
+            benchmarkBitmapAccess(static_cast<int>(options.bitmap));}
+        if(!options.hdr.empty()){
+            benchmarkHdrDecode(options.hdr);}
+        if(options.descriptorSets > 0){
+            runDescriptorBench(options.descriptorSets);}
+    }
+    catch(const std::exception& e){
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return 0;
+}
@@ -0,0 +1,10 @@
+# cmake -DBAKER=<JIBLBaker> -DOUTPUT=<brdfLut.inc> -DFALLBACK=<committed brdfLut.inc> -P bakeBrdfLut.cmake
+# bakes the lut with JIBLBaker, the committed copy (same size / samples) when that fails
+execute_process(COMMAND ${BAKER} --brdf-inc ${OUTPUT} RESULT_VARIABLE result)
+if(NOT result EQUAL 0 OR NOT EXISTS ${OUTPUT})
+  message(WARNING "JIBLBaker --brdf-inc failed (${result}), using ${FALLBACK}")
+  execute_process(COMMAND ${CMAKE_COMMAND} -E copy ${FALLBACK} ${OUTPUT} RESULT_VARIABLE result)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "cant copy ${FALLBACK} to ${OUTPUT}")
+  endif()
+endif()
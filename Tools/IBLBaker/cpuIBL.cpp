@@ -0,0 +1,420 @@
+#include "cpuIBL.hpp"
+#include "Renderers/precomputeCommon.hpp"
+#include "VulkanCore/material/imageDecode.hpp"
+#include "VulkanCore/material/cubemapUtils.hpp"
+#include "VulkanCore/material/bitmap.hpp"
+#include "VulkanCore/utility.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+
+
+JCpuCubemap::JCpuCubemap(uint32_t faceSize, uint32_t mipLevels):
+    faceSize_(faceSize), mipLevels_(mipLevels)
+{
+    size_t total = 0;
+    for(uint32_t mip = 0; mip < mipLevels_; ++mip){
+        levelOffsets_.push_back(total);
+        total += size_t(levelSize(mip)) * levelSize(mip) * 4 * 6;}
+    texels_.resize(total, 0.0f);
+}
+
+
+JCpuCubemap JCpuCubemap::fromEquirect(const std::string& path){
+    MappedFile file(path);
+    int width, height, fileChannels;
+    if(!TexUtils::queryImageInfo(file, width, height, fileChannels) || width <= 0 || height <= 0){
+        throw std::runtime_error("JCpuCubemap: failed to load ' " + path + " '");}
+
+    //same decode + resample as JCubemap's cpu path, into half faces
+    TexUtils::HdrInfo hdr;
+    const bool isRGBE = TexUtils::parseHdr(file, hdr);
+    JBitmap in = isRGBE ? JBitmap(width, height, 4, eJBitmapFormat_UnsignedByte)
+                        : JBitmap(width, height, 4, eJBitmapFormat_Float);
+    if(isRGBE){
+        TexUtils::decodeHdrRGBE(file, hdr, in.data_.data());}
+    else{
+        TexUtils::decodeInto(file, 4, true, in.data_.data(), in.data_.size());}
+
+    const uint32_t faceSize = static_cast<uint32_t>(width / 4);
+    const uint32_t mipLevels = static_cast<uint32_t>(std::floor(std::log2(faceSize))) + 1;
+    const size_t faceTexels = size_t(faceSize) * faceSize * 4;
+    std::vector<uint16_t> halfFaces(faceTexels * 6);
+    if(isRGBE){
+        convertRGBEEquirectToCubeMapFaces(in, halfFaces.data(), eJBitmapFormat_Half);}
+    else{
+        convertEquirectangularMapToCubeMapFaces(in, halfFaces.data(), eJBitmapFormat_Half);}
+
+    JCpuCubemap cube(faceSize, mipLevels);
+    cube.contentHash_ = TexUtils::equirectCubeCacheKey(file, "cpu", faceSize, kBakedMapFormat);
+
+    //mips: 2x2 box in half, in place per face (= the linear blit chain for power of two faces), then to float
+    util::parallelFor(6, 1, [&](int f){
+        uint16_t* src = halfFaces.data() + faceTexels * f;
+        for(uint32_t mip = 0; mip < mipLevels; ++mip){
+            const int size = int(cube.levelSize(mip));
+            if(mip > 0){
+                const int srcSize = int(cube.levelSize(mip - 1));
+                downsample2x(JBitmapView<eJBitmapFormat_Half, 4, false>(src, srcSize, srcSize),
+                             JBitmapView<eJBitmapFormat_Half, 4>(src, size, size));}
+            halfToFloatN(src, cube.face(mip, uint32_t(f)), size_t(size) * size * 4);
+        }
+    });
+
+    std::cout << "DEBUG: cpu cubemap " << path << " face " << faceSize << ", " << mipLevels << " mips" << std::endl;
+    return cube;
+}
+
+
+__m128 JCpuCubemap::bilinear(uint32_t mip, uint32_t faceIndex, float s, float t) const{
+    const int size = int(levelSize(mip));
+    const float u = s * float(size) - 0.5f;
+    const float v = t * float(size) - 0.5f;
+    const float fu = std::floor(u);
+    const float fv = std::floor(v);
+    const int x0 = std::clamp(int(fu), 0, size - 1),  x1 = std::clamp(int(fu) + 1, 0, size - 1);
+    const int y0 = std::clamp(int(fv), 0, size - 1),  y1 = std::clamp(int(fv) + 1, 0, size - 1);
+
+    const float* texels = face(mip, faceIndex);
+    const __m128 c00 = _mm_loadu_ps(texels + (size_t(y0) * size + x0) * 4);
+    const __m128 c10 = _mm_loadu_ps(texels + (size_t(y0) * size + x1) * 4);
+    const __m128 c01 = _mm_loadu_ps(texels + (size_t(y1) * size + x0) * 4);
+    const __m128 c11 = _mm_loadu_ps(texels + (size_t(y1) * size + x1) * 4);
+
+    const __m128 au = _mm_set1_ps(u - fu);
+    const __m128 top    = _mm_add_ps(c00, _mm_mul_ps(_mm_sub_ps(c10, c00), au));
+    const __m128 bottom = _mm_add_ps(c01, _mm_mul_ps(_mm_sub_ps(c11, c01), au));
+    return _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), _mm_set1_ps(v - fv)));
+}
+
+
+__m128 JCpuCubemap::sample(const glm::vec3& dir, float lod) const{
+    //vulkan spec cube face selection: major axis -> layer, sc / tc
+    const glm::vec3 a = glm::abs(dir);
+    uint32_t faceIndex;
+    float sc, tc, ma;
+    if(a.x >= a.y && a.x >= a.z){
+        faceIndex = dir.x >= 0.0f ? 0 : 1;
+        sc = dir.x >= 0.0f ? -dir.z : dir.z;    tc = -dir.y;    ma = a.x;}
+    else if(a.y >= a.z){
+        faceIndex = dir.y >= 0.0f ? 2 : 3;
+        sc = dir.x;    tc = dir.y >= 0.0f ? dir.z : -dir.z;     ma = a.y;}
+    else{
+        faceIndex = dir.z >= 0.0f ? 4 : 5;
+        sc = dir.z >= 0.0f ? dir.x : -dir.x;    tc = -dir.y;    ma = a.z;}
+    const float s = 0.5f * (sc / ma + 1.0f);
+    const float t = 0.5f * (tc / ma + 1.0f);
+
+    lod = std::clamp(lod, 0.0f, float(mipLevels_ - 1));
+    const uint32_t level = uint32_t(lod);
+    const float blend = lod - float(level);
+    const __m128 c0 = bilinear(level, faceIndex, s, t);
+    if(blend <= 0.0f || level + 1 >= mipLevels_) return c0;
+    const __m128 c1 = bilinear(level + 1, faceIndex, s, t);
+    return _mm_add_ps(c0, _mm_mul_ps(_mm_sub_ps(c1, c0), _mm_set1_ps(blend)));
+}
+
+
+void JCpuCubemap::writeKtx2(const std::string& path, uint32_t levelCount) const{
+    levelCount = std::min(levelCount, mipLevels_);
+    std::vector<VkBufferImageCopy> regions;
+    const VkDeviceSize size = TexUtils::Ktx2ReadbackRegions(kBakedMapFormat, faceSize_, faceSize_, levelCount, 6, regions);
+
+    //pack like a gpu readback would, then the same writer the viewer uses
+    std::vector<uint8_t> packed(size);
+    for(const VkBufferImageCopy& region : regions){
+        const uint32_t mip = region.imageSubresource.mipLevel;
+        const uint32_t f   = region.imageSubresource.baseArrayLayer;
+        floatToHalfN(face(mip, f), reinterpret_cast<uint16_t*>(packed.data() + region.bufferOffset),
+                     size_t(region.imageExtent.width) * region.imageExtent.height * 4);
+    }
+    TexUtils::WriteKtx2FromReadback(packed.data(), regions, kBakedMapFormat, faceSize_, faceSize_, levelCount, 6, path);
+}
+
+
+
+
+namespace CpuIBL{
+
+namespace{
+
+//the shaders' random(), in float like the gpu
+float shaderRandom(float x, float y){
+    const float dt = x * 12.9898f + y * 78.233f;
+    const float sn = dt - 3.14f * std::floor(dt / 3.14f);   //glsl mod
+    const float v = std::sin(sn) * 43758.5453f;
+    return v - std::floor(v);
+}
+
+//computePrefilIrrad.comp uvToXYZ
+glm::vec3 uvToXYZ(uint32_t faceIndex, float u, float v){
+    switch(faceIndex){
+        case 0:  return glm::vec3( 1.0f,  -v,   -u);    // +X
+        case 1:  return glm::vec3(-1.0f,  -v,    u);    // -X
+        case 2:  return glm::vec3(    u,  1.0f,  v);    // +Y
+        case 3:  return glm::vec3(    u, -1.0f, -v);    // -Y
+        case 4:  return glm::vec3(    u,  -v,  1.0f);   // +Z
+        default: return glm::vec3(   -u,  -v, -1.0f);   // -Z
+    }
+}
+
+//generate_TB_normal
+glm::mat3 frameLambertian(const glm::vec3& normal){
+    glm::vec3 bitangent(0.0f, 1.0f, 0.0f);
+    const float NdotUp = normal.y;
+    if(1.0f - std::abs(NdotUp) <= 0.0000001f){
+        bitangent = NdotUp > 0.0f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 0.0f, -1.0f);}
+    const glm::vec3 tangent = glm::normalize(glm::cross(bitangent, normal));
+    bitangent = glm::cross(normal, tangent);
+    return glm::mat3(tangent, bitangent, normal);
+}
+
+//generate_TB_GGX, frame rotated by the per texel phi jitter
+glm::mat3 frameGGX(const glm::vec3& normal){
+    const glm::vec3 up = std::abs(normal.z) < 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+    const glm::vec3 tangentX = glm::normalize(glm::cross(up, normal));
+    const glm::vec3 tangentY = glm::normalize(glm::cross(normal, tangentX));
+    const float jitter = shaderRandom(normal.x, normal.z) * 0.1f;
+    const float c = std::cos(jitter);
+    const float s = std::sin(jitter);
+    return glm::mat3(c * tangentX + s * tangentY, c * tangentY - s * tangentX, normal);
+}
+
+//the shader's main: every texel of 6 size x size faces (rgba, face after face) from one sample run.
+//rows go over all threads
+void filterFaces(const JCpuCubemap& env, bool ggx, const std::vector<PrefilterSample>& table, const SampleRun& run,
+                 uint32_t size, float* faces){
+    //one row of one face per task
+    util::parallelFor(int(size * 6), 1, [&](int task){
+        const uint32_t f = uint32_t(task) / size;
+        const uint32_t y = uint32_t(task) % size;
+        float* row = faces + (size_t(f) * size + y) * size * 4;
+        const float v = (float(y) + 0.5f) / float(size) * 2.0f - 1.0f;
+        for(uint32_t x = 0; x < size; ++x){
+            const float u = (float(x) + 0.5f) / float(size) * 2.0f - 1.0f;
+            const glm::vec3 N = glm::normalize(uvToXYZ(f, u, v));
+            const glm::mat3 TBN = ggx ? frameGGX(N) : frameLambertian(N);
+
+            __m128 color = _mm_setzero_ps();
+            float weights = 0.0f;
+            for(uint32_t i = run.offset; i < run.offset + run.count; ++i){
+                const PrefilterSample& s = table[i];
+                const float weight = ggx ? s.z : 1.0f;
+                const glm::vec3 L = TBN * glm::vec3(s.x, s.y, s.z);
+                color = _mm_add_ps(color, _mm_mul_ps(env.sample(L, s.lod), _mm_set1_ps(weight)));
+                weights += weight;
+            }
+            color = _mm_div_ps(color, _mm_set1_ps(std::max(weights, 1e-6f)));
+            _mm_storeu_ps(row + x * 4, color);
+            row[x * 4 + 3] = 1.0f;
+        }
+    });
+}
+
+//roughness goes over the whole chain the viewer allocates, like levelRoughness there
+uint32_t roughnessMipCount(uint32_t distribution, uint32_t faceSize, uint32_t levelCount){
+    const uint32_t fullMips = static_cast<uint32_t>(std::floor(std::log2(faceSize))) + 1;
+    return distribution == Distribution_GGX ? fullMips : levelCount;
+}
+
+} // namespace
+
+
+
+JCpuCubemap prefilter(const JCpuCubemap& env, uint32_t distribution, uint32_t faceSize, uint32_t levelCount,
+                      const std::vector<uint32_t>& budgets){
+    const uint32_t fullMips = static_cast<uint32_t>(std::floor(std::log2(faceSize))) + 1;
+    levelCount = std::clamp(levelCount, 1u, std::min<uint32_t>(fullMips, static_cast<uint32_t>(budgets.size())));
+    JCpuCubemap dst(faceSize, levelCount);
+
+    const uint32_t roughnessMips = roughnessMipCount(distribution, faceSize, levelCount);
+    const bool ggx = distribution == Distribution_GGX;
+
+    for(uint32_t mip = 0; mip < levelCount; ++mip){
+        const auto start = std::chrono::steady_clock::now();
+        const uint32_t size = dst.levelSize(mip);
+        const float roughness = levelRoughness(distribution, mip, roughnessMips);
+
+        std::vector<PrefilterSample> table;
+        const uint32_t count = (ggx && mip == 0) ? 1u : budgets[mip];
+        const SampleRun run = appendSamples(table, distribution, roughness, count, env.faceSize(), size, size);
+        filterFaces(env, ggx, table, run, size, dst.face(mip, 0));
+
+        std::cout << "DEBUG: cpu prefilter mip " << mip << " (" << size << "^2, " << run.count << " samples) "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms" << std::endl;
+    }
+    return dst;
+}
+
+
+
+std::vector<uint32_t> calibrate(const JCpuCubemap& env, uint32_t distribution, uint32_t faceSize, uint32_t levelCount,
+                                uint32_t sampleCount, float maxError){
+    const uint32_t fullMips = static_cast<uint32_t>(std::floor(std::log2(faceSize))) + 1;
+    levelCount = std::clamp(levelCount, 1u, fullMips);
+    const uint32_t roughnessMips = roughnessMipCount(distribution, faceSize, levelCount);
+    const bool ggx = distribution == Distribution_GGX;
+    const std::vector<uint32_t> candidates = calibrationCandidates(sampleCount);
+
+    const size_t probeFloats = size_t(kProbeSize) * kProbeSize * 6 * 4;
+    std::vector<float> reference(probeFloats), result(probeFloats);
+    std::vector<uint32_t> budgets(levelCount, sampleCount);
+    for(uint32_t level = 0; level < levelCount; ++level){
+        const float roughness = levelRoughness(distribution, level, roughnessMips);
+        //mirror: every ggx sample is N itself
+        if(ggx && roughness == 0.0f){
+            budgets[level] = 1;
+            continue;}
+
+        //lod depends on the real mip size, the probe only picks which directions get compared
+        const uint32_t dstW = std::max(1u, faceSize >> level);
+        std::vector<PrefilterSample> table;
+        filterFaces(env, ggx, table, appendSamples(table, distribution, roughness, kReferenceSampleCount, env.faceSize(), dstW, dstW),
+                    kProbeSize, reference.data());
+
+        //relative rms of rgb over all probe texels, first candidate under maxError wins
+        for(uint32_t count : candidates){
+            table.clear();
+            filterFaces(env, ggx, table, appendSamples(table, distribution, roughness, count, env.faceSize(), dstW, dstW),
+                        kProbeSize, result.data());
+            double errorSum = 0.0, referenceSum = 0.0;
+            for(size_t i = 0; i < probeFloats; i += 4){
+                for(size_t ch = 0; ch < 3; ++ch){
+                    const double d = double(result[i + ch]) - reference[i + ch];
+                    errorSum += d * d;
+                    referenceSum += double(reference[i + ch]) * reference[i + ch];
+                }
+            }
+            //black probe: anything passes
+            const double error = referenceSum > 0.0 ? std::sqrt(errorSum / referenceSum) : 0.0;
+            if(error <= maxError){
+                budgets[level] = count;
+                break;}
+        }
+    }
+    return budgets;
+}
+
+
+
+std::vector<uint16_t> brdfLut(uint32_t width, uint32_t height, uint32_t sampleCount){
+    constexpr float PI = 3.1415926536f;
+    const glm::vec3 N(0.0f, 0.0f, 1.0f);
+    //importanceSample_GGX with N = +z: fixed frame, fixed jitter
+    const glm::vec3 tangentX = glm::normalize(glm::cross(glm::vec3(1.0f, 0.0f, 0.0f), N));
+    const glm::vec3 tangentY = glm::normalize(glm::cross(N, tangentX));
+    const float jitter = shaderRandom(N.x, N.z) * 0.1f;
+
+    std::vector<uint16_t> lut(size_t(width) * height * 2, 0);
+    util::parallelFor(int(height), 1, [&](int y){
+        const float roughness = (float(y) + 0.5f) / float(height);
+        const float alpha = roughness * roughness;
+        const float k = roughness * roughness / 2.0f;
+
+        for(uint32_t x = 0; x < width; ++x){
+            const float NdotV = (float(x) + 0.5f) / float(width);
+            const glm::vec3 V(std::sqrt(1.0f - NdotV * NdotV), 0.0f, NdotV);
+
+            float scale = 0.0f, bias = 0.0f;
+            for(uint32_t i = 0; i < sampleCount; ++i){
+                const float xi0 = float(i) / float(sampleCount);
+                const float xi1 = radicalInverse(i);
+                const float phi = 2.0f * PI * xi0 + jitter;
+                const float cosTheta = std::sqrt((1.0f - xi1) / (1.0f + (alpha * alpha - 1.0f) * xi1));
+                const float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+                const glm::vec3 H = glm::normalize(tangentX * (sinTheta * std::cos(phi)) +
+                                                   tangentY * (sinTheta * std::sin(phi)) + N * cosTheta);
+                const glm::vec3 L = 2.0f * glm::dot(V, H) * H - V;
+
+                const float NdotL = std::max(L.z, 0.0f);
+                const float VdotH = std::max(glm::dot(V, H), 0.0f);
+                const float NdotH = std::max(H.z, 0.0f);
+                if(NdotL > 0.0f){
+                    const float G = (NdotL / (NdotL * (1.0f - k) + k)) * (NdotV / (NdotV * (1.0f - k) + k));
+                    const float G_vis = (G * VdotH) / (NdotH * NdotV);
+                    const float Fc = std::pow(1.0f - VdotH, 5.0f);
+                    scale += (1.0f - Fc) * G_vis;
+                    bias  += Fc * G_vis;
+                }
+            }
+
+            uint16_t* texel = lut.data() + (size_t(y) * width + x) * 2;
+            texel[0] = floatToHalf(scale / float(sampleCount));
+            texel[1] = floatToHalf(bias / float(sampleCount));
+        }
+    });
+    return lut;
+}
+
+
+
+void writeBrdfLutInc(const std::vector<uint16_t>& lut, uint32_t width, uint32_t height, uint32_t sampleCount,
+                     const std::string& path){
+    const std::filesystem::path outPath(path);
+    if(outPath.has_parent_path()){
+        std::filesystem::create_directories(outPath.parent_path());}
+    const std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::trunc);
+        out << "//generated by JIBLBaker --brdf-inc, do not edit. " << width << "x" << height << " rg16f, "
+            << sampleCount << " samples\n";
+        char hex[16];
+        for(size_t i = 0; i < lut.size(); ++i){
+            std::snprintf(hex, sizeof(hex), "0x%04x,", lut[i]);
+            out << hex << ((i % 8 == 7) ? "\n" : " ");}
+        out << "\n";
+        if(!out) throw std::runtime_error("writeBrdfLutInc: failed to write " + tmpPath);
+    }
+    if(std::rename(tmpPath.c_str(), path.c_str()) != 0){
+        std::remove(tmpPath.c_str());
+        throw std::runtime_error("writeBrdfLutInc: failed to write " + path);}
+}
+
+
+
+std::vector<double> compareKtx2(const std::string& pathA, const std::string& pathB){
+    MappedFile fileA(pathA), fileB(pathB);
+    TexUtils::Ktx2Header a, b;
+    if(!TexUtils::parseKtx2Header(fileA, a) || !TexUtils::parseKtx2Header(fileB, b)) return {};
+    if(a.vkFormat != kBakedMapFormat || b.vkFormat != kBakedMapFormat ||
+       !TexUtils::isKtx2Readable(a) || !TexUtils::isKtx2Readable(b) ||
+       a.pixelWidth != b.pixelWidth || a.pixelHeight != b.pixelHeight ||
+       a.faceCount != b.faceCount || a.layerCount != b.layerCount) return {};
+
+    //raw or zstd, either way every level uncompressed in memory first
+    std::vector<VkDeviceSize> offsetsA, offsetsB;
+    std::vector<uint8_t> dataA(TexUtils::Ktx2LevelLayout(a, offsetsA)), dataB(TexUtils::Ktx2LevelLayout(b, offsetsB));
+    if(!TexUtils::ReadKtx2Levels(fileA, a, offsetsA, dataA.data()) || !TexUtils::ReadKtx2Levels(fileB, b, offsetsB, dataB.data())) return {};
+
+    const uint32_t levels = std::min(a.levelCount, b.levelCount);
+    std::vector<double> errors;
+    for(uint32_t level = 0; level < levels; ++level){
+        const uint64_t levelBytes = a.levels[level].uncompressedByteLength;
+        if(levelBytes != b.levels[level].uncompressedByteLength) return {};
+
+        //rms of the difference over rms of b, rgb only
+        const auto* ha = reinterpret_cast<const uint16_t*>(dataA.data() + offsetsA[level]);
+        const auto* hb = reinterpret_cast<const uint16_t*>(dataB.data() + offsetsB[level]);
+        double diff = 0.0, ref = 0.0;
+        for(size_t i = 0; i < levelBytes / 2; ++i){
+            if(i % 4 == 3) continue;
+            const double va = halfToFloat(ha[i]);
+            const double vb = halfToFloat(hb[i]);
+            diff += (va - vb) * (va - vb);
+            ref  += vb * vb;
+        }
+        errors.push_back(ref > 0.0 ? std::sqrt(diff / ref) : std::sqrt(diff));
+    }
+    return errors;
+}
+
+} // namespace CpuIBL
+
+
+
@@ -0,0 +1,77 @@
+//cpu versions of the ibl bakes (PrecomputeSystem, computePrefilIrrad.comp) and the brdf lut the viewer is built with.
+//no device, no window: same sample tables (precomputeCommon), same math, same ktx2 layout as the files the viewer writes
+#pragma once
+#include <immintrin.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+
+
+//6 faces x mips of rgba float. sampled like a samplerCube, written out as rgba16f ktx2 (zstd)
+class JCpuCubemap{
+public:
+    JCpuCubemap(uint32_t faceSize, uint32_t mipLevels);
+
+    //equirect (.hdr or anything stbi reads) -> cube + full mip chain. the same cube JCubemap's cpu path builds:
+    //face size = width / 4, faces rounded to half, mips 2x2 box filtered in half like the blit chain
+    static JCpuCubemap fromEquirect(const std::string& path);
+
+    uint32_t faceSize() const                       {return faceSize_;}
+    uint32_t mipLevels() const                      {return mipLevels_;}
+    uint32_t levelSize(uint32_t mip) const          {return std::max(1u, faceSize_ >> mip);}
+    //what JCubemap::getContentHash is for the same file, 0 if it was not loaded from one
+    uint64_t contentHash() const                    {return contentHash_;}
+
+    float* face(uint32_t mip, uint32_t face)              {return texels_.data() + levelOffsets_[mip] + faceOffset(mip, face);}
+    const float* face(uint32_t mip, uint32_t face) const  {return texels_.data() + levelOffsets_[mip] + faceOffset(mip, face);}
+
+    //textureLod(samplerCube, dir, lod): vulkan face selection, linear + mip linear, clamp to edge.
+    //filtering does not cross face edges (the gpu's seamless cube does), only the outermost texel ring differs
+    __m128 sample(const glm::vec3& dir, float lod) const;
+
+    //first levelCount mips, rgba16f zstd, faceCount 6
+    void writeKtx2(const std::string& path, uint32_t levelCount) const;
+
+private:
+    uint32_t faceSize_;
+    uint32_t mipLevels_;
+    uint64_t contentHash_{0};
+    std::vector<size_t> levelOffsets_;              //in floats
+    std::vector<float>  texels_;
+
+    size_t faceOffset(uint32_t mip, uint32_t face) const {return size_t(face) * levelSize(mip) * levelSize(mip) * 4;}
+    __m128 bilinear(uint32_t mip, uint32_t face, float s, float t) const;
+};
+
+
+
+namespace CpuIBL{
+
+//PrecomputeSystem's bake: mip i gets budgets[i] samples (calibrate, or a flat count for a reference bake).
+//ggx mip 0 is a mirror, one sample is exact there. rows go over all threads
+JCpuCubemap prefilter(const JCpuCubemap& env, uint32_t distribution, uint32_t faceSize, uint32_t levelCount,
+                      const std::vector<uint32_t>& budgets);
+
+//PrecomputeSystem's calibration on the cpu: same candidates, probe, reference and error rule (precomputeCommon),
+//samples per mip for prefilter
+std::vector<uint32_t> calibrate(const JCpuCubemap& env, uint32_t distribution, uint32_t faceSize, uint32_t levelCount,
+                                uint32_t sampleCount, float maxError);
+
+//split sum lut: x = NdotV, y = roughness, rg16f = scale / bias on F0. rows go over all threads.
+//only runs at build time (--brdf-inc), the viewer has the result compiled in (Renderers/brdfLut.hpp)
+std::vector<uint16_t> brdfLut(uint32_t width, uint32_t height, uint32_t sampleCount);
+
+//lut as the body of a uint16_t array initializer, 8 halfs a line. written to path + ".tmp", then renamed
+void writeBrdfLutInc(const std::vector<uint16_t>& lut, uint32_t width, uint32_t height, uint32_t sampleCount,
+                     const std::string& path);
+
+//relative rms of rgb per mip between two rgba16f ktx2 files (raw or zstd) of the same shape (eg. gpu bake vs cpu
+//reference). empty when the files cant be read or dont match
+std::vector<double> compareKtx2(const std::string& pathA, const std::string& pathB);
+
+} // namespace CpuIBL
+
+
+
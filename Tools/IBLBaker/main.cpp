@@ -0,0 +1,183 @@
+//JIBLBaker: bakes the prefiltered envmap on the cpu, no gpu / window needed (eg. render nodes without one).
+//calibrates the per mip budgets like the viewer and writes the same ktx2 under the same manifest key, so the viewer
+//loads it instead of baking. --compare against a gpu bake is the parity check.
+//also the build step for the brdf lut the viewer has compiled in (--brdf-inc, see CMakeLists.txt)
+//
+//  JIBLBaker <equirect.hdr> [--out ../data] [--samples 2048] [--shaders ../shaders]
+//            [--irradiance [--irradiance-size N] [--irradiance-samples 2048]]
+//                        --irradiance: also irradianceMap.ktx, debug output only (the viewer uses sh9, never reads it)
+//  JIBLBaker --compare <a.ktx> <b.ktx> [--tolerance 0.02]      exit code 1 if any mip is further apart
+//  JIBLBaker --brdf-inc <brdfLut.inc> [--brdf-size 256] [--brdf-samples 1024]
+#include "VulkanCore/material/imageDecode.hpp"
+//stbi output buffers go through the same hooks as the viewer's, see TexUtils::decodeInto
+#define STBI_MALLOC(sz)         TexUtils::detail::stbiMalloc(sz)
+#define STBI_REALLOC(p, newsz)  TexUtils::detail::stbiRealloc(p, newsz)
+#define STBI_FREE(p)            TexUtils::detail::stbiFree(p)
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+#include "cpuIBL.hpp"
+#include "Renderers/precomputeCommon.hpp"
+#include "VulkanCore/material/cubemapUtils.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+
+
+namespace{
+
+struct Options{
+    std::string input;
+    std::string outDir              = std::filesystem::path(kPrefilterEnvMapPath).parent_path().string();
+    std::string shaderDir           = "../shaders";
+    uint32_t    samples             = kPrefilterSampleCount;   //ceiling of the calibrated budgets, like the viewer's
+    bool        irradiance          = false;
+    uint32_t    irradianceSize      = 0;                //0: face size of the source
+    uint32_t    irradianceSamples   = kPrefilterSampleCount;
+    uint32_t    brdfSize            = kBrdfLutSize;
+    uint32_t    brdfSamples         = kBrdfSampleCount;
+
+    std::string brdfInc;
+    std::string compareA, compareB;
+    double      tolerance           = 0.02;
+};
+
+void printUsage(){
+    std::cout << "usage: JIBLBaker <equirect.hdr> [--out dir] [--samples n] [--shaders dir]\n"
+                 "                 [--irradiance [--irradiance-size n] [--irradiance-samples n]]\n"
+                 "       JIBLBaker --compare <a.ktx> <b.ktx> [--tolerance x]\n"
+                 "       JIBLBaker --brdf-inc <file> [--brdf-size n] [--brdf-samples n]" << std::endl;
+}
+
+bool parseArgs(int argc, char** argv, Options& options){
+    for(int i = 1; i < argc; ++i){
+        const std::string arg = argv[i];
+        auto next = [&]() -> const char*{
+            if(i + 1 >= argc) throw std::runtime_error("missing value after " + arg);
+            return argv[++i];};
+        auto nextUint = [&](){return static_cast<uint32_t>(std::stoul(next()));};
+
+        if(arg == "--out")                      options.outDir = next();
+        else if(arg == "--shaders")             options.shaderDir = next();
+        else if(arg == "--samples")             options.samples = nextUint();
+        else if(arg == "--irradiance")          options.irradiance = true;
+        else if(arg == "--irradiance-size")     options.irradianceSize = nextUint();
+        else if(arg == "--irradiance-samples")  options.irradianceSamples = nextUint();
+        else if(arg == "--brdf-size")           options.brdfSize = nextUint();
+        else if(arg == "--brdf-samples")        options.brdfSamples = nextUint();
+        else if(arg == "--tolerance")           options.tolerance = std::stod(next());
+        else if(arg == "--brdf-inc")            options.brdfInc = next();
+        else if(arg == "--compare"){
+            options.compareA = next();
+            options.compareB = next();}
+        else if(arg == "-h" || arg == "--help") return false;
+        else if(!arg.empty() && arg[0] == '-')  throw std::runtime_error("unknown option " + arg);
+        else                                    options.input = arg;
+    }
+    return !options.input.empty() || !options.compareA.empty() || !options.brdfInc.empty();
+}
+
+double msSince(std::chrono::steady_clock::time_point start){
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+int compare(const Options& options){
+    const std::vector<double> errors = CpuIBL::compareKtx2(options.compareA, options.compareB);
+    if(errors.empty()){
+        std::cerr << "compare: " << options.compareA << " and " << options.compareB
+                  << " are not the same shape of rgba16f ktx2 (raw or zstd)" << std::endl;
+        return 2;}
+
+    bool pass = true;
+    for(size_t mip = 0; mip < errors.size(); ++mip){
+        pass = pass && errors[mip] <= options.tolerance;
+        std::cout << "mip " << mip << " relative rms " << errors[mip]
+                  << (errors[mip] <= options.tolerance ? "" : "  > tolerance") << std::endl;}
+    std::cout << (pass ? "PASS" : "FAIL") << std::endl;
+    return pass ? 0 : 1;
+}
+
+
+//rg16f lut as an array initializer, Engine/Renderers/brdfLut.cpp includes it
+int bakeBrdfLut(const Options& options){
+    const auto start = std::chrono::steady_clock::now();
+    const std::vector<uint16_t> lut = CpuIBL::brdfLut(options.brdfSize, options.brdfSize, options.brdfSamples);
+    CpuIBL::writeBrdfLutInc(lut, options.brdfSize, options.brdfSize, options.brdfSamples, options.brdfInc);
+    std::cout << "DEBUG: " << options.brdfInc << " baked in " << msSince(start) << " ms" << std::endl;
+    return 0;
+}
+
+
+int bake(const Options& options){
+    const std::filesystem::path outDir(options.outDir);
+    const std::string prefilterPath  = (outDir / std::filesystem::path(kPrefilterEnvMapPath).filename()).string();
+    const std::string irradiancePath = (outDir / "irradianceMap.ktx").string();
+    PrecomputeManifest manifest((outDir / std::filesystem::path(kPrecomputeManifestPath).filename()).string());
+
+    //spir-v hash is part of the manifest entries, same fields as the viewer's. without the .spv the file is still
+    //written, the manifest is not updated
+    const uint64_t prefilterSpirvHash = hashFileContent(options.shaderDir + "/computePrefilIrrad.comp.spv");
+
+    auto start = std::chrono::steady_clock::now();
+    const JCpuCubemap env = JCpuCubemap::fromEquirect(options.input);
+    std::cout << "DEBUG: source cube ready in " << msSince(start) << " ms" << std::endl;
+
+    //prefiltered envmap, every mip of the source face size, the viewer's per mip budgets.
+    //shared with the viewer through the manifest: whichever calibrated this sky first, the other just takes them
+    const float maxError = maxSampleErrorFromEnv();
+    const uint64_t budgetsKey = calibrationKey(env.contentHash(), env.faceSize(), Distribution_GGX, options.samples, maxError);
+    start = std::chrono::steady_clock::now();
+    std::vector<uint32_t> budgets = manifest.calibratedBudgets(budgetsKey, env.mipLevels());
+    if(budgets.empty()){
+        budgets = CpuIBL::calibrate(env, Distribution_GGX, env.faceSize(), env.mipLevels(), options.samples, maxError);
+        manifest.recordBudgets(budgetsKey, budgets);
+        std::cout << "DEBUG: calibrated in " << msSince(start) << " ms, samples per mip:";}
+    else{
+        std::cout << "DEBUG: calibrated before (manifest), samples per mip:";}
+    for(uint32_t budget : budgets){
+        std::cout << " " << budget;}
+    std::cout << std::endl;
+
+    start = std::chrono::steady_clock::now();
+    const JCpuCubemap prefiltered = CpuIBL::prefilter(env, Distribution_GGX, env.faceSize(), env.mipLevels(), budgets);
+    prefiltered.writeKtx2(prefilterPath, prefiltered.mipLevels());
+    std::cout << "DEBUG: " << prefilterPath << " baked in " << msSince(start) << " ms" << std::endl;
+    if(prefilterSpirvHash != 0){
+        manifest.record(prefilterCacheEntry(prefilterPath, env.contentHash(), env.faceSize(), Distribution_GGX,
+                                            options.samples, prefilterSpirvHash, maxError));}
+
+    //irradiance: debug output only, the viewer uses SH9 and never reads this file
+    if(options.irradiance){
+        start = std::chrono::steady_clock::now();
+        const uint32_t irradianceSize = options.irradianceSize ? options.irradianceSize : env.faceSize();
+        const JCpuCubemap irradiance = CpuIBL::prefilter(env, Distribution_Lambertian, irradianceSize, 1, {options.irradianceSamples});
+        irradiance.writeKtx2(irradiancePath, 1);
+        std::cout << "DEBUG: " << irradiancePath << " baked in " << msSince(start) << " ms" << std::endl;}
+
+    if(prefilterSpirvHash == 0){
+        std::cout << "no .spv under " << options.shaderDir << ", manifest not updated" << std::endl;}
+    return 0;
+}
+
+} // namespace
+
+
+
+int main(int argc, char** argv){
+    Options options;
+    try{
+        if(!parseArgs(argc, argv, options)){
+            printUsage();
+            return 2;}
+        if(!options.brdfInc.empty()) return bakeBrdfLut(options);
+        return options.compareA.empty() ? bake(options) : compare(options);
+    }
+    catch(const std::exception& e){
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
@@ -1,6 +1,14 @@
-/usr/bin/glslc shaders/shader.vert -o shaders/shader.vert.spv
-/usr/bin/glslc shaders/shader.frag -o shaders/shader.frag.spv
-/usr/bin/glslc shaders/skybox.vert -o shaders/skybox.vert.spv
-/usr/bin/glslc shaders/skybox.frag -o shaders/skybox.frag.spv
-/usr/bin/glslc shaders/BRDF_LUT.comp -o shaders/BRDF_LUT.comp.spv
-/usr/bin/glslc shaders/computePrefilIrrad.comp -o shaders/computePrefilIrrad.comp.spv
+#!/bin/sh
+# refresh the committed spir-v under shaders/prebuilt (what a build without glslc falls back to, see CMakeLists.txt)
+# run from the repo root after touching a shader
+set -e
+GLSLC=${GLSLC:-glslc}
+OUT=shaders/prebuilt
+mkdir -p $OUT
+$GLSLC shaders/shader.vert -o $OUT/shader.vert.spv
+$GLSLC shaders/shader.frag -o $OUT/shader.frag.spv
+$GLSLC -DBINDLESS shaders/shader.frag -o $OUT/shader_bindless.frag.spv
+$GLSLC shaders/skybox.vert -o $OUT/skybox.vert.spv
+$GLSLC shaders/skybox.frag -o $OUT/skybox.frag.spv
+$GLSLC shaders/computePrefilIrrad.comp -o $OUT/computePrefilIrrad.comp.spv
+$GLSLC shaders/equirectToCube.comp -o $OUT/equirectToCube.comp.spv
@@ -1,14 +1,33 @@
 #version 450
+#ifdef BINDLESS
+// before any declaration (common.sp has some)
+#extension GL_EXT_nonuniform_qualifier : require
+#endif
 #include "common.sp"  //where camera matrix
 
+#ifdef BINDLESS
+// compiled with -DBINDLESS: one texture table for all materials, material picked by push.materialIndex
+layout (set = 2, binding = 0) uniform sampler2D textures[];
+struct Material{
+	uint albedo;
+	uint orm;
+	uint normal;
+	uint pad;
+};
+layout (std430, set = 2, binding = 1) readonly buffer Materials{
+	Material materials[];
+};
+#define albedoMap	textures[nonuniformEXT(materials[push.materialIndex].albedo)]
+#define ormMap		textures[nonuniformEXT(materials[push.materialIndex].orm)]
+#define normalMap	textures[nonuniformEXT(materials[push.materialIndex].normal)]
+#else
 layout (set = 2, binding = 0) uniform sampler2D albedoMap;
-layout (set = 2, binding = 1) uniform sampler2D roughnessMap;
-layout (set = 2, binding = 2) uniform sampler2D metallicMap;
-layout (set = 2, binding = 3) uniform sampler2D normalMap;
+layout (set = 2, binding = 1) uniform sampler2D ormMap;  // r: occlusion, g: roughness, b: metallic
+layout (set = 2, binding = 2) uniform sampler2D normalMap;
+#endif
 
 layout (set = 1, binding = 1) uniform sampler2D samplerBRDFLUT;
-layout (set = 1, binding = 2) uniform samplerCube samplerIrradiance;
-layout (set = 1, binding = 3) uniform samplerCube prefilteredMap;
+layout (set = 1, binding = 2) uniform samplerCube prefilteredMap;
 
 layout(location = 0) in vec3 inWorldPos;
 layout(location = 1) in vec3 inNormal;
@@ -30,6 +49,9 @@ layout(push_constant) uniform Push{
     int inputRoughnessPath;
     int inputMetallicPath;
     int inputNormalPath;
+    int inputOcclusionPath;
+
+    int materialIndex;
 }push;
 
 
@@ -78,6 +100,21 @@ vec3 F_SchlickR(float cosTheta, vec3 F0, float roughness)
 	return F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(1.0 - cosTheta, 5.0);
 }
 
+// diffuse irradiance from the sh9 in the global ubo (projected on the cpu, already cosine convolved)
+vec3 irradianceSH9(vec3 N)
+{
+	vec3 result = ubo.irradianceSH[0].rgb * 0.282095;
+	result += ubo.irradianceSH[1].rgb * 0.488603 * N.y;
+	result += ubo.irradianceSH[2].rgb * 0.488603 * N.z;
+	result += ubo.irradianceSH[3].rgb * 0.488603 * N.x;
+	result += ubo.irradianceSH[4].rgb * 1.092548 * N.x * N.y;
+	result += ubo.irradianceSH[5].rgb * 1.092548 * N.y * N.z;
+	result += ubo.irradianceSH[6].rgb * 0.315392 * (3.0 * N.z * N.z - 1.0);
+	result += ubo.irradianceSH[7].rgb * 1.092548 * N.x * N.z;
+	result += ubo.irradianceSH[8].rgb * 0.546274 * (N.x * N.x - N.y * N.y);
+	return max(result, vec3(0.0));	// ringing can go slightly negative
+}
+
 vec3 prefilteredReflection(vec3 R, float roughness)
 {	
 	float maxLod = float(textureQueryLevels(prefilteredMap) - 1.0f);
@@ -186,16 +223,21 @@ void main()
 		albedo = push.baseColor;
 	}
 
+	// one fetch for occlusion, roughness and metallic
+	vec3 orm = texture(ormMap, inUV).rgb;
+	// toggled off: the packed map may still hold the last loaded ao
+	float occlusion = push.inputOcclusionPath == 1 ? orm.r : 1.0;
+
 	float metallic;
 	if(push.inputMetallicPath == 1){
-		metallic = texture(metallicMap, inUV).r;
+		metallic = orm.b;
 	}else{
 		metallic = push.metallic;
 	}
 
 	float roughness;
 	if(push.inputRoughnessPath == 1){
-		roughness = texture(roughnessMap, inUV).r;
+		roughness = orm.g;
 	}else{
 		roughness = push.roughness;
 	}
@@ -212,7 +254,7 @@ void main()
 	
 	vec2 brdf = texture(samplerBRDFLUT, vec2(max(dot(N, V), 0.0), roughness)).rg;
 	vec3 reflection = prefilteredReflection(R, roughness).rgb;	
-	vec3 irradiance = texture(samplerIrradiance, N).rgb;
+	vec3 irradiance = irradianceSH9(N);
 
 	// Diffuse based on irradiance
 	vec3 diffuse = irradiance * albedo;	
@@ -223,11 +265,10 @@ void main()
 	vec3 specular = reflection * (F * brdf.x + brdf.y);
 
 
-	// Ambient part (i dont use ao for now)
+	// Ambient part
 	vec3 kD = 1.0 - F;
 	kD *= 1.0 - metallic;	  
-	// vec3 ambient = (kD * diffuse + specular) * texture(aoMap, inUV).rrr;
-    vec3 ambient = (kD * diffuse + specular);
+    vec3 ambient = (kD * diffuse + specular) * occlusion;
 
 
 	vec3 color = ambient + Lo;
@@ -248,7 +289,7 @@ void main()
 	// color = pow(color, vec3(1.0f / 2.2f)); // Standard sRGB gamma
 
 	outColor = vec4(color, 1.0);
-	// outColor = vec4(texture(samplerIrradiance, N).rgb, 1.0);
+	// outColor = vec4(irradianceSH9(N), 1.0);
 }
 
 